@@ -0,0 +1,396 @@
+/*
+ * aio_pool - asynchronous disk reads for event loops (server.aio-threads)
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+#include "first.h"
+
+#include "aio_pool.h"
+
+#include "base.h"
+#include "connections.h"
+#include "fdevent.h"
+#include "log.h"
+
+#if defined(HAVE_THREADS) && defined(HAVE_PREADV2)
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef RWF_NOWAIT
+#define AIO_POOL_SUPPORTED
+#endif
+
+#endif
+
+#ifdef AIO_POOL_SUPPORTED
+
+/* read ahead into page cache up to this much of a file chunk per job
+ * (larger than MAX_WRITE_LIMIT so that subsequent writes find pages cached) */
+#define AIO_POOL_PREFETCH (1024*1024)
+
+typedef struct aio_job {
+    struct aio_job *next;
+    struct aio_loop *loop;
+    connection *con;
+    uint32_t gen;       /* con->aio_gen at submit; stale if con reset */
+    int fd;             /* dup() of file chunk fd */
+    off_t off;
+    off_t len;
+} aio_job;
+
+typedef struct aio_loop {
+    int fds[2];         /* completion notification pipe */
+    fdnode *fdn;
+    server *srv;
+    aio_job *done;      /* completed jobs (protected by aio_pool.mtx) */
+    uint32_t active;    /* jobs in progress in workers (aio_pool.mtx) */
+} aio_loop;
+
+static struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;      /* job queued or pool stopping */
+    pthread_cond_t idle;      /* job completed */
+    aio_job *head;
+    aio_job **tail;
+    pthread_t *tids;
+    uint32_t nthreads;
+    int stop;
+    long pagesz;
+} aio_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+               PTHREAD_COND_INITIALIZER, NULL, &aio_pool.head,
+               NULL, 0, 0, 4096 };
+
+/* preadv2() RWF_NOWAIT may be unsupported by kernel or by filesystem;
+ * cleared (atomic) on first such failure and probing is skipped thereafter */
+static int aio_pool_nowait = 1;
+
+
+static void aio_pool_read (const aio_job * const job)
+{
+    /* fault pages into page cache; data is discarded */
+    char buf[65536];
+    off_t off = job->off;
+    off_t len = job->len;
+    while (len > 0) {
+        const ssize_t rd =
+          pread(job->fd, buf, len < (off_t)sizeof(buf) ? (size_t)len : sizeof(buf), off);
+        if (rd > 0) {
+            off += rd;
+            len -= rd;
+        }
+        else if (rd < 0 && errno == EINTR)
+            continue;
+        else
+            break; /*(error or EOF; left for network_write to report)*/
+    }
+}
+
+
+static void * aio_pool_worker (void *arg)
+{
+    UNUSED(arg);
+    pthread_mutex_lock(&aio_pool.mtx);
+    for (;;) {
+        aio_job * const job = aio_pool.head;
+        if (NULL == job) {
+            if (aio_pool.stop) break;
+            pthread_cond_wait(&aio_pool.cond, &aio_pool.mtx);
+            continue;
+        }
+        if (NULL == (aio_pool.head = job->next))
+            aio_pool.tail = &aio_pool.head;
+        aio_loop * const loop = job->loop;
+        ++loop->active;
+        pthread_mutex_unlock(&aio_pool.mtx);
+
+        aio_pool_read(job);
+
+        pthread_mutex_lock(&aio_pool.mtx);
+        job->next = loop->done;
+        loop->done = job;
+        if (NULL == job->next) /* notify loop if done list was empty */
+            (void)(write(loop->fds[1], "", 1));
+        if (0 == --loop->active)
+            pthread_cond_broadcast(&aio_pool.idle);
+    }
+    pthread_mutex_unlock(&aio_pool.mtx);
+    return NULL;
+}
+
+
+static void aio_pool_jobs_free (aio_job *job, server * const srv)
+{
+    while (job) {
+        aio_job * const next = job->next;
+        close(job->fd);
+        --srv->cur_fds;
+        free(job);
+        job = next;
+    }
+}
+
+
+static handler_t aio_pool_handle_fdevent (void *ctx, int revents)
+{
+    aio_loop * const loop = ctx;
+    UNUSED(revents);
+
+    /* drain notification pipe before taking done list (see aio_pool_worker)*/
+    char buf[64];
+    while (read(loop->fds[0], buf, sizeof(buf)) > 0) ;
+
+    pthread_mutex_lock(&aio_pool.mtx);
+    aio_job * const done = loop->done;
+    loop->done = NULL;
+    pthread_mutex_unlock(&aio_pool.mtx);
+
+    for (aio_job *job = done; job; job = job->next) {
+        connection * const con = job->con;
+        if (con->aio_gen == job->gen && con->aio_wait) {
+            con->aio_wait = 0;
+            con->is_writable = 1;
+            joblist_append(con);
+        }
+    }
+    aio_pool_jobs_free(done, loop->srv);
+
+    return HANDLER_GO_ON;
+}
+
+
+static int aio_pool_submit (connection * const con, const int fd, const off_t off, const off_t len)
+{
+    server * const srv = con->srv;
+    aio_job * const job = malloc(sizeof(*job));
+    if (NULL == job) return 0;
+    /* dup() fd so that worker read is independent of chunk lifetime */
+    job->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (-1 == job->fd) {
+        free(job);
+        return 0;
+    }
+    ++srv->cur_fds;
+    job->next = NULL;
+    job->loop = srv->aio;
+    job->con = con;
+    job->gen = ++con->aio_gen;
+    job->off = off;
+    job->len = len;
+
+    pthread_mutex_lock(&aio_pool.mtx);
+    *aio_pool.tail = job;
+    aio_pool.tail = &job->next;
+    pthread_cond_signal(&aio_pool.cond);
+    pthread_mutex_unlock(&aio_pool.mtx);
+    return 1;
+}
+
+
+static int aio_pool_resident (const int fd, const off_t off)
+{
+    char c;
+    struct iovec iov = { &c, 1 };
+    if (preadv2(fd, &iov, 1, off, RWF_NOWAIT) >= 0) return 1;
+    switch (errno) {
+      case EAGAIN:
+        return 0;
+      case ENOSYS:
+      case EOPNOTSUPP:
+      case EINVAL:
+        __atomic_store_n(&aio_pool_nowait, 0, __ATOMIC_RELAXED);
+        return 1;
+      default:
+        return 1; /*(error left for network_write to report)*/
+    }
+}
+
+
+off_t aio_pool_check (connection * const con, const chunkqueue * const cq, off_t max_bytes)
+{
+    if (!__atomic_load_n(&aio_pool_nowait, __ATOMIC_RELAXED)) return max_bytes;
+
+    /* MEM_CHUNKs at head of queue are written without disk access */
+    off_t memb = 0;
+    const chunk *c = cq->first;
+    for (; c && c->type == MEM_CHUNK; c = c->next) {
+        memb += (off_t)buffer_string_length(c->mem) - c->offset;
+        if (memb >= max_bytes) return max_bytes;
+    }
+    if (NULL == c || c->file.fd < 0) return max_bytes;
+  #ifdef HAVE_SPLICE
+    if (chunk_is_pipe(c)) return max_bytes;
+  #endif
+
+    /* probe first and last page of the range to be written */
+    const off_t rem = c->file.length - c->offset;
+    const off_t len = (max_bytes - memb < rem) ? max_bytes - memb : rem;
+    const off_t off = c->file.start + c->offset;
+    if (len <= 0
+        || (aio_pool_resident(c->file.fd, off)
+            && (len <= aio_pool.pagesz
+                || aio_pool_resident(c->file.fd, off + len - 1))))
+        return max_bytes;
+
+    if (!aio_pool_submit(con, c->file.fd, off,
+                         rem < AIO_POOL_PREFETCH ? rem : AIO_POOL_PREFETCH))
+        return max_bytes; /*(fall back to blocking write)*/
+
+    con->aio_wait = 1;
+    return memb;
+}
+
+
+void aio_pool_loop_init (server * const srv)
+{
+    srv->aio = NULL;
+    if (0 == aio_pool.nthreads) return;
+
+    aio_loop * const loop = calloc(1, sizeof(*loop));
+    force_assert(loop);
+    if (0 != pipe2(loop->fds, O_CLOEXEC | O_NONBLOCK)) {
+        log_perror(srv->errh, __FILE__, __LINE__,
+          "pipe2() failed; server.aio-threads disabled in event loop");
+        free(loop);
+        return;
+    }
+    srv->cur_fds += 2;
+    loop->srv = srv;
+    loop->fdn = fdevent_register(srv->ev, loop->fds[0],
+                                 aio_pool_handle_fdevent, loop);
+    fdevent_fdnode_event_set(srv->ev, loop->fdn, FDEVENT_IN);
+    srv->aio = loop;
+}
+
+
+void aio_pool_loop_free (server * const srv)
+{
+    aio_loop * const loop = srv->aio;
+    if (NULL == loop) return;
+    srv->aio = NULL;
+
+    /* remove queued jobs for loop and wait for jobs in progress */
+    pthread_mutex_lock(&aio_pool.mtx);
+    aio_job *cancel = NULL;
+    for (aio_job **jp = &aio_pool.head; *jp; ) {
+        aio_job * const job = *jp;
+        if (job->loop == loop) {
+            *jp = job->next;
+            job->next = cancel;
+            cancel = job;
+        }
+        else
+            jp = &job->next;
+    }
+    aio_pool.tail = &aio_pool.head;
+    while (*aio_pool.tail) aio_pool.tail = &(*aio_pool.tail)->next;
+    while (loop->active)
+        pthread_cond_wait(&aio_pool.idle, &aio_pool.mtx);
+    aio_job * const done = loop->done;
+    loop->done = NULL;
+    pthread_mutex_unlock(&aio_pool.mtx);
+
+    aio_pool_jobs_free(cancel, srv);
+    aio_pool_jobs_free(done, srv);
+
+    fdevent_fdnode_event_del(srv->ev, loop->fdn);
+    fdevent_unregister(srv->ev, loop->fds[0]);
+    close(loop->fds[0]);
+    close(loop->fds[1]);
+    srv->cur_fds -= 2;
+    free(loop);
+}
+
+
+int aio_pool_init (server * const srv)
+{
+    const uint32_t n = srv->srvconf.aio_threads;
+    aio_pool.tids = calloc(n, sizeof(*aio_pool.tids));
+    force_assert(aio_pool.tids);
+    aio_pool.stop = 0;
+    const long pagesz = sysconf(_SC_PAGESIZE);
+    if (pagesz > 0) aio_pool.pagesz = pagesz;
+
+    /* workers do not handle (asynchronous) signals */
+    sigset_t sigs, osigs;
+    sigfillset(&sigs);
+    sigdelset(&sigs, SIGBUS);
+    sigdelset(&sigs, SIGSEGV);
+    sigdelset(&sigs, SIGFPE);
+    sigdelset(&sigs, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &sigs, &osigs);
+
+    int rc = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (0 != pthread_create(aio_pool.tids+i, NULL, aio_pool_worker, NULL)) {
+            log_perror(srv->errh, __FILE__, __LINE__, "pthread_create()");
+            rc = -1;
+            break;
+        }
+        ++aio_pool.nthreads;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &osigs, NULL);
+
+    if (0 == rc)
+        aio_pool_loop_init(srv);
+    return rc;
+}
+
+
+void aio_pool_free (server * const srv)
+{
+    aio_pool_loop_free(srv);
+    if (0 == aio_pool.nthreads) return;
+
+    pthread_mutex_lock(&aio_pool.mtx);
+    aio_pool.stop = 1;
+    pthread_cond_broadcast(&aio_pool.cond);
+    pthread_mutex_unlock(&aio_pool.mtx);
+    for (uint32_t i = 0; i < aio_pool.nthreads; ++i)
+        pthread_join(aio_pool.tids[i], NULL);
+    free(aio_pool.tids);
+    aio_pool.tids = NULL;
+    aio_pool.nthreads = 0;
+}
+
+#else /* !AIO_POOL_SUPPORTED */
+
+int aio_pool_init (server * const srv)
+{
+    log_error(srv->errh, __FILE__, __LINE__,
+      "server.aio-threads ignored; "
+      "preadv2() RWF_NOWAIT or threads not supported in this build");
+    srv->srvconf.aio_threads = 0;
+    return 0;
+}
+
+void aio_pool_free (server * const srv)
+{
+    UNUSED(srv);
+}
+
+void aio_pool_loop_init (server * const srv)
+{
+    srv->aio = NULL;
+}
+
+void aio_pool_loop_free (server * const srv)
+{
+    UNUSED(srv);
+}
+
+off_t aio_pool_check (connection * const con, const chunkqueue * const cq, off_t max_bytes)
+{
+    UNUSED(con);
+    UNUSED(cq);
+    return max_bytes;
+}
+
+#endif /* !AIO_POOL_SUPPORTED */
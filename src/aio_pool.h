@@ -0,0 +1,34 @@
+#ifndef INCLUDED_AIO_POOL_H
+#define INCLUDED_AIO_POOL_H
+#include "first.h"
+
+#include "base_decls.h"
+#include "chunk.h"
+
+/* asynchronous disk reads (server.aio-threads)
+ *
+ * Before writing a file chunk to a client, the event loop probes whether the
+ * pages to be sent are in the page cache (preadv2() RWF_NOWAIT).  If not, the
+ * read is handed to a pool of worker threads which fault the pages into the
+ * page cache, and the connection is parked (no write interest) until the
+ * worker signals completion to the event loop owning the connection.  The
+ * event loop thus does not block in sendfile(), mmap, or read() on cold
+ * files. */
+
+__attribute_cold__
+int aio_pool_init (server *srv);
+
+__attribute_cold__
+void aio_pool_free (server *srv);
+
+__attribute_cold__
+void aio_pool_loop_init (server *srv);
+
+__attribute_cold__
+void aio_pool_loop_free (server *srv);
+
+/* return max_bytes which may be written from cq without blocking on disk;
+ * 0 if connection is parked waiting for disk read to complete */
+off_t aio_pool_check (connection *con, const chunkqueue *cq, off_t max_bytes);
+
+#endif
@@ -8,6 +8,27 @@
 #include <stdlib.h>
 #include <limits.h>
 
+/* hash index of frozen array (see array_freeze())
+ * open addressing (linear probing) with load factor <= 1/2;
+ * slot[].i is index+1 into a->sorted[] (0 if slot is empty) */
+struct array_hidx {
+    uint32_t bits;
+    struct { uint32_t h; uint32_t i; } slot[];
+};
+
+/* (arrays with fewer elements are quickly binary searched) */
+#define ARRAY_FREEZE_MIN 16
+
+__attribute_cold__
+static void array_hidx_free(array * const a) {
+    free(a->hidx);
+    a->hidx = NULL;
+}
+
+static inline void array_thaw(array * const a) {
+    if (a->hidx) array_hidx_free(a);
+}
+
 __attribute_cold__
 static void array_extend(array * const a, uint32_t n) {
     a->size  += n;
@@ -15,6 +36,8 @@ static void array_extend(array * const a, uint32_t n) {
     a->sorted = realloc(a->sorted, sizeof(*a->sorted) * a->size);
     force_assert(a->data);
     force_assert(a->sorted);
+    heap_nallocs_inc();
+    heap_nallocs_inc();
     memset(a->data+a->used, 0, (a->size-a->used)*sizeof(*a->data));
 }
 
@@ -23,12 +46,14 @@ array *array_init(uint32_t n) {
 
 	a = calloc(1, sizeof(*a));
 	force_assert(a);
+	heap_nallocs_inc();
 	if (n) array_extend(a, n);
 
 	return a;
 }
 
 void array_free_data(array * const a) {
+	array_thaw(a);
 	if (a->sorted) free(a->sorted);
 	data_unset ** const data = a->data;
 	const uint32_t sz = a->size;
@@ -71,6 +96,7 @@ void array_reset_data_strings(array * const a) {
 	data_string ** const data = (data_string **)a->data;
 	const uint32_t used = a->used;
 	a->used = 0;
+	array_thaw(a);
 	for (uint32_t i = 0; i < used; ++i) {
 		data_string * const ds = data[i];
 		/*force_assert(ds->type == TYPE_STRING);*/
@@ -148,14 +174,71 @@ static int32_t array_get_index(const array * const a, const char * const k, cons
     return -(int)lower - 1;
 }
 
+__attribute_pure__
+static uint32_t array_hidx_hash(const char * const k, const size_t klen) {
+    /* djbhash() of key lowercased (as in array_caseless_compare()) */
+    const unsigned char * const s = (const unsigned char *)k;
+    uint32_t h = 5381;
+    for (size_t i = 0; i < klen; ++i)
+        h = ((h << 5) + h) ^ (s[i] | (((uint32_t)(s[i] - 'A') < 26) << 5));
+    return h;
+}
+
+__attribute_const__
+static inline uint32_t array_hidx_pos(const uint32_t h, const uint32_t bits) {
+    return (h * 0x9E3779B1u) >> (32 - bits); /*(scatter low-entropy djbhash)*/
+}
+
+void array_freeze(array * const a) {
+    array_thaw(a);
+    const uint32_t used = a->used;
+    if (used < ARRAY_FREEZE_MIN) return;
+    for (uint32_t i = 0; i < used; ++i) {
+        if (0 == a->sorted[i]->key.used) return; /*(list w/o keys; not a map)*/
+    }
+
+    uint32_t bits = 1;
+    while ((1u << bits) < used * 2) ++bits;
+    const uint32_t mask = (1u << bits) - 1;
+    struct array_hidx * const x =
+      calloc(1, sizeof(*x) + sizeof(x->slot[0]) * (mask + 1));
+    force_assert(x);
+    x->bits = bits;
+    for (uint32_t i = 0; i < used; ++i) {
+        const buffer * const k = &a->sorted[i]->key;
+        const uint32_t h = array_hidx_hash(k->ptr, k->used - 1);
+        uint32_t pos = array_hidx_pos(h, bits);
+        while (x->slot[pos].i) pos = (pos + 1) & mask;
+        x->slot[pos].h = h;
+        x->slot[pos].i = i + 1;
+    }
+    a->hidx = x;
+}
+
+__attribute_hot__
+__attribute_pure__
+static data_unset *array_hidx_get(const struct array_hidx * const x, data_unset * const * const sorted, const char * const k, const size_t klen) {
+    const uint32_t h = array_hidx_hash(k, klen);
+    const uint32_t mask = (1u << x->bits) - 1;
+    for (uint32_t pos = array_hidx_pos(h, x->bits); x->slot[pos].i; pos = (pos + 1) & mask) {
+        if (x->slot[pos].h != h) continue;
+        data_unset * const du = sorted[x->slot[pos].i - 1];
+        if (0 == array_keycmp(k, klen, du->key.ptr, du->key.used - 1))
+            return du;
+    }
+    return NULL;
+}
+
 __attribute_hot__
 data_unset *array_get_element_klen(const array * const a, const char *key, const size_t klen) {
+    if (a->hidx) return array_hidx_get(a->hidx, a->sorted, key, klen);
     const int32_t ipos = array_get_index(a, key, klen);
     return ipos >= 0 ? a->sorted[ipos] : NULL;
 }
 
 /* non-const (data_config *) for configparser.y (not array_get_element_klen())*/
 data_unset *array_get_data_unset(const array * const a, const char *key, const size_t klen) {
+    if (a->hidx) return array_hidx_get(a->hidx, a->sorted, key, klen);
     const int32_t ipos = array_get_index(a, key, klen);
     return ipos >= 0 ? a->sorted[ipos] : NULL;
 }
@@ -164,6 +247,8 @@ data_unset *array_extract_element_klen(array * const a, const char *key, const s
     const int32_t ipos = array_get_index(a, key, klen);
     if (ipos < 0) return NULL;
 
+    array_thaw(a);
+
     /* remove entry from a->sorted: move everything after pos one step left */
     data_unset * const entry = a->sorted[ipos];
     const uint32_t last_ndx = --a->used;
@@ -215,6 +300,7 @@ static data_unset *array_get_unused_element(array * const a, const data_type_t t
 static void array_insert_data_at_pos(array * const a, data_unset * const entry, const uint32_t pos) {
     /* This data structure should not be used for nearly so many entries */
     force_assert(a->used + 1 <= INT32_MAX);
+    array_thaw(a);
 
     if (a->size == a->used) {
         array_extend(a, 16);
@@ -23,12 +23,16 @@ typedef struct data_unset {
 	DATA_UNSET;
 } data_unset;
 
+struct array_hidx; /* opaque; see array_freeze() */
+
 typedef struct {
 	data_unset **data;
 	data_unset **sorted;
 
 	uint32_t used; /* <= INT32_MAX */
 	uint32_t size;
+
+	struct array_hidx *hidx; /* optional hash index of frozen array */
 } array;
 
 typedef struct {
@@ -94,6 +98,12 @@ int array_is_kvstring(const array *a);
 __attribute_pure__
 data_unset *array_get_element_klen(const array *a, const char *key, size_t klen);
 
+/* build hash index for O(1) array_get_element_klen() on arrays which are
+ * not modified after config load (e.g. mimetype.assign); any modification
+ * of array discards index (array reverts to binary search) */
+__attribute_cold__
+void array_freeze(array *a);
+
 __attribute_cold__
 __attribute_pure__
 data_unset *array_get_data_unset(const array *a, const char *key, size_t klen);
@@ -18,8 +18,10 @@
 #include "http_kv.h"
 #include "request.h"
 #include "sock_addr.h"
+#include "timer_wheel.h"
 
 struct fdevents;        /* declaration */
+struct h2con;           /* declaration */
 
 
 struct connection {
@@ -35,10 +37,13 @@ struct connection {
 	signed char is_writable;
 	char is_ssl_sock;
 	char traffic_limit_reached;
+	char aio_wait;               /* parked waiting for disk read (aio_pool) */
 
 	chunkqueue *write_queue;      /* a large queue for low-level write ( HTTP response ) [ file, mem ] */
 	chunkqueue *read_queue;       /* a small queue for low-level read ( HTTP request ) [ mem ] */
 
+	struct h2con *h2;             /* HTTP/2 connection state; NULL if HTTP/1.x */
+
 	off_t bytes_written;          /* used by mod_accesslog, mod_rrd */
 	off_t bytes_written_cur_second; /* used by mod_accesslog, mod_rrd */
 	off_t bytes_read;             /* used by mod_accesslog, mod_rrd */
@@ -59,9 +64,14 @@ struct connection {
 	time_t read_idle_ts;
 	time_t close_timeout_ts;
 	time_t write_request_ts;
+	uint64_t read_idle_ms;        /* (ms resolution; server.max-*-idle-ms) */
+	uint64_t write_request_ms;
+	time_t bytes_written_cur_ts;  /* second of bytes_written_cur_second */
+	tw_node timer;                /* next timeout check (srv->tw) */
 
 	time_t connection_start;
 	uint32_t request_count;      /* number of requests handled in this connection */
+	uint32_t aio_gen;            /* invalidates aio_pool jobs on reset */
 	int keep_alive_idle;         /* remember max_keep_alive_idle from config */
 
 	uint16_t proto_default_port;
@@ -90,9 +100,12 @@ typedef struct {
 	unsigned char http_host_normalize;
 	unsigned char http_method_get_body;
 	unsigned char high_precision_timestamps;
+	unsigned char h2proto; /* HTTP/2 enabled (server.feature-flags) */
 	unsigned short http_url_normalize;
 
 	unsigned short max_worker;
+	unsigned short threads;    /* event loop threads (server.threads) */
+	unsigned short aio_threads;/* disk read threads (server.aio-threads) */
 	unsigned short max_fds;
 	unsigned short max_conns;
 	unsigned short port;
@@ -129,6 +142,8 @@ typedef struct server_socket {
 
 	unsigned short is_ssl;
 	unsigned short sidx;
+	unsigned short reuseport;     /* 0: shared; else 1 + worker ndx */
+	unsigned short reuseport_cpu; /* SO_REUSEPORT group steered by CPU */
 
 	fdnode *fdn;
 	server *srv;
@@ -157,12 +172,17 @@ struct server {
 	connections joblist;
 	connections fdwaitqueue;
 
+	tw_wheel tw;    /* connection timeouts */
+	struct aio_loop *aio; /* disk read completions (server.aio-threads) */
+
 	/* counters */
 	int con_opened;
 	int con_read;
 	int con_written;
 	int con_closed;
 
+	uint32_t thread_ndx; /* event loop thread (server.threads); 0 is main */
+
 	int max_fds;    /* max possible fds */
 	int max_fds_lowat;/* low  watermark */
 	int max_fds_hiwat;/* high watermark */
@@ -10,6 +10,8 @@
 static const char hex_chars_lc[] = "0123456789abcdef";
 static const char hex_chars_uc[] = "0123456789ABCDEF";
 
+uint64_t heap_nallocs;
+
 /**
  * init the buffer
  *
@@ -20,6 +22,7 @@ buffer* buffer_init(void) {
 
 	b = malloc(sizeof(*b));
 	force_assert(b);
+	heap_nallocs_inc();
 
 	b->ptr = NULL;
 	b->size = 0;
@@ -80,6 +83,7 @@ static void buffer_realloc(buffer * const b, const size_t len) {
 
     b->size = sz;
     b->ptr = realloc(b->ptr, sz);
+    heap_nallocs_inc();
 
     force_assert(NULL != b->ptr);
 }
@@ -24,6 +24,23 @@ typedef struct {
 	uint32_t size;
 } buffer;
 
+/* count of heap allocations by buffers and by request-path objects (chunks,
+ * arrays, request arenas, connection, request and handler_ctx objects);
+ * reported by mod_status (RequestAllocations).  Since these are pooled and
+ * reused, under steady-state load the count should not increase with the
+ * number of requests served.  (counter is shared by threads (server.threads))
+ */
+extern uint64_t heap_nallocs;
+#ifdef HAVE_THREADS
+#define heap_nallocs_inc() \
+        __atomic_add_fetch(&heap_nallocs, 1, __ATOMIC_RELAXED)
+#define heap_nallocs_get() \
+        __atomic_load_n(&heap_nallocs, __ATOMIC_RELAXED)
+#else
+#define heap_nallocs_inc() (++heap_nallocs)
+#define heap_nallocs_get() (heap_nallocs)
+#endif
+
 /* create new buffer; either empty or copy given data */
 __attribute_returns_nonnull__
 buffer* buffer_init(void);
@@ -195,6 +212,11 @@ static inline int light_isalnum(int c) {
 	return light_isdigit(c) || light_isalpha(c);
 }
 
+#define light_bshift(b)           ((uint64_t)1uL << (b))
+#define light_btst(a,b)  ((a) &   ((uint64_t)1uL << (b)))
+#define light_bclr(a,b)  ((a) &= ~((uint64_t)1uL << (b)))
+#define light_bset(a,b)  ((a) |=  ((uint64_t)1uL << (b)))
+
 
 __attribute_pure__
 static inline uint32_t buffer_string_length(const buffer *b); /* buffer string length without terminating 0 */
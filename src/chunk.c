@@ -26,8 +26,10 @@
 #define MAX_TEMPFILE_SIZE (128 * 1024 * 1024)
 
 static size_t chunk_buf_sz = 8192;
-static chunk *chunks, *chunks_oversized;
-static chunk *chunk_buffers;
+/* (chunk pools are per-thread with server.threads) */
+static __thread_local chunk *chunks, *chunks_oversized;
+static __thread_local chunk *chunk_buffers;
+static __thread_local chunk *chunks_ref; /* chunk structs w/o buffer (mem_ref) */
 static const array *chunkqueue_default_tempdirs = NULL;
 static off_t chunkqueue_default_tempfile_size = DEFAULT_TEMPFILE_SIZE;
 
@@ -61,6 +63,7 @@ chunkqueue *chunkqueue_init(void) {
 
 	cq = calloc(1, sizeof(*cq));
 	force_assert(NULL != cq);
+	heap_nallocs_inc();
 
 	cq->first = NULL;
 	cq->last = NULL;
@@ -77,6 +80,7 @@ static chunk *chunk_init(size_t sz) {
 
 	c = calloc(1, sizeof(*c));
 	force_assert(NULL != c);
+	heap_nallocs_inc();
 
 	c->type = MEM_CHUNK;
 	c->mem = buffer_init();
@@ -85,6 +89,10 @@ static chunk *chunk_init(size_t sz) {
 	c->file.mmap.start = MAP_FAILED;
 	c->file.mmap.length = 0;
 	c->file.is_temp = 0;
+	c->file.ref = NULL;
+	c->file.refchg = 0;
+	c->file.pipe.wr = -1;
+	c->file.pipe.sz = 0;
 	c->offset = 0;
 	c->next = NULL;
 
@@ -93,11 +101,62 @@ static chunk *chunk_init(size_t sz) {
 	return c;
 }
 
+#ifdef HAVE_SPLICE
+
+/* (spare pipe is per-thread with server.threads) */
+static __thread_local struct { int fd[2]; int sz; } chunk_pipe_spare = {
+  { -1, -1 }, 0
+};
+
+static int chunk_pipe_acquire(int fds[2]) {
+	if (chunk_pipe_spare.fd[0] >= 0) {
+		fds[0] = chunk_pipe_spare.fd[0];
+		fds[1] = chunk_pipe_spare.fd[1];
+		chunk_pipe_spare.fd[0] = chunk_pipe_spare.fd[1] = -1;
+		return chunk_pipe_spare.sz;
+	}
+	if (0 != pipe2(fds, O_CLOEXEC | O_NONBLOCK)) return -1;
+	const int sz = fcntl(fds[0], F_GETPIPE_SZ);
+	return sz > 0 ? sz : 4096;
+}
+
+static void chunk_pipe_release(int rd, int wr, int sz) {
+	/* keep one (empty) pipe for reuse rather than close and reopen pipe
+	 * each time client has been sent all data in pipe */
+	int n;
+	if (chunk_pipe_spare.fd[0] < 0
+	    && 0 == fdevent_ioctl_fionread(rd, S_IFIFO, &n) && 0 == n) {
+		chunk_pipe_spare.fd[0] = rd;
+		chunk_pipe_spare.fd[1] = wr;
+		chunk_pipe_spare.sz = sz;
+	}
+	else {
+		close(rd);
+		close(wr);
+	}
+}
+
+#endif
+
 static void chunk_reset_file_chunk(chunk *c) {
+      #ifdef HAVE_SPLICE
+	if (c->file.pipe.wr >= 0) {
+		chunk_pipe_release(c->file.fd, c->file.pipe.wr, c->file.pipe.sz);
+		c->file.fd = -1;
+		c->file.pipe.wr = -1;
+		c->file.pipe.sz = 0;
+	}
+      #endif
 	if (c->file.is_temp && !chunk_buffer_string_is_empty(c->mem)) {
 		unlink(c->mem->ptr);
 	}
-	if (c->file.fd != -1) {
+	if (c->file.refchg) {
+		c->file.refchg(c->file.ref, -1);/*(fd closed by owner, if needed)*/
+		c->file.refchg = 0;
+		c->file.ref = NULL;
+		c->file.fd = -1;
+	}
+	else if (c->file.fd != -1) {
 		close(c->file.fd);
 		c->file.fd = -1;
 	}
@@ -180,6 +239,13 @@ static chunk * chunk_acquire(size_t sz) {
 }
 
 static void chunk_release(chunk *c) {
+    if (c->type == MEM_CHUNK && c->file.refchg) {
+        /*(c->mem is shared; see chunkqueue_append_mem_ref())*/
+        c->file.refchg(c->file.ref, -1);
+        c->next = chunks_ref;
+        chunks_ref = c;
+        return;
+    }
     const size_t sz = c->mem->size;
     if (sz == chunk_buf_sz) {
         chunk_reset(c);
@@ -210,6 +276,11 @@ void chunkqueue_chunk_pool_clear(void)
         chunk_free(c);
     }
     chunks_oversized = NULL;
+    for (chunk *next, *c = chunks_ref; c; c = next) {
+        next = c->next;
+        free(c);
+    }
+    chunks_ref = NULL;
 }
 
 void chunkqueue_chunk_pool_free(void)
@@ -221,6 +292,13 @@ void chunkqueue_chunk_pool_free(void)
         chunk_free(c);
     }
     chunk_buffers = NULL;
+  #ifdef HAVE_SPLICE
+    if (chunk_pipe_spare.fd[0] >= 0) {
+        close(chunk_pipe_spare.fd[0]);
+        close(chunk_pipe_spare.fd[1]);
+        chunk_pipe_spare.fd[0] = chunk_pipe_spare.fd[1] = -1;
+    }
+  #endif
 }
 
 __attribute_pure__
@@ -299,6 +377,17 @@ void chunkqueue_append_file_fd(chunkqueue * const restrict cq, const buffer * co
     }
 }
 
+void chunkqueue_append_file_fd_ref(chunkqueue * const restrict cq, const buffer * const restrict fn, int fd, off_t offset, off_t len, void *ref, void (*refchg)(void *, int)) {
+    /* fd is owned by ref; chunk holds a reference until chunk is released */
+    if (len > 0) {
+        chunk * const c = chunkqueue_append_file_chunk(cq, fn, offset, len);
+        c->file.fd = fd;
+        c->file.ref = ref;
+        c->file.refchg = refchg;
+        refchg(ref, 1);
+    }
+}
+
 void chunkqueue_append_file(chunkqueue * const restrict cq, const buffer * const restrict fn, off_t offset, off_t len) {
     if (len > 0) {
         chunkqueue_append_file_chunk(cq, fn, offset, len);
@@ -309,7 +398,7 @@ void chunkqueue_append_file(chunkqueue * const restrict cq, const buffer * const
 static int chunkqueue_append_mem_extend_chunk(chunkqueue * const restrict cq, const char * const restrict mem, size_t len) {
 	chunk *c = cq->last;
 	if (0 == len) return 1;
-	if (c != NULL && c->type == MEM_CHUNK
+	if (c != NULL && c->type == MEM_CHUNK && NULL == c->file.refchg
 	    && chunk_buffer_string_space(c->mem) >= len) {
 		buffer_append_string_len(c->mem, mem, len);
 		cq->bytes_in += len;
@@ -341,6 +430,34 @@ void chunkqueue_append_mem(chunkqueue * const restrict cq, const char * const re
 }
 
 
+void chunkqueue_append_mem_ref(chunkqueue * const restrict cq, buffer * const restrict mem, void *ref, void (*refchg)(void *, int)) {
+	/* mem is immutable and owned by ref; chunk holds a reference to ref
+	 * until chunk is released, and chunk is returned to separate pool of
+	 * chunk structs without buffers */
+	const size_t len = buffer_string_length(mem);
+	if (0 == len) return;
+	chunk *c = chunks_ref;
+	if (NULL != c) {
+		chunks_ref = c->next;
+		memset(c, 0, sizeof(*c));
+	}
+	else {
+		c = calloc(1, sizeof(*c));
+		force_assert(NULL != c);
+		heap_nallocs_inc();
+	}
+	c->type = MEM_CHUNK;
+	c->mem = mem;
+	c->file.fd = -1;
+	c->file.mmap.start = MAP_FAILED;
+	c->file.ref = ref;
+	c->file.refchg = refchg;
+	refchg(ref, 1);
+	chunkqueue_append_chunk(cq, c);
+	cq->bytes_in += len;
+}
+
+
 void chunkqueue_append_mem_min(chunkqueue * const restrict cq, const char * const restrict mem, size_t len) {
 	chunk *c;
 	if (len < chunk_buf_sz && chunkqueue_append_mem_extend_chunk(cq, mem, len))
@@ -409,7 +526,7 @@ char * chunkqueue_get_memory(chunkqueue * const restrict cq, size_t * const rest
 	size_t sz = *len ? *len : (chunk_buf_sz >> 1);
 	buffer *b;
 	chunk *c = cq->last;
-	if (NULL != c && MEM_CHUNK == c->type) {
+	if (NULL != c && MEM_CHUNK == c->type && NULL == c->file.refchg) {
 		/* return pointer into existing buffer if large enough */
 		size_t avail = chunk_buffer_string_space(c->mem);
 		if (avail >= sz) {
@@ -499,7 +616,20 @@ void chunkqueue_steal(chunkqueue * const restrict dest, chunkqueue * const restr
 				break;
 			case FILE_CHUNK:
 				/* tempfile flag is in "last" chunk after the split */
-				chunkqueue_append_file(dest, c->mem, c->file.start + c->offset, use);
+				if (c->file.refchg) {
+					chunkqueue_append_file_fd_ref(dest, c->mem, c->file.fd, c->file.start + c->offset, use, c->file.ref, c->file.refchg);
+				}
+				else {
+					/* share open fd (avoid reopen when split repeatedly,
+					 * e.g. into HTTP/2 DATA frames) */
+					int fd = c->file.fd >= 0 ? dup(c->file.fd) : -1;
+					if (fd >= 0) {
+						fdevent_setfd_cloexec(fd);
+						chunkqueue_append_file_fd(dest, c->mem, fd, c->file.start + c->offset, use);
+					}
+					else
+						chunkqueue_append_file(dest, c->mem, c->file.start + c->offset, use);
+				}
 				break;
 			}
 
@@ -548,6 +678,58 @@ static chunk *chunkqueue_get_append_tempfile(chunkqueue * const restrict cq, log
 	return c;
 }
 
+#ifdef HAVE_SPLICE
+ssize_t chunkqueue_append_splice_sock(chunkqueue * const restrict cq, const int fd, size_t len, log_error_st * const restrict errh) {
+	/* append to pipe chunk if last chunk in cq is pipe with available space
+	 * or else create pipe chunk only if cq is empty (all prior data sent),
+	 * limiting to a single pipe in cq (i.e. per request) if client can not
+	 * keep up; caller should fall back to read() into memory (or tempfile) */
+	chunk *c = cq->last;
+	ssize_t n;
+	if (NULL != c) {
+		if (!chunk_is_pipe(c)) return -2;
+		const off_t avail = c->file.pipe.sz - (c->file.length - c->offset);
+		if (avail <= 0) return -2;
+		if (len > (size_t)avail) len = (size_t)avail;
+		n = splice(fd, NULL, c->file.pipe.wr, NULL, len,
+		           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n > 0) {
+			c->file.length += n;
+			cq->bytes_in += n;
+		}
+		else if (n < 0 && (errno == EINVAL || errno == ENOSYS))
+			return -2;
+		return n;
+	}
+
+	int fds[2];
+	const int sz = chunk_pipe_acquire(fds);
+	if (sz < 0) {
+		log_perror(errh, __FILE__, __LINE__, "pipe2()");
+		return -2;
+	}
+	if (len > (size_t)sz) len = (size_t)sz;
+	n = splice(fd, NULL, fds[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (n <= 0) {
+		const int errnum = errno;
+		chunk_pipe_release(fds[0], fds[1], sz);
+		errno = errnum;
+		return (n < 0 && (errno == EINVAL || errno == ENOSYS)) ? -2 : n;
+	}
+
+	c = chunk_acquire(0);
+	chunkqueue_append_chunk(cq, c);
+	c->type = FILE_CHUNK;
+	c->file.start = 0;
+	c->file.length = n;
+	c->file.fd = fds[0];
+	c->file.pipe.wr = fds[1];
+	c->file.pipe.sz = sz;
+	cq->bytes_in += n;
+	return n;
+}
+#endif
+
 int chunkqueue_append_mem_to_tempfile(chunkqueue * const restrict dest, const char * restrict mem, size_t len, log_error_st * const restrict errh) {
 	chunk *dst_c;
 	ssize_t written;
@@ -779,7 +961,12 @@ void chunkqueue_compact_mem(chunkqueue *cq, size_t clen) {
     }
     for (chunk *fc = c; ((clen -= len) && (c = fc->next)); ) {
         len = buffer_string_length(c->mem) - c->offset;
-        if (len > clen) len = clen;
+        if (len > clen) {
+            /*(partial chunk; consolidate only what is needed)*/
+            buffer_append_string_len(b, c->mem->ptr + c->offset, clen);
+            c->offset += clen;
+            break;
+        }
         buffer_append_string_len(b, c->mem->ptr + c->offset, len);
         fc->next = c->next;
         if (NULL == c->next) cq->last = fc;
@@ -824,3 +1011,17 @@ int chunkqueue_open_file_chunk(chunkqueue * const restrict cq, log_error_st * co
 
 	return 0;
 }
+
+ssize_t chunk_file_pread(int fd, void *buf, size_t count, off_t offset) {
+    /* (fd might be shared, e.g. cached by stat_cache and used concurrently
+     *  by connections in other server threads, so do not lseek() fd) */
+  #ifdef HAVE_PREAD
+    ssize_t rd;
+    do {
+        rd = pread(fd, buf, count, offset);
+    } while (-1 == rd && errno == EINTR);
+    return rd;
+  #else
+    return (-1 != lseek(fd, offset, SEEK_SET)) ? read(fd, buf, count) : -1;
+  #endif
+}
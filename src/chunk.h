@@ -30,11 +30,17 @@ typedef struct chunk {
 
 		int    fd;
 		int is_temp; /* file is temporary and will be deleted if on cleanup */
+		void *ref;   /* owner of fd (or of mem, if MEM_CHUNK) if shared */
+		void (*refchg)(void *, int); /* adjust refcnt of ref (+1 or -1) */
 		struct {
 			char   *start; /* the start pointer of the mmap'ed area */
 			size_t length; /* size of the mmap'ed area */
 			off_t  offset; /* start is <n> octet away from the start of the file */
 		} mmap;
+		struct {
+			int wr; /* write end of pipe if fd is read end of pipe (splice) */
+			int sz; /* pipe capacity */
+		} pipe;
 	} file;
 } chunk;
 
@@ -66,7 +72,9 @@ void chunkqueue_set_tempdirs_default (const array *tempdirs, off_t upload_temp_f
 void chunkqueue_set_tempdirs(chunkqueue * restrict cq, const array * restrict tempdirs, off_t upload_temp_file_size);
 void chunkqueue_append_file(chunkqueue * restrict cq, const buffer * restrict fn, off_t offset, off_t len); /* copies "fn" */
 void chunkqueue_append_file_fd(chunkqueue * restrict cq, const buffer * restrict fn, int fd, off_t offset, off_t len); /* copies "fn" */
+void chunkqueue_append_file_fd_ref(chunkqueue * restrict cq, const buffer * restrict fn, int fd, off_t offset, off_t len, void *ref, void (*refchg)(void *, int)); /* copies "fn" */
 void chunkqueue_append_mem(chunkqueue * restrict cq, const char * restrict mem, size_t len); /* copies memory */
+void chunkqueue_append_mem_ref(chunkqueue * restrict cq, buffer * restrict mem, void *ref, void (*refchg)(void *, int)); /* references immutable "mem" owned by "ref" */
 void chunkqueue_append_mem_min(chunkqueue * restrict cq, const char * restrict mem, size_t len); /* copies memory */
 void chunkqueue_append_buffer(chunkqueue * restrict cq, buffer * restrict mem); /* may reset "mem" */
 void chunkqueue_append_chunkqueue(chunkqueue * restrict cq, chunkqueue * restrict src);
@@ -89,6 +97,19 @@ void chunkqueue_append_buffer_commit(chunkqueue *cq);
 
 int chunkqueue_append_mem_to_tempfile(chunkqueue * restrict cq, const char * restrict mem, size_t len, struct log_error_st * const restrict errh);
 
+#ifdef HAVE_SPLICE
+/* splice() up to len bytes from socket fd into pipe chunk at end of cq
+ * (data is moved in-kernel; written to client socket with splice())
+ * return bytes spliced, 0 on EOF, -1 on error (errno set),
+ * or -2 if no pipe chunk with available space (cq not empty) */
+ssize_t chunkqueue_append_splice_sock(chunkqueue * restrict cq, int fd, size_t len, struct log_error_st * restrict errh);
+
+static inline int chunk_is_pipe(const chunk *c);
+static inline int chunk_is_pipe(const chunk *c) {
+	return (c->type == FILE_CHUNK && c->file.pipe.wr >= 0);
+}
+#endif
+
 /* functions to handle buffers to read into: */
 /* obtain/reserve memory in chunkqueue at least len (input) size,
  * return pointer to memory with len (output) available for use
@@ -114,6 +135,8 @@ int chunkqueue_steal_with_tempfiles(chunkqueue * restrict dest, chunkqueue * res
 
 int chunkqueue_open_file_chunk(chunkqueue * restrict cq, struct log_error_st * const restrict errh);
 
+ssize_t chunk_file_pread(int fd, void *buf, size_t count, off_t offset);
+
 void chunkqueue_compact_mem(chunkqueue *cq, size_t clen);
 
 __attribute_pure__
@@ -15,6 +15,7 @@
 /* System */
 #cmakedefine  HAVE_SYS_DEVPOLL_H
 #cmakedefine  HAVE_SYS_EPOLL_H
+#cmakedefine  HAVE_LINUX_IO_URING_H
 #cmakedefine  HAVE_SYS_EVENT_H
 #cmakedefine  HAVE_SYS_LOADAVG_H
 #cmakedefine  HAVE_SYS_MMAN_H
@@ -73,6 +74,8 @@
 /* PCRE */
 #cmakedefine  HAVE_PCRE_H
 #cmakedefine  HAVE_LIBPCRE
+#cmakedefine  HAVE_PCRE2_H
+#cmakedefine  HAVE_LIBPCRE2
 
 #cmakedefine  HAVE_POLL_H
 #cmakedefine  HAVE_PWD_H
@@ -133,6 +136,7 @@
 #cmakedefine  HAVE_PORT_CREATE
 #cmakedefine  HAVE_PRCTL
 #cmakedefine  HAVE_PREAD
+#cmakedefine  HAVE_PREADV2
 #cmakedefine  HAVE_POSIX_FADVISE
 #cmakedefine  HAVE_SELECT
 #cmakedefine  HAVE_SENDFILE
@@ -142,6 +146,7 @@
 #cmakedefine  HAVE_SIGACTION
 #cmakedefine  HAVE_SIGNAL
 #cmakedefine  HAVE_SIGTIMEDWAIT
+#cmakedefine  HAVE_SPLICE
 #cmakedefine  HAVE_STRPTIME
 #cmakedefine  HAVE_SYSLOG
 #cmakedefine  HAVE_WRITEV
@@ -6,6 +6,7 @@
 #include "log.h"
 #include "http_header.h"
 #include "sock_addr.h"
+#include "splaytree.h"  /* djbhash() */
 
 #include "configfile.h"
 #include "plugin.h"
@@ -30,6 +31,24 @@ static struct {
     uint32_t used;                   /* (srv->config_context->used) */
 } config_reference;
 
+/* index of equality conditions (== and !=) on request values, so that a single
+ * hash lookup per request decides all such conditions on the same field
+ * (e.g. thousands of $HTTP["host"] == "..." vhost blocks) instead of a string
+ * compare per condition.  The lookup result is stored in the local_result of
+ * the matching conditions; the sentinel r->cond_cache[used + comp] records
+ * that the lookup for comp was done for the current request.  Preconditions
+ * (parent, else/elseif chain) are still evaluated for each condition. */
+typedef struct {
+    uint32_t h;
+    uint32_t ndx; /* context_ndx (0 if slot is empty) */
+} config_cond_slot;
+
+static struct {
+    uint8_t *indexed;                        /* [config_reference.used] */
+    config_cond_slot *slots[COMP_LAST_ELEMENT];
+    uint32_t bits[COMP_LAST_ELEMENT];
+} config_cond_index;
+
 
 void config_get_config_cond_info(config_cond_info * const cfginfo, uint32_t idx) {
     const data_config * const dc = (data_config *)config_reference.data[idx];
@@ -249,11 +268,14 @@ int config_plugin_values_init_block(server * const srv, const array * const ca,
 int config_plugin_values_init(server * const srv, void *p_d, const config_plugin_keys_t * const cpk, const char * const mname) {
     plugin_data_base * const p = (plugin_data_base *)p_d;
     array * const touched = srv->srvconf.config_touched;
-    unsigned char matches[4096];   /*directives matches (4k is way too many!)*/
-    unsigned short contexts[4096]; /*conditions matches (4k is way too many!)*/
+    /*(large vhost configs may have many thousands of conditions)*/
+    unsigned char * const matches =   /*directives matches*/
+      malloc(srv->config_context->used * sizeof(*matches));
+    uint32_t * const contexts =       /*conditions matches*/
+      malloc(srv->config_context->used * sizeof(*contexts));
+    force_assert(matches && contexts);
     uint32_t n = 0;
     int rc = 1; /* default is success */
-    force_assert(sizeof(matches) >= srv->config_context->used);
 
     /* save config reference data for later internal use
      * (config_plugin_values_init() is called with same srv->config_context) */
@@ -283,7 +305,7 @@ int config_plugin_values_init(server * const srv, void *p_d, const config_plugin
                   "variable: %s", cpk[i].k);
             }
         }
-        if (matches[n]) contexts[n++] = (unsigned short)u;
+        if (matches[n]) contexts[n++] = u;
     }
 
     uint32_t elts = 0;
@@ -315,6 +337,8 @@ int config_plugin_values_init(server * const srv, void *p_d, const config_plugin
             rc = 0;
     }
 
+    free(contexts);
+    free(matches);
     return rc;
 }
 
@@ -413,13 +437,177 @@ static int config_addrbuf_eq_remote_ip_mask(request_st * const r, const buffer *
 
 static int data_config_pcre_exec(const data_config *dc, cond_cache_t *cache, const buffer *b, cond_match_t *cond_match);
 
-static cond_result_t config_check_cond_nocache(request_st * const r, const data_config * const dc, const int debug_cond, cond_cache_t * const cache) {
-	static struct const_char_buffer {
-	  const char *ptr;
-	  uint32_t used;
-	  uint32_t size;
-	} empty_string = { "", 1, 0 };
+static struct const_char_buffer {
+  const char *ptr;
+  uint32_t used;
+  uint32_t size;
+} empty_string = { "", 1, 0 };
+
+__attribute_pure__
+static int config_cond_indexable(const data_config * const dc) {
+    if (dc->cond != CONFIG_COND_EQ && dc->cond != CONFIG_COND_NE) return 0;
+    if (buffer_is_empty(&dc->string)) return 0;
+    switch (dc->comp) {
+      case COMP_HTTP_HOST:
+        /* (no server-port appended or removed for comparison) */
+        return NULL == strchr(dc->string.ptr, ':');
+      case COMP_HTTP_REMOTE_IP:
+        /* (not netmask) */
+        return NULL == strchr(dc->string.ptr, '/');
+      case COMP_SERVER_SOCKET:
+      case COMP_HTTP_URL:
+      case COMP_HTTP_QUERY_STRING:
+      case COMP_HTTP_SCHEME:
+      case COMP_HTTP_REQUEST_METHOD:
+        return 1;
+      default:
+        return 0;
+    }
+}
 
+__attribute_const__
+static inline uint32_t config_cond_index_pos(const uint32_t h, const uint32_t bits) {
+    return (h * 0x9E3779B1u) >> (32 - bits); /*(scatter low-entropy djbhash)*/
+}
+
+void config_cond_index_init(server * const srv) {
+    const uint32_t used = config_reference.used;
+    uint32_t n[COMP_LAST_ELEMENT];
+    uint32_t indexed = 0, linear = 0;
+    if (used <= 1) return;
+
+    memset(n, 0, sizeof(n));
+    uint8_t * const x = calloc(used, sizeof(*x));
+    force_assert(x);
+    for (uint32_t i = 1; i < used; ++i) {
+        const data_config * const dc = config_reference.data[i];
+        if (dc->cond == CONFIG_COND_ELSE) continue;
+        if (config_cond_indexable(dc)) {
+            x[i] = 1;
+            ++n[dc->comp];
+            ++indexed;
+        }
+        else
+            ++linear;
+    }
+    if (0 == indexed) {
+        free(x);
+        return;
+    }
+    config_cond_index.indexed = x;
+
+    for (int comp = 0; comp < COMP_LAST_ELEMENT; ++comp) {
+        if (0 == n[comp]) continue;
+        uint32_t bits = 1;
+        while ((1u << bits) < n[comp] * 2) ++bits;
+        const uint32_t mask = (1u << bits) - 1;
+        config_cond_slot * const slots = calloc(mask + 1, sizeof(*slots));
+        force_assert(slots);
+        config_cond_index.slots[comp] = slots;
+        config_cond_index.bits[comp] = bits;
+        for (uint32_t i = 1; i < used; ++i) {
+            const data_config * const dc = config_reference.data[i];
+            if (!x[i] || dc->comp != (comp_key_t)comp) continue;
+            const uint32_t h = djbhash(CONST_BUF_LEN(&dc->string), DJBHASH_INIT);
+            uint32_t pos = config_cond_index_pos(h, bits);
+            while (slots[pos].ndx) pos = (pos + 1) & mask;
+            slots[pos].h = h;
+            slots[pos].ndx = i;
+        }
+    }
+
+    log_error(srv->errh, __FILE__, __LINE__,
+      "config conditions: %u indexed, %u evaluated linearly", indexed, linear);
+}
+
+void config_cond_index_free(void) {
+    free(config_cond_index.indexed);
+    for (int comp = 0; comp < COMP_LAST_ELEMENT; ++comp)
+        free(config_cond_index.slots[comp]);
+    memset(&config_cond_index, 0, sizeof(config_cond_index));
+}
+
+static const buffer * config_cond_index_value(request_st * const r, const comp_key_t comp) {
+    /* (must match values compared in config_check_cond_nocache()
+     *  for conditions accepted by config_cond_indexable()) */
+    const buffer *l;
+    switch (comp) {
+      case COMP_HTTP_HOST:
+        l = &r->uri.authority;
+        if (buffer_string_is_empty(l))
+            return (buffer *)&empty_string;
+        if (0 != sock_addr_get_port(&r->con->srv_socket->addr)) {
+            const char * const val_colon = strchr(l->ptr, ':');
+            if (NULL != val_colon) {
+                /* condition "host" but client send "host:port" */
+                buffer * const tb = r->tmp_buf;
+                buffer_copy_string_len(tb, l->ptr, val_colon - l->ptr);
+                l = tb;
+            }
+        }
+        return l;
+      case COMP_HTTP_REMOTE_IP:
+        return r->con->dst_addr_buf;
+      case COMP_HTTP_SCHEME:
+        return &r->uri.scheme;
+      case COMP_HTTP_URL:
+        return &r->uri.path;
+      case COMP_HTTP_QUERY_STRING:
+        l = &r->uri.query;
+        return (NULL != l->ptr) ? l : (buffer *)&empty_string;
+      case COMP_SERVER_SOCKET:
+        return r->con->srv_socket->srv_token;
+      case COMP_HTTP_REQUEST_METHOD: {
+        buffer * const tb = r->tmp_buf;
+        buffer_clear(tb);
+        http_method_append(tb, r->http_method);
+        return tb;
+      }
+      default:
+        return (buffer *)&empty_string; /*(should not happen)*/
+    }
+}
+
+__attribute_noinline__
+static void config_cond_index_lookup(request_st * const r, const comp_key_t comp, const int debug_cond) {
+    const buffer * const l = config_cond_index_value(r, comp);
+    const config_cond_slot * const slots = config_cond_index.slots[comp];
+    const uint32_t bits = config_cond_index.bits[comp];
+    const uint32_t mask = (1u << bits) - 1;
+    const uint32_t h = djbhash(CONST_BUF_LEN(l), DJBHASH_INIT);
+    cond_cache_t * const cond_cache = r->cond_cache;
+    for (uint32_t pos = config_cond_index_pos(h, bits); slots[pos].ndx; pos = (pos + 1) & mask) {
+        if (slots[pos].h != h) continue;
+        const data_config * const dc = config_reference.data[slots[pos].ndx];
+        if (!buffer_is_equal(l, &dc->string)) continue;
+        cond_cache[slots[pos].ndx].local_result =
+          (dc->cond == CONFIG_COND_EQ) ? COND_RESULT_TRUE : COND_RESULT_FALSE;
+        if (debug_cond) {
+            log_error(r->conf.errh, __FILE__, __LINE__,
+              "%s (%s) indexed match %d", dc->comp_key->ptr, l->ptr,
+              dc->context_ndx);
+        }
+    }
+    /* mark lookup done for comp */
+    cond_cache[config_reference.used + comp].result = COND_RESULT_TRUE;
+}
+
+static cond_result_t config_cond_index_check(request_st * const r, const data_config * const dc, const int debug_cond, cond_cache_t * const cache) {
+    if (COND_RESULT_UNSET == r->cond_cache[config_reference.used+dc->comp].result) {
+        config_cond_index_lookup(r, dc->comp, debug_cond);
+        if (COND_RESULT_UNSET != cache->local_result)
+            return cache->local_result; /* (matched) */
+    }
+    else if (debug_cond) {
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "%s compare to %s (indexed; no match)",
+          dc->comp_key->ptr, dc->string.ptr);
+    }
+    /* not matched */
+    return (dc->cond == CONFIG_COND_EQ) ? COND_RESULT_FALSE : COND_RESULT_TRUE;
+}
+
+static cond_result_t config_check_cond_nocache(request_st * const r, const data_config * const dc, const int debug_cond, cond_cache_t * const cache) {
 	/* check parent first */
 	if (dc->parent && dc->parent->context_ndx) {
 		/**
@@ -489,6 +677,9 @@ static cond_result_t config_check_cond_nocache(request_st * const r, const data_
 
 	if (CONFIG_COND_ELSE == dc->cond) return COND_RESULT_TRUE;
 
+	if (config_cond_index.indexed && config_cond_index.indexed[dc->context_ndx])
+		return config_cond_index_check(r, dc, debug_cond, cache);
+
 	/* pass the rules */
 
 	buffer *l;
@@ -677,6 +868,8 @@ void config_cond_cache_reset_item(request_st * const r, comp_key_t item) {
 			config_cond_clear_node(cond_cache, dc);
 		}
 	}
+	/* clear indexed lookup for item */
+	cond_cache[used + item].result = COND_RESULT_UNSET;
 }
 
 /**
@@ -686,22 +879,71 @@ void config_cond_cache_reset(request_st * const r) {
 	/* resetting all entries; no need to follow children as in config_cond_cache_reset_item */
 	/* static_assert(0 == COND_RESULT_UNSET); */
 	const uint32_t used = config_reference.used;
+	/* (+COMP_LAST_ELEMENT for sentinels of indexed lookups) */
 	if (used > 1)
-		memset(r->cond_cache, 0, used*sizeof(cond_cache_t));
+		memset(r->cond_cache, 0, (used+COMP_LAST_ELEMENT)*sizeof(cond_cache_t));
 }
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
+#ifdef HAVE_PCRE2_H
+
+/* match data is reused for all pcre2_match() in thread (event loop) */
+static __thread_local pcre2_match_data *config_pcre2_md;
+
+__attribute_cold__
+__attribute_noinline__
+static pcre2_match_data * config_pcre2_match_data_init(void) {
+    config_pcre2_md = pcre2_match_data_create(20, NULL);
+    force_assert(config_pcre2_md);
+    return config_pcre2_md;
+}
+
+pcre2_match_data * config_pcre2_match_data(void) {
+    return config_pcre2_md ? config_pcre2_md : config_pcre2_match_data_init();
+}
+
+#endif
+
+void config_pcre2_match_data_free(void) {
+  #ifdef HAVE_PCRE2_H
+    if (config_pcre2_md) {
+        pcre2_match_data_free(config_pcre2_md);
+        config_pcre2_md = NULL;
+    }
+  #endif
+}
+
 static int data_config_pcre_exec(const data_config *dc, cond_cache_t *cache, const buffer *b, cond_match_t *cond_match) {
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+    pcre2_match_data * const md = config_pcre2_match_data();
+    int n = pcre2_match(dc->code, (PCRE2_SPTR)b->ptr, buffer_string_length(b),
+                        0, 0, md, NULL);
+    if (n >= 0) {
+        /* keep only $0..$9 (for %0..%9 in substitutions); (n is 0 if there
+         * are more captures than fit in match data, which is still filled) */
+        if (0 == n || n > 10) n = 10;
+        const PCRE2_SIZE * const ovec = pcre2_get_ovector_pointer(md);
+        for (int i = 0; i < 2*n; ++i)
+            cond_match->matches[i] = (int)ovec[i];
+        cond_match->comp_value = b; /*holds pointer to b (!) for pattern subst*/
+    }
+    return (cache->patterncount = n);
+#elif defined(HAVE_PCRE_H)
     #ifndef elementsof
     #define elementsof(x) (sizeof(x) / sizeof(x[0]))
     #endif
     cache->patterncount =
       pcre_exec(dc->regex, dc->regex_study, CONST_BUF_LEN(b), 0, 0,
                 cond_match->matches, elementsof(cond_match->matches));
+    /* (0 if more than 9 captures; first 10 pairs are filled) */
+    if (0 == cache->patterncount)
+        cache->patterncount = elementsof(cond_match->matches) / 3;
     if (cache->patterncount > 0)
         cond_match->comp_value = b; /*holds pointer to b (!) for pattern subst*/
     return cache->patterncount;
@@ -69,7 +69,13 @@ void config_reset_config_bytes_sec(void * const p_d) {
         for (; -1 != cpv->k_id; ++cpv) {
             switch (cpv->k_id) {
               case 18:/* server.kbytes-per-second */
-                if (cpv->vtype == T_CONFIG_LOCAL) ((off_t *)cpv->v.v)[0] = 0;
+                if (cpv->vtype == T_CONFIG_LOCAL) {
+                  #ifdef HAVE_THREADS
+                    __atomic_store_n((off_t *)cpv->v.v, 0, __ATOMIC_RELAXED);
+                  #else
+                    ((off_t *)cpv->v.v)[0] = 0;
+                  #endif
+                }
                 break;
               default:
                 break;
@@ -186,6 +192,12 @@ static void config_merge_config_cpv(request_config * const pconf, const config_p
       case 32:/* server.breakagelog */
         if (cpv->vtype == T_CONFIG_LOCAL) pconf->serrh = cpv->v.v;
         break;
+      case 33:/* server.max-read-idle-ms */
+        pconf->max_read_idle_ms = cpv->v.u;
+        break;
+      case 34:/* server.max-write-idle-ms */
+        pconf->max_write_idle_ms = cpv->v.u;
+        break;
       default:/* should not happen */
         return;
     }
@@ -650,6 +662,24 @@ static int config_insert_srvconf(server *srv) {
      ,{ CONST_STR_LEN("server.feature-flags"),
         T_CONFIG_ARRAY_KVANY,
         T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.stat-cache-max-entries"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.stat-cache-max-fds"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.stat-cache-max-content-size"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.stat-cache-max-content-total"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.threads"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.aio-threads"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_SERVER }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -784,6 +814,29 @@ static int config_insert_srvconf(server *srv) {
                 break;
               case 33:/* server.feature-flags */
                 srv->srvconf.feature_flags = cpv->v.a;
+                srv->srvconf.h2proto =
+                  config_plugin_value_tobool(
+                    array_get_element_klen(cpv->v.a,
+                                           CONST_STR_LEN("server.h2proto")),
+                    0);
+                break;
+              case 34:/* server.stat-cache-max-entries */
+                stat_cache_max_entries(cpv->v.u);
+                break;
+              case 35:/* server.stat-cache-max-fds */
+                stat_cache_max_fds(cpv->v.u);
+                break;
+              case 36:/* server.stat-cache-max-content-size */
+                stat_cache_max_content_size(cpv->v.u);
+                break;
+              case 37:/* server.stat-cache-max-content-total */
+                stat_cache_max_content_total(cpv->v.u);
+                break;
+              case 38:/* server.threads */
+                srv->srvconf.threads = cpv->v.shrt;
+                break;
+              case 39:/* server.aio-threads */
+                srv->srvconf.aio_threads = cpv->v.shrt;
                 break;
               default:/* should not happen */
                 break;
@@ -907,6 +960,12 @@ static int config_insert(server *srv) {
      ,{ CONST_STR_LEN("server.breakagelog"),
         T_CONFIG_STRING,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("server.max-read-idle-ms"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("server.max-write-idle-ms"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -1005,6 +1064,8 @@ static int config_insert(server *srv) {
               case 30:/* debug.log-timeouts */
               case 31:/* server.errorlog */   /*(idx in server.c must match)*/
               case 32:/* server.breakagelog *//*(idx in server.c must match)*/
+              case 33:/* server.max-read-idle-ms */
+              case 34:/* server.max-write-idle-ms */
                 break;
               default:/* should not happen */
                 break;
@@ -1052,6 +1113,18 @@ static int config_insert(server *srv) {
     return rc;
 }
 
+__attribute_cold__
+static void config_freeze_arrays(array * const a) {
+    /* index config arrays (e.g. mimetype.assign) for faster lookups;
+     * (config arrays are not modified after plugins_call_set_defaults()) */
+    for (uint32_t i = 0; i < a->used; ++i) {
+        data_unset * const du = a->data[i];
+        if (du->type == TYPE_ARRAY)
+            config_freeze_arrays(&((data_array *)du)->value);
+    }
+    array_freeze(a);
+}
+
 int config_finalize(server *srv, const buffer *default_server_tag) {
     /* (call after plugins_call_set_defaults()) */
 
@@ -1088,6 +1161,13 @@ int config_finalize(server *srv, const buffer *default_server_tag) {
     array_free(srv->srvconf.config_touched);
     srv->srvconf.config_touched = NULL;
 
+    for (uint32_t i = 0; i < srv->config_context->used; ++i) {
+        array *config = ((data_config *)srv->config_context->data[i])->value;
+        if (config) config_freeze_arrays(config);
+    }
+
+    config_cond_index_init(srv);
+
     if (srv->srvconf.config_unsupported || srv->srvconf.config_deprecated) {
         if (srv->srvconf.config_unsupported)
             log_error(srv->errh, __FILE__, __LINE__,
@@ -1108,6 +1188,7 @@ void config_print(server *srv) {
 
 void config_free(server *srv) {
     config_free_config(srv->config_data_base);
+    config_cond_index_free();
 
     array_free(srv->config_context);
     array_free(srv->srvconf.config_touched);
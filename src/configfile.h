@@ -13,7 +13,9 @@
  * for compare: comp          cond  string/regex
  */
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+struct pcre2_real_code_8;   /* declaration */
+#elif defined(HAVE_PCRE_H)
 struct pcre_extra;      /* declaration */
 #endif
 
@@ -33,7 +35,9 @@ struct data_config {
 	data_config *next;
 
 	buffer string;
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+	struct pcre2_real_code_8 *code;
+#elif defined(HAVE_PCRE_H)
 	void *regex;
 	struct pcre_extra *regex_study;
 #endif
@@ -53,6 +57,12 @@ int data_config_pcre_compile(data_config *dc);
 /*struct cond_cache_t;*/    /* declaration */ /*(moved to plugin_config.h)*/
 /*int data_config_pcre_exec(const data_config *dc, struct cond_cache_t *cache, buffer *b);*/
 
+__attribute_cold__
+void config_cond_index_init(server *srv);
+
+__attribute_cold__
+void config_cond_index_free(void);
+
 typedef struct {
 	server *srv;
 	int     ok;
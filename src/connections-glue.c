@@ -3,7 +3,9 @@
 #include "sys-socket.h"
 #include "base.h"
 #include "connections.h"
+#include "aio_pool.h"
 #include "fdevent.h"
+#include "h2.h"
 #include "http_header.h"
 #include "log.h"
 #include "response.h"
@@ -293,10 +295,28 @@ static handler_t connection_handle_read_body_unknown(request_st * const r, chunk
     return HANDLER_GO_ON;
 }
 
+/* global/aggregate rate limit counters are shared by threads (server.threads)
+ * (reset once per second by main thread; see config_reset_config_bytes_sec())*/
+#ifdef HAVE_THREADS
+#define connection_global_bytes_get(p)    __atomic_load_n((p), __ATOMIC_RELAXED)
+#define connection_global_bytes_add(p, n) \
+        __atomic_fetch_add((p), (n), __ATOMIC_RELAXED)
+#else
+#define connection_global_bytes_get(p)    (*(p))
+#define connection_global_bytes_add(p, n) (*(p) += (n))
+#endif
+
+uint64_t connection_bytes_out;
+
 static off_t connection_write_throttle(connection * const con, off_t max_bytes) {
 	request_st * const r = &con->request;
+	if (con->bytes_written_cur_ts != log_epoch_secs) {
+		con->bytes_written_cur_ts = log_epoch_secs;
+		con->bytes_written_cur_second = 0;
+	}
 	if (r->conf.global_bytes_per_second) {
-		off_t limit = (off_t)r->conf.global_bytes_per_second - *(r->conf.global_bytes_per_second_cnt_ptr);
+		off_t limit = (off_t)r->conf.global_bytes_per_second
+		            - connection_global_bytes_get(r->conf.global_bytes_per_second_cnt_ptr);
 		if (limit <= 0) {
 			/* we reached the global traffic limit */
 			r->con->traffic_limit_reached = 1;
@@ -324,10 +344,18 @@ static off_t connection_write_throttle(connection * const con, off_t max_bytes)
 
 int connection_write_chunkqueue(connection *con, chunkqueue *cq, off_t max_bytes) {
 	con->write_request_ts = log_epoch_secs;
+	con->write_request_ms = log_epoch_ms();
 
 	max_bytes = connection_write_throttle(con, max_bytes);
 	if (0 == max_bytes) return 1;
 
+	/* park connection while cold file pages are read by aio_pool thread
+	 * (HTTP/2 frames are written by h2 scheduler; not parked) */
+	if (con->srv->aio && NULL == con->h2) {
+		max_bytes = aio_pool_check(con, cq, max_bytes);
+		if (0 == max_bytes) return 1;
+	}
+
 	off_t written = cq->bytes_out;
 	int ret;
 
@@ -365,9 +393,10 @@ int connection_write_chunkqueue(connection *con, chunkqueue *cq, off_t max_bytes
 	written = cq->bytes_out - written;
 	con->bytes_written += written;
 	con->bytes_written_cur_second += written;
+	connection_bytes_out_add((uint64_t)written);
 	request_st * const r = &con->request;
 	if (r->conf.global_bytes_per_second_cnt_ptr)
-		*(r->conf.global_bytes_per_second_cnt_ptr) += written;
+		connection_global_bytes_add(r->conf.global_bytes_per_second_cnt_ptr, written);
 
 	return ret;
 }
@@ -393,8 +422,9 @@ static int connection_write_100_continue(request_st * const r, connection * cons
 	written = cq->bytes_out - written;
 	con->bytes_written += written;
 	con->bytes_written_cur_second += written;
+	connection_bytes_out_add((uint64_t)written);
 	if (r->conf.global_bytes_per_second_cnt_ptr)
-		*(r->conf.global_bytes_per_second_cnt_ptr) += written;
+		connection_global_bytes_add(r->conf.global_bytes_per_second_cnt_ptr, written);
 
 	if (rc < 0) {
 		r->state = CON_STATE_ERROR;
@@ -422,8 +452,14 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 
 	int is_closed = 0;
 
-	if (con->is_readable) {
+	if (r->h2id) {
+		/* HTTP/2 DATA is placed in r->read_queue by h2 frame parser */
+		is_closed = (r->h2state == H2_STATE_HALF_CLOSED_REMOTE
+		             || r->h2state == H2_STATE_CLOSED);
+	}
+	else if (con->is_readable) {
 		con->read_idle_ts = log_epoch_secs;
+		con->read_idle_ms = log_epoch_ms();
 
 		switch(con->network_read(con, cq, MAX_READ_LIMIT)) {
 		case -1:
@@ -442,7 +478,7 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 	/* Check for Expect: 100-continue in request headers
 	 * if no request body received yet */
 	if (chunkqueue_is_empty(cq) && 0 == dst_cq->bytes_in
-	    && r->http_version != HTTP_VERSION_1_0
+	    && r->http_version == HTTP_VERSION_1_1
 	    && chunkqueue_is_empty(r->write_queue) && con->is_writable) {
 		const buffer *vb = http_header_request_get(r, HTTP_HEADER_EXPECT, CONST_STR_LEN("Expect"));
 		if (NULL != vb && buffer_eq_icase_slen(vb, CONST_STR_LEN("100-continue"))) {
@@ -455,10 +491,13 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 
 	if (r->reqbody_length < 0) {
 		/*(-1: Transfer-Encoding: chunked, -2: unspecified length)*/
-		handler_t rc = (-1 == r->reqbody_length)
+		/*(HTTP/2 request body length is delimited by END_STREAM)*/
+		handler_t rc = (-1 == r->reqbody_length && !r->h2id)
                   ? connection_handle_read_post_chunked(r, cq, dst_cq)
                   : connection_handle_read_body_unknown(r, cq, dst_cq);
 		if (HANDLER_GO_ON != rc) return rc;
+		if (r->h2id && is_closed)
+			r->reqbody_length = dst_cq->bytes_in;
 	}
 	else if (r->reqbody_length <= 64*1024) {
 		/* don't buffer request bodies <= 64k on disk */
@@ -471,6 +510,12 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 
 	chunkqueue_remove_finished_chunks(cq);
 
+	if (r->h2id && !is_closed && r->h2_rwin <= H2_STREAM_RWIN/2) {
+		/* replenish HTTP/2 stream recv window as request body is consumed */
+		h2_send_window_update(con, r->h2id, (uint32_t)(H2_STREAM_RWIN - r->h2_rwin));
+		r->h2_rwin = H2_STREAM_RWIN;
+	}
+
 	if (dst_cq->bytes_in == (off_t)r->reqbody_length) {
 		/* Content is ready */
 		r->conf.stream_request_body &= ~FDEVENT_STREAM_REQUEST_POLLIN;
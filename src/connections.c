@@ -7,7 +7,9 @@
 #include "log.h"
 #include "connections.h"
 #include "fdevent.h"
+#include "h2.h"
 #include "http_header.h"
+#include "http_scan.h"
 
 #include "request.h"
 #include "response.h"
@@ -155,6 +157,7 @@ static void connection_close(connection *con) {
 	}
 	con->fd = -1;
 
+	tw_del(&srv->tw, &con->timer);
 	connection_del(srv, con);
 }
 
@@ -436,7 +439,7 @@ static int connection_handle_write_prepare(request_st * const r) {
 	if (r->resp_body_finished) {
 		/* we have all the content and chunked encoding is not used, set a content-length */
 
-		if (!(r->resp_htags & (HTTP_HEADER_CONTENT_LENGTH|HTTP_HEADER_TRANSFER_ENCODING))) {
+		if (!(r->resp_htags & (light_bshift(HTTP_HEADER_CONTENT_LENGTH)|light_bshift(HTTP_HEADER_TRANSFER_ENCODING)))) {
 			off_t qlen = chunkqueue_length(r->write_queue);
 
 			/**
@@ -478,10 +481,12 @@ static int connection_handle_write_prepare(request_st * const r) {
 		 * - Upgrade: ... (lighttpd then acts as transparent proxy)
 		 */
 
-		if (!(r->resp_htags & (HTTP_HEADER_CONTENT_LENGTH|HTTP_HEADER_TRANSFER_ENCODING|HTTP_HEADER_UPGRADE))) {
+		if (!(r->resp_htags & (light_bshift(HTTP_HEADER_CONTENT_LENGTH)|light_bshift(HTTP_HEADER_TRANSFER_ENCODING)|light_bshift(HTTP_HEADER_UPGRADE)))) {
 			if (r->http_method == HTTP_METHOD_CONNECT
 			    && r->http_status == 200) {
 				/*(no transfer-encoding if successful CONNECT)*/
+			} else if (r->http_version == HTTP_VERSION_2) {
+				/*(HTTP/2 DATA frames; END_STREAM ends response)*/
 			} else if (r->http_version == HTTP_VERSION_1_1) {
 				off_t qlen = chunkqueue_length(r->write_queue);
 				r->resp_send_chunked = 1;
@@ -542,7 +547,10 @@ static void connection_handle_write(connection *con) {
 static void connection_handle_write_state(request_st * const r, connection * const con) {
     do {
         /* only try to write if we have something in the queue */
-        if (!chunkqueue_is_empty(con->write_queue)) {
+        if (r->h2id) {
+            /*(HTTP/2 stream; DATA framed and written by h2 scheduler)*/
+        }
+        else if (!chunkqueue_is_empty(con->write_queue)) {
             if (con->is_writable) {
                 connection_handle_write(con);
                 if (r->state != CON_STATE_WRITE) break;
@@ -575,6 +583,7 @@ static void connection_handle_write_state(request_st * const r, connection * con
             }
         }
     } while (r->state == CON_STATE_WRITE
+             && !r->h2id
              && (!chunkqueue_is_empty(con->write_queue)
                  ? con->is_writable
                  : r->resp_body_finished));
@@ -582,7 +591,7 @@ static void connection_handle_write_state(request_st * const r, connection * con
 
 
 __attribute_cold__
-static void
+void
 request_init (request_st * const r, connection * const con, server * const srv)
 {
 	r->write_queue = chunkqueue_init();
@@ -597,15 +606,20 @@ request_init (request_st * const r, connection * const con, server * const srv)
 	/* init plugin-specific per-request structures */
 	r->plugin_ctx = calloc(1, (srv->plugins.used + 1) * sizeof(void *));
 	force_assert(NULL != r->plugin_ctx);
+	heap_nallocs_inc();
 
-	r->cond_cache = calloc(srv->config_context->used, sizeof(cond_cache_t));
+	/*(+COMP_LAST_ELEMENT for sentinels of indexed condition lookups)*/
+	r->cond_cache = calloc(srv->config_context->used + COMP_LAST_ELEMENT,
+	                       sizeof(cond_cache_t));
 	force_assert(NULL != r->cond_cache);
+	heap_nallocs_inc();
 
-      #ifdef HAVE_PCRE_H
+      #ifdef HAVE_PCRE
 	if (srv->config_context->used > 1) {/*(save 128b per con if no conditions)*/
 		r->cond_match =
 		  calloc(srv->config_context->used, sizeof(cond_match_t));
 		force_assert(NULL != r->cond_match);
+		heap_nallocs_inc();
 	}
       #endif
 
@@ -616,6 +630,7 @@ __attribute_cold__
 static connection *connection_init(server *srv) {
 	connection * const con = calloc(1, sizeof(*con));
 	force_assert(NULL != con);
+	heap_nallocs_inc();
 
 	con->fd = 0;
 	con->ndx = -1;
@@ -624,6 +639,7 @@ static connection *connection_init(server *srv) {
 
 	con->dst_addr_buf = buffer_init();
 	con->srv  = srv;
+	con->timer.ctx = con;
 	con->plugin_slots = srv->plugin_slots;
 	con->config_data_base = srv->config_data_base;
 
@@ -635,12 +651,13 @@ static connection *connection_init(server *srv) {
 	/* init plugin-specific per-connection structures */
 	con->plugin_ctx = calloc(1, (srv->plugins.used + 1) * sizeof(void *));
 	force_assert(NULL != con->plugin_ctx);
+	heap_nallocs_inc();
 
 	return con;
 }
 
 
-static void
+void
 request_free (request_st * const r)
 {
 		chunkqueue_free(r->reqbody_queue);
@@ -670,6 +687,7 @@ request_free (request_st * const r)
 		free(r->plugin_ctx);
 		free(r->cond_cache);
 		free(r->cond_match);
+		request_arena_free(&r->arena);
 
 		/* note: r is not zeroed here and r is not freed here */
 }
@@ -698,7 +716,7 @@ void connections_free(server *srv) {
 }
 
 
-static void
+void
 request_reset (request_st * const r) {
 	plugins_call_handle_request_reset(r);
 
@@ -753,6 +771,8 @@ request_reset (request_st * const r) {
 	/* The cond_cache gets reset in response.c */
 	/* config_cond_cache_reset(r); */
 
+	request_arena_reset(&r->arena);
+
 	r->async_callback = 0;
 	r->error_handler_saved_status = 0;
 	/*r->error_handler_saved_method = HTTP_METHOD_UNSET;*/
@@ -763,8 +783,11 @@ request_reset (request_st * const r) {
 
 static void connection_reset(connection *con) {
 	request_st * const r = &con->request;
+	if (con->h2) h2_retire_con(con);
 	request_reset(r);
 	con->is_readable = 1;
+	con->aio_wait = 0;
+	++con->aio_gen;
 
 	con->bytes_written = 0;
 	con->bytes_written_cur_second = 0;
@@ -785,6 +808,7 @@ static void connection_discard_blank_line(request_st * const r, const char * con
 static chunk * connection_read_header_more(connection *con, chunkqueue *cq, chunk *c, const size_t olen) {
     if ((NULL == c || NULL == c->next) && con->is_readable) {
         con->read_idle_ts = log_epoch_secs;
+        con->read_idle_ms = log_epoch_ms();
         if (0 != con->network_read(con, cq, MAX_READ_LIMIT)) {
             request_st * const r = &con->request;
             connection_set_state(r, CON_STATE_ERROR);
@@ -805,22 +829,6 @@ static chunk * connection_read_header_more(connection *con, chunkqueue *cq, chun
       : NULL;
 }
 
-__attribute_hot__
-static uint32_t connection_read_header_hoff(const char *n, const uint32_t clen, unsigned short hoff[8192]) {
-    uint32_t hlen = 0;
-    for (const char *b; (n = memchr((b = n),'\n',clen-hlen)); ++n) {
-        uint32_t x = (uint32_t)(n - b + 1);
-        hlen += x;
-        if (x <= 2 && (x == 1 || n[-1] == '\r')) {
-            hoff[hoff[0]+1] = hlen;
-            return hlen;
-        }
-        if (++hoff[0] >= /*sizeof(hoff)/sizeof(hoff[0])-1*/ 8192-1) break;
-        hoff[hoff[0]] = hlen;
-    }
-    return 0;
-}
-
 /**
  * handle request header read
  *
@@ -861,7 +869,7 @@ static int connection_handle_read_state(connection * const con)  {
         /*hoff[2] = ...;*/                   /* offset from base for 2nd line */
 
         header_len =
-          connection_read_header_hoff(c->mem->ptr + c->offset, clen, hoff);
+          http_scan_header_lines(c->mem->ptr + c->offset, clen, hoff);
 
         /* casting to (unsigned short) might truncate, and the hoff[]
          * addition might overflow, but max_request_field_size is USHRT_MAX,
@@ -891,6 +899,17 @@ static int connection_handle_read_state(connection * const con)  {
         }
     } while ((c = connection_read_header_more(con, cq, c, clen)));
 
+    if (1 == con->request_count
+        && (r->http_version == HTTP_VERSION_2 /*(ALPN "h2" negotiated)*/
+            || (c && 18 == header_len && con->srv->srvconf.h2proto
+                && 0 == memcmp(c->mem->ptr + c->offset,
+                               "PRI * HTTP/2.0\r\n\r\n", 18)))) {
+        /* HTTP/2 (client connection preface is processed by h2 layer)
+         * (with prior knowledge on cleartext (h2c); RFC 7540 3.4) */
+        h2_init_con(r, con);
+        return 0;
+    }
+
     if (keepalive_request_start) {
         if (0 != con->bytes_read) {
             /* update r->start_ts timestamp when first byte of
@@ -899,7 +918,10 @@ static int connection_handle_read_state(connection * const con)  {
             if (r->conf.high_precision_timestamps)
                 log_clock_gettime_realtime(&r->start_hp);
         }
-        if (pipelined_request_start && c) con->read_idle_ts = log_epoch_secs;
+        if (pipelined_request_start && c) {
+            con->read_idle_ts = log_epoch_secs;
+            con->read_idle_ms = log_epoch_ms();
+        }
     }
 
     if (NULL == c) return 0; /* incomplete request headers */
@@ -925,6 +947,15 @@ static int connection_handle_read_state(connection * const con)  {
         buffer_reset(&r->target_orig);
     }
 
+    connection_request_parse(r, hdrs, hoff, header_len);
+
+    chunkqueue_mark_written(cq, header_len);
+    connection_set_state(r, CON_STATE_REQUEST_END);
+    return 1;
+}
+
+void connection_request_parse (request_st * const r, char * const hdrs, const unsigned short * const hoff, const uint32_t header_len) {
+    connection * const con = r->con;
     if (r->conf.log_request_header) {
         log_error(r->conf.errh, __FILE__, __LINE__,
                   "fd: %d request-len: %d\n%.*s", con->fd, (int)header_len,
@@ -955,9 +986,6 @@ static int connection_handle_read_state(connection * const con)  {
     }
 
     r->rqst_header_len = header_len;
-    chunkqueue_mark_written(cq, header_len);
-    connection_set_state(r, CON_STATE_REQUEST_END);
-    return 1;
 }
 
 static handler_t connection_handle_fdevent(void *context, int revents) {
@@ -1341,10 +1369,8 @@ static int connection_handle_request(request_st * const r) {
 }
 
 
-int connection_state_machine(connection *con) {
-	request_st * const r = &con->request;
+static void connection_state_machine_loop(request_st * const r, connection * const con) {
 	request_state_t ostate;
-	int rc;
 	const int log_state_handling = r->conf.log_state_handling;
 
 	if (log_state_handling) {
@@ -1361,6 +1387,7 @@ int connection_state_machine(connection *con) {
 		switch ((ostate = r->state)) {
 		case CON_STATE_REQUEST_START: /* transient */
 			r->start_ts = con->read_idle_ts = log_epoch_secs;
+			con->read_idle_ms = log_epoch_ms();
 			if (r->conf.high_precision_timestamps)
 				log_clock_gettime_realtime(&r->start_hp);
 
@@ -1370,7 +1397,11 @@ int connection_state_machine(connection *con) {
 			connection_set_state(r, CON_STATE_READ);
 			/* fall through */
 		case CON_STATE_READ:
-			if (!connection_handle_read_state(con)) break;
+			if (!connection_handle_read_state(con)) {
+				/*(end loop if connection upgraded to HTTP/2)*/
+				if (con->h2) ostate = r->state;
+				break;
+			}
 			/*if (r->state != CON_STATE_REQUEST_END) break;*/
 			/* fall through */
 		case CON_STATE_REQUEST_END: /* transient */
@@ -1407,6 +1438,8 @@ int connection_state_machine(connection *con) {
 			/* fall through */
 		case CON_STATE_RESPONSE_END: /* transient */
 		case CON_STATE_ERROR:        /* transient */
+			/*(HTTP/2 streams are retired by connection_state_machine_h2())*/
+			if (r->h2id) break;
 			connection_handle_response_end_state(r, con);
 			break;
 		case CON_STATE_CLOSE:
@@ -1425,8 +1458,103 @@ int connection_state_machine(connection *con) {
 		log_error(r->conf.errh, __FILE__, __LINE__,
 		  "state at exit: %d %s", con->fd, connection_get_state(r->state));
 	}
+}
+
+static void connection_handle_write_state_h2(request_st * const h2r, connection * const con) {
+	/* frame response data from active streams into con->write_queue
+	 * (round-robin, one DATA frame per stream per pass), and write */
+	h2con * const h2c = con->h2;
+	const off_t bytes_out = con->write_queue->bytes_out;
+	do {
+		for (int progress = 1; progress; ) {
+			progress = 0;
+			for (uint32_t i = 0; i < h2c->rused; ++i) {
+				request_st * const r = h2c->r[i];
+				if (r->state != CON_STATE_WRITE) continue;
+				if (!chunkqueue_is_empty(r->write_queue)
+				    && h2_send_cqdata(r, con, r->write_queue, H2_MAX_FRAME_SIZE))
+					progress = 1;
+				if (r->resp_body_finished && chunkqueue_is_empty(r->write_queue)) {
+					h2_send_end_stream(r, con);
+					connection_set_state(r, CON_STATE_RESPONSE_END);
+				}
+			}
+			/*(limit amount framed in advance of socket write)*/
+			if (chunkqueue_length(con->write_queue) >= 65536) break;
+		}
+
+		if (chunkqueue_is_empty(con->write_queue) || !con->is_writable) break;
+		connection_handle_write(con);
+		if (con->write_queue->bytes_out - bytes_out >= MAX_WRITE_LIMIT) {
+			/*(MAX_WRITE_LIMIT reached; resume upon next write event)*/
+			if (con->is_writable > 0) con->is_writable = -1;
+			break;
+		}
+	} while (h2r->state == CON_STATE_WRITE && con->is_writable);
+}
+
+static void connection_state_machine_h2(request_st * const h2r, connection * const con) {
+	h2con * const h2c = con->h2;
+
+	if (h2r->state == CON_STATE_WRITE && h2c->sent_goaway <= 0) {
+		/* read and process HTTP/2 frames */
+		if (con->is_readable) {
+			con->read_idle_ts = log_epoch_secs;
+			con->read_idle_ms = log_epoch_ms();
+			switch (con->network_read(con, con->read_queue, MAX_READ_LIMIT)) {
+			case 0:
+				break;
+			default: /* -1 error, -2 remote close */
+				connection_set_state(h2r, CON_STATE_ERROR);
+				break;
+			}
+		}
+		if (!chunkqueue_is_empty(con->read_queue))
+			h2_parse_frames(con);
+	}
+
+	/* process active streams */
+	for (uint32_t i = 0; i < h2c->rused; ++i) {
+		request_st * const r = h2c->r[i];
+		connection_state_machine_loop(r, con);
+	}
 
-	rc = 0;
+	if (h2r->state == CON_STATE_WRITE)
+		connection_handle_write_state_h2(h2r, con);
+
+	/* retire completed and aborted streams */
+	for (uint32_t i = 0; i < h2c->rused; ) {
+		request_st * const r = h2c->r[i];
+		if (r->state == CON_STATE_RESPONSE_END
+		    || r->state == CON_STATE_ERROR)
+			h2_retire_stream(r, con); /*(removes r from h2c->r[])*/
+		else
+			++i;
+	}
+
+	if (h2r->state == CON_STATE_WRITE) {
+		/* close connection after GOAWAY once responses have been sent */
+		if (!chunkqueue_is_empty(con->write_queue))
+			return; /*(wait for pending frames to be written)*/
+		if (h2c->sent_goaway > 0)
+			connection_set_state(h2r, CON_STATE_ERROR);
+		else if ((h2c->sent_goaway || h2c->received_goaway) && 0 == h2c->rused)
+			connection_set_state(h2r, CON_STATE_RESPONSE_END);
+		else
+			return;
+	}
+
+	if (h2r->state == CON_STATE_RESPONSE_END || h2r->state == CON_STATE_ERROR) {
+		/*(streams are retired in connection_reset() via h2_retire_con())*/
+		h2r->keep_alive = 0;
+		connection_handle_shutdown(con);
+	}
+}
+
+static void connection_set_fdevent_interest(request_st * const r, connection * const con) {
+	if (con->fd < 0) return;
+
+	int rc = 0;
 	switch(r->state) {
 	case CON_STATE_READ:
 		rc = FDEVENT_IN | FDEVENT_RDHUP;
@@ -1438,7 +1566,8 @@ int connection_state_machine(connection *con) {
 		 */
 		if (!chunkqueue_is_empty(con->write_queue) &&
 		    (con->is_writable == 0) &&
-		    (con->traffic_limit_reached == 0)) {
+		    (con->traffic_limit_reached == 0) &&
+		    (con->aio_wait == 0)) {
 			rc |= FDEVENT_OUT;
 		}
 		/* fall through */
@@ -1453,7 +1582,11 @@ int connection_state_machine(connection *con) {
 	default:
 		break;
 	}
-	if (con->fd >= 0) {
+	if (con->h2 && con->h2->sent_goaway <= 0) {
+		/*(HTTP/2 connection reads frames while streams are active)*/
+		rc |= FDEVENT_IN | FDEVENT_RDHUP;
+	}
+	{
 		const int events = fdevent_fdnode_interest(con->fdn);
 		if (con->is_readable < 0) {
 			con->is_readable = 0;
@@ -1470,31 +1603,239 @@ int connection_state_machine(connection *con) {
 			/* update timestamps when enabling interest in events */
 			if ((rc & FDEVENT_IN) && !(events & FDEVENT_IN)) {
 				con->read_idle_ts = log_epoch_secs;
+				con->read_idle_ms = log_epoch_ms();
 			}
 			if ((rc & FDEVENT_OUT) && !(events & FDEVENT_OUT)) {
 				con->write_request_ts = log_epoch_secs;
+				con->write_request_ms = log_epoch_ms();
 			}
 			fdevent_fdnode_event_set(con->srv->ev, con->fdn, rc);
 		}
 	}
+}
+
+static void connection_timeout_min (uint64_t * const next, const time_t ts, const int idle) {
+    /* (see connection_check_timeout(): timed out when cur_ts - ts > idle) */
+    const uint64_t t = ((uint64_t)ts + (uint64_t)idle + 1) * 1000;
+    if (*next > t) *next = t;
+}
+
+static void connection_timeout_min_ms (uint64_t * const next, const uint64_t ts_ms, const unsigned int idle_ms) {
+    /* (see connection_idle_expired(): timed out when cur_ms - ts_ms > idle) */
+    const uint64_t t = ts_ms + idle_ms + 1;
+    if (*next > t) *next = t;
+}
 
+/* server.max-read-idle-ms and server.max-write-idle-ms, if set, take
+ * precedence over server.max-read-idle and server.max-write-idle (secs) */
+
+static void connection_timeout_idle (uint64_t * const next, uint64_t * const next_ms, const time_t ts, const uint64_t ts_ms, const unsigned short idle, const unsigned int idle_ms) {
+    if (idle_ms)
+        connection_timeout_min_ms(next_ms, ts_ms, idle_ms);
+    else
+        connection_timeout_min(next, ts, idle);
+}
+
+static int connection_idle_expired (const time_t ts, const uint64_t ts_ms, const unsigned short idle, const unsigned int idle_ms, const time_t cur_ts, const uint64_t cur_ms) {
+    return idle_ms
+      ? (int64_t)(cur_ms - ts_ms) > (int64_t)idle_ms
+      : cur_ts - ts > idle;
+}
+
+static void connection_set_timer (connection * const con) {
+    if (con->fd < 0) return;
+
+    /* schedule next timeout check; mirrors connection_check_timeout() */
+    uint64_t next = UINT64_MAX;
+    uint64_t next_ms = UINT64_MAX;
+    request_st * const r = &con->request;
+    if (con->h2) {
+        const h2con * const h2c = con->h2;
+        if (0 == h2c->rused)
+            connection_timeout_min(&next, con->read_idle_ts,
+                                   con->keep_alive_idle);
+        for (uint32_t i = 0; i < h2c->rused; ++i) {
+            const request_st * const hr = h2c->r[i];
+            if (hr->state == CON_STATE_READ_POST)
+                connection_timeout_idle(&next, &next_ms,
+                                        con->read_idle_ts, con->read_idle_ms,
+                                        hr->conf.max_read_idle,
+                                        hr->conf.max_read_idle_ms);
+            else if (hr->state == CON_STATE_WRITE)
+                connection_timeout_idle(&next, &next_ms,
+                                        con->write_request_ts > hr->start_ts
+                                          ? con->write_request_ts
+                                          : hr->start_ts,
+                                        con->write_request_ms > hr->start_ms
+                                          ? con->write_request_ms
+                                          : hr->start_ms,
+                                        hr->conf.max_write_idle,
+                                        hr->conf.max_write_idle_ms);
+        }
+        if (!chunkqueue_is_empty(con->write_queue))
+            connection_timeout_idle(&next, &next_ms,
+                                    con->write_request_ts,
+                                    con->write_request_ms,
+                                    r->conf.max_write_idle,
+                                    r->conf.max_write_idle_ms);
+    }
+    else if (r->state == CON_STATE_CLOSE)
+        connection_timeout_min(&next, con->close_timeout_ts,
+                               HTTP_LINGER_TIMEOUT);
+    else if (fdevent_fdnode_interest(con->fdn) & FDEVENT_IN) {
+        if (con->request_count == 1 || r->state != CON_STATE_READ)
+            connection_timeout_idle(&next, &next_ms,
+                                    con->read_idle_ts, con->read_idle_ms,
+                                    r->conf.max_read_idle,
+                                    r->conf.max_read_idle_ms);
+        else
+            connection_timeout_min(&next, con->read_idle_ts,
+                                   con->keep_alive_idle);
+    }
+
+    if (r->state == CON_STATE_WRITE && !con->h2 && con->write_request_ts != 0)
+        connection_timeout_idle(&next, &next_ms,
+                                con->write_request_ts, con->write_request_ms,
+                                r->conf.max_write_idle,
+                                r->conf.max_write_idle_ms);
+
+    if (con->traffic_limit_reached)
+        connection_timeout_min(&next, log_epoch_secs, 0);
+
+    if (next != UINT64_MAX) {
+        /* timeouts in secs; check no more often than once per sec */
+        const uint64_t min = ((uint64_t)log_epoch_secs + 1) * 1000;
+        if (next < min) next = min;
+    }
+    if (next > next_ms) next = next_ms; /*(ms timeouts are not rounded)*/
+
+    if (next == UINT64_MAX) return; /*(no timeout; leave any pending check)*/
+
+    /* (lazy: timestamps only move forward with activity; if the timer fires
+     *  early, connection_check_timeout() is a no-op and timer rescheduled) */
+    tw_node * const n = &con->timer;
+    if (!tw_is_scheduled(n) || next < n->expires)
+        tw_add(&con->srv->tw, n, next);
+}
+
+int connection_state_machine(connection *con) {
+	request_st * const r = &con->request;
+	if (!con->h2)
+		connection_state_machine_loop(r, con);
+	if (con->h2) /*(not else; connection might have been upgraded)*/
+		connection_state_machine_h2(r, con);
+	connection_set_fdevent_interest(r, con);
+	connection_set_timer(con);
 	return 0;
 }
 
-static void connection_check_timeout (connection * const con, const time_t cur_ts) {
+static void connection_log_write_timeout (const request_st * const r, const connection * const con, const off_t bytes) {
+    if (r->conf.max_write_idle_ms)
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "NOTE: a request from %.*s for %.*s timed out after writing "
+          "%lld bytes. We waited %u ms.  If this is a problem, "
+          "increase server.max-write-idle-ms",
+          BUFFER_INTLEN_PTR(con->dst_addr_buf),
+          BUFFER_INTLEN_PTR(&r->target),
+          (long long)bytes, r->conf.max_write_idle_ms);
+    else
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "NOTE: a request from %.*s for %.*s timed out after writing "
+          "%lld bytes. We waited %d seconds.  If this is a problem, "
+          "increase server.max-write-idle",
+          BUFFER_INTLEN_PTR(con->dst_addr_buf),
+          BUFFER_INTLEN_PTR(&r->target),
+          (long long)bytes, (int)r->conf.max_write_idle);
+}
+
+static int connection_check_timeout_h2 (connection * const con, const time_t cur_ts, const uint64_t cur_ms) {
+    request_st * const h2r = &con->request;
+    h2con * const h2c = con->h2;
+    int changed = 0;
+
+    if (0 == h2c->rused && cur_ts - con->read_idle_ts > con->keep_alive_idle) {
+        /* time - out */
+        if (h2r->conf.log_request_handling) {
+            log_error(h2r->conf.errh, __FILE__, __LINE__,
+                      "connection closed - keep-alive timeout: %d", con->fd);
+        }
+        h2_send_goaway(con, H2_E_NO_ERROR);
+        changed = 1;
+    }
+
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        request_st * const r = h2c->r[i];
+        if (r->state == CON_STATE_READ_POST) {
+            if (connection_idle_expired(con->read_idle_ts, con->read_idle_ms,
+                                        r->conf.max_read_idle,
+                                        r->conf.max_read_idle_ms,
+                                        cur_ts, cur_ms)) {
+                /* time - out */
+                if (r->conf.log_request_handling) {
+                    log_error(r->conf.errh, __FILE__, __LINE__,
+                              "request aborted - read timeout: %d", con->fd);
+                }
+                connection_set_state(r, CON_STATE_ERROR);
+                changed = 1;
+            }
+        }
+        else if (r->state == CON_STATE_WRITE) {
+            const time_t ts = con->write_request_ts > r->start_ts
+              ? con->write_request_ts
+              : r->start_ts;
+            const uint64_t ts_ms = con->write_request_ms > r->start_ms
+              ? con->write_request_ms
+              : r->start_ms;
+            if (connection_idle_expired(ts, ts_ms, r->conf.max_write_idle,
+                                        r->conf.max_write_idle_ms,
+                                        cur_ts, cur_ms)) {
+                /* time - out */
+                if (r->conf.log_timeouts)
+                    connection_log_write_timeout(r, con,
+                                                 r->write_queue->bytes_out);
+                connection_set_state(r, CON_STATE_ERROR);
+                changed = 1;
+            }
+        }
+    }
+
+    if (!chunkqueue_is_empty(con->write_queue)
+        && connection_idle_expired(con->write_request_ts,
+                                   con->write_request_ms,
+                                   h2r->conf.max_write_idle,
+                                   h2r->conf.max_write_idle_ms,
+                                   cur_ts, cur_ms)) {
+        /* time - out (client not reading) */
+        if (h2r->conf.log_request_handling) {
+            log_error(h2r->conf.errh, __FILE__, __LINE__,
+                      "connection closed - write timeout: %d", con->fd);
+        }
+        connection_set_state(h2r, CON_STATE_ERROR);
+        changed = 1;
+    }
+
+    return changed;
+}
+
+static void connection_check_timeout (connection * const con, const time_t cur_ts, const uint64_t cur_ms) {
     const int waitevents = fdevent_fdnode_interest(con->fdn);
     int changed = 0;
     int t_diff;
 
     request_st * const r = &con->request;
-    if (r->state == CON_STATE_CLOSE) {
+    if (con->h2) {
+        changed = connection_check_timeout_h2(con, cur_ts, cur_ms);
+    } else if (r->state == CON_STATE_CLOSE) {
         if (cur_ts - con->close_timeout_ts > HTTP_LINGER_TIMEOUT) {
             changed = 1;
         }
     } else if (waitevents & FDEVENT_IN) {
         if (con->request_count == 1 || r->state != CON_STATE_READ) {
             /* e.g. CON_STATE_READ_POST || CON_STATE_WRITE */
-            if (cur_ts - con->read_idle_ts > r->conf.max_read_idle) {
+            if (connection_idle_expired(con->read_idle_ts, con->read_idle_ms,
+                                        r->conf.max_read_idle,
+                                        r->conf.max_read_idle_ms,
+                                        cur_ts, cur_ms)) {
                 /* time - out */
                 if (r->conf.log_request_handling) {
                     log_error(r->conf.errh, __FILE__, __LINE__,
@@ -1524,7 +1865,7 @@ static void connection_check_timeout (connection * const con, const time_t cur_t
      * future: have separate backend timeout, and then change this
      * to check for write interest before checking for timeout */
     /*if (waitevents & FDEVENT_OUT)*/
-    if ((r->state == CON_STATE_WRITE) &&
+    if ((r->state == CON_STATE_WRITE) && !con->h2 &&
         (con->write_request_ts != 0)) {
       #if 0
         if (cur_ts - con->write_request_ts > 60) {
@@ -1534,17 +1875,14 @@ static void connection_check_timeout (connection * const con, const time_t cur_t
         }
       #endif
 
-        if (cur_ts - con->write_request_ts > r->conf.max_write_idle) {
+        if (connection_idle_expired(con->write_request_ts,
+                                    con->write_request_ms,
+                                    r->conf.max_write_idle,
+                                    r->conf.max_write_idle_ms,
+                                    cur_ts, cur_ms)) {
             /* time - out */
-            if (r->conf.log_timeouts) {
-                log_error(r->conf.errh, __FILE__, __LINE__,
-                  "NOTE: a request from %.*s for %.*s timed out after writing "
-                  "%lld bytes. We waited %d seconds.  If this is a problem, "
-                  "increase server.max-write-idle",
-                  BUFFER_INTLEN_PTR(con->dst_addr_buf),
-                  BUFFER_INTLEN_PTR(&r->target),
-                  (long long)con->bytes_written, (int)r->conf.max_write_idle);
-            }
+            if (r->conf.log_timeouts)
+                connection_log_write_timeout(r, con, con->bytes_written);
             connection_set_state(r, CON_STATE_ERROR);
             changed = 1;
         }
@@ -1561,18 +1899,21 @@ static void connection_check_timeout (connection * const con, const time_t cur_t
         changed = 1;
     }
 
-    con->bytes_written_cur_second = 0;
-
     if (changed) {
         connection_state_machine(con);
     }
+    else {
+        connection_set_timer(con);
+    }
 }
 
-void connection_periodic_maint (server * const srv, const time_t cur_ts) {
-    /* check all connections for timeouts */
-    connections * const conns = &srv->conns;
-    for (size_t ndx = 0; ndx < conns->used; ++ndx) {
-        connection_check_timeout(conns->ptr[ndx], cur_ts);
+void connection_periodic_maint (server * const srv, const uint64_t cur_ms) {
+    /* check connections with expired timers for timeouts */
+    tw_node *n = tw_expire(&srv->tw, cur_ms);
+    while (n) {
+        connection * const con = n->ctx;
+        n = n->next; /*(before con->timer might be rescheduled)*/
+        connection_check_timeout(con, log_epoch_secs, cur_ms);
     }
 }
 
@@ -1583,13 +1924,20 @@ void connection_graceful_shutdown_maint (server *srv) {
         int changed = 0;
 
         request_st * const r = &con->request;
-        if (r->state == CON_STATE_CLOSE) {
+        if (con->h2) {
+            /* HTTP/2: no new streams; close after active streams complete */
+            h2_send_goaway(con, H2_E_NO_ERROR);
+            changed = 1;
+        }
+        else if (r->state == CON_STATE_CLOSE) {
             /* reduce remaining linger timeout to be
              * (from zero) *up to* one more second, but no more */
             if (HTTP_LINGER_TIMEOUT > 1)
                 con->close_timeout_ts -= (HTTP_LINGER_TIMEOUT - 1);
             if (log_epoch_secs - con->close_timeout_ts > HTTP_LINGER_TIMEOUT)
                 changed = 1;
+            else
+                connection_set_timer(con); /*(reschedule earlier)*/
         }
         else if (r->state == CON_STATE_READ && con->request_count > 1
                  && chunkqueue_is_empty(con->read_queue)) {
@@ -10,7 +10,7 @@ void connections_free(server *srv);
 __attribute_cold__
 void connection_graceful_shutdown_maint (server *srv);
 
-void connection_periodic_maint (server *srv, time_t cur_ts);
+void connection_periodic_maint (server *srv, uint64_t cur_ms);
 
 connection * connection_accept(server *srv, server_socket *srv_sock);
 connection * connection_accepted(server *srv, server_socket *srv_socket, sock_addr *cnt_addr, int cnt);
@@ -26,6 +26,26 @@ handler_t connection_handle_read_post_error(request_st *r, int http_status);
 int connection_write_chunkqueue(connection *con, chunkqueue *c, off_t max_bytes);
 void connection_response_reset(request_st *r);
 
+void connection_request_parse(request_st *r, char *hdrs, const unsigned short *hoff, uint32_t header_len);
+
+__attribute_cold__
+void request_init(request_st *r, connection *con, server *srv);
+void request_reset(request_st *r);
+void request_free(request_st *r);
+
+/* bytes written to clients by all connections; reported by mod_status
+ * (counter is shared by threads (server.threads)) */
+extern uint64_t connection_bytes_out;
+#ifdef HAVE_THREADS
+#define connection_bytes_out_add(n) \
+        __atomic_add_fetch(&connection_bytes_out, (n), __ATOMIC_RELAXED)
+#define connection_bytes_out_get() \
+        __atomic_load_n(&connection_bytes_out, __ATOMIC_RELAXED)
+#else
+#define connection_bytes_out_add(n) (connection_bytes_out += (n))
+#define connection_bytes_out_get() (connection_bytes_out)
+#endif
+
 #define joblist_append(con) connection_list_append(&(con)->srv->joblist, (con))
 void connection_list_append(connections *conns, connection *con);
 
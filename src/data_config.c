@@ -7,7 +7,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
@@ -36,9 +39,11 @@ static void data_config_free(data_unset *d) {
 	vector_config_weak_clear(&ds->children);
 
 	free(ds->string.ptr);
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+	if (ds->code) pcre2_code_free(ds->code);
+#elif defined(HAVE_PCRE_H)
 	if (ds->regex) pcre_free(ds->regex);
-	if (ds->regex_study) pcre_free(ds->regex_study);
+	if (ds->regex_study) pcre_free_study(ds->regex_study);
 #endif
 
 	free(d);
@@ -148,13 +153,38 @@ data_config *data_config_init(void) {
 }
 
 int data_config_pcre_compile(data_config *dc) {
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+    /* (use fprintf() on error, as this is called from configparser.y) */
+    int errcode;
+    PCRE2_SIZE erroff;
+
+    if (dc->code) pcre2_code_free(dc->code);
+
+    dc->code = pcre2_compile((PCRE2_SPTR)dc->string.ptr,
+                             buffer_string_length(&dc->string),
+                             0, &errcode, &erroff, NULL);
+    if (NULL == dc->code) {
+        PCRE2_UCHAR errbuf[256];
+        pcre2_get_error_message(errcode, errbuf, sizeof(errbuf));
+        fprintf(stderr, "parsing regex failed: %s -> %s at offset %zu\n",
+                dc->string.ptr, (char *)errbuf, (size_t)erroff);
+        return 0;
+    }
+
+    /* JIT compile; (on failure, e.g. if JIT unsupported on platform,
+     * pcre2_match() uses the interpreter) */
+    (void)pcre2_jit_compile(dc->code, PCRE2_JIT_COMPLETE);
+
+    /* (more than 9 captures are permitted, though only $0..$9 are saved
+     *  for %0..%9 substitutions; see data_config_pcre_exec()) */
+    return 1;
+#elif defined(HAVE_PCRE_H)
     /* (use fprintf() on error, as this is called from configparser.y) */
     const char *errptr;
-    int erroff, captures;
+    int erroff;
 
     if (dc->regex) pcre_free(dc->regex);
-    if (dc->regex_study) pcre_free(dc->regex_study);
+    if (dc->regex_study) pcre_free_study(dc->regex_study);
 
     dc->regex = pcre_compile(dc->string.ptr, 0, &errptr, &erroff, NULL);
     if (NULL == dc->regex) {
@@ -163,24 +193,18 @@ int data_config_pcre_compile(data_config *dc) {
         return 0;
     }
 
-    dc->regex_study = pcre_study(dc->regex, 0, &errptr);
+  #ifndef PCRE_STUDY_JIT_COMPILE
+  #define PCRE_STUDY_JIT_COMPILE 0
+  #endif
+    dc->regex_study = pcre_study(dc->regex, PCRE_STUDY_JIT_COMPILE, &errptr);
     if (NULL == dc->regex_study && errptr != NULL) {
         fprintf(stderr, "studying regex failed: %s -> %s\n",
                 dc->string.ptr, errptr);
         return 0;
     }
 
-    erroff = pcre_fullinfo(dc->regex, dc->regex_study, PCRE_INFO_CAPTURECOUNT,
-                           &captures);
-    if (0 != erroff) {
-        fprintf(stderr, "getting capture count for regex failed: %s\n",
-                dc->string.ptr);
-        return 0;
-    } else if (captures > 9) {
-        fprintf(stderr, "Too many captures in regex, use (?:...) instead of (...): %s\n",
-                dc->string.ptr);
-        return 0;
-    }
+    /* (more than 9 captures are permitted, though only $0..$9 are saved
+     *  for %0..%9 substitutions; see data_config_pcre_exec()) */
     return 1;
 #else
     fprintf(stderr, "can't handle '$%s[%s] =~ ...' as you compiled without pcre support. \n"
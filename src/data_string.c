@@ -80,6 +80,7 @@ data_string *data_string_init(void) {
 
 	ds = calloc(1, sizeof(*ds));
 	force_assert(NULL != ds);
+	heap_nallocs_inc();
 
 	ds->type = TYPE_STRING;
 	ds->fn = &fn;
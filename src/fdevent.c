@@ -33,6 +33,10 @@ int fdevent_config(const char **event_handler_name, log_error_st *errh) {
 		{ FDEVENT_HANDLER_LINUX_SYSEPOLL, "linux-sysepoll" },
 		{ FDEVENT_HANDLER_LINUX_SYSEPOLL, "epoll" },
 #endif
+#ifdef FDEVENT_USE_LINUX_IOURING
+		{ FDEVENT_HANDLER_LINUX_IOURING,  "linux-iouring" },
+		{ FDEVENT_HANDLER_LINUX_IOURING,  "io_uring" },
+#endif
 #ifdef FDEVENT_USE_SOLARIS_PORT
 		{ FDEVENT_HANDLER_SOLARIS_PORT,   "solaris-eventports" },
 #endif
@@ -114,6 +118,11 @@ const char * fdevent_show_event_handlers(void) {
 #else
       "\t- epoll (Linux)\n"
 #endif
+#ifdef FDEVENT_USE_LINUX_IOURING
+      "\t+ io_uring (Linux)\n"
+#else
+      "\t- io_uring (Linux)\n"
+#endif
 #ifdef FDEVENT_USE_SOLARIS_DEVPOLL
       "\t+ /dev/poll (Solaris)\n"
 #else
@@ -153,7 +162,9 @@ fdevents * fdevent_init(const char *event_handler, int *max_fds, int *cur_fds, l
 	 * Test if SOCK_NONBLOCK is ignored by kernel on sockets.
 	 * (reported on Android running a custom ROM)
 	 * https://redmine.lighttpd.net/issues/2883
+	 * (test once; fdevent_init() is called for each thread w/ server.threads)
 	 */
+	if (!use_sock_cloexec) {
        #ifdef SOCK_NONBLOCK
 	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
        #else
@@ -167,6 +178,7 @@ fdevents * fdevent_init(const char *event_handler, int *max_fds, int *cur_fds, l
 		use_sock_cloexec = 1;
 		close(fd);
 	}
+	}
       #endif
 
       #ifdef FDEVENT_USE_SELECT
@@ -211,6 +223,11 @@ fdevents * fdevent_init(const char *event_handler, int *max_fds, int *cur_fds, l
 		if (0 == fdevent_linux_sysepoll_init(ev)) return ev;
 		break;
 	#endif
+	#ifdef FDEVENT_USE_LINUX_IOURING
+	case FDEVENT_HANDLER_LINUX_IOURING:
+		if (0 == fdevent_linux_iouring_init(ev)) return ev;
+		break;
+	#endif
 	#ifdef FDEVENT_USE_SOLARIS_DEVPOLL
 	case FDEVENT_HANDLER_SOLARIS_DEVPOLL:
 		if (0 == fdevent_solaris_devpoll_init(ev)) return ev;
@@ -1081,6 +1098,20 @@ int fdevent_set_so_reuseaddr (const int fd, const int opt)
     return setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 }
 
+int fdevent_set_so_reuseport (const int fd, const int opt)
+{
+  #if defined(SO_REUSEPORT_LB) /* FreeBSD: load-balancing variant */
+    return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT_LB, &opt, sizeof(opt));
+  #elif defined(SO_REUSEPORT)
+    return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+  #else
+    UNUSED(fd);
+    UNUSED(opt);
+    errno = ENOPROTOOPT;
+    return -1;
+  #endif
+}
+
 
 #include <sys/stat.h>
 #include "safe_memclear.h"
@@ -9,6 +9,11 @@
 struct epoll_event;     /* declaration */
 #endif
 
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__linux__)
+# define FDEVENT_USE_LINUX_IOURING
+struct fdevent_iouring; /* declaration */
+#endif
+
 /* MacOS 10.3.x has poll.h under /usr/include/, all other unixes
  * under /usr/include/sys/ */
 #if defined HAVE_POLL && (defined(HAVE_SYS_POLL_H) || defined(HAVE_POLL_H))
@@ -57,7 +62,8 @@ typedef enum {
     FDEVENT_HANDLER_SOLARIS_DEVPOLL,
     FDEVENT_HANDLER_SOLARIS_PORT,
     FDEVENT_HANDLER_FREEBSD_KQUEUE,
-    FDEVENT_HANDLER_LIBEV
+    FDEVENT_HANDLER_LIBEV,
+    FDEVENT_HANDLER_LINUX_IOURING
 } fdevent_handler_t;
 
 /**
@@ -89,6 +95,9 @@ struct fdevents {
     int epoll_fd;
     struct epoll_event *epoll_events;
   #endif
+  #ifdef FDEVENT_USE_LINUX_IOURING
+    struct fdevent_iouring *iouring;
+  #endif
   #ifdef FDEVENT_USE_SOLARIS_DEVPOLL
     int devpoll_fd;
     struct pollfd *devpollfds;
@@ -137,6 +146,8 @@ int fdevent_poll_init(struct fdevents *ev);
 __attribute_cold__
 int fdevent_linux_sysepoll_init(struct fdevents *ev);
 __attribute_cold__
+int fdevent_linux_iouring_init(struct fdevents *ev);
+__attribute_cold__
 int fdevent_solaris_devpoll_init(struct fdevents *ev);
 __attribute_cold__
 int fdevent_solaris_port_init(struct fdevents *ev);
@@ -74,7 +74,7 @@ static void timeout_watcher_cb(struct ev_loop *loop, ev_timer *w, int revents) {
 	UNUSED(revents);
 }
 
-static ev_timer timeout_watcher;
+static __thread_local ev_timer timeout_watcher;
 
 static int fdevent_libev_poll(fdevents *ev, int timeout_ms) {
 	timeout_watcher.repeat = (timeout_ms > 0) ? timeout_ms/1000.0 : 0.001;
@@ -0,0 +1,338 @@
+#include "first.h"
+
+#include "fdevent_impl.h"
+#include "fdevent.h"
+#include "buffer.h"
+#include "log.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef FDEVENT_USE_LINUX_IOURING
+
+# include <poll.h>
+# include <linux/io_uring.h>
+
+/*
+ * io_uring event handler
+ *
+ * Readiness notification is built on one-shot IORING_OP_POLL_ADD requests,
+ * which are re-armed after each completion in order to preserve the
+ * level-triggered semantics lighttpd expects from every event handler.
+ * Changes in interest (event_set, event_del) are only queued in the
+ * submission ring and are submitted to the kernel together with the wait for
+ * completions in a single io_uring_enter() syscall per fdevent_poll(),
+ * instead of one epoll_ctl() syscall per change.
+ *
+ * This is a readiness backend only: accept(), read(), writev() and sendfile()
+ * are still issued by the callers, as with the other event handlers.
+ *
+ * Each armed poll request is tagged with a generation number (stored in
+ * fdn->fde_ndx) in addition to the fd, so that completions of stale requests
+ * (removed, replaced, or for a since-reused fd number) are discarded.
+ *
+ * The ring is set up with raw syscalls; liburing is not required.
+ */
+
+struct fdevent_iouring {
+    int ring_fd;
+    uint32_t gen;          /* generation counter for poll requests */
+    uint32_t *armed;       /* per-fd generation of outstanding poll; 0: none */
+
+    /* submission queue */
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    struct io_uring_sqe *sqes;
+
+    /* completion queue */
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_sz;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+};
+
+static int fdevent_linux_iouring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, const void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+static uint32_t fdevent_linux_iouring_sq_pending(const struct fdevent_iouring * const ior) {
+    return *ior->sq_tail - __atomic_load_n(ior->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static int fdevent_linux_iouring_submit(struct fdevent_iouring * const ior) {
+    uint32_t to_submit = fdevent_linux_iouring_sq_pending(ior);
+    while (to_submit) {
+        int rc = fdevent_linux_iouring_enter(ior->ring_fd, to_submit, 0, 0,
+                                             NULL, 0);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        to_submit = fdevent_linux_iouring_sq_pending(ior);
+    }
+    return 0;
+}
+
+static struct io_uring_sqe * fdevent_linux_iouring_get_sqe(struct fdevent_iouring * const ior) {
+    if (fdevent_linux_iouring_sq_pending(ior) == ior->sq_entries
+        && 0 != fdevent_linux_iouring_submit(ior))
+        return NULL;
+    const uint32_t tail = *ior->sq_tail;
+    const uint32_t ndx = tail & ior->sq_mask;
+    struct io_uring_sqe * const sqe = ior->sqes + ndx;
+    memset(sqe, 0, sizeof(*sqe));
+    ior->sq_array[ndx] = ndx;
+    return sqe;
+}
+
+static void fdevent_linux_iouring_queue_sqe(struct fdevent_iouring * const ior) {
+    __atomic_store_n(ior->sq_tail, *ior->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static int fdevent_linux_iouring_poll_add(struct fdevent_iouring * const ior, int fd, uint32_t gen, int events) {
+    struct io_uring_sqe * const sqe = fdevent_linux_iouring_get_sqe(ior);
+    if (NULL == sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    /*(FDEVENT_* event bits all fit in 16-bit poll_events)*/
+    sqe->poll_events = (uint16_t)(events | POLLERR | POLLHUP);
+    sqe->user_data = ((uint64_t)gen << 32) | (uint32_t)fd;
+    fdevent_linux_iouring_queue_sqe(ior);
+    ior->armed[fd] = gen;
+    return 0;
+}
+
+static int fdevent_linux_iouring_poll_remove(struct fdevent_iouring * const ior, int fd) {
+    const uint32_t gen = ior->armed[fd];
+    if (0 == gen) return 0; /*(no outstanding poll request)*/
+    struct io_uring_sqe * const sqe = fdevent_linux_iouring_get_sqe(ior);
+    if (NULL == sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = ((uint64_t)gen << 32) | (uint32_t)fd;
+    sqe->user_data = 0; /*(completions of removal requests are ignored)*/
+    fdevent_linux_iouring_queue_sqe(ior);
+    ior->armed[fd] = 0;
+    return 0;
+}
+
+__attribute_cold__
+static void fdevent_linux_iouring_free(fdevents *ev) {
+    struct fdevent_iouring * const ior = ev->iouring;
+    if (NULL == ior) return;
+    if (ior->sqes)
+        munmap(ior->sqes, ior->sqes_sz);
+    if (ior->cq_ring && ior->cq_ring != ior->sq_ring)
+        munmap(ior->cq_ring, ior->cq_ring_sz);
+    if (ior->sq_ring)
+        munmap(ior->sq_ring, ior->sq_ring_sz);
+    if (-1 != ior->ring_fd)
+        close(ior->ring_fd);
+    free(ior->armed);
+    free(ior);
+    ev->iouring = NULL;
+}
+
+static int fdevent_linux_iouring_event_del(fdevents *ev, fdnode *fdn) {
+    return fdevent_linux_iouring_poll_remove(ev->iouring, fdn->fd);
+}
+
+static int fdevent_linux_iouring_event_set(fdevents *ev, fdnode *fdn, int events) {
+    struct fdevent_iouring * const ior = ev->iouring;
+    if (0 != fdevent_linux_iouring_poll_remove(ior, fdn->fd)) return -1;
+    if (++ior->gen > INT32_MAX) ior->gen = 1; /*(fde_ndx is int; skip 0)*/
+    if (0 != fdevent_linux_iouring_poll_add(ior, fdn->fd, ior->gen, events))
+        return -1;
+    fdn->fde_ndx = (int)ior->gen;
+    return 0;
+}
+
+static int fdevent_linux_iouring_poll(fdevents * const ev, int timeout_ms) {
+    struct fdevent_iouring * const ior = ev->iouring;
+    uint32_t to_submit = fdevent_linux_iouring_sq_pending(ior);
+    uint32_t head = *ior->cq_head;
+    int rc;
+
+    if (head == __atomic_load_n(ior->cq_tail, __ATOMIC_ACQUIRE)
+        && 0 != timeout_ms) {
+        /* submit queued interest changes and wait for events in one syscall */
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (timeout_ms > 0) {
+            ts.tv_sec  = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+        rc = fdevent_linux_iouring_enter(ior->ring_fd, to_submit, 1,
+                                         IORING_ENTER_GETEVENTS
+                                        |IORING_ENTER_EXT_ARG,
+                                         &arg, sizeof(arg));
+        if (rc < 0 && errno != ETIME) return -1;
+    }
+    else if (to_submit) {
+        rc = fdevent_linux_iouring_enter(ior->ring_fd, to_submit, 0, 0,
+                                         NULL, 0);
+        if (rc < 0 && errno != EINTR) return -1;
+    }
+
+    const uint32_t tail = __atomic_load_n(ior->cq_tail, __ATOMIC_ACQUIRE);
+    int n = 0;
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe * const cqe = ior->cqes + (head & ior->cq_mask);
+        const uint64_t user_data = cqe->user_data;
+        const int res = cqe->res;
+        /*(release cqe slot before running handler)*/
+        __atomic_store_n(ior->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        if (0 == user_data) continue; /*(POLL_REMOVE completion)*/
+        const int fd = (int)(uint32_t)user_data;
+        const uint32_t gen = (uint32_t)(user_data >> 32);
+        if (ior->armed[fd] != gen) continue; /*(stale; removed or replaced)*/
+        ior->armed[fd] = 0; /*(one-shot poll request has completed)*/
+
+        fdnode * const fdn = ev->fdarray[fd];
+        if (NULL == fdn || ((uintptr_t)fdn & 0x3)) continue;
+        if (fdn->fde_ndx != (int)gen) continue;
+
+        ++n;
+        if ((fdevent_handler)NULL != fdn->handler) {
+            (*fdn->handler)(fdn->ctx, res >= 0 ? res : FDEVENT_ERR);
+        }
+
+        /* re-arm poll request (level-triggered semantics) unless handler
+         * removed or modified interest, or unregistered or closed the fd */
+        if (0 == ior->armed[fd] && ev->fdarray[fd] == fdn
+            && fdn->fde_ndx == (int)gen) {
+            if (0 != fdevent_linux_iouring_poll_add(ior, fd, gen, fdn->events))
+                log_perror(ev->errh, __FILE__, __LINE__,
+                  "io_uring poll re-arm failed on fd %d", fd);
+        }
+    }
+
+    return n;
+}
+
+__attribute_cold__
+int fdevent_linux_iouring_init(fdevents *ev) {
+    force_assert(POLLIN    == FDEVENT_IN);
+    force_assert(POLLPRI   == FDEVENT_PRI);
+    force_assert(POLLOUT   == FDEVENT_OUT);
+    force_assert(POLLERR   == FDEVENT_ERR);
+    force_assert(POLLHUP   == FDEVENT_HUP);
+    force_assert(POLLNVAL  == FDEVENT_NVAL);
+  #ifdef POLLRDHUP
+    force_assert(POLLRDHUP == FDEVENT_RDHUP);
+  #endif
+
+    ev->type      = FDEVENT_HANDLER_LINUX_IOURING;
+    ev->event_set = fdevent_linux_iouring_event_set;
+    ev->event_del = fdevent_linux_iouring_event_del;
+    ev->poll      = fdevent_linux_iouring_poll;
+    ev->free      = fdevent_linux_iouring_free;
+
+    struct fdevent_iouring * const ior = ev->iouring =
+      calloc(1, sizeof(struct fdevent_iouring));
+    force_assert(NULL != ior);
+    ior->ring_fd = -1;
+    ior->armed = calloc(ev->maxfds, sizeof(*ior->armed));
+    force_assert(NULL != ior->armed);
+
+    /* size SQ for a burst of interest changes (flushed early if full);
+     * size CQ for one outstanding poll request per fd plus removals */
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    p.cq_entries = ev->maxfds * 2;
+    uint32_t entries = ev->maxfds < 1024 ? ev->maxfds : 1024;
+    ior->ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (-1 == ior->ring_fd) {
+        log_perror(ev->errh, __FILE__, __LINE__, "io_uring_setup()");
+        fdevent_linux_iouring_free(ev);
+        return -1;
+    }
+
+    fdevent_setfd_cloexec(ior->ring_fd);
+
+    /*(require kernel 5.11+: never drop completions; timeout in enter())*/
+    if (!(p.features & IORING_FEAT_NODROP)
+        || !(p.features & IORING_FEAT_EXT_ARG)) {
+        log_error(ev->errh, __FILE__, __LINE__,
+          "io_uring: kernel lacks required features (Linux 5.11+ required)");
+        fdevent_linux_iouring_free(ev);
+        return -1;
+    }
+
+    ior->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ior->cq_ring_sz = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ior->cq_ring_sz > ior->sq_ring_sz)
+            ior->sq_ring_sz = ior->cq_ring_sz;
+        ior->cq_ring_sz = ior->sq_ring_sz;
+    }
+
+    ior->sq_ring = mmap(NULL, ior->sq_ring_sz, PROT_READ|PROT_WRITE,
+                        MAP_SHARED|MAP_POPULATE, ior->ring_fd,
+                        IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ior->sq_ring) {
+        ior->sq_ring = NULL;
+        log_perror(ev->errh, __FILE__, __LINE__, "io_uring mmap()");
+        fdevent_linux_iouring_free(ev);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        ior->cq_ring = ior->sq_ring;
+    else {
+        ior->cq_ring = mmap(NULL, ior->cq_ring_sz, PROT_READ|PROT_WRITE,
+                            MAP_SHARED|MAP_POPULATE, ior->ring_fd,
+                            IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ior->cq_ring) {
+            ior->cq_ring = NULL;
+            log_perror(ev->errh, __FILE__, __LINE__, "io_uring mmap()");
+            fdevent_linux_iouring_free(ev);
+            return -1;
+        }
+    }
+
+    ior->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    ior->sqes = mmap(NULL, ior->sqes_sz, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, ior->ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == ior->sqes) {
+        ior->sqes = NULL;
+        log_perror(ev->errh, __FILE__, __LINE__, "io_uring mmap()");
+        fdevent_linux_iouring_free(ev);
+        return -1;
+    }
+
+    char * const sq = ior->sq_ring;
+    char * const cq = ior->cq_ring;
+    ior->sq_head    = (uint32_t *)(sq + p.sq_off.head);
+    ior->sq_tail    = (uint32_t *)(sq + p.sq_off.tail);
+    ior->sq_mask    = *(uint32_t *)(sq + p.sq_off.ring_mask);
+    ior->sq_entries = *(uint32_t *)(sq + p.sq_off.ring_entries);
+    ior->sq_array   = (uint32_t *)(sq + p.sq_off.array);
+    ior->cq_head    = (uint32_t *)(cq + p.cq_off.head);
+    ior->cq_tail    = (uint32_t *)(cq + p.cq_off.tail);
+    ior->cq_mask    = *(uint32_t *)(cq + p.cq_off.ring_mask);
+    ior->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+#endif
@@ -147,5 +147,19 @@
 #endif
 #endif
 
+/* threaded event loops (server.threads) require pthreads and thread-local
+ * storage; otherwise, per-thread caches are simply (single) static storage */
+#if defined(HAVE_PTHREAD_H) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_THREADS
+#define __thread_local __thread
+#else
+#define __thread_local
+#endif
+
+/* regex support (pcre2, or legacy pcre) */
+#if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
+#define HAVE_PCRE
+#endif
+
 
 #endif
@@ -30,77 +30,127 @@
 #include "array.h"
 #include "buffer.h"
 #include "crc32.h"
+#include "rand.h"
 #include "fdevent.h"
 #include "log.h"
 #include "sock_addr.h"
 #include "settings.h"   /* MAX_WRITE_LIMIT */
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* gw_host and gw_proc state (load, proc lists and state, idle connections,
+ * latency and health) is shared between server.threads; gw_lock() is held
+ * by callers of the static gw_host_*() and gw_proc_*() routines below */
+static pthread_mutex_t gw_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define gw_lock()   pthread_mutex_lock(&gw_mutex)
+#define gw_unlock() pthread_mutex_unlock(&gw_mutex)
+#else
+#define gw_lock()   do { } while (0)
+#define gw_unlock() do { } while (0)
+#endif
+
 
 
 
 #include "status_counter.h"
 
+#define GW_STATUS_LABEL_SZ 288
+
 __attribute_noinline__
-static int * gw_status_get_counter(gw_host *host, gw_proc *proc, const char *tag, size_t tlen) {
+static size_t gw_status_label(char * const label, const gw_host * const host, const gw_proc * const proc, const char * const tag, const size_t tlen) {
     /*(At the cost of some memory, could prepare strings for host and for proc
      * so that here we would copy ready made string for proc (or if NULL,
      * for host), and then append tag to produce key)*/
-    char label[288];
     size_t llen = sizeof("gw.backend.")-1, len;
     memcpy(label, "gw.backend.", llen);
 
     len = buffer_string_length(host->id);
-    force_assert(len < sizeof(label) - llen);
+    force_assert(len < GW_STATUS_LABEL_SZ - llen);
     memcpy(label+llen, host->id->ptr, len);
     llen += len;
 
     if (proc) {
-        force_assert(llen < sizeof(label) - (LI_ITOSTRING_LENGTH + 1));
+        force_assert(llen < GW_STATUS_LABEL_SZ - (LI_ITOSTRING_LENGTH + 1));
         label[llen++] = '.';
         len = li_utostrn(label+llen, LI_ITOSTRING_LENGTH, proc->id);
         llen += len;
     }
 
-    force_assert(tlen < sizeof(label) - llen);
+    force_assert(tlen < GW_STATUS_LABEL_SZ - llen);
     memcpy(label+llen, tag, tlen);
     llen += tlen;
     label[llen] = '\0';
 
-    return status_counter_get_counter(label, llen);
+    return llen;
+}
+
+static void gw_status_set(gw_host *host, gw_proc *proc, const char *tag, size_t tlen, int val) {
+    char label[GW_STATUS_LABEL_SZ];
+    const size_t llen = gw_status_label(label, host, proc, tag, tlen);
+    status_counter_set(label, llen, val);
 }
 
 static void gw_proc_tag_inc(gw_host *host, gw_proc *proc, const char *tag, size_t len) {
-    ++(*gw_status_get_counter(host, proc, tag, len));
+    char label[GW_STATUS_LABEL_SZ];
+    const size_t llen = gw_status_label(label, host, proc, tag, len);
+    status_counter_inc(label, llen);
 }
 
 static void gw_proc_load_inc(gw_host *host, gw_proc *proc) {
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".load")) = ++proc->load;
+    gw_status_set(host, proc, CONST_STR_LEN(".load"), ++proc->load);
 
     status_counter_inc(CONST_STR_LEN("gw.active-requests"));
 }
 
 static void gw_proc_load_dec(gw_host *host, gw_proc *proc) {
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".load")) = --proc->load;
+    gw_status_set(host, proc, CONST_STR_LEN(".load"), --proc->load);
 
     status_counter_dec(CONST_STR_LEN("gw.active-requests"));
 }
 
 static void gw_host_assign(gw_host *host) {
-    *gw_status_get_counter(host, NULL, CONST_STR_LEN(".load")) = ++host->load;
+    gw_status_set(host, NULL, CONST_STR_LEN(".load"), ++host->load);
 }
 
 static void gw_host_reset(gw_host *host) {
-    *gw_status_get_counter(host, NULL, CONST_STR_LEN(".load")) = --host->load;
+    gw_status_set(host, NULL, CONST_STR_LEN(".load"), --host->load);
+}
+
+static uint64_t gw_usecs(void) {
+    struct timespec ts;
+    log_clock_gettime_realtime(&ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static void gw_proc_latency_sample(gw_handler_ctx * const hctx) {
+    /* time from sending request to start of response from backend */
+    gw_proc * const proc = hctx->proc;
+    const uint64_t ts = gw_usecs();
+    uint64_t us = ts > hctx->send_us ? ts - hctx->send_us : 0;
+    hctx->send_us = 0;
+    if (us > UINT32_MAX) us = UINT32_MAX;
+    /* exponentially weighted moving average (weight 1/8, as TCP srtt) */
+    proc->latency = proc->latency_n
+      ? proc->latency - (proc->latency >> 3) + ((uint32_t)us >> 3)
+      : (uint32_t)us;
+    /* peak EWMA: jump immediately to higher latency; decay more slowly */
+    proc->latency_peak = (proc->latency_n && proc->latency_peak > (uint32_t)us)
+      ? proc->latency_peak - (proc->latency_peak >> 3) + ((uint32_t)us >> 3)
+      : (uint32_t)us;
+    proc->latency_ts = log_epoch_secs;
+    if (proc->latency_n != UINT32_MAX) ++proc->latency_n;
 }
 
 static int gw_status_init(gw_host *host, gw_proc *proc) {
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".disabled")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".died")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".overloaded")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".connected")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".load")) = 0;
+    gw_status_set(host, proc, CONST_STR_LEN(".disabled"), 0);
+    gw_status_set(host, proc, CONST_STR_LEN(".died"), 0);
+    gw_status_set(host, proc, CONST_STR_LEN(".overloaded"), 0);
+    gw_status_set(host, proc, CONST_STR_LEN(".connected"), 0);
+    gw_status_set(host, proc, CONST_STR_LEN(".load"), 0);
+    gw_status_set(host, proc, CONST_STR_LEN(".idle"), 0);
+    gw_status_set(host, proc, CONST_STR_LEN(".reused"), 0);
 
-    *gw_status_get_counter(host, NULL, CONST_STR_LEN(".load")) = 0;
+    gw_status_set(host, NULL, CONST_STR_LEN(".load"), 0);
 
     return 0;
 }
@@ -108,16 +158,139 @@ static int gw_status_init(gw_host *host, gw_proc *proc) {
 
 
 
+static void gw_conn_close(gw_conn * const c) {
+    if (c->ev) {
+        fdevent_fdnode_event_del(c->ev, c->fdn);
+        /*fdevent_unregister(ev, c->fd);*//*(handled below)*/
+        fdevent_sched_close(c->ev, c->fd, 1);
+    }
+    else /*(not registered with fdevents of any thread)*/
+        close(c->fd);
+    free(c);
+}
+
+typedef struct gw_probe {
+    gw_host *host;
+    gw_proc *proc;
+    fdevents *ev;
+    fdnode *fdn;
+    int fd;
+    int connected;
+    log_error_st *errh;
+    uint32_t rlen;
+    char rbuf[16];
+} gw_probe;
+
+static void gw_probe_close(gw_probe * const hp) {
+    hp->proc->probe = NULL;
+    fdevent_fdnode_event_del(hp->ev, hp->fdn);
+    /*fdevent_unregister(ev, hp->fd);*//*(handled below)*/
+    fdevent_sched_close(hp->ev, hp->fd, 1);
+    free(hp);
+}
+
+static int gw_conn_is_idle(const int fd) {
+    /* check that backend has not closed idle connection
+     * (and has not sent unexpected data) */
+    char c;
+    if (-1 != recv(fd, &c, 1, MSG_PEEK)) return 0;
+    switch (errno) {
+      case EAGAIN:
+     #ifdef EWOULDBLOCK
+     #if EWOULDBLOCK != EAGAIN
+      case EWOULDBLOCK:
+     #endif
+     #endif
+      case EINTR:
+        return 1;
+      default:
+        return 0;
+    }
+}
+
+static void gw_proc_conns_status(gw_host *host, gw_proc *proc) {
+    gw_status_set(host, proc, CONST_STR_LEN(".idle"), (int)proc->num_conns);
+}
+
+static void gw_proc_conns_close(gw_host *host, gw_proc *proc) {
+    for (gw_conn *c; (c = proc->conns); ) {
+        proc->conns = c->next;
+        gw_conn_close(c);
+    }
+    proc->num_conns = 0;
+    gw_proc_conns_status(host, proc);
+}
+
+static void gw_proc_conns_prune(gw_host *host, gw_proc *proc) {
+    const time_t cur_ts = log_epoch_secs;
+    const time_t idle_ts = cur_ts - host->keepalive_idle_timeout;
+    const time_t conn_ts = host->keepalive_max_age
+      ? cur_ts - host->keepalive_max_age
+      : 0;
+    const uint32_t num_conns = proc->num_conns;
+    for (gw_conn **cp = &proc->conns, *c; (c = *cp); ) {
+        if (c->idle_ts < idle_ts || c->conn_ts < conn_ts) {
+            *cp = c->next;
+            --proc->num_conns;
+            gw_conn_close(c);
+        }
+        else
+            cp = &c->next;
+    }
+    if (num_conns != proc->num_conns)
+        gw_proc_conns_status(host, proc);
+}
+
+static handler_t gw_handle_fdevent_idle(void *ctx, int revents) {
+    gw_conn * const c = ctx;
+    /* backend closed idle connection or sent unexpected data
+     * (or event is stale, e.g. from before connection was made idle) */
+    if (!(revents & (FDEVENT_HUP|FDEVENT_ERR)) && gw_conn_is_idle(c->fd))
+        return HANDLER_FINISHED;
+
+    gw_proc * const proc = c->proc;
+    gw_lock();
+    for (gw_conn **cp = &proc->conns; *cp; cp = &(*cp)->next) {
+        if (*cp == c) {
+            *cp = c->next;
+            --proc->num_conns;
+            break;
+        }
+    }
+    gw_proc_conns_status(c->host, proc);
+    gw_unlock();
+    gw_conn_close(c);
+    return HANDLER_FINISHED;
+}
+
 static void gw_proc_set_state(gw_host *host, gw_proc *proc, int state) {
     if ((int)proc->state == state) return;
+    if (proc->conns && state != PROC_STATE_RUNNING)
+        gw_proc_conns_close(host, proc);
     if (proc->state == PROC_STATE_RUNNING) {
         --host->active_procs;
     } else if (state == PROC_STATE_RUNNING) {
-        ++host->active_procs;
+        if (0 == host->active_procs++)
+            host->slow_start_ts = log_epoch_secs;
+        proc->slow_start_ts = log_epoch_secs;
+        proc->health_fails = 0;
+        proc->health_down = 0;
+        proc->latency = 0;
+        proc->latency_n = 0;
+        proc->latency_peak = 0;
     }
     proc->state = state;
 }
 
+static int gw_slow_start_load(int load, time_t ts, unsigned short slow_start) {
+    /* scale up load of host or proc recently (re-)enabled so that it is sent
+     * a smaller (and linearly increasing) share of requests during slow start*/
+    const time_t elapsed = log_epoch_secs - ts;
+    return (elapsed >= 0 && elapsed < (time_t)slow_start)
+      ? (int)((load + 1) * (int)slow_start / (int)(elapsed + 1))
+      : load;
+}
+
 
 static gw_proc *gw_proc_init(void) {
     gw_proc *f = calloc(1, sizeof(*f));
@@ -138,6 +311,24 @@ static void gw_proc_free(gw_proc *f) {
 
     gw_proc_free(f->next);
 
+    if (f->probe) {
+        gw_probe * const hp = f->probe;
+        fdevent_fdnode_event_del(hp->ev, hp->fdn);
+        fdevent_unregister(hp->ev, hp->fd);
+        close(hp->fd);
+        free(hp);
+    }
+
+    for (gw_conn *c; (c = f->conns); ) {
+        f->conns = c->next;
+        if (c->ev) {
+            fdevent_fdnode_event_del(c->ev, c->fdn);
+            fdevent_unregister(c->ev, c->fd);
+        }
+        close(c->fd);
+        free(c);
+    }
+
     buffer_free(f->unixsocket);
     buffer_free(f->connection_name);
     free(f->saddr);
@@ -307,13 +498,15 @@ static void gw_proc_release(gw_host *host, gw_proc *proc, int debug, log_error_s
 static void gw_proc_check_enable(gw_host * const host, gw_proc * const proc, log_error_st * const errh) {
     if (log_epoch_secs <= proc->disabled_until) return;
     if (proc->state != PROC_STATE_OVERLOADED) return;
+    if (proc->health_down) return; /* (enabled when health check succeeds) */
 
     gw_proc_set_state(host, proc, PROC_STATE_RUNNING);
 
     log_error(errh, __FILE__, __LINE__,
       "gw-server re-enabled: %s %s %hu %s",
-      proc->connection_name->ptr, host->host->ptr, host->port,
-      host->unixsocket->ptr ? host->unixsocket->ptr : "");
+      proc->connection_name->ptr,
+      host->host && host->host->ptr ? host->host->ptr : "", host->port,
+      host->unixsocket && host->unixsocket->ptr ? host->unixsocket->ptr : "");
 }
 
 static void gw_proc_waitpid_log(const gw_host * const host, const gw_proc * const proc, log_error_st * const errh, const int status) {
@@ -695,6 +888,7 @@ static void gw_proc_kill(gw_host *host, gw_proc *proc) {
 
     kill(proc->pid, host->kill_signal);
 
+    if (proc->probe) gw_probe_close(proc->probe);
     gw_proc_set_state(host, proc, PROC_STATE_KILLED);
 
     --host->num_procs;
@@ -784,9 +978,49 @@ enum {
   GW_BALANCE_LEAST_CONNECTION,
   GW_BALANCE_RR,
   GW_BALANCE_HASH,
-  GW_BALANCE_STICKY
+  GW_BALANCE_STICKY,
+  GW_BALANCE_PEAK_EWMA,
+  GW_BALANCE_P2C
 };
 
+#define GW_PEAK_EWMA_PENALTY 1000000 /* usec; latency est. of unsampled proc */
+
+static uint64_t gw_proc_cost(const gw_host * const host, const gw_proc * const proc) {
+    /* peak EWMA latency (halved for each second without a sample, so that
+     * a proc which was slow is retried) weighted by outstanding requests */
+    uint64_t latency;
+    if (0 == proc->latency_n)
+        latency = proc->load ? GW_PEAK_EWMA_PENALTY : 0;
+    else {
+        const time_t elapsed = log_epoch_secs - proc->latency_ts;
+        latency = proc->latency_peak;
+        if (elapsed > 0) latency >>= (elapsed < 32 ? elapsed : 32);
+    }
+    int load = proc->load;
+    if (host->slow_start)
+        load = gw_slow_start_load(load, proc->slow_start_ts, host->slow_start);
+    return (latency + 1) * (uint64_t)(load + 1);
+}
+
+static uint64_t gw_host_cost(const gw_host * const host) {
+    uint64_t cost = UINT64_MAX;
+    for (const gw_proc *proc = host->first; proc; proc = proc->next) {
+        if (proc->state != PROC_STATE_RUNNING) continue;
+        const uint64_t c = gw_proc_cost(host, proc);
+        if (c < cost) cost = c;
+    }
+    return cost;
+}
+
+static int gw_host_next_active(const gw_extension * const extension, uint32_t k, const int skip) {
+    for (uint32_t i = 0; i < extension->used; ++i) {
+        if ((int)k != skip && 0 != extension->hosts[k]->active_procs)
+            return (int)k;
+        if (++k == extension->used) k = 0;
+    }
+    return -1;
+}
+
 static gw_host * gw_host_get(request_st * const r, gw_extension *extension, int balance, int debug) {
     gw_host *host;
     buffer *dst_addr_buf;
@@ -844,8 +1078,12 @@ static gw_host * gw_host_get(request_st * const r, gw_extension *extension, int
             host = extension->hosts[k];
             if (0 == host->active_procs) continue;
 
-            if (host->load < max_usage) {
-                max_usage = host->load;
+            int load = host->load;
+            if (host->slow_start)
+                load = gw_slow_start_load(load, host->slow_start_ts,
+                                          host->slow_start);
+            if (load < max_usage) {
+                max_usage = load;
                 ndx = k;
             }
         }
@@ -886,6 +1124,51 @@ static gw_host * gw_host_get(request_st * const r, gw_extension *extension, int
         /* Save new index for next round */
         extension->last_used_ndx = ndx;
 
+        break;
+    case GW_BALANCE_PEAK_EWMA:
+        /* lowest latency-weighted load */
+        if (debug) {
+            log_error(r->conf.errh, __FILE__, __LINE__,
+              "proxy - used peak-ewma balancing");
+        }
+
+        {
+            uint64_t min_cost = UINT64_MAX;
+            for (k = 0, ndx = -1; k < extension->used; ++k) {
+                host = extension->hosts[k];
+                if (0 == host->active_procs) continue;
+
+                const uint64_t cost = gw_host_cost(host);
+                if (cost < min_cost) {
+                    min_cost = cost;
+                    ndx = k;
+                }
+            }
+        }
+
+        break;
+    case GW_BALANCE_P2C:
+        /* power of two random choices: lower latency-weighted load of two
+         * randomly chosen hosts (or next active hosts after those chosen) */
+        if (debug) {
+            log_error(r->conf.errh, __FILE__, __LINE__,
+              "proxy - used p2c balancing");
+        }
+
+        {
+            const uint32_t used = extension->used;
+            k = (uint32_t)li_rand_pseudo() % used;
+            uint32_t k2 = (uint32_t)li_rand_pseudo() % (used - 1);
+            if (k2 >= k) ++k2;
+            ndx = gw_host_next_active(extension, k, -1);
+            if (-1 == ndx) break;
+            const int ndx2 = gw_host_next_active(extension, k2, ndx);
+            if (-1 != ndx2
+                && gw_host_cost(extension->hosts[ndx2])
+                    < gw_host_cost(extension->hosts[ndx]))
+                ndx = ndx2;
+        }
+
         break;
     case GW_BALANCE_STICKY:
         /* source sticky balancing */
@@ -975,7 +1258,10 @@ static int gw_establish_connection(request_st * const r, gw_host *host, gw_proc
 
             return 1;
         } else {
-            gw_proc_connect_error(r, host, proc, pid, errno, debug);
+            const int errnum = errno;
+            gw_lock();
+            gw_proc_connect_error(r, host, proc, pid, errnum, debug);
+            gw_unlock();
             return -1;
         }
     }
@@ -1069,9 +1355,91 @@ static void gw_restart_dead_procs(gw_host * const host, log_error_st * const err
 static handler_t gw_handle_fdevent(void *ctx, int revents);
 
 
+static int gw_proc_conn_put(gw_handler_ctx * const hctx) {
+    /*(gw_lock() must be held by caller)*/
+    gw_host * const host = hctx->host;
+    gw_proc * const proc = hctx->proc;
+    if (NULL == proc || proc->state != PROC_STATE_RUNNING) return 0;
+    if (proc->num_conns >= host->keepalive_max_idle) return 0;
+    if (host->keepalive_max_age
+        && hctx->conn_ts + host->keepalive_max_age <= log_epoch_secs)
+        return 0;
+
+    gw_conn * const c = malloc(sizeof(*c));
+    force_assert(c);
+    c->ev = hctx->ev;
+    c->fdn = hctx->fdn;
+    c->fd = hctx->fd;
+    c->conn_ts = hctx->conn_ts;
+    c->idle_ts = log_epoch_secs;
+    c->proc = proc;
+    c->host = host;
+    c->next = proc->conns;
+    proc->conns = c;
+    ++proc->num_conns;
+    gw_proc_conns_status(host, proc);
+
+    server * const srv = hctx->r->con->srv;
+    if (srv->srvconf.threads > 1) {
+        /* next request to reuse connection might be handled in another thread;
+         * unregister from fdevents of this thread (gw_conn_is_idle() checks
+         * that backend has not closed connection before reuse) */
+        fdevent_fdnode_event_del(c->ev, c->fdn);
+        fdevent_unregister(c->ev, c->fd);
+        --srv->cur_fds;
+        c->ev = NULL;
+        c->fdn = NULL;
+        return 1;
+    }
+
+    /* (fdnode is kept registered; watch for backend closing connection) */
+    c->fdn->handler = gw_handle_fdevent_idle;
+    c->fdn->ctx = c;
+    fdevent_fdnode_event_set(c->ev, c->fdn, FDEVENT_IN|FDEVENT_RDHUP);
+    return 1;
+}
+
+static int gw_proc_conn_get(gw_handler_ctx * const hctx) {
+    /*(gw_lock() must be held by caller)*/
+    gw_host * const host = hctx->host;
+    gw_proc * const proc = hctx->proc;
+    const time_t conn_ts = host->keepalive_max_age
+      ? log_epoch_secs - host->keepalive_max_age
+      : 0;
+    int rc = 0;
+    for (gw_conn *c; (c = proc->conns); ) {
+        proc->conns = c->next;
+        --proc->num_conns;
+        if (c->conn_ts < conn_ts || !gw_conn_is_idle(c->fd)) {
+            gw_conn_close(c);
+            continue;
+        }
+        hctx->fd = c->fd;
+        hctx->conn_ts = c->conn_ts;
+        hctx->conn_reused = 1;
+        if (c->ev) {
+            hctx->fdn = c->fdn;
+            hctx->fdn->handler = gw_handle_fdevent;
+            hctx->fdn->ctx = hctx;
+        }
+        else { /*(register with fdevents of this thread)*/
+            ++hctx->r->con->srv->cur_fds;
+            hctx->fdn =
+              fdevent_register(hctx->ev, hctx->fd, gw_handle_fdevent, hctx);
+        }
+        free(c);
+        rc = 1;
+        break;
+    }
+    gw_proc_conns_status(host, proc);
+    return rc;
+}
+
+
 static gw_handler_ctx * handler_ctx_init(size_t sz) {
     gw_handler_ctx *hctx = calloc(1, 0 == sz ? sizeof(*hctx) : sz);
     force_assert(hctx);
+    heap_nallocs_inc();
 
     /*hctx->response = chunk_buffer_acquire();*//*(allocated when needed)*/
 
@@ -1122,6 +1490,8 @@ static void handler_ctx_clear(gw_handler_ctx *hctx) {
     if (hctx->response) buffer_clear(hctx->response);
 
     hctx->fd = -1;
+    hctx->keepalive = 0;
+    hctx->conn_reused = 0;
     hctx->reconnects = 0;
     hctx->request_id = 0;
     hctx->send_content_body = 1;
@@ -1280,6 +1650,30 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
      ,{ CONST_STR_LEN("tcp-fin-propagate"),
         T_CONFIG_BOOL,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("keep-alive-max-idle"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("keep-alive-idle-timeout"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("keep-alive-max-age"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("health-check-interval"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("health-check-path"),
+        T_CONFIG_STRING,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("outlier-latency-factor"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("outlier-eject-time"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("slow-start"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -1349,6 +1743,14 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
             host->fix_root_path_name = 0;
             host->listen_backlog = 1024;
             host->xsendfile_allow = 0;
+            host->keepalive_max_idle = 0;
+            host->keepalive_idle_timeout = 4;
+            host->keepalive_max_age = 300;
+            host->health_check_interval = 0;
+            host->health_check_path = NULL;
+            host->outlier_latency_factor = 0;
+            host->outlier_eject_time = 30;
+            host->slow_start = 0;
             host->refcount = 0;
 
             config_plugin_value_t *cpv = cvlist;
@@ -1453,6 +1855,46 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
                   case 22:/* tcp-fin-propagate */
                     host->tcp_fin_propagate = (0 != cpv->v.u);
                     break;
+                  case 23:/* keep-alive-max-idle */
+                    host->keepalive_max_idle = cpv->v.shrt;
+                    break;
+                  case 24:/* keep-alive-idle-timeout */
+                    host->keepalive_idle_timeout = cpv->v.shrt;
+                    break;
+                  case 25:/* keep-alive-max-age */
+                    host->keepalive_max_age = cpv->v.shrt;
+                    break;
+                  case 26:/* health-check-interval */
+                    host->health_check_interval = cpv->v.shrt;
+                    break;
+                  case 27:/* health-check-path */
+                    if (buffer_string_is_empty(cpv->v.b)) break;
+                    if (0 != strcmp(cpkkey, "proxy.server")) {
+                        log_error(srv->errh, __FILE__, __LINE__,
+                          "health-check-path is only supported by "
+                          "proxy.server; health check will only connect: "
+                          "%s = (%s => (%s ( ...", cpkkey, da_ext->key.ptr,
+                          da_host->key.ptr);
+                        break;
+                    }
+                    if (cpv->v.b->ptr[0] != '/') {
+                        log_error(srv->errh, __FILE__, __LINE__,
+                          "health-check-path must begin with '/': "
+                          "%s = (%s => (%s ( ...", cpkkey, da_ext->key.ptr,
+                          da_host->key.ptr);
+                        goto error;
+                    }
+                    host->health_check_path = cpv->v.b;
+                    break;
+                  case 28:/* outlier-latency-factor */
+                    host->outlier_latency_factor = cpv->v.shrt;
+                    break;
+                  case 29:/* outlier-eject-time */
+                    host->outlier_eject_time = cpv->v.shrt;
+                    break;
+                  case 30:/* slow-start */
+                    host->slow_start = cpv->v.shrt;
+                    break;
                   default:
                     break;
                 }
@@ -1724,10 +2166,15 @@ int gw_get_defaults_balance(server *srv, const buffer *b) {
         return GW_BALANCE_HASH;
     if (buffer_eq_slen(b, CONST_STR_LEN("sticky")))
         return GW_BALANCE_STICKY;
+    if (buffer_eq_slen(b, CONST_STR_LEN("peak-ewma")))
+        return GW_BALANCE_PEAK_EWMA;
+    if (buffer_eq_slen(b, CONST_STR_LEN("p2c")))
+        return GW_BALANCE_P2C;
 
     log_error(srv->errh, __FILE__, __LINE__,
       "xxxxx.balance has to be one of: "
-      "least-connection, round-robin, hash, sticky, but not: %s", b->ptr);
+      "least-connection, round-robin, hash, sticky, peak-ewma, p2c, "
+      "but not: %s", b->ptr);
     return GW_BALANCE_LEAST_CONNECTION;
 }
 
@@ -1750,13 +2197,21 @@ void gw_set_transparent(gw_handler_ctx *hctx) {
 
 
 static void gw_backend_close(gw_handler_ctx * const hctx, request_st * const r) {
+    gw_lock();
     if (hctx->fd >= 0) {
-        fdevent_fdnode_event_del(hctx->ev, hctx->fdn);
-        /*fdevent_unregister(ev, hctx->fd);*//*(handled below)*/
-        fdevent_sched_close(hctx->ev, hctx->fd, 1);
+        /* keep connection open for reuse if response completed after request
+         * was fully sent, else close connection */
+        if (2 != hctx->keepalive || hctx->state != GW_STATE_READ
+            || !gw_proc_conn_put(hctx)) {
+            fdevent_fdnode_event_del(hctx->ev, hctx->fdn);
+            /*fdevent_unregister(ev, hctx->fd);*//*(handled below)*/
+            fdevent_sched_close(hctx->ev, hctx->fd, 1);
+        }
         hctx->fdn = NULL;
         hctx->fd = -1;
     }
+    hctx->keepalive = 0;
+    hctx->conn_reused = 0;
 
     if (hctx->host) {
         if (hctx->proc) {
@@ -1768,6 +2223,7 @@ static void gw_backend_close(gw_handler_ctx * const hctx, request_st * const r)
         gw_host_reset(hctx->host);
         hctx->host = NULL;
     }
+    gw_unlock();
 }
 
 static void gw_connection_close(gw_handler_ctx * const hctx, request_st * const r) {
@@ -1785,10 +2241,12 @@ static void gw_connection_close(gw_handler_ctx * const hctx, request_st * const
 static handler_t gw_reconnect(gw_handler_ctx * const hctx, request_st * const r) {
     gw_backend_close(hctx, r);
 
+    gw_lock();
     hctx->host = gw_host_get(r,hctx->ext,hctx->conf.balance,hctx->conf.debug);
+    if (NULL != hctx->host) gw_host_assign(hctx->host);
+    gw_unlock();
     if (NULL == hctx->host) return HANDLER_FINISHED;
 
-    gw_host_assign(hctx->host);
     hctx->request_id = 0;
     hctx->opts.xsendfile_allow = hctx->host->xsendfile_allow;
     hctx->opts.xsendfile_docroot = hctx->host->xsendfile_docroot;
@@ -1827,6 +2285,7 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
     case GW_STATE_INIT:
         /* do we have a running process for this host (max-procs) ? */
         hctx->proc = NULL;
+        gw_lock();
 
         for (gw_proc *proc = hctx->host->first; proc; proc = proc->next) {
              if (proc->state == PROC_STATE_RUNNING) {
@@ -1837,16 +2296,61 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
 
         /* all children are dead */
         if (hctx->proc == NULL) {
+            gw_unlock();
             return HANDLER_ERROR;
         }
 
         /* check the other procs if they have a lower load */
-        for (gw_proc *proc = hctx->proc->next; proc; proc = proc->next) {
-            if (proc->state != PROC_STATE_RUNNING) continue;
-            if (proc->load < hctx->proc->load) hctx->proc = proc;
+        if (hctx->conf.balance == GW_BALANCE_PEAK_EWMA
+            || hctx->conf.balance == GW_BALANCE_P2C) {
+            const gw_host * const host = hctx->host;
+            uint64_t cost = gw_proc_cost(host, hctx->proc);
+            for (gw_proc *proc = hctx->proc->next; proc; proc = proc->next) {
+                if (proc->state != PROC_STATE_RUNNING) continue;
+                const uint64_t pcost = gw_proc_cost(host, proc);
+                if (pcost < cost) {
+                    hctx->proc = proc;
+                    cost = pcost;
+                }
+            }
+        }
+        else if (!hctx->host->slow_start) {
+            for (gw_proc *proc = hctx->proc->next; proc; proc = proc->next) {
+                if (proc->state != PROC_STATE_RUNNING) continue;
+                if (proc->load < hctx->proc->load) hctx->proc = proc;
+            }
+        }
+        else {
+            const unsigned short slow_start = hctx->host->slow_start;
+            int load = gw_slow_start_load((int)hctx->proc->load,
+                                          hctx->proc->slow_start_ts,slow_start);
+            for (gw_proc *proc = hctx->proc->next; proc; proc = proc->next) {
+                if (proc->state != PROC_STATE_RUNNING) continue;
+                int pload = gw_slow_start_load((int)proc->load,
+                                               proc->slow_start_ts, slow_start);
+                if (pload < load) {
+                    hctx->proc = proc;
+                    load = pload;
+                }
+            }
         }
 
         gw_proc_load_inc(hctx->host, hctx->proc);
+        hctx->send_us = gw_usecs();
+
+        if (hctx->proc->is_local) {
+            hctx->pid = hctx->proc->pid;
+        }
+
+        if (hctx->proc->conns && gw_proc_conn_get(hctx)) {
+            /* reuse idle keep-alive connection to backend */
+            gw_proc_tag_inc(hctx->host, hctx->proc, CONST_STR_LEN(".reused"));
+            hctx->proc->last_used = log_epoch_secs;
+            gw_unlock();
+            gw_set_state(hctx, GW_STATE_PREPARE_WRITE);
+            return gw_write_request(hctx, r);
+        }
+        gw_unlock();
 
         hctx->fd = fdevent_socket_nb_cloexec(hctx->host->family,SOCK_STREAM,0);
         if (-1 == hctx->fd) {
@@ -1863,13 +2367,10 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
         }
 
         ++r->con->srv->cur_fds;
+        hctx->conn_ts = log_epoch_secs;
 
         hctx->fdn = fdevent_register(hctx->ev,hctx->fd,gw_handle_fdevent,hctx);
 
-        if (hctx->proc->is_local) {
-            hctx->pid = hctx->proc->pid;
-        }
-
         switch (gw_establish_connection(r, hctx->host, hctx->proc, hctx->pid,
                                         hctx->fd, hctx->conf.debug)) {
         case 1: /* connection is in progress */
@@ -1887,14 +2388,18 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
         if (hctx->state == GW_STATE_CONNECT_DELAYED) { /*(not GW_STATE_INIT)*/
             int socket_error = fdevent_connect_status(hctx->fd);
             if (socket_error != 0) {
+                gw_lock();
                 gw_proc_connect_error(r, hctx->host, hctx->proc, hctx->pid,
                                       socket_error, hctx->conf.debug);
+                gw_unlock();
                 return HANDLER_ERROR;
             }
             /* go on with preparing the request */
         }
 
+        gw_lock();
         gw_proc_connect_success(hctx->host, hctx->proc, hctx->conf.debug, r);
+        gw_unlock();
 
         gw_set_state(hctx, GW_STATE_PREPARE_WRITE);
         /* fall through */
@@ -1993,18 +2498,54 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
     }
 }
 
+__attribute_cold__
+static int gw_conn_reused_retry(gw_handler_ctx * const hctx, request_st * const r) {
+    /* backend might close an idle keep-alive connection at the same time that
+     * a request is sent on the reused connection.  Retry request on a new
+     * connection if no response has been received and if the request can be
+     * sent again (no request body) */
+    if (!hctx->conn_reused || r->resp_body_started || 0 != r->reqbody_length)
+        return 0;
+    if (!buffer_string_is_empty(hctx->response)
+        || (hctx->rb && !chunkqueue_is_empty(hctx->rb)))
+        return 0;
+    if (hctx->reconnects++ >= 5)
+        return 0;
+
+    if (hctx->conf.debug) {
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "reused connection closed by backend on socket: %s for %s?%.*s, "
+          "reconnecting", hctx->proc->connection_name->ptr,
+          r->uri.path.ptr, BUFFER_INTLEN_PTR(&r->uri.query));
+    }
+
+    /* other idle connections to proc are also likely to have been closed */
+    gw_lock();
+    gw_proc_conns_close(hctx->host, hctx->proc);
+    gw_unlock();
+    chunkqueue_reset(hctx->wb);
+    hctx->wb_reqlen = 0;
+    return 1;
+}
+
 __attribute_cold__
 static handler_t gw_write_error(gw_handler_ctx * const hctx, request_st * const r) {
     int status = r->http_status;
 
+    if (hctx->state == GW_STATE_WRITE && gw_conn_reused_retry(hctx, r))
+        return gw_reconnect(hctx, r);
+
     if (hctx->state == GW_STATE_INIT ||
         hctx->state == GW_STATE_CONNECT_DELAYED) {
 
         /* (optimization to detect backend process exit while processing a
          *  large number of ready events; (this block could be removed)) */
         server * const srv = r->con->srv;
-        if (0 == srv->srvconf.max_worker)
+        if (0 == srv->srvconf.max_worker) {
+            gw_lock();
             gw_restart_dead_procs(hctx->host, srv->errh, hctx->conf.debug, 0);
+            gw_unlock();
+        }
 
         /* cleanup this request and let request handler start request again */
         if (hctx->reconnects++ < 5) return gw_reconnect(hctx, r);
@@ -2025,6 +2566,62 @@ static handler_t gw_send_request(gw_handler_ctx * const hctx, request_st * const
 static handler_t gw_recv_response(gw_handler_ctx *hctx, request_st *r);
 
 
+#ifdef HAVE_SPLICE
+
+static handler_t gw_splice_request_body(gw_handler_ctx * const hctx, request_st * const r) {
+    /* transparent proxy (e.g. mod_sockproxy): splice() data from client
+     * socket through pipe chunk in hctx->wb to backend, bypassing
+     * r->read_queue and r->reqbody_queue (and copy into userspace);
+     * fall back to reading request body into memory if client connection
+     * uses TLS or if backend is not keeping up (hctx->wb not drained) */
+    connection * const con = r->con;
+    if (-1 != hctx->wb_reqlen || NULL != hctx->stdin_append
+        || con->is_ssl_sock || r->h2id || !con->is_readable
+        || !chunkqueue_is_empty(r->read_queue)
+        || !chunkqueue_is_empty(r->reqbody_queue))
+        return connection_handle_read_post_state(r);
+
+    int frd;
+    const size_t len =
+      (0 == fdevent_ioctl_fionread(con->fd, S_IFSOCK, &frd) && frd > 0)
+        ? (size_t)frd
+        : 65536;
+    const ssize_t n =
+      chunkqueue_append_splice_sock(hctx->wb, con->fd, len, r->conf.errh);
+    if (n > 0) {
+        con->read_idle_ts = log_epoch_secs;
+        con->read_idle_ms = log_epoch_ms();
+        con->bytes_read += n;
+        r->reqbody_queue->bytes_in += n;
+        r->reqbody_queue->bytes_out += n;
+        if ((size_t)n < len) con->is_readable = 0;
+        r->conf.stream_request_body |= FDEVENT_STREAM_REQUEST_POLLIN;
+        return HANDLER_GO_ON;
+    }
+    else if (-1 == n) {
+        switch (errno) {
+          case EAGAIN:
+         #ifdef EWOULDBLOCK
+         #if EWOULDBLOCK != EAGAIN
+          case EWOULDBLOCK:
+         #endif
+         #endif
+            con->is_readable = 0;
+            __attribute_fallthrough__
+          case EINTR:
+            r->conf.stream_request_body |= FDEVENT_STREAM_REQUEST_POLLIN;
+            return HANDLER_GO_ON;
+          default:
+            break; /*(read() in connection_handle_read_post_state())*/
+        }
+    }
+
+    /* (0 == n) (EOF), or (-2 == n), or error */
+    return connection_handle_read_post_state(r);
+}
+
+#endif
+
 handler_t gw_handle_subrequest(request_st * const r, void *p_d) {
     gw_plugin_data *p = p_d;
     gw_handler_ctx *hctx = r->plugin_ctx[p->id];
@@ -2063,7 +2660,11 @@ handler_t gw_handle_subrequest(request_st * const r, void *p_d) {
             if (0 != hctx->wb->bytes_in) return HANDLER_WAIT_FOR_EVENT;
         }
         else {
+          #ifdef HAVE_SPLICE
+            handler_t rc = gw_splice_request_body(hctx, r);
+          #else
             handler_t rc = connection_handle_read_post_state(r);
+          #endif
 
             /* XXX: create configurable flag */
             /* CGI environment requires that Content-Length be set.
@@ -2128,6 +2729,12 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
 
     if (b != hctx->response) chunk_buffer_release(b);
 
+    if (hctx->send_us && r->resp_body_started) {
+        gw_lock();
+        gw_proc_latency_sample(hctx);
+        gw_unlock();
+    }
+
     switch (rc) {
     default:
         return HANDLER_GO_ON;
@@ -2150,7 +2757,9 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
                 physpath = r->physical.path.ptr;
             }
 
+            gw_lock();
             proc->last_used = log_epoch_secs;
+            gw_unlock();
             gw_backend_close(hctx, r);
             handler_ctx_clear(hctx);
 
@@ -2176,6 +2785,9 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
 
             r->handler_module = NULL;
             return HANDLER_COMEBACK;
+        } else if (!r->resp_body_started && gw_conn_reused_retry(hctx, r)) {
+            /* backend closed reused keep-alive connection */
+            return gw_reconnect(hctx, r);
         } else {
             /* we are done */
             gw_connection_close(hctx, r);
@@ -2185,10 +2797,14 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
     case HANDLER_COMEBACK: /*(not expected; treat as error)*/
     case HANDLER_ERROR:
         /* (optimization to detect backend process exit while processing a
-         *  large number of ready events; (this block could be removed)) */
+         *  large number of ready events; (this block could be removed))
+         * (skipped in server.threads other than main thread, which reaps
+         *  children; waitpid() here would race main thread waitpid()) */
+        gw_lock();
         if (proc->is_local && 1 == proc->load && proc->pid == hctx->pid
             && proc->state != PROC_STATE_DIED
-            && 0 == r->con->srv->srvconf.max_worker) {
+            && 0 == r->con->srv->srvconf.max_worker
+            && 0 == r->con->srv->thread_ndx) {
             /* intentionally check proc->disabed_until before gw_proc_waitpid */
             log_error_st * const errh = r->con->srv->errh;
             if (proc->disabled_until < log_epoch_secs
@@ -2205,6 +2821,7 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
                 }
             }
         }
+        gw_unlock();
 
         if (r->resp_body_started == 0) {
             /* nothing has been sent out yet, try to use another child */
@@ -2221,6 +2838,9 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
                 return gw_reconnect(hctx, r);
             }
 
+            if (gw_conn_reused_retry(hctx, r))
+                return gw_reconnect(hctx, r);
+
             log_error(r->conf.errh, __FILE__, __LINE__,
               "response not received, request sent: %lld on "
               "socket: %s for %s?%.*s, closing connection",
@@ -2307,11 +2927,11 @@ static handler_t gw_handle_fdevent(void *ctx, int revents) {
     return HANDLER_FINISHED;
 }
 
-handler_t gw_check_extension(request_st * const r, gw_plugin_data * const p, int uri_path_handler, size_t hctx_sz) {
+handler_t gw_check_extension(request_st * const r, gw_plugin_data * const p, const gw_plugin_config * const pconf, int uri_path_handler, size_t hctx_sz) {
   #if 0 /*(caller must handle)*/
     if (NULL != r->handler_module) return HANDLER_GO_ON;
-    gw_patch_connection(r, p);
-    if (NULL == p->conf.exts) return HANDLER_GO_ON;
+    gw_patch_connection(r, p, &pconf);
+    if (NULL == pconf->exts) return HANDLER_GO_ON;
   #endif
 
     buffer *fn = uri_path_handler ? &r->uri.path : &r->physical.path;
@@ -2323,24 +2943,24 @@ handler_t gw_check_extension(request_st * const r, gw_plugin_data * const p, int
 
     if (0 == s_len) return HANDLER_GO_ON; /*(not expected)*/
 
-    /* check p->conf.exts_auth list and then p->conf.ext_resp list
-     * (skip p->conf.exts_auth if array is empty
+    /* check pconf->exts_auth list and then pconf->ext_resp list
+     * (skip pconf->exts_auth if array is empty
      *  or if GW_AUTHORIZER already ran in this request) */
     hctx = r->plugin_ctx[p->id];
     /*(hctx not NULL if GW_AUTHORIZER ran; hctx->ext_auth check is redundant)*/
     gw_mode = (NULL == hctx || NULL == hctx->ext_auth)
-      ? 0              /*GW_AUTHORIZER p->conf.exts_auth will be searched next*/
-      : GW_AUTHORIZER; /*GW_RESPONDER p->conf.exts_resp will be searched next*/
+      ? 0              /*GW_AUTHORIZER pconf->exts_auth will be searched next*/
+      : GW_AUTHORIZER; /*GW_RESPONDER pconf->exts_resp will be searched next*/
 
     do {
 
         gw_exts *exts;
         if (0 == gw_mode) {
             gw_mode = GW_AUTHORIZER;
-            exts = p->conf.exts_auth;
+            exts = pconf->exts_auth;
         } else {
             gw_mode = GW_RESPONDER;
-            exts = p->conf.exts_resp;
+            exts = pconf->exts_resp;
         }
 
         if (0 == exts->used) continue;
@@ -2354,9 +2974,9 @@ handler_t gw_check_extension(request_st * const r, gw_plugin_data * const p, int
          * */
 
         /* check if extension-mapping matches */
-        if (p->conf.ext_mapping) {
+        if (pconf->ext_mapping) {
             data_string *ds =
-              (data_string *)array_match_key_suffix(p->conf.ext_mapping, fn);
+              (data_string *)array_match_key_suffix(pconf->ext_mapping, fn);
             if (NULL != ds) {
                 /* found a mapping */
                     /* check if we know the extension */
@@ -2412,13 +3032,16 @@ handler_t gw_check_extension(request_st * const r, gw_plugin_data * const p, int
     }
 
     /* check if we have at least one server for this extension up and running */
-    host = gw_host_get(r, extension, p->conf.balance, p->conf.debug);
+    gw_lock();
+    host = gw_host_get(r, extension, pconf->balance, pconf->debug);
     if (NULL == host) {
+        gw_unlock();
         return HANDLER_FINISHED;
     }
 
     /* a note about no handler is not sent yet */
     extension->note_is_sent = 0;
+    gw_unlock();
 
     /*
      * if check-local is disabled, use the uri.path handler
@@ -2492,20 +3115,22 @@ handler_t gw_check_extension(request_st * const r, gw_plugin_data * const p, int
     hctx->host             = host;
     hctx->proc             = NULL;
     hctx->ext              = extension;
+    gw_lock();
     gw_host_assign(host);
+    gw_unlock();
 
     hctx->gw_mode = gw_mode;
     if (gw_mode == GW_AUTHORIZER) {
         hctx->ext_auth = hctx->ext;
     }
 
-    /*hctx->conf.exts        = p->conf.exts;*/
-    /*hctx->conf.exts_auth   = p->conf.exts_auth;*/
-    /*hctx->conf.exts_resp   = p->conf.exts_resp;*/
-    /*hctx->conf.ext_mapping = p->conf.ext_mapping;*/
-    hctx->conf.balance     = p->conf.balance;
-    hctx->conf.proto       = p->conf.proto;
-    hctx->conf.debug       = p->conf.debug;
+    /*hctx->conf.exts        = pconf->exts;*/
+    /*hctx->conf.exts_auth   = pconf->exts_auth;*/
+    /*hctx->conf.exts_resp   = pconf->exts_resp;*/
+    /*hctx->conf.ext_mapping = pconf->ext_mapping;*/
+    hctx->conf.balance     = pconf->balance;
+    hctx->conf.proto       = pconf->proto;
+    hctx->conf.debug       = pconf->debug;
 
     hctx->opts.fdfmt = S_IFSOCK;
     hctx->opts.authorizer = (gw_mode == GW_AUTHORIZER);
@@ -2544,6 +3169,7 @@ static void gw_handle_trigger_host(gw_host * const host, log_error_st * const er
 
     for (proc = host->first; proc; proc = proc->next) {
         gw_proc_waitpid(host, proc, errh);
+        if (proc->conns) gw_proc_conns_prune(host, proc);
     }
 
     gw_restart_dead_procs(host, errh, debug, 1);
@@ -2594,6 +3220,206 @@ static void gw_handle_trigger_host(gw_host * const host, log_error_st * const er
     }
 }
 
+#define GW_HEALTH_CHECK_FAILS   2     /* consecutive failures to disable proc */
+#define GW_OUTLIER_MIN_SAMPLES  8     /* latency samples before comparison */
+#define GW_OUTLIER_MIN_LATENCY  10000 /* usec above avg before ejection */
+
+static void gw_proc_health(gw_host * const host, gw_proc * const proc, const int ok, log_error_st * const errh) {
+    if (ok) {
+        proc->health_fails = 0;
+        if (proc->health_down) {
+            proc->health_down = 0;
+            proc->disabled_until = 0;
+            gw_proc_check_enable(host, proc, errh);
+        }
+    }
+    else if (++proc->health_fails >= GW_HEALTH_CHECK_FAILS
+             && !proc->health_down) {
+        log_error(errh, __FILE__, __LINE__,
+          "health check failed %hu times; disabling: %s",
+          proc->health_fails, proc->connection_name->ptr);
+        proc->health_down = 1;
+        if (proc->state == PROC_STATE_RUNNING) {
+            gw_proc_tag_inc(host, proc, CONST_STR_LEN(".disabled"));
+            gw_proc_set_state(host, proc, PROC_STATE_OVERLOADED);
+        }
+    }
+}
+
+static void gw_probe_done(gw_probe * const hp, const int ok) {
+    gw_host * const host = hp->host;
+    gw_proc * const proc = hp->proc;
+    log_error_st * const errh = hp->errh;
+    gw_probe_close(hp);
+    gw_proc_health(host, proc, ok, errh);
+}
+
+static int gw_probe_send(gw_probe * const hp) {
+    const gw_host * const host = hp->host;
+    buffer * const b = chunk_buffer_acquire();
+    buffer_copy_string_len(b, CONST_STR_LEN("GET "));
+    buffer_append_string_buffer(b, host->health_check_path);
+    buffer_append_string_len(b, CONST_STR_LEN(" HTTP/1.0\r\nHost: "));
+    if (!buffer_string_is_empty(host->host))
+        buffer_append_string_buffer(b, host->host);
+    else
+        buffer_append_string_len(b, CONST_STR_LEN("localhost"));
+    buffer_append_string_len(b, CONST_STR_LEN("\r\nConnection: close\r\n\r\n"));
+    const ssize_t wr = write(hp->fd, CONST_BUF_LEN(b));
+    const int rc = (wr == (ssize_t)buffer_string_length(b)) ? 0 : -1;
+    chunk_buffer_release(b);
+    return rc;
+}
+
+static handler_t gw_probe_handle_fdevent(gw_probe * const hp) {
+    /*(gw_lock() must be held by caller)*/
+    if (!hp->connected) {
+        if (0 != fdevent_connect_status(hp->fd)) {
+            gw_probe_done(hp, 0);
+            return HANDLER_FINISHED;
+        }
+        hp->connected = 1;
+        /* connect-only health check if no request path configured */
+        if (NULL == hp->host->health_check_path) {
+            gw_probe_done(hp, 1);
+            return HANDLER_FINISHED;
+        }
+        if (0 != gw_probe_send(hp)) {
+            gw_probe_done(hp, 0);
+            return HANDLER_FINISHED;
+        }
+        fdevent_fdnode_event_set(hp->ev, hp->fdn, FDEVENT_IN | FDEVENT_RDHUP);
+        return HANDLER_FINISHED;
+    }
+
+    /* read status line, e.g. "HTTP/1.1 200" */
+    const ssize_t n =
+      read(hp->fd, hp->rbuf + hp->rlen, sizeof(hp->rbuf) - 1 - hp->rlen);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return HANDLER_FINISHED;
+    if (n > 0) {
+        hp->rlen += (uint32_t)n;
+        if (hp->rlen < sizeof("HTTP/1.1 200")-1) return HANDLER_FINISHED;
+    }
+
+    int status = 0;
+    const char * const s = hp->rbuf;
+    if (hp->rlen >= sizeof("HTTP/1.1 200")-1
+        && 0 == memcmp(s, "HTTP/1.", sizeof("HTTP/1.")-1) && s[8] == ' '
+        && light_isdigit(s[9]) && light_isdigit(s[10]) && light_isdigit(s[11]))
+        status = (s[9]-'0')*100 + (s[10]-'0')*10 + (s[11]-'0');
+    gw_probe_done(hp, status >= 200 && status < 400);
+    return HANDLER_FINISHED;
+}
+
+static handler_t gw_handle_probe_fdevent(void *ctx, int revents) {
+    UNUSED(revents);
+    gw_lock();
+    const handler_t rc = gw_probe_handle_fdevent(ctx);
+    gw_unlock();
+    return rc;
+}
+
+static void gw_probe_start(server * const srv, gw_host * const host, gw_proc * const proc) {
+    proc->health_ts = log_epoch_secs;
+    const int fd = fdevent_socket_nb_cloexec(proc->saddr->sa_family,
+                                             SOCK_STREAM, 0);
+    if (-1 == fd) return; /* (e.g. out of fds; retry next interval) */
+    ++srv->cur_fds;
+
+    gw_probe * const hp = calloc(1, sizeof(*hp));
+    force_assert(hp);
+    hp->host = host;
+    hp->proc = proc;
+    hp->ev = srv->ev;
+    hp->errh = srv->errh;
+    hp->fd = fd;
+    hp->fdn = fdevent_register(srv->ev, fd, gw_handle_probe_fdevent, hp);
+    proc->probe = hp;
+
+    if (-1 == connect(fd, proc->saddr, proc->saddrlen)
+        && errno != EINPROGRESS && errno != EALREADY && errno != EINTR) {
+        gw_probe_done(hp, 0);
+        return;
+    }
+
+    /*(wait for connect to complete, even if connected immediately)*/
+    fdevent_fdnode_event_set(srv->ev, hp->fdn, FDEVENT_OUT);
+}
+
+static void gw_handle_trigger_health(server * const srv, gw_host * const host) {
+    const time_t cur_ts = log_epoch_secs;
+    for (gw_proc *proc = host->first; proc; proc = proc->next) {
+        if (proc->probe) {
+            /* health check timeout */
+            if (cur_ts - proc->health_ts > host->health_check_interval)
+                gw_probe_done(proc->probe, 0);
+            continue;
+        }
+        if (proc->state != PROC_STATE_RUNNING
+            && proc->state != PROC_STATE_OVERLOADED) continue;
+        if (cur_ts - proc->health_ts < host->health_check_interval) continue;
+        gw_probe_start(srv, host, proc);
+    }
+}
+
+static void gw_handle_trigger_outliers(gw_extension * const ex, log_error_st * const errh) {
+    /* eject proc whose average response latency is much higher than the
+     * average of the other procs, while keeping at least half of procs */
+    uint64_t sum = 0;
+    uint32_t n = 0, running = 0, total = 0;
+    for (uint32_t k = 0; k < ex->used; ++k) {
+        for (gw_proc *proc = ex->hosts[k]->first; proc; proc = proc->next) {
+            ++total;
+            if (proc->state != PROC_STATE_RUNNING) continue;
+            ++running;
+            if (proc->latency_n < GW_OUTLIER_MIN_SAMPLES) continue;
+            sum += proc->latency;
+            ++n;
+        }
+    }
+
+    for (uint32_t k = 0; k < ex->used; ++k) {
+        gw_host * const host = ex->hosts[k];
+        if (!host->outlier_latency_factor) continue;
+        for (gw_proc *proc = host->first; proc; proc = proc->next) {
+            if (n < 2 || (running - 1) * 2 < total) return;
+            if (proc->state != PROC_STATE_RUNNING) continue;
+            if (proc->latency_n < GW_OUTLIER_MIN_SAMPLES) continue;
+            const uint64_t avg = (sum - proc->latency) / (n - 1);
+            if (proc->latency <= avg * host->outlier_latency_factor) continue;
+            if (proc->latency - avg < GW_OUTLIER_MIN_LATENCY) continue;
+
+            log_error(errh, __FILE__, __LINE__,
+              "latency outlier (%u us; others %llu us); "
+              "disabling for %hu seconds: %s", proc->latency,
+              (unsigned long long)avg, host->outlier_eject_time,
+              proc->connection_name->ptr);
+            sum -= proc->latency;
+            --n;
+            --running;
+            proc->disabled_until = log_epoch_secs + host->outlier_eject_time;
+            gw_proc_tag_inc(host, proc, CONST_STR_LEN(".disabled"));
+            gw_proc_set_state(host, proc, PROC_STATE_OVERLOADED);
+        }
+    }
+}
+
+static void gw_handle_trigger_exts_health(server * const srv, gw_exts * const exts) {
+    for (uint32_t j = 0; j < exts->used; ++j) {
+        gw_extension * const ex = exts->exts+j;
+        int outliers = 0;
+        for (uint32_t n = 0; n < ex->used; ++n) {
+            gw_host * const host = ex->hosts[n];
+            if (host->health_check_interval)
+                gw_handle_trigger_health(srv, host);
+            outliers |= host->outlier_latency_factor;
+        }
+        if (outliers)
+            gw_handle_trigger_outliers(ex, srv->errh);
+    }
+}
+
 static void gw_handle_trigger_exts(gw_exts * const exts, log_error_st * const errh, const int debug) {
     for (uint32_t j = 0; j < exts->used; ++j) {
         gw_extension *ex = exts->exts+j;
@@ -2611,6 +3437,8 @@ static void gw_handle_trigger_exts_wkr(gw_exts *exts, log_error_st *errh) {
             for (gw_proc *proc = host->first; proc; proc = proc->next) {
                 if (proc->state == PROC_STATE_OVERLOADED)
                     gw_proc_check_enable(host, proc, errh);
+                if (proc->conns)
+                    gw_proc_conns_prune(host, proc);
             }
         }
     }
@@ -2623,6 +3451,7 @@ handler_t gw_handle_trigger(server *srv, void *p_d) {
     int global_debug = 0;
 
     if (NULL == p->cvlist) return HANDLER_GO_ON;
+    gw_lock();
     /* (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
         config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
@@ -2650,12 +3479,17 @@ handler_t gw_handle_trigger(server *srv, void *p_d) {
         wkr
           ? gw_handle_trigger_exts_wkr(conf->exts, errh)
           : gw_handle_trigger_exts(conf->exts, errh, debug);
+
+        /* (health checks run in workers, if workers are configured) */
+        if (wkr || 0 == srv->srvconf.max_worker)
+            gw_handle_trigger_exts_health(srv, conf->exts);
     }
+    gw_unlock();
 
     return HANDLER_GO_ON;
 }
 
-handler_t gw_handle_waitpid_cb(server *srv, void *p_d, pid_t pid, int status) {
+static handler_t gw_handle_waitpid(server *srv, void *p_d, pid_t pid, int status) {
     gw_plugin_data * const p = p_d;
     if (0 != srv->srvconf.max_worker && p->srv_pid != srv->pid)
         return HANDLER_GO_ON;
@@ -2729,3 +3563,10 @@ handler_t gw_handle_waitpid_cb(server *srv, void *p_d, pid_t pid, int status) {
 
     return HANDLER_GO_ON;
 }
+
+handler_t gw_handle_waitpid_cb(server *srv, void *p_d, pid_t pid, int status) {
+    gw_lock();
+    const handler_t rc = gw_handle_waitpid(srv, p_d, pid, status);
+    gw_unlock();
+    return rc;
+}
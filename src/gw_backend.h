@@ -16,6 +16,26 @@ typedef struct {
     uint32_t used;
 } char_array;
 
+struct fdevents;        /* declaration */
+struct fdnode_st;       /* declaration */
+struct gw_proc;         /* declaration */
+struct gw_host;         /* declaration */
+struct gw_probe;        /* declaration */
+
+/* idle (keep-alive) connection to backend, kept open for reuse
+ * (ev is NULL if fd is not registered with any fdevents, e.g. if shared
+ *  between server.threads, where next request might be in another thread) */
+typedef struct gw_conn {
+    struct gw_conn *next;
+    struct fdevents *ev;
+    struct fdnode_st *fdn;
+    int fd;
+    time_t conn_ts; /* time connection was established (see keepalive_max_age) */
+    time_t idle_ts; /* time connection was returned to idle pool */
+    struct gw_proc *proc;
+    struct gw_host *host;
+} gw_conn;
+
 typedef struct gw_proc {
     uint32_t id; /* id will be between 1 and max_procs */
     unsigned short port;  /* config.port + pno */
@@ -37,6 +57,19 @@ typedef struct gw_proc {
 
     int is_local;
 
+    gw_conn *conns;     /* idle keep-alive connections (most recent first) */
+    uint32_t num_conns; /* number of idle connections in conns */
+
+    struct gw_probe *probe;      /* health check in progress */
+    time_t health_ts;            /* time last health check started */
+    unsigned short health_fails; /* consecutive failed health checks */
+    unsigned short health_down;  /* disabled due to failed health checks */
+    time_t slow_start_ts;        /* time proc entered PROC_STATE_RUNNING */
+    uint32_t latency;            /* EWMA of response latency (usec) */
+    uint32_t latency_n;          /* number of latency samples */
+    uint32_t latency_peak;       /* peak-sensitive EWMA of latency (usec) */
+    time_t latency_ts;           /* time of last latency sample */
+
     enum {
         PROC_STATE_RUNNING,    /* alive */
         PROC_STATE_OVERLOADED, /* listen-queue is full */
@@ -46,7 +79,7 @@ typedef struct gw_proc {
     } state;
 } gw_proc;
 
-typedef struct {
+typedef struct gw_host {
     /* the key that is used to reference this value */
     const buffer *id;
 
@@ -202,6 +235,44 @@ typedef struct {
     const buffer *strip_request_uri;
 
     unsigned short tcp_fin_propagate;
+
+    /*
+     * keep-alive connections to backend
+     *
+     * keep up to keepalive_max_idle idle connections per proc for reuse
+     * (0 disables), closing idle connections after keepalive_idle_timeout
+     * and not reusing connections older than keepalive_max_age (0 no limit)
+     */
+    unsigned short keepalive_max_idle;
+    unsigned short keepalive_idle_timeout;
+    unsigned short keepalive_max_age;
+
+    /*
+     * active health checks
+     *
+     * connect to each proc every health_check_interval secs (0 disables)
+     * and, if health_check_path is set (mod_proxy), send a request and
+     * expect 2xx or 3xx response status.  A proc is disabled after
+     * consecutive failed checks and enabled again after a check succeeds.
+     */
+    unsigned short health_check_interval;
+    const buffer *health_check_path;
+
+    /*
+     * outlier ejection: disable proc for outlier_eject_time secs if its
+     * response latency exceeds outlier_latency_factor times the average
+     * latency of other procs for the same extension (0 disables)
+     */
+    unsigned short outlier_latency_factor;
+    unsigned short outlier_eject_time;
+
+    /*
+     * slow start: ramp up share of requests sent to a host or proc over
+     * slow_start secs after it is (re-)enabled (0 disables)
+     */
+    unsigned short slow_start;
+    time_t slow_start_ts; /* time host became active (active_procs > 0) */
+
     unsigned short kill_signal; /* we need a setting for this as libfcgi
                                    applications prefer SIGUSR1 while the
                                    rest of the world would use SIGTERM
@@ -268,11 +339,11 @@ typedef struct gw_plugin_config {
     int debug;
 } gw_plugin_config;
 
-/* generic plugin data, shared between all connections */
+/* generic plugin data, shared between all connections
+ * (and between server.threads; must not hold per-request state) */
 typedef struct gw_plugin_data {
     PLUGIN_DATA;
     pid_t srv_pid; /* must precede gw_plugin_config for mods w/ larger struct */
-    gw_plugin_config conf; /* used only as long as no gw_handler_ctx is setup */
     gw_plugin_config defaults;/*(must not be used by gw_backend.c: lg struct) */
 } gw_plugin_data;
 
@@ -285,8 +356,6 @@ typedef enum {
     GW_STATE_READ
 } gw_connection_state_t;
 
-struct fdevents;        /* declaration */
-
 #define GW_RESPONDER  1
 #define GW_AUTHORIZER 2
 #define GW_FILTER     3  /*(not implemented)*/
@@ -310,6 +379,11 @@ typedef struct gw_handler_ctx {
     struct fdevents *ev;
     fdnode   *fdn;       /* fdevent (fdnode *) object */
     int       fd;        /* fd to the gw process */
+    int       keepalive; /* 1 if backend conn may be kept alive after response;
+                          * 2 when response complete and conn can be reused */
+    int       conn_reused; /* request sent on reused keep-alive connection */
+    time_t    conn_ts;   /* time backend connection was established */
+    uint64_t  send_us;   /* time request started (usec) (latency tracking) */
 
     pid_t     pid;
     int       reconnects; /* number of reconnect attempts */
@@ -347,7 +421,7 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
 __attribute_cold__
 int gw_get_defaults_balance(server *srv, const buffer *b);
 
-handler_t gw_check_extension(request_st *r, gw_plugin_data *p, int uri_path_handler, size_t hctx_sz);
+handler_t gw_check_extension(request_st *r, gw_plugin_data *p, const gw_plugin_config *pconf, int uri_path_handler, size_t hctx_sz);
 handler_t gw_handle_request_reset(request_st *r, void *p_d);
 handler_t gw_handle_subrequest(request_st *r, void *p_d);
 handler_t gw_handle_trigger(server *srv, void *p_d);
@@ -0,0 +1,1055 @@
+/*
+ * h2 - HTTP/2 protocol layer (RFC 7540)
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+#include "first.h"
+
+#include "h2.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "base.h"
+#include "buffer.h"
+#include "chunk.h"
+#include "connections.h"/* request_init() request_reset() request_free() */
+#include "log.h"
+#include "plugin.h"
+#include "plugin_config.h"
+#include "request.h"
+
+/* retired stream request_st are kept for reuse by new streams, so that
+ * request buffers and header arrays (and their data_string keys and values)
+ * are reused instead of allocated for each stream, as is done for HTTP/1.x
+ * keep-alive requests (pool is per-thread with server.threads) */
+#define H2_STREAM_POOL_SZ 64
+static __thread_local struct {
+    request_st *r[H2_STREAM_POOL_SZ];
+    uint32_t used;
+} h2_stream_pool;
+
+/* client connection preface (RFC 7540 3.5) */
+static const char h2_client_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+enum { H2_PH_METHOD, H2_PH_SCHEME, H2_PH_AUTHORITY, H2_PH_PATH };
+
+typedef struct h2_hdrs_ctx {
+    h2con *h2c;
+    uint32_t hlen;          /* decoded header list size (approximation) */
+    uint32_t seen;          /* bitmask of pseudo-headers received */
+    uint32_t ph[4];         /* offset of pseudo-header value in h2c->ph */
+    uint32_t phlen[4];      /* length of pseudo-header value */
+    int regular;            /* regular header field received */
+    int has_cl;             /* content-length received */
+    int err;                /* malformed request */
+} h2_hdrs_ctx;
+
+
+static uint32_t h2_u24 (const uint8_t * const s)
+{
+    return ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+}
+
+
+static uint32_t h2_u31 (const uint8_t * const s)
+{
+    return ((uint32_t)(s[0] & 0x7f) << 24) | ((uint32_t)s[1] << 16)
+         | ((uint32_t)s[2] << 8) | s[3];
+}
+
+
+static uint32_t h2_u32 (const uint8_t * const s)
+{
+    return ((uint32_t)s[0] << 24) | ((uint32_t)s[1] << 16)
+         | ((uint32_t)s[2] << 8) | s[3];
+}
+
+
+static void h2_put_u32 (uint8_t * const s, const uint32_t n)
+{
+    s[0] = (uint8_t)(n >> 24);
+    s[1] = (uint8_t)(n >> 16);
+    s[2] = (uint8_t)(n >> 8);
+    s[3] = (uint8_t)n;
+}
+
+
+static void h2_frame_header (uint8_t * const s, const uint32_t len, const request_h2ftype_t type, const uint8_t flags, const uint32_t h2id)
+{
+    s[0] = (uint8_t)(len >> 16);
+    s[1] = (uint8_t)(len >> 8);
+    s[2] = (uint8_t)len;
+    s[3] = (uint8_t)type;
+    s[4] = flags;
+    h2_put_u32(s+5, h2id & 0x7fffffff);
+}
+
+
+static request_st * h2_get_stream_req (h2con * const h2c, const uint32_t h2id)
+{
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        request_st * const r = h2c->r[i];
+        if (r->h2id == h2id) return r;
+    }
+    return NULL;
+}
+
+
+void h2_send_goaway (connection * const con, const request_h2error_t e)
+{
+    h2con * const h2c = con->h2;
+    if (h2c->sent_goaway > 0) return; /*(connection error already sent)*/
+    if (e == H2_E_NO_ERROR && h2c->sent_goaway) return;
+    h2c->sent_goaway = (e != H2_E_NO_ERROR) ? (int)e : -1;
+
+    uint8_t f[9+8];
+    h2_frame_header(f, 8, H2_FTYPE_GOAWAY, 0, 0);
+    h2_put_u32(f+9, h2c->h2_cid);   /* last-stream-id */
+    h2_put_u32(f+13, (uint32_t)e);  /* error code */
+    chunkqueue_append_mem(con->write_queue, (const char *)f, sizeof(f));
+}
+
+
+static void h2_send_rst_stream_id (const uint32_t h2id, connection * const con, const request_h2error_t e)
+{
+    uint8_t f[9+4];
+    h2_frame_header(f, 4, H2_FTYPE_RST_STREAM, 0, h2id);
+    h2_put_u32(f+9, (uint32_t)e);
+    chunkqueue_append_mem(con->write_queue, (const char *)f, sizeof(f));
+}
+
+
+static void h2_send_rst_stream (request_st * const r, connection * const con, const request_h2error_t e)
+{
+    h2_send_rst_stream_id(r->h2id, con, e);
+    r->h2state = H2_STATE_CLOSED;
+    r->state = CON_STATE_ERROR;
+}
+
+
+void h2_send_window_update (connection * const con, const uint32_t h2id, const uint32_t len)
+{
+    uint8_t f[9+4];
+    h2_frame_header(f, 4, H2_FTYPE_WINDOW_UPDATE, 0, h2id);
+    h2_put_u32(f+9, len & 0x7fffffff);
+    chunkqueue_append_mem(con->write_queue, (const char *)f, sizeof(f));
+}
+
+
+static void h2_end_stream_local (request_st * const r)
+{
+    r->h2state = (r->h2state == H2_STATE_HALF_CLOSED_REMOTE)
+      ? H2_STATE_CLOSED
+      : H2_STATE_HALF_CLOSED_LOCAL;
+}
+
+
+static void h2_end_stream_remote (request_st * const r)
+{
+    r->h2state = (r->h2state == H2_STATE_HALF_CLOSED_LOCAL)
+      ? H2_STATE_CLOSED
+      : H2_STATE_HALF_CLOSED_REMOTE;
+}
+
+
+void h2_send_headers (request_st * const r, connection * const con, const buffer * const hpack)
+{
+    /* frame HPACK-encoded response header block as HEADERS (+ CONTINUATION)
+     * (sent with END_STREAM if response has no body to follow) */
+    h2con * const h2c = con->h2;
+    const uint32_t fsz = h2c->s_max_frame_size;
+    const char *s = hpack->ptr;
+    uint32_t len = buffer_string_length(hpack);
+    const int end_stream =
+      r->resp_body_finished && chunkqueue_is_empty(r->write_queue);
+    request_h2ftype_t type = H2_FTYPE_HEADERS;
+    uint8_t flags = end_stream ? H2_FLAG_END_STREAM : 0;
+
+    chunkqueue * const cq = con->write_queue;
+    buffer * const b =
+      chunkqueue_append_buffer_open_sz(cq, len + 9 * (1 + len / fsz) + 1);
+    do {
+        const uint32_t n = len > fsz ? fsz : len;
+        len -= n;
+        if (0 == len) flags |= H2_FLAG_END_HEADERS;
+        uint8_t f[9];
+        h2_frame_header(f, n, type, flags, r->h2id);
+        buffer_append_string_len(b, (const char *)f, sizeof(f));
+        buffer_append_string_len(b, s, n);
+        s += n;
+        type = H2_FTYPE_CONTINUATION;
+        flags = 0;
+    } while (len);
+    chunkqueue_append_buffer_commit(cq);
+
+    if (end_stream) h2_end_stream_local(r);
+}
+
+
+uint32_t h2_send_cqdata (request_st * const r, connection * const con, chunkqueue * const cq, uint32_t dlen)
+{
+    /* frame (up to) dlen octets from cq into a single DATA frame, limited by
+     * peer max frame size and by connection and stream send windows;
+     * DATA frame is sent with END_STREAM if it completes the response */
+    h2con * const h2c = con->h2;
+    if (dlen > h2c->s_max_frame_size) dlen = h2c->s_max_frame_size;
+    if (r->h2_swin < (int32_t)dlen) dlen = r->h2_swin > 0 ? (uint32_t)r->h2_swin : 0;
+    if (h2c->swin  < (int32_t)dlen) dlen = h2c->swin  > 0 ? (uint32_t)h2c->swin  : 0;
+    const off_t cqlen = chunkqueue_length(cq);
+    if (cqlen < (off_t)dlen) dlen = (uint32_t)cqlen;
+    if (0 == dlen) return 0;
+
+    r->h2_swin -= (int32_t)dlen;
+    h2c->swin -= (int32_t)dlen;
+
+    const int end_stream = r->resp_body_finished && cqlen == (off_t)dlen;
+    uint8_t f[9];
+    h2_frame_header(f, dlen, H2_FTYPE_DATA,
+                    end_stream ? H2_FLAG_END_STREAM : 0, r->h2id);
+    chunkqueue_append_mem(con->write_queue, (const char *)f, sizeof(f));
+    chunkqueue_steal(con->write_queue, cq, (off_t)dlen);
+
+    if (end_stream) h2_end_stream_local(r);
+    return dlen;
+}
+
+
+void h2_send_end_stream (request_st * const r, connection * const con)
+{
+    if (r->h2state != H2_STATE_OPEN && r->h2state != H2_STATE_HALF_CLOSED_REMOTE)
+        return; /*(END_STREAM already sent)*/
+    uint8_t f[9];
+    h2_frame_header(f, 0, H2_FTYPE_DATA, H2_FLAG_END_STREAM, r->h2id);
+    chunkqueue_append_mem(con->write_queue, (const char *)f, sizeof(f));
+    h2_end_stream_local(r);
+}
+
+
+void h2_init_con (request_st * const h2r, connection * const con)
+{
+    h2con * const h2c = calloc(1, sizeof(h2con));
+    force_assert(h2c);
+    heap_nallocs_inc();
+    con->h2 = h2c;
+    h2r->http_version = HTTP_VERSION_2;
+    con->keep_alive_idle = h2r->conf.max_keep_alive_idle;
+    con->read_idle_ts = log_epoch_secs;
+    con->read_idle_ms = log_epoch_ms();
+
+    h2c->rwin = H2_CON_RWIN;
+    h2c->swin = 65535;
+    h2c->s_initial_window_size = 65535;
+    h2c->s_max_frame_size = H2_MAX_FRAME_SIZE;
+    hpack_table_init(&h2c->decoder, HPACK_TABLE_SIZE_DEFAULT);
+    hpack_table_init(&h2c->encoder, HPACK_TABLE_SIZE_DEFAULT);
+    h2c->kb = buffer_init();
+    h2c->vb = buffer_init();
+    h2c->ph = buffer_init();
+    h2c->hb = buffer_init();
+    h2c->cookie = buffer_init();
+
+    /* server connection preface: SETTINGS (RFC 7540 3.5)
+     * followed by WINDOW_UPDATE to enlarge the connection recv window */
+    static const uint8_t s[] = {
+      /* SETTINGS */
+      0x00, 0x00, 0x12, H2_FTYPE_SETTINGS, 0x00, 0x00, 0x00, 0x00, 0x00
+     ,0x00, H2_SETTINGS_MAX_CONCURRENT_STREAMS
+     ,0x00, 0x00, 0x00, H2_MAX_CONCURRENT_STREAMS
+     ,0x00, H2_SETTINGS_INITIAL_WINDOW_SIZE
+     ,(H2_STREAM_RWIN >> 24) & 0xff, (H2_STREAM_RWIN >> 16) & 0xff
+     ,(H2_STREAM_RWIN >> 8) & 0xff, H2_STREAM_RWIN & 0xff
+     ,0x00, H2_SETTINGS_ENABLE_PUSH
+     ,0x00, 0x00, 0x00, 0x00
+      /* WINDOW_UPDATE */
+     ,0x00, 0x00, 0x04, H2_FTYPE_WINDOW_UPDATE, 0x00, 0x00, 0x00, 0x00, 0x00
+     ,((H2_CON_RWIN - 65535) >> 24) & 0xff, ((H2_CON_RWIN - 65535) >> 16) & 0xff
+     ,((H2_CON_RWIN - 65535) >> 8) & 0xff, (H2_CON_RWIN - 65535) & 0xff
+    };
+    chunkqueue_append_mem(con->write_queue, (const char *)s, sizeof(s));
+
+    h2r->state = CON_STATE_WRITE;
+}
+
+
+void h2_retire_stream (request_st * const r, connection * const con)
+{
+    h2con * const h2c = con->h2;
+
+    /* call request_done hook if http_status set (e.g. to log request) */
+    /* (even if error, stream reset, as long as http_status is set) */
+    if (r->http_status) plugins_call_handle_request_done(r);
+
+    if (r->state != CON_STATE_ERROR) ++con->srv->con_written;
+
+    /* reset stream if response ended before request body was received,
+     * or if response ended in error */
+    if (r->h2state != H2_STATE_CLOSED)
+        h2_send_rst_stream_id(r->h2id, con, r->state == CON_STATE_ERROR
+                                            ? H2_E_INTERNAL_ERROR
+                                            : H2_E_NO_ERROR);
+
+    uint32_t i = 0;
+    while (i < h2c->rused && h2c->r[i] != r) ++i;
+    if (i < h2c->rused) {
+        memmove(h2c->r+i, h2c->r+i+1, (--h2c->rused - i) * sizeof(*h2c->r));
+        h2c->r[h2c->rused] = NULL;
+    }
+
+    request_reset(r);
+    if (h2_stream_pool.used < H2_STREAM_POOL_SZ) {
+        chunkqueue_reset(r->write_queue);
+        chunkqueue_reset(r->read_queue);
+        h2_stream_pool.r[h2_stream_pool.used++] = r;
+    }
+    else {
+        request_free(r);
+        free(r);
+    }
+}
+
+
+void h2_stream_pool_free (void)
+{
+    while (h2_stream_pool.used) {
+        request_st * const r = h2_stream_pool.r[--h2_stream_pool.used];
+        request_free(r);
+        free(r);
+    }
+}
+
+
+void h2_retire_con (connection * const con)
+{
+    h2con * const h2c = con->h2;
+    if (NULL == h2c) return;
+
+    while (h2c->rused) {
+        request_st * const r = h2c->r[0];
+        if (r->state != CON_STATE_RESPONSE_END) r->state = CON_STATE_ERROR;
+        h2_retire_stream(r, con);
+    }
+
+    hpack_table_free(&h2c->decoder);
+    hpack_table_free(&h2c->encoder);
+    buffer_free(h2c->kb);
+    buffer_free(h2c->vb);
+    buffer_free(h2c->ph);
+    buffer_free(h2c->hb);
+    buffer_free(h2c->cookie);
+    free(h2c);
+    con->h2 = NULL;
+}
+
+
+static request_st * h2_init_stream (connection * const con, const uint32_t h2id)
+{
+    h2con * const h2c = con->h2;
+    request_st *r;
+    if (h2_stream_pool.used) {
+        r = h2_stream_pool.r[--h2_stream_pool.used];
+        r->con = con;
+        r->state = CON_STATE_CONNECT;
+        r->keep_alive = 0;
+    }
+    else {
+        r = calloc(1, sizeof(request_st));
+        force_assert(r);
+        heap_nallocs_inc();
+        request_init(r, con, con->srv);
+    }
+    h2c->r[h2c->rused++] = r;
+
+    r->h2id = h2id;
+    r->h2state = H2_STATE_OPEN;
+    r->h2_rwin = H2_STREAM_RWIN;
+    r->h2_swin = h2c->s_initial_window_size;
+    r->http_method = HTTP_METHOD_UNSET;
+    r->http_version = HTTP_VERSION_2;
+
+    r->start_ts = log_epoch_secs;
+    r->start_ms = con->read_idle_ms; /*(stream HEADERS frame just read)*/
+    if (r->conf.high_precision_timestamps)
+        log_clock_gettime_realtime(&r->start_hp);
+    ++con->request_count;
+
+    config_cond_cache_reset(r);
+    r->conditional_is_valid = (1 << COMP_SERVER_SOCKET)
+                            | (1 << COMP_HTTP_REMOTE_IP);
+    return r;
+}
+
+
+static int h2_discard_header (void * const ctx, const char * const k, const uint32_t klen, const char * const v, const uint32_t vlen)
+{
+    UNUSED(ctx);
+    UNUSED(k);
+    UNUSED(klen);
+    UNUSED(v);
+    UNUSED(vlen);
+    return 0;
+}
+
+
+static int h2_tchar_lc (const unsigned char c)
+{
+    /* RFC 7230 tchar, excluding uppercase (RFC 7540 8.1.2) */
+    switch (c) {
+      case '!': case '#': case '$': case '%': case '&': case '\'':
+      case '*': case '+': case '-': case '.': case '^': case '_':
+      case '`': case '|': case '~':
+        return 1;
+      default:
+        return light_isdigit(c) || (c >= 'a' && c <= 'z');
+    }
+}
+
+
+static int h2_parse_header (void * const ctx, const char * const k, const uint32_t klen, const char * const v, const uint32_t vlen)
+{
+    /* (always return 0 to continue decoding and keep HPACK table in sync) */
+    h2_hdrs_ctx * const hctx = ctx;
+    h2con * const h2c = hctx->h2c;
+    hctx->hlen += klen + vlen + 4;
+    if (hctx->err) return 0;
+
+    for (uint32_t i = 0; i < vlen; ++i) {
+        if (v[i] == '\0' || v[i] == '\r' || v[i] == '\n') {
+            hctx->err = 1;
+            return 0;
+        }
+    }
+
+    if (k[0] == ':') {
+        int i;
+        if (klen == 7 && 0 == memcmp(k, ":method", 7))
+            i = H2_PH_METHOD;
+        else if (klen == 7 && 0 == memcmp(k, ":scheme", 7))
+            i = H2_PH_SCHEME;
+        else if (klen == 10 && 0 == memcmp(k, ":authority", 10))
+            i = H2_PH_AUTHORITY;
+        else if (klen == 5 && 0 == memcmp(k, ":path", 5))
+            i = H2_PH_PATH;
+        else
+            i = -1;
+        if (i < 0 || hctx->regular || (hctx->seen & (1u << i))) {
+            hctx->err = 1;
+            return 0;
+        }
+        hctx->seen |= (1u << i);
+        hctx->ph[i] = buffer_string_length(h2c->ph);
+        hctx->phlen[i] = vlen;
+        buffer_append_string_len(h2c->ph, v, vlen);
+        return 0;
+    }
+
+    hctx->regular = 1;
+    for (uint32_t i = 0; i < klen; ++i) {
+        if (!h2_tchar_lc((unsigned char)k[i])) {
+            hctx->err = 1;
+            return 0;
+        }
+    }
+
+    switch (klen) {
+      case 2:
+        if (0 == memcmp(k, "te", 2)) {
+            /* "te: trailers" is the only value permitted; not forwarded */
+            if (!(vlen == 8 && 0 == memcmp(v, "trailers", 8)))
+                hctx->err = 1;
+            return 0;
+        }
+        break;
+      case 4:
+        if (0 == memcmp(k, "host", 4)) {
+            /* :authority takes precedence over host */
+            if (hctx->seen & (1u << H2_PH_AUTHORITY)) return 0;
+        }
+        break;
+      case 6:
+        if (0 == memcmp(k, "cookie", 6)) {
+            /* cookie crumbs are joined into a single header (8.1.2.5) */
+            if (!buffer_string_is_empty(h2c->cookie))
+                buffer_append_string_len(h2c->cookie, CONST_STR_LEN("; "));
+            buffer_append_string_len(h2c->cookie, v, vlen);
+            return 0;
+        }
+        break;
+      case 7:
+        if (0 == memcmp(k, "upgrade", 7)) hctx->err = 1;
+        break;
+      case 10:
+        if (0 == memcmp(k, "connection", 10)
+            || 0 == memcmp(k, "keep-alive", 10))
+            hctx->err = 1;
+        break;
+      case 14:
+        if (0 == memcmp(k, "content-length", 14)) hctx->has_cl = 1;
+        break;
+      case 16:
+        if (0 == memcmp(k, "proxy-connection", 16)) hctx->err = 1;
+        break;
+      case 17:
+        if (0 == memcmp(k, "transfer-encoding", 17)) hctx->err = 1;
+        break;
+      default:
+        break;
+    }
+    if (hctx->err) return 0;
+
+    buffer * const hb = h2c->hb;
+    buffer_append_string_len(hb, k, klen);
+    buffer_append_string_len(hb, CONST_STR_LEN(": "));
+    buffer_append_string_len(hb, v, vlen);
+    buffer_append_string_len(hb, CONST_STR_LEN("\r\n"));
+    return 0;
+}
+
+
+static void h2_recv_request (request_st * const r, connection * const con, const h2_hdrs_ctx * const hctx, const int end_stream)
+{
+    /* reconstruct request headers in HTTP/1.1 syntax to reuse
+     * http_request_parse() and the connection request processing */
+    h2con * const h2c = con->h2;
+    const char * const ph = h2c->ph->ptr;
+    const uint32_t mlen = hctx->phlen[H2_PH_METHOD];
+    const char * const m = ph + hctx->ph[H2_PH_METHOD];
+    const int connect = (mlen == 7 && 0 == memcmp(m, "CONNECT", 7));
+    const int get_or_head = (mlen == 3 && 0 == memcmp(m, "GET", 3))
+                         || (mlen == 4 && 0 == memcmp(m, "HEAD", 4));
+
+    if (hctx->err
+        || !(hctx->seen & (1u << H2_PH_METHOD))
+        || (connect
+            ? (hctx->seen & ((1u << H2_PH_SCHEME) | (1u << H2_PH_PATH)))
+              || !(hctx->seen & (1u << H2_PH_AUTHORITY))
+            : (hctx->seen & ((1u << H2_PH_SCHEME) | (1u << H2_PH_PATH)))
+              != ((1u << H2_PH_SCHEME) | (1u << H2_PH_PATH))
+              || 0 == hctx->phlen[H2_PH_PATH])) {
+        /* malformed request (RFC 7540 8.1.2.6) */
+        h2_send_rst_stream(r, con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+
+    buffer * const b = h2c->kb; /*(HPACK decoding is complete; reuse kb)*/
+    buffer_copy_string_len(b, m, mlen);
+    buffer_append_string_len(b, CONST_STR_LEN(" "));
+    if (connect)
+        buffer_append_string_len(b, ph + hctx->ph[H2_PH_AUTHORITY],
+                                 hctx->phlen[H2_PH_AUTHORITY]);
+    else
+        buffer_append_string_len(b, ph + hctx->ph[H2_PH_PATH],
+                                 hctx->phlen[H2_PH_PATH]);
+    buffer_append_string_len(b, CONST_STR_LEN(" HTTP/1.1\r\n"));
+    if (hctx->seen & (1u << H2_PH_AUTHORITY)) {
+        buffer_append_string_len(b, CONST_STR_LEN("Host: "));
+        buffer_append_string_len(b, ph + hctx->ph[H2_PH_AUTHORITY],
+                                 hctx->phlen[H2_PH_AUTHORITY]);
+        buffer_append_string_len(b, CONST_STR_LEN("\r\n"));
+    }
+    buffer_append_string_buffer(b, h2c->hb);
+    if (!buffer_string_is_empty(h2c->cookie)) {
+        buffer_append_string_len(b, CONST_STR_LEN("Cookie: "));
+        buffer_append_string_buffer(b, h2c->cookie);
+        buffer_append_string_len(b, CONST_STR_LEN("\r\n"));
+    }
+    if (!hctx->has_cl) {
+        /* request body length is delimited by END_STREAM; note unknown
+         * length as if Transfer-Encoding: chunked (see h2 read_post_state) */
+        if (!end_stream && !get_or_head)
+            buffer_append_string_len(b, CONST_STR_LEN("Transfer-Encoding: chunked\r\n"));
+        else if (end_stream && mlen == 4 && 0 == memcmp(m, "POST", 4))
+            buffer_append_string_len(b, CONST_STR_LEN("Content-Length: 0\r\n"));
+    }
+    buffer_append_string_len(b, CONST_STR_LEN("\r\n"));
+
+    char * const hdrs = b->ptr;
+    const uint32_t header_len = buffer_string_length(b);
+    unsigned short hoff[8192]; /* max num header lines + 3; 16k on stack */
+    hoff[0] = 1;
+    hoff[1] = 0;
+    if (header_len <= r->conf.max_request_field_size
+        && hctx->hlen <= r->conf.max_request_field_size) {
+        for (uint32_t i = 0; i < header_len - 2; ++i) {
+            if (hdrs[i] != '\n') continue;
+            if (++hoff[0] >= sizeof(hoff)/sizeof(hoff[0])-1) break;
+            hoff[hoff[0]] = (unsigned short)(i+1);
+        }
+    }
+    else
+        hoff[0] = sizeof(hoff)/sizeof(hoff[0])-1;
+
+    if (hoff[0] >= sizeof(hoff)/sizeof(hoff[0])-1) {
+        log_error(r->conf.errh, __FILE__, __LINE__, "%s",
+                  "oversized request-header -> sending Status 431");
+        r->http_status = 431; /* Request Header Fields Too Large */
+        r->http_version = HTTP_VERSION_2;
+        r->keep_alive = 0;
+    }
+    else {
+        hoff[hoff[0]+1] = (unsigned short)header_len;
+        connection_request_parse(r, hdrs, hoff, header_len);
+        r->http_version = HTTP_VERSION_2;
+        if (end_stream && r->reqbody_length > 0 && 0 == r->http_status) {
+            /* content-length does not match (empty) request body */
+            h2_send_rst_stream(r, con, H2_E_PROTOCOL_ERROR);
+            return;
+        }
+    }
+
+    if (end_stream) h2_end_stream_remote(r);
+    r->state = CON_STATE_REQUEST_END;
+}
+
+
+static void h2_recv_headers (connection * const con, uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t h2id = h2_u31(s+5);
+    const uint8_t flags = s[4];
+    const unsigned char *psrc = s + 9;
+    uint32_t alen = flen;
+
+    if (0 == h2id || !(h2id & 1)) { /* client-initiated stream ids are odd */
+        h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+    if (flags & H2_FLAG_PADDED) {
+        if (0 == alen || psrc[0] >= alen) {
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+            return;
+        }
+        alen -= 1 + psrc[0];
+        ++psrc;
+    }
+    if (flags & H2_FLAG_PRIORITY) { /*(priority is ignored)*/
+        if (alen < 5) {
+            h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+            return;
+        }
+        psrc += 5;
+        alen -= 5;
+    }
+
+    request_st *r = NULL;
+    if (h2id <= h2c->h2_cid) {
+        /* trailers: HEADERS with END_STREAM on open stream (not forwarded) */
+        r = h2_get_stream_req(h2c, h2id);
+        if (NULL == r || !(flags & H2_FLAG_END_STREAM)
+            || (r->h2state != H2_STATE_OPEN
+                && r->h2state != H2_STATE_HALF_CLOSED_LOCAL)) {
+            h2_send_goaway(con, r ? H2_E_PROTOCOL_ERROR : H2_E_STREAM_CLOSED);
+            return;
+        }
+        if (0 != hpack_decode(&h2c->decoder, psrc, alen, h2_discard_header,
+                              NULL, h2c->kb, h2c->vb)) {
+            h2_send_goaway(con, H2_E_COMPRESSION_ERROR);
+            return;
+        }
+        if (r->reqbody_length >= 0
+            && r->read_queue->bytes_in != r->reqbody_length
+            && 0 == r->http_status) {
+            /* DATA less than content-length */
+            h2_send_rst_stream(r, con, H2_E_PROTOCOL_ERROR);
+            return;
+        }
+        h2_end_stream_remote(r);
+        return;
+    }
+
+    if (h2c->sent_goaway || h2c->rused == H2_MAX_CONCURRENT_STREAMS) {
+        /* decode (and discard) to keep HPACK decoder state in sync */
+        if (0 != hpack_decode(&h2c->decoder, psrc, alen, h2_discard_header,
+                              NULL, h2c->kb, h2c->vb)) {
+            h2_send_goaway(con, H2_E_COMPRESSION_ERROR);
+            return;
+        }
+        if (!h2c->sent_goaway) {
+            h2c->h2_cid = h2id;
+            h2_send_rst_stream_id(h2id, con, H2_E_REFUSED_STREAM);
+        }
+        return;
+    }
+
+    h2c->h2_cid = h2id;
+    r = h2_init_stream(con, h2id);
+
+    h2_hdrs_ctx hctx;
+    memset(&hctx, 0, sizeof(hctx));
+    hctx.h2c = h2c;
+    buffer_clear(h2c->ph);
+    buffer_clear(h2c->hb);
+    buffer_clear(h2c->cookie);
+    if (0 != hpack_decode(&h2c->decoder, psrc, alen, h2_parse_header, &hctx,
+                          h2c->kb, h2c->vb)) {
+        h2_send_goaway(con, H2_E_COMPRESSION_ERROR);
+        return;
+    }
+
+    h2_recv_request(r, con, &hctx, (flags & H2_FLAG_END_STREAM));
+}
+
+
+static void h2_recv_data (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t h2id = h2_u31(s+5);
+    if (0 == h2id || h2id > h2c->h2_cid) {
+        h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+
+    /* flow control applies to entire frame payload, including padding */
+    h2c->rwin -= (int32_t)flen;
+    if (h2c->rwin < 0) {
+        h2_send_goaway(con, H2_E_FLOW_CONTROL_ERROR);
+        return;
+    }
+    if (h2c->rwin <= H2_CON_RWIN/2) {
+        h2_send_window_update(con, 0, (uint32_t)(H2_CON_RWIN - h2c->rwin));
+        h2c->rwin = H2_CON_RWIN;
+    }
+
+    request_st * const r = h2_get_stream_req(h2c, h2id);
+    if (NULL == r) return; /*(stream closed; e.g. reset; discard DATA)*/
+    if (r->h2state != H2_STATE_OPEN
+        && r->h2state != H2_STATE_HALF_CLOSED_LOCAL) {
+        if (r->h2state != H2_STATE_CLOSED)
+            h2_send_rst_stream(r, con, H2_E_STREAM_CLOSED);
+        return;
+    }
+
+    const char *d = (const char *)s + 9;
+    uint32_t dlen = flen;
+    if (s[4] & H2_FLAG_PADDED) {
+        if (0 == flen || (uint8_t)d[0] >= flen) {
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+            return;
+        }
+        dlen -= 1 + (uint8_t)d[0];
+        ++d;
+    }
+
+    r->h2_rwin -= (int32_t)flen;
+    if (r->h2_rwin < 0) {
+        h2_send_rst_stream(r, con, H2_E_FLOW_CONTROL_ERROR);
+        return;
+    }
+
+    chunkqueue * const cq = r->read_queue;
+    if (r->reqbody_length >= 0
+        && cq->bytes_in + (off_t)dlen > r->reqbody_length) {
+        if (0 == r->reqbody_length && 0 != r->http_status) {
+            /* request error; discard request body (response pending) */
+            if (r->h2_rwin <= H2_STREAM_RWIN/2) {
+                h2_send_window_update(con, r->h2id,
+                                      (uint32_t)(H2_STREAM_RWIN - r->h2_rwin));
+                r->h2_rwin = H2_STREAM_RWIN;
+            }
+            if (s[4] & H2_FLAG_END_STREAM) h2_end_stream_remote(r);
+            return;
+        }
+        /* DATA exceeds content-length */
+        h2_send_rst_stream(r, con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+    if (dlen) chunkqueue_append_mem(cq, d, dlen);
+
+    if (s[4] & H2_FLAG_END_STREAM) {
+        if (r->reqbody_length >= 0 && cq->bytes_in != r->reqbody_length) {
+            /* DATA less than content-length */
+            h2_send_rst_stream(r, con, H2_E_PROTOCOL_ERROR);
+            return;
+        }
+        h2_end_stream_remote(r);
+    }
+}
+
+
+static void h2_recv_settings (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    if (0 != h2_u31(s+5)) {
+        h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+    if (s[4] & H2_FLAG_ACK) {
+        if (0 != flen) h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+        return;
+    }
+    if (flen % 6) {
+        h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+        return;
+    }
+
+    for (const uint8_t *p = s+9, * const end = p+flen; p < end; p += 6) {
+        const uint32_t v = h2_u32(p+2);
+        switch ((p[0] << 8) | p[1]) {
+          case H2_SETTINGS_HEADER_TABLE_SIZE:
+            hpack_table_set_max_size(&h2c->encoder, v);
+            break;
+          case H2_SETTINGS_ENABLE_PUSH:
+            if (v > 1) {
+                h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+                return;
+            }
+            break;
+          case H2_SETTINGS_INITIAL_WINDOW_SIZE:
+            if (v > 0x7fffffff) {
+                h2_send_goaway(con, H2_E_FLOW_CONTROL_ERROR);
+                return;
+            }
+            else {
+                /* adjust send window of open streams (RFC 7540 6.9.2) */
+                const int32_t diff = (int32_t)v - h2c->s_initial_window_size;
+                for (uint32_t i = 0; i < h2c->rused; ++i) {
+                    request_st * const r = h2c->r[i];
+                    const int64_t swin = (int64_t)r->h2_swin + diff;
+                    if (swin > 0x7fffffff) {
+                        h2_send_goaway(con, H2_E_FLOW_CONTROL_ERROR);
+                        return;
+                    }
+                    r->h2_swin = (int32_t)swin;
+                }
+                h2c->s_initial_window_size = (int32_t)v;
+            }
+            break;
+          case H2_SETTINGS_MAX_FRAME_SIZE:
+            if (v < 16384 || v > 16777215) {
+                h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+                return;
+            }
+            h2c->s_max_frame_size = v;
+            break;
+          case H2_SETTINGS_MAX_CONCURRENT_STREAMS: /*(no server push)*/
+          case H2_SETTINGS_MAX_HEADER_LIST_SIZE:   /*(advisory)*/
+          default:                                 /*(ignore unknown)*/
+            break;
+        }
+    }
+
+    /* acknowledge SETTINGS */
+    static const uint8_t ack[] = {
+      0x00, 0x00, 0x00, H2_FTYPE_SETTINGS, H2_FLAG_ACK, 0x00, 0x00, 0x00, 0x00
+    };
+    chunkqueue_append_mem(con->write_queue, (const char *)ack, sizeof(ack));
+}
+
+
+static void h2_recv_rst_stream (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t h2id = h2_u31(s+5);
+    if (4 != flen) {
+        h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+        return;
+    }
+    if (0 == h2id || h2id > h2c->h2_cid) {
+        h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+    request_st * const r = h2_get_stream_req(h2c, h2id);
+    if (NULL == r) return;
+    r->h2state = H2_STATE_CLOSED;
+    if (r->state != CON_STATE_RESPONSE_END) r->state = CON_STATE_ERROR;
+}
+
+
+static void h2_recv_window_update (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t h2id = h2_u31(s+5);
+    if (4 != flen) {
+        h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+        return;
+    }
+    const uint32_t incr = h2_u31(s+9);
+    if (0 == h2id) {
+        if (0 == incr) {
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+            return;
+        }
+        if ((int64_t)h2c->swin + incr > 0x7fffffff) {
+            h2_send_goaway(con, H2_E_FLOW_CONTROL_ERROR);
+            return;
+        }
+        h2c->swin += (int32_t)incr;
+        return;
+    }
+    if (h2id > h2c->h2_cid) {
+        h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+    request_st * const r = h2_get_stream_req(h2c, h2id);
+    if (NULL == r || r->h2state == H2_STATE_CLOSED) return;
+    if (0 == incr) {
+        h2_send_rst_stream(r, con, H2_E_PROTOCOL_ERROR);
+        return;
+    }
+    if ((int64_t)r->h2_swin + incr > 0x7fffffff) {
+        h2_send_rst_stream(r, con, H2_E_FLOW_CONTROL_ERROR);
+        return;
+    }
+    r->h2_swin += (int32_t)incr;
+}
+
+
+static void h2_recv_frame (connection * const con, uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    switch (s[3]) {
+      case H2_FTYPE_DATA:
+        h2_recv_data(con, s, flen);
+        break;
+      case H2_FTYPE_HEADERS:
+        h2_recv_headers(con, s, flen);
+        break;
+      case H2_FTYPE_PRIORITY: /*(priority is ignored)*/
+        if (0 == h2_u31(s+5))
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        else if (5 != flen)
+            h2_send_rst_stream_id(h2_u31(s+5), con, H2_E_FRAME_SIZE_ERROR);
+        break;
+      case H2_FTYPE_RST_STREAM:
+        h2_recv_rst_stream(con, s, flen);
+        break;
+      case H2_FTYPE_SETTINGS:
+        h2_recv_settings(con, s, flen);
+        break;
+      case H2_FTYPE_PING:
+        if (0 != h2_u31(s+5))
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        else if (8 != flen)
+            h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+        else if (!(s[4] & H2_FLAG_ACK)) {
+            s[4] |= H2_FLAG_ACK; /*(modify in place and echo)*/
+            chunkqueue_append_mem(con->write_queue, (const char *)s, 9+8);
+        }
+        break;
+      case H2_FTYPE_GOAWAY:
+        if (0 != h2_u31(s+5))
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        else if (flen < 8)
+            h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+        else
+            h2c->received_goaway = 1;
+        break;
+      case H2_FTYPE_WINDOW_UPDATE:
+        h2_recv_window_update(con, s, flen);
+        break;
+      case H2_FTYPE_PUSH_PROMISE: /*(clients must not send PUSH_PROMISE)*/
+      case H2_FTYPE_CONTINUATION: /*(not preceded by HEADERS)*/
+        h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        break;
+      default: /*(ignore unknown frame types)*/
+        break;
+    }
+}
+
+
+static uint8_t * h2_frame_contiguous (chunkqueue * const cq, const uint32_t n)
+{
+    chunk *c = cq->first;
+    if (buffer_string_length(c->mem) - c->offset < n) {
+        chunkqueue_compact_mem(cq, n);
+        c = cq->first;
+    }
+    return (uint8_t *)c->mem->ptr + c->offset;
+}
+
+
+static uint32_t h2_recv_continuation (connection * const con, chunkqueue * const cq, uint32_t flen, const off_t cqlen)
+{
+    /* HEADERS without END_HEADERS is followed by CONTINUATION frames
+     * (with no other frames interleaved); wait for entire header block,
+     * then join payloads in place into a single HEADERS frame.
+     * return length consumed from cq; 0 if incomplete or error */
+    uint32_t n = 9 + flen;
+    uint8_t *s;
+    uint8_t flags;
+    do {
+        if (cqlen < (off_t)n + 9) return 0;
+        s = h2_frame_contiguous(cq, n + 9);
+        const uint8_t * const f = s + n;
+        const uint32_t clen = h2_u24(f);
+        if (f[3] != H2_FTYPE_CONTINUATION || h2_u31(f+5) != h2_u31(s+5)) {
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+            return 0;
+        }
+        if (clen > H2_MAX_FRAME_SIZE || n + clen > 65536) {
+            h2_send_goaway(con, H2_E_ENHANCE_YOUR_CALM);
+            return 0;
+        }
+        flags = f[4];
+        n += 9 + clen;
+    } while (!(flags & H2_FLAG_END_HEADERS));
+
+    if (cqlen < (off_t)n) return 0;
+    s = h2_frame_contiguous(cq, n);
+
+    /* join CONTINUATION payloads to HEADERS payload (overwrite headers) */
+    uint32_t m = 9 + flen;
+    for (uint32_t i = m; i < n; ) {
+        const uint32_t clen = h2_u24(s+i);
+        memmove(s+m, s+i+9, clen);
+        m += clen;
+        i += 9 + clen;
+    }
+    s[4] |= H2_FLAG_END_HEADERS;
+    h2_recv_headers(con, s, m - 9);
+    return n;
+}
+
+
+int h2_parse_frames (connection * const con)
+{
+    /* process complete frames received from client
+     * return 0 if connection error (GOAWAY sent), else 1 */
+    h2con * const h2c = con->h2;
+    chunkqueue * const cq = con->read_queue;
+    chunkqueue_remove_finished_chunks(cq);
+
+    if (!h2c->preface) {
+        if (chunkqueue_length(cq) < (off_t)sizeof(h2_client_preface)-1)
+            return 1;
+        const uint8_t * const s =
+          h2_frame_contiguous(cq, sizeof(h2_client_preface)-1);
+        if (0 != memcmp(s, h2_client_preface, sizeof(h2_client_preface)-1)) {
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+            return 0;
+        }
+        chunkqueue_mark_written(cq, sizeof(h2_client_preface)-1);
+        h2c->preface = 1;
+    }
+
+    for (off_t cqlen; h2c->sent_goaway <= 0 && (cqlen = chunkqueue_length(cq)) >= 9; ) {
+        uint8_t *s = h2_frame_contiguous(cq, 9);
+        const uint32_t flen = h2_u24(s);
+        if (flen > H2_MAX_FRAME_SIZE) {
+            h2_send_goaway(con, H2_E_FRAME_SIZE_ERROR);
+            return 0;
+        }
+        if (h2c->preface == 1) { /*(first frame must be SETTINGS)*/
+            if (s[3] != H2_FTYPE_SETTINGS || (s[4] & H2_FLAG_ACK)) {
+                h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+                return 0;
+            }
+            h2c->preface = 2;
+        }
+        if (cqlen < (off_t)(9 + flen)) break; /* incomplete frame */
+
+        uint32_t n;
+        if (s[3] == H2_FTYPE_HEADERS && !(s[4] & H2_FLAG_END_HEADERS)) {
+            n = h2_recv_continuation(con, cq, flen, cqlen);
+            if (0 == n) break; /* incomplete header block (or error) */
+        }
+        else {
+            s = h2_frame_contiguous(cq, 9 + flen);
+            h2_recv_frame(con, s, flen);
+            n = 9 + flen;
+        }
+        chunkqueue_mark_written(cq, n);
+    }
+
+    return (h2c->sent_goaway <= 0);
+}
@@ -0,0 +1,112 @@
+#ifndef INCLUDED_H2_H
+#define INCLUDED_H2_H
+#include "first.h"
+
+#include "base_decls.h"
+#include "buffer.h"
+#include "hpack.h"
+
+/* HTTP/2 (RFC 7540) */
+
+struct chunkqueue;      /* declaration */
+
+/* (lighttpd limits; advertised in server SETTINGS) */
+#define H2_MAX_CONCURRENT_STREAMS 16
+#define H2_MAX_FRAME_SIZE         16384   /* SETTINGS_MAX_FRAME_SIZE default */
+#define H2_STREAM_RWIN            65536   /* SETTINGS_INITIAL_WINDOW_SIZE */
+#define H2_CON_RWIN               262144  /* connection recv window */
+
+typedef enum {
+    H2_FTYPE_DATA          = 0x00,
+    H2_FTYPE_HEADERS       = 0x01,
+    H2_FTYPE_PRIORITY      = 0x02,
+    H2_FTYPE_RST_STREAM    = 0x03,
+    H2_FTYPE_SETTINGS      = 0x04,
+    H2_FTYPE_PUSH_PROMISE  = 0x05,
+    H2_FTYPE_PING          = 0x06,
+    H2_FTYPE_GOAWAY        = 0x07,
+    H2_FTYPE_WINDOW_UPDATE = 0x08,
+    H2_FTYPE_CONTINUATION  = 0x09
+} request_h2ftype_t;
+
+typedef enum {
+    H2_FLAG_END_STREAM     = 0x01, /* DATA HEADERS */
+    H2_FLAG_ACK            = 0x01, /* SETTINGS PING */
+    H2_FLAG_END_HEADERS    = 0x04, /* HEADERS PUSH_PROMISE CONTINUATION */
+    H2_FLAG_PADDED         = 0x08, /* DATA HEADERS PUSH_PROMISE */
+    H2_FLAG_PRIORITY       = 0x20  /* HEADERS */
+} request_h2flag_t;
+
+typedef enum {
+    H2_SETTINGS_HEADER_TABLE_SIZE      = 0x01,
+    H2_SETTINGS_ENABLE_PUSH            = 0x02,
+    H2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x03,
+    H2_SETTINGS_INITIAL_WINDOW_SIZE    = 0x04,
+    H2_SETTINGS_MAX_FRAME_SIZE         = 0x05,
+    H2_SETTINGS_MAX_HEADER_LIST_SIZE   = 0x06
+} request_h2settings_t;
+
+typedef enum {
+    H2_E_NO_ERROR            = 0x00,
+    H2_E_PROTOCOL_ERROR      = 0x01,
+    H2_E_INTERNAL_ERROR      = 0x02,
+    H2_E_FLOW_CONTROL_ERROR  = 0x03,
+    H2_E_SETTINGS_TIMEOUT    = 0x04,
+    H2_E_STREAM_CLOSED       = 0x05,
+    H2_E_FRAME_SIZE_ERROR    = 0x06,
+    H2_E_REFUSED_STREAM      = 0x07,
+    H2_E_CANCEL              = 0x08,
+    H2_E_COMPRESSION_ERROR   = 0x09,
+    H2_E_CONNECT_ERROR       = 0x0a,
+    H2_E_ENHANCE_YOUR_CALM   = 0x0b,
+    H2_E_INADEQUATE_SECURITY = 0x0c,
+    H2_E_HTTP_1_1_REQUIRED   = 0x0d
+} request_h2error_t;
+
+typedef struct h2con {
+    request_st *r[H2_MAX_CONCURRENT_STREAMS]; /* active streams */
+    uint32_t rused;
+
+    uint32_t h2_cid;        /* highest client-initiated stream id */
+    int32_t rwin;           /* connection recv window */
+    int32_t swin;           /* connection send window */
+    int sent_goaway;        /* 0: no; -1: NO_ERROR (graceful); >0: error */
+    int received_goaway;
+    int preface;            /* client connection preface (and SETTINGS) */
+
+    /* peer SETTINGS */
+    int32_t  s_initial_window_size;
+    uint32_t s_max_frame_size;
+
+    hpack_table decoder;
+    hpack_table encoder;
+    buffer *kb;             /* scratch for HPACK decoding */
+    buffer *vb;             /* scratch for HPACK decoding */
+    buffer *ph;             /* request pseudo-header values */
+    buffer *hb;             /* request headers (HTTP/1.1 syntax) */
+    buffer *cookie;         /* request cookie crumbs */
+} h2con;
+
+void h2_init_con (request_st *h2r, connection *con);
+
+__attribute_cold__
+void h2_retire_con (connection *con);
+
+void h2_retire_stream (request_st *r, connection *con);
+
+__attribute_cold__
+void h2_stream_pool_free (void);
+
+int h2_parse_frames (connection *con);
+
+void h2_send_goaway (connection *con, request_h2error_t e);
+
+void h2_send_window_update (connection *con, uint32_t h2id, uint32_t len);
+
+void h2_send_headers (request_st *r, connection *con, const buffer *hpack);
+
+uint32_t h2_send_cqdata (request_st *r, connection *con, struct chunkqueue *cq, uint32_t dlen);
+
+void h2_send_end_stream (request_st *r, connection *con);
+
+#endif
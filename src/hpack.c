@@ -0,0 +1,605 @@
+/*
+ * hpack - HTTP/2 header compression (RFC 7541)
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+#include "first.h"
+
+#include "hpack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+
+struct hpack_entry {
+    uint32_t klen;
+    uint32_t vlen;
+    char s[];           /* "key\0value\0" */
+};
+
+/* RFC 7541 Appendix A Static Table (index 1..61) */
+static const struct hpack_static_entry {
+    uint8_t klen;
+    uint8_t vlen;
+    const char *k;
+    const char *v;
+} hpack_static[] = {
+  { 0, 0, "", "" }, /*(index 0 unused)*/
+  { 10,  0, ":authority", "" }
+ ,{  7,  3, ":method", "GET" }
+ ,{  7,  4, ":method", "POST" }
+ ,{  5,  1, ":path", "/" }
+ ,{  5, 11, ":path", "/index.html" }
+ ,{  7,  4, ":scheme", "http" }
+ ,{  7,  5, ":scheme", "https" }
+ ,{  7,  3, ":status", "200" }
+ ,{  7,  3, ":status", "204" }
+ ,{  7,  3, ":status", "206" }
+ ,{  7,  3, ":status", "304" }
+ ,{  7,  3, ":status", "400" }
+ ,{  7,  3, ":status", "404" }
+ ,{  7,  3, ":status", "500" }
+ ,{ 14,  0, "accept-charset", "" }
+ ,{ 15, 13, "accept-encoding", "gzip, deflate" }
+ ,{ 15,  0, "accept-language", "" }
+ ,{ 13,  0, "accept-ranges", "" }
+ ,{  6,  0, "accept", "" }
+ ,{ 27,  0, "access-control-allow-origin", "" }
+ ,{  3,  0, "age", "" }
+ ,{  5,  0, "allow", "" }
+ ,{ 13,  0, "authorization", "" }
+ ,{ 13,  0, "cache-control", "" }
+ ,{ 19,  0, "content-disposition", "" }
+ ,{ 16,  0, "content-encoding", "" }
+ ,{ 16,  0, "content-language", "" }
+ ,{ 14,  0, "content-length", "" }
+ ,{ 16,  0, "content-location", "" }
+ ,{ 13,  0, "content-range", "" }
+ ,{ 12,  0, "content-type", "" }
+ ,{  6,  0, "cookie", "" }
+ ,{  4,  0, "date", "" }
+ ,{  4,  0, "etag", "" }
+ ,{  6,  0, "expect", "" }
+ ,{  7,  0, "expires", "" }
+ ,{  4,  0, "from", "" }
+ ,{  4,  0, "host", "" }
+ ,{  8,  0, "if-match", "" }
+ ,{ 17,  0, "if-modified-since", "" }
+ ,{ 13,  0, "if-none-match", "" }
+ ,{  8,  0, "if-range", "" }
+ ,{ 19,  0, "if-unmodified-since", "" }
+ ,{ 13,  0, "last-modified", "" }
+ ,{  4,  0, "link", "" }
+ ,{  8,  0, "location", "" }
+ ,{ 12,  0, "max-forwards", "" }
+ ,{ 18,  0, "proxy-authenticate", "" }
+ ,{ 19,  0, "proxy-authorization", "" }
+ ,{  5,  0, "range", "" }
+ ,{  7,  0, "referer", "" }
+ ,{  7,  0, "refresh", "" }
+ ,{ 11,  0, "retry-after", "" }
+ ,{  6,  0, "server", "" }
+ ,{ 10,  0, "set-cookie", "" }
+ ,{ 25,  0, "strict-transport-security", "" }
+ ,{ 17,  0, "transfer-encoding", "" }
+ ,{ 10,  0, "user-agent", "" }
+ ,{  4,  0, "vary", "" }
+ ,{  3,  0, "via", "" }
+ ,{ 16,  0, "www-authenticate", "" }
+};
+
+#define HPACK_STATIC_ENTRIES 61
+
+/* RFC 7541 Appendix B Huffman code; (code, bit length) by symbol */
+static const uint32_t hpack_huff_code[257] = {
+  0x00001ff8, 0x007fffd8, 0x0fffffe2, 0x0fffffe3, 0x0fffffe4, 0x0fffffe5,
+  0x0fffffe6, 0x0fffffe7, 0x0fffffe8, 0x00ffffea, 0x3ffffffc, 0x0fffffe9,
+  0x0fffffea, 0x3ffffffd, 0x0fffffeb, 0x0fffffec, 0x0fffffed, 0x0fffffee,
+  0x0fffffef, 0x0ffffff0, 0x0ffffff1, 0x0ffffff2, 0x3ffffffe, 0x0ffffff3,
+  0x0ffffff4, 0x0ffffff5, 0x0ffffff6, 0x0ffffff7, 0x0ffffff8, 0x0ffffff9,
+  0x0ffffffa, 0x0ffffffb, 0x00000014, 0x000003f8, 0x000003f9, 0x00000ffa,
+  0x00001ff9, 0x00000015, 0x000000f8, 0x000007fa, 0x000003fa, 0x000003fb,
+  0x000000f9, 0x000007fb, 0x000000fa, 0x00000016, 0x00000017, 0x00000018,
+  0x00000000, 0x00000001, 0x00000002, 0x00000019, 0x0000001a, 0x0000001b,
+  0x0000001c, 0x0000001d, 0x0000001e, 0x0000001f, 0x0000005c, 0x000000fb,
+  0x00007ffc, 0x00000020, 0x00000ffb, 0x000003fc, 0x00001ffa, 0x00000021,
+  0x0000005d, 0x0000005e, 0x0000005f, 0x00000060, 0x00000061, 0x00000062,
+  0x00000063, 0x00000064, 0x00000065, 0x00000066, 0x00000067, 0x00000068,
+  0x00000069, 0x0000006a, 0x0000006b, 0x0000006c, 0x0000006d, 0x0000006e,
+  0x0000006f, 0x00000070, 0x00000071, 0x00000072, 0x000000fc, 0x00000073,
+  0x000000fd, 0x00001ffb, 0x0007fff0, 0x00001ffc, 0x00003ffc, 0x00000022,
+  0x00007ffd, 0x00000003, 0x00000023, 0x00000004, 0x00000024, 0x00000005,
+  0x00000025, 0x00000026, 0x00000027, 0x00000006, 0x00000074, 0x00000075,
+  0x00000028, 0x00000029, 0x0000002a, 0x00000007, 0x0000002b, 0x00000076,
+  0x0000002c, 0x00000008, 0x00000009, 0x0000002d, 0x00000077, 0x00000078,
+  0x00000079, 0x0000007a, 0x0000007b, 0x00007ffe, 0x000007fc, 0x00003ffd,
+  0x00001ffd, 0x0ffffffc, 0x000fffe6, 0x003fffd2, 0x000fffe7, 0x000fffe8,
+  0x003fffd3, 0x003fffd4, 0x003fffd5, 0x007fffd9, 0x003fffd6, 0x007fffda,
+  0x007fffdb, 0x007fffdc, 0x007fffdd, 0x007fffde, 0x00ffffeb, 0x007fffdf,
+  0x00ffffec, 0x00ffffed, 0x003fffd7, 0x007fffe0, 0x00ffffee, 0x007fffe1,
+  0x007fffe2, 0x007fffe3, 0x007fffe4, 0x001fffdc, 0x003fffd8, 0x007fffe5,
+  0x003fffd9, 0x007fffe6, 0x007fffe7, 0x00ffffef, 0x003fffda, 0x001fffdd,
+  0x000fffe9, 0x003fffdb, 0x003fffdc, 0x007fffe8, 0x007fffe9, 0x001fffde,
+  0x007fffea, 0x003fffdd, 0x003fffde, 0x00fffff0, 0x001fffdf, 0x003fffdf,
+  0x007fffeb, 0x007fffec, 0x001fffe0, 0x001fffe1, 0x003fffe0, 0x001fffe2,
+  0x007fffed, 0x003fffe1, 0x007fffee, 0x007fffef, 0x000fffea, 0x003fffe2,
+  0x003fffe3, 0x003fffe4, 0x007ffff0, 0x003fffe5, 0x003fffe6, 0x007ffff1,
+  0x03ffffe0, 0x03ffffe1, 0x000fffeb, 0x0007fff1, 0x003fffe7, 0x007ffff2,
+  0x003fffe8, 0x01ffffec, 0x03ffffe2, 0x03ffffe3, 0x03ffffe4, 0x07ffffde,
+  0x07ffffdf, 0x03ffffe5, 0x00fffff1, 0x01ffffed, 0x0007fff2, 0x001fffe3,
+  0x03ffffe6, 0x07ffffe0, 0x07ffffe1, 0x03ffffe7, 0x07ffffe2, 0x00fffff2,
+  0x001fffe4, 0x001fffe5, 0x03ffffe8, 0x03ffffe9, 0x0ffffffd, 0x07ffffe3,
+  0x07ffffe4, 0x07ffffe5, 0x000fffec, 0x00fffff3, 0x000fffed, 0x001fffe6,
+  0x003fffe9, 0x001fffe7, 0x001fffe8, 0x007ffff3, 0x003fffea, 0x003fffeb,
+  0x01ffffee, 0x01ffffef, 0x00fffff4, 0x00fffff5, 0x03ffffea, 0x007ffff4,
+  0x03ffffeb, 0x07ffffe6, 0x03ffffec, 0x03ffffed, 0x07ffffe7, 0x07ffffe8,
+  0x07ffffe9, 0x07ffffea, 0x07ffffeb, 0x0ffffffe, 0x07ffffec, 0x07ffffed,
+  0x07ffffee, 0x07ffffef, 0x07fffff0, 0x03ffffee, 0x3fffffff,
+};
+
+static const uint8_t hpack_huff_len[257] = {
+  13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+  28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+   6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+   5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+  13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+   7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+  15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+   6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+  20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+  24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+  22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+  21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+  26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+  19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+  20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+  26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+  30,
+};
+
+/* symbols ordered by (code length, symbol); the code is canonical */
+static const uint16_t hpack_huff_sym[257] = {
+   48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,
+   45,  46,  47,  51,  52,  53,  54,  55,  56,  57,  61,  65,
+   95,  98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+   58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+   77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89,
+  106, 107, 113, 118, 119, 120, 121, 122,  38,  42,  44,  59,
+   88,  90,  33,  34,  40,  41,  63,  39,  43, 124,  35,  62,
+    0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+  195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+  167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+  132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+  173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+  233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+  151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+  183, 188, 191, 197, 231, 239,   9, 142, 144, 145, 148, 159,
+  171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+  200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+  255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+  246, 247, 248, 250, 251, 252, 253, 254,   2,   3,   4,   5,
+    6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+   21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220,
+  249,  10,  13,  22, 256,
+};
+
+/* per code length 5..30: left-justified upper limit of codes of that length,
+ * and offset from code value to index in hpack_huff_sym[] */
+static const uint32_t hpack_huff_lim[26] = {
+  0x50000000, 0xb8000000, 0xf8000000, 0xfe000000, 0xfe000000, 0xff400000,
+  0xffa00000, 0xffc00000, 0xfff00000, 0xfff80000, 0xfffe0000, 0xfffe0000,
+  0xfffe0000, 0xfffe0000, 0xfffe6000, 0xfffee000, 0xffff4800, 0xffffb000,
+  0xffffea00, 0xfffff600, 0xfffff800, 0xfffffbc0, 0xfffffe20, 0xfffffff0,
+  0xfffffff0, 0xffffffff,
+};
+
+static const int32_t hpack_huff_ofs[26] = {
+  0, -10, -56, -180, 0, -942,
+  -1963, -4008, -8100, -16290, -32672, 0,
+  0, 0, -524177, -1048452, -2097010, -4194139,
+  -8388423, -16777020, -33554226, -67108642, -134217489, -268435202,
+  0, -1073741567,
+};
+
+
+void hpack_table_init (hpack_table * const t, const uint32_t max_size_limit)
+{
+    memset(t, 0, sizeof(*t));
+    t->max_size_limit = max_size_limit <= HPACK_TABLE_SIZE_DEFAULT
+      ? max_size_limit
+      : HPACK_TABLE_SIZE_DEFAULT;
+    t->max_size = t->max_size_limit;
+}
+
+
+void hpack_table_free (hpack_table * const t)
+{
+    for (uint32_t i = 0; i < t->used; ++i)
+        free(t->e[(t->head - i) & (HPACK_TABLE_ENTRIES_MAX-1)]);
+    t->used = 0;
+    t->size = 0;
+}
+
+
+static void hpack_table_evict (hpack_table * const t, const uint32_t sz)
+{
+    /* evict oldest entries until table size + sz fits in max_size */
+    while (t->used && t->size + sz > t->max_size) {
+        const uint32_t n = (t->head - --t->used) & (HPACK_TABLE_ENTRIES_MAX-1);
+        struct hpack_entry * const e = t->e[n];
+        t->size -= e->klen + e->vlen + 32;
+        free(e);
+        t->e[n] = NULL;
+    }
+}
+
+
+static void hpack_table_resize (hpack_table * const t, const uint32_t sz)
+{
+    t->max_size = sz;
+    hpack_table_evict(t, 0);
+}
+
+
+void hpack_table_set_max_size (hpack_table * const t, uint32_t sz)
+{
+    /* (encoder) peer SETTINGS_HEADER_TABLE_SIZE is an upper bound;
+     * lighttpd uses no more than HPACK_TABLE_SIZE_DEFAULT */
+    if (sz > HPACK_TABLE_SIZE_DEFAULT) sz = HPACK_TABLE_SIZE_DEFAULT;
+    if (sz == t->max_size_limit) return;
+    t->max_size_limit = sz;
+    if (sz < t->max_size) {
+        hpack_table_resize(t, sz);
+        t->size_update = sz + 1; /*(+1 to flag 0 as pending)*/
+    }
+}
+
+
+static void hpack_table_insert (hpack_table * const t, const char * const k, const uint32_t klen, const char * const v, const uint32_t vlen)
+{
+    /* RFC 7541 4.4 Entry Eviction When Adding New Entries
+     * an entry larger than the maximum size empties the table */
+    const uint32_t sz = klen + vlen + 32;
+    hpack_table_evict(t, sz);
+    if (sz > t->max_size) {
+        hpack_table_evict(t, t->max_size+1);
+        return;
+    }
+
+    struct hpack_entry * const e = malloc(sizeof(*e) + klen + vlen + 2);
+    force_assert(e);
+    e->klen = klen;
+    e->vlen = vlen;
+    memcpy(e->s, k, klen);
+    e->s[klen] = '\0';
+    memcpy(e->s+klen+1, v, vlen);
+    e->s[klen+1+vlen] = '\0';
+
+    t->head = (t->head + 1) & (HPACK_TABLE_ENTRIES_MAX-1);
+    t->e[t->head] = e;
+    ++t->used;
+    t->size += sz;
+}
+
+
+static const struct hpack_entry * hpack_table_get (const hpack_table * const t, const uint32_t ndx)
+{
+    /* ndx is 0-based index into dynamic table (0 is most recent entry) */
+    return (ndx < t->used)
+      ? t->e[(t->head - ndx) & (HPACK_TABLE_ENTRIES_MAX-1)]
+      : NULL;
+}
+
+
+/* RFC 7541 5.1 Integer Representation */
+static int hpack_decode_int (const unsigned char ** const sp, const unsigned char * const end, const int nbits, uint32_t * const n)
+{
+    const unsigned char *s = *sp;
+    const uint32_t mask = (1u << nbits) - 1;
+    uint32_t i = *s++ & mask;
+    if (i == mask) {
+        uint32_t m = 0;
+        unsigned char c;
+        do {
+            if (s == end || m > 21) return -1; /*(limit to < 2^28)*/
+            c = *s++;
+            i += (uint32_t)(c & 0x7f) << m;
+            m += 7;
+        } while (c & 0x80);
+    }
+    *n = i;
+    *sp = s;
+    return 0;
+}
+
+
+static int hpack_huffman_decode (buffer * const b, const unsigned char *s, const unsigned char * const end)
+{
+    /* output is at most 8/5 of input length (shortest code is 5 bits) */
+    char *d = buffer_string_prepare_copy(b, (size_t)(end - s) * 8 / 5);
+    char * const d0 = d;
+    uint64_t acc = 0; /* bits left-justified */
+    uint32_t n = 0;   /* number of bits in acc */
+    for (;;) {
+        while (n <= 56 && s < end) {
+            acc |= (uint64_t)*s++ << (56 - n);
+            n += 8;
+        }
+        if (0 == n) break;
+        /* pad with 1 bits (EOS prefix) if fewer than 32 bits remain */
+        const uint32_t w = (uint32_t)(acc >> 32) | (n < 32 ? 0xffffffffu >> n : 0);
+        uint32_t i = 0;
+        while (i < sizeof(hpack_huff_lim)/sizeof(*hpack_huff_lim)
+               && w >= hpack_huff_lim[i]) ++i;
+        const uint32_t len = i + 5;
+        if (i == sizeof(hpack_huff_lim)/sizeof(*hpack_huff_lim) || len > n) {
+            /* RFC 7541 5.2: padding must be < 8 bits and most-significant
+             * bits of EOS (all 1 bits); otherwise decoding error */
+            if (n > 7 || (uint32_t)(acc >> (64 - n)) != (1u << n) - 1)
+                return -1;
+            break;
+        }
+        const uint32_t sym = hpack_huff_sym[(int32_t)(w >> (32 - len))
+                                            + hpack_huff_ofs[i]];
+        if (sym == 256) return -1; /* EOS in string is a decoding error */
+        *d++ = (char)sym;
+        acc <<= len;
+        n -= len;
+    }
+    buffer_commit(b, (size_t)(d - d0));
+    return 0;
+}
+
+
+/* RFC 7541 5.2 String Literal Representation */
+static int hpack_decode_str (const unsigned char ** const sp, const unsigned char * const end, buffer * const b)
+{
+    const unsigned char *s = *sp;
+    if (s == end) return -1;
+    const int huffman = (*s & 0x80);
+    uint32_t len;
+    if (0 != hpack_decode_int(&s, end, 7, &len)) return -1;
+    if (len > (uint32_t)(end - s)) return -1;
+    if (huffman) {
+        if (0 != hpack_huffman_decode(b, s, s+len)) return -1;
+    }
+    else
+        buffer_copy_string_len(b, (const char *)s, len);
+    *sp = s + len;
+    return 0;
+}
+
+
+static int hpack_decode_name (const hpack_table * const t, const uint32_t ndx, buffer * const kb)
+{
+    if (0 == ndx) return -1;
+    if (ndx <= HPACK_STATIC_ENTRIES) {
+        const struct hpack_static_entry * const se = hpack_static+ndx;
+        buffer_copy_string_len(kb, se->k, se->klen);
+        return 0;
+    }
+    const struct hpack_entry * const e =
+      hpack_table_get(t, ndx - HPACK_STATIC_ENTRIES - 1);
+    if (NULL == e) return -1;
+    buffer_copy_string_len(kb, e->s, e->klen);
+    return 0;
+}
+
+
+int hpack_decode (hpack_table * const restrict t, const unsigned char *s, const uint32_t len, hpack_header_fn fn, void *ctx, buffer * const restrict kb, buffer * const restrict vb)
+{
+    const unsigned char * const end = s + len;
+    int size_update_ok = 1; /* only at beginning of header block */
+    while (s < end) {
+        const unsigned char c = *s;
+        uint32_t ndx;
+        int rc;
+        if (c & 0x80) {
+            /* 6.1 Indexed Header Field Representation */
+            if (0 != hpack_decode_int(&s, end, 7, &ndx) || 0 == ndx)
+                return -1;
+            if (ndx <= HPACK_STATIC_ENTRIES) {
+                const struct hpack_static_entry * const se = hpack_static+ndx;
+                rc = fn(ctx, se->k, se->klen, se->v, se->vlen);
+            }
+            else {
+                const struct hpack_entry * const e =
+                  hpack_table_get(t, ndx - HPACK_STATIC_ENTRIES - 1);
+                if (NULL == e) return -1;
+                rc = fn(ctx, e->s, e->klen, e->s+e->klen+1, e->vlen);
+            }
+        }
+        else if ((c & 0xe0) == 0x20) {
+            /* 6.3 Dynamic Table Size Update */
+            if (!size_update_ok) return -1;
+            if (0 != hpack_decode_int(&s, end, 5, &ndx)) return -1;
+            if (ndx > t->max_size_limit) return -1;
+            hpack_table_resize(t, ndx);
+            continue;
+        }
+        else {
+            /* 6.2.1 Literal Header Field with Incremental Indexing (01)
+             * 6.2.2 Literal Header Field without Indexing (0000)
+             * 6.2.3 Literal Header Field Never Indexed (0001) */
+            const int incr = (c & 0x40);
+            if (0 != hpack_decode_int(&s, end, incr ? 6 : 4, &ndx))
+                return -1;
+            if (0 != (ndx
+                      ? hpack_decode_name(t, ndx, kb)
+                      : hpack_decode_str(&s, end, kb)))
+                return -1;
+            if (0 != hpack_decode_str(&s, end, vb)) return -1;
+            if (incr)
+                hpack_table_insert(t, kb->ptr, buffer_string_length(kb),
+                                      vb->ptr, buffer_string_length(vb));
+            rc = fn(ctx, kb->ptr, buffer_string_length(kb),
+                         vb->ptr, buffer_string_length(vb));
+        }
+        if (0 != rc) return rc;
+        size_update_ok = 0;
+    }
+    return 0;
+}
+
+
+static void hpack_encode_int (buffer * const b, const unsigned char prefix, const int nbits, uint32_t n)
+{
+    const uint32_t mask = (1u << nbits) - 1;
+    unsigned char *d = (unsigned char *)buffer_string_prepare_append(b, 6);
+    unsigned char * const d0 = d;
+    if (n < mask)
+        *d++ = prefix | (unsigned char)n;
+    else {
+        *d++ = prefix | (unsigned char)mask;
+        for (n -= mask; n >= 0x80; n >>= 7)
+            *d++ = (unsigned char)(n | 0x80);
+        *d++ = (unsigned char)n;
+    }
+    buffer_commit(b, (size_t)(d - d0));
+}
+
+
+static void hpack_encode_str (buffer * const b, const char * const s, const uint32_t len)
+{
+    /* use Huffman coding if it is shorter than the raw string */
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < len; ++i)
+        bits += hpack_huff_len[(unsigned char)s[i]];
+    const uint32_t hlen = (uint32_t)((bits + 7) >> 3);
+    if (hlen >= len) {
+        hpack_encode_int(b, 0x00, 7, len);
+        buffer_append_string_len(b, s, len);
+        return;
+    }
+
+    hpack_encode_int(b, 0x80, 7, hlen);
+    unsigned char *d = (unsigned char *)buffer_string_prepare_append(b, hlen);
+    uint64_t acc = 0;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        const unsigned char c = (unsigned char)s[i];
+        acc = (acc << hpack_huff_len[c]) | hpack_huff_code[c];
+        n += hpack_huff_len[c];
+        while (n >= 8) {
+            n -= 8;
+            *d++ = (unsigned char)(acc >> n);
+        }
+    }
+    if (n) /* pad with most-significant bits of EOS */
+        *d++ = (unsigned char)((acc << (8 - n)) | (0xffu >> n));
+    buffer_commit(b, hlen);
+}
+
+
+void hpack_encode_begin (hpack_table * const restrict t, buffer * const restrict b)
+{
+    if (t->size_update) {
+        hpack_encode_int(b, 0x20, 5, t->size_update - 1);
+        t->size_update = 0;
+    }
+}
+
+
+void hpack_encode_status (hpack_table * const restrict t, buffer * const restrict b, const int status)
+{
+    UNUSED(t);
+    uint32_t ndx;
+    switch (status) {
+      case 200: ndx = 8;  break;
+      case 204: ndx = 9;  break;
+      case 206: ndx = 10; break;
+      case 304: ndx = 11; break;
+      case 400: ndx = 12; break;
+      case 404: ndx = 13; break;
+      case 500: ndx = 14; break;
+      default:
+        /* literal without indexing; indexed name ":status" */
+        {
+            char s[3] = { (char)('0' + (status / 100) % 10),
+                          (char)('0' + (status / 10) % 10),
+                          (char)('0' + status % 10) };
+            hpack_encode_int(b, 0x00, 4, 8);
+            hpack_encode_str(b, s, 3);
+        }
+        return;
+    }
+    hpack_encode_int(b, 0x80, 7, ndx);
+}
+
+
+static uint32_t hpack_static_name (const char * const k, const uint32_t klen)
+{
+    for (uint32_t i = 15; i <= HPACK_STATIC_ENTRIES; ++i) {
+        if (hpack_static[i].klen == klen && hpack_static[i].k[0] == k[0]
+            && 0 == memcmp(hpack_static[i].k, k, klen))
+            return i;
+    }
+    return 0;
+}
+
+
+static int hpack_header_indexing (const char * const k, const uint32_t klen)
+{
+    /* 0: literal without indexing, 1: with incremental indexing,
+     * 2: never indexed (sensitive value) */
+    switch (klen) {
+      case 3:
+        if (0 == memcmp(k, "age", 3)) return 0;
+        break;
+      case 4:
+        if (0 == memcmp(k, "date", 4)) return 0;
+        if (0 == memcmp(k, "etag", 4)) return 0;
+        break;
+      case 7:
+        if (0 == memcmp(k, "expires", 7)) return 0;
+        break;
+      case 8:
+        if (0 == memcmp(k, "location", 8)) return 0;
+        break;
+      case 10:
+        if (0 == memcmp(k, "set-cookie", 10)) return 2;
+        break;
+      case 13:
+        if (0 == memcmp(k, "content-range", 13)) return 0;
+        if (0 == memcmp(k, "last-modified", 13)) return 0;
+        break;
+      case 14:
+        if (0 == memcmp(k, "content-length", 14)) return 0;
+        break;
+      default:
+        break;
+    }
+    return 1;
+}
+
+
+void hpack_encode_header (hpack_table * const restrict t, buffer * const restrict b, const char * const restrict k, const uint32_t klen, const char * const restrict v, const uint32_t vlen)
+{
+    const int indexing = hpack_header_indexing(k, klen);
+    uint32_t ndx = hpack_static_name(k, klen);
+
+    if (1 == indexing) {
+        /* search dynamic table for matching entry (or matching name) */
+        for (uint32_t i = 0; i < t->used; ++i) {
+            const struct hpack_entry * const e = hpack_table_get(t, i);
+            if (e->klen != klen || 0 != memcmp(e->s, k, klen)) continue;
+            if (e->vlen == vlen && 0 == memcmp(e->s+klen+1, v, vlen)) {
+                hpack_encode_int(b, 0x80, 7, HPACK_STATIC_ENTRIES + 1 + i);
+                return;
+            }
+            if (0 == ndx) ndx = HPACK_STATIC_ENTRIES + 1 + i;
+        }
+        if (klen + vlen + 32 <= t->max_size) {
+            hpack_encode_int(b, 0x40, 6, ndx);
+            if (0 == ndx) hpack_encode_str(b, k, klen);
+            hpack_encode_str(b, v, vlen);
+            hpack_table_insert(t, k, klen, v, vlen);
+            return;
+        }
+    }
+
+    hpack_encode_int(b, 2 == indexing ? 0x10 : 0x00, 4, ndx);
+    if (0 == ndx) hpack_encode_str(b, k, klen);
+    hpack_encode_str(b, v, vlen);
+}
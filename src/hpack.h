@@ -0,0 +1,48 @@
+#ifndef INCLUDED_HPACK_H
+#define INCLUDED_HPACK_H
+#include "first.h"
+
+#include "buffer.h"
+
+/* HPACK: Header Compression for HTTP/2 (RFC 7541) */
+
+/* SETTINGS_HEADER_TABLE_SIZE default (and the maximum used by lighttpd) */
+#define HPACK_TABLE_SIZE_DEFAULT 4096
+/* each entry occupies at least 32 octets of table size */
+#define HPACK_TABLE_ENTRIES_MAX (HPACK_TABLE_SIZE_DEFAULT/32)
+
+struct hpack_entry;     /* declaration */
+
+typedef struct hpack_table {
+    struct hpack_entry *e[HPACK_TABLE_ENTRIES_MAX]; /* ring; newest at head */
+    uint32_t head;          /* ring index of most recently inserted entry */
+    uint32_t used;          /* number of entries in table */
+    uint32_t size;          /* sum of entry sizes (RFC 7541 4.1) */
+    uint32_t max_size;      /* current maximum table size */
+    uint32_t max_size_limit;/* upper bound on max_size (SETTINGS) */
+    uint32_t size_update;   /* (encoder) table size update to be signalled */
+} hpack_table;
+
+void hpack_table_init (hpack_table *t, uint32_t max_size_limit);
+void hpack_table_free (hpack_table *t);
+
+/* (encoder) peer sent SETTINGS_HEADER_TABLE_SIZE */
+void hpack_table_set_max_size (hpack_table *t, uint32_t sz);
+
+typedef int (*hpack_header_fn)(void *ctx, const char *k, uint32_t klen, const char *v, uint32_t vlen);
+
+/* decode header block; call fn for each header field decoded
+ * (k and v are '\0'-terminated and valid only for duration of call)
+ * return 0 on success, -1 on decoding error (COMPRESSION_ERROR),
+ * or else the non-zero value returned by fn (decoding is then aborted) */
+int hpack_decode (hpack_table * restrict t, const unsigned char *s, uint32_t len, hpack_header_fn fn, void *ctx, buffer * restrict kb, buffer * restrict vb);
+
+/* start new header block (emits pending dynamic table size update, if any) */
+void hpack_encode_begin (hpack_table * restrict t, buffer * restrict b);
+
+void hpack_encode_status (hpack_table * restrict t, buffer * restrict b, int status);
+
+/* (k must be lowercase) */
+void hpack_encode_header (hpack_table * restrict t, buffer * restrict b, const char * restrict k, uint32_t klen, const char * restrict v, uint32_t vlen);
+
+#endif
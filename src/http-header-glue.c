@@ -44,8 +44,8 @@ static int http_response_buffer_append_authority(request_st * const r, buffer *
 
 		if (our_addr.plain.sa_family == AF_INET
 		    && our_addr.ipv4.sin_addr.s_addr == htonl(INADDR_LOOPBACK)) {
-			static char lhost[32];
-			static size_t lhost_len = 0;
+			static __thread_local char lhost[32];
+			static __thread_local size_t lhost_len = 0;
 			if (0 != lhost_len) {
 				buffer_append_string_len(o, lhost, lhost_len);
 			}
@@ -122,8 +122,8 @@ struct mtime_cache_type {
     time_t mtime;  /* key */
     buffer str;    /* buffer for string representation */
 };
-static struct mtime_cache_type mtime_cache[MTIME_CACHE_MAX];
-static char mtime_cache_str[MTIME_CACHE_MAX][30];
+static __thread_local struct mtime_cache_type mtime_cache[MTIME_CACHE_MAX];
+static __thread_local char mtime_cache_str[MTIME_CACHE_MAX][30];
 /* 30-chars for "%a, %d %b %Y %H:%M:%S GMT" */
 
 void strftime_cache_reset(void) {
@@ -136,7 +136,7 @@ void strftime_cache_reset(void) {
 }
 
 const buffer * strftime_cache_get(const time_t last_mod) {
-    static int mtime_cache_idx;
+    static __thread_local int mtime_cache_idx;
 
     for (int j = 0; j < MTIME_CACHE_MAX; ++j) {
         if (mtime_cache[j].mtime == last_mod)
@@ -235,12 +235,12 @@ int http_response_handle_cachable(request_st * const r, const buffer * const mti
 
 void http_response_body_clear (request_st * const r, int preserve_length) {
     r->resp_send_chunked = 0;
-    if (r->resp_htags & HTTP_HEADER_TRANSFER_ENCODING) {
+    if (light_btst(r->resp_htags, HTTP_HEADER_TRANSFER_ENCODING)) {
         http_header_response_unset(r, HTTP_HEADER_TRANSFER_ENCODING, CONST_STR_LEN("Transfer-Encoding"));
     }
     if (!preserve_length) { /* preserve for HEAD responses and no-content responses (204, 205, 304) */
         r->content_length = -1;
-        if (r->resp_htags & HTTP_HEADER_CONTENT_LENGTH) {
+        if (light_btst(r->resp_htags, HTTP_HEADER_CONTENT_LENGTH)) {
             http_header_response_unset(r, HTTP_HEADER_CONTENT_LENGTH, CONST_STR_LEN("Content-Length"));
         }
         /*(if not preserving Content-Length, do not preserve trailers, if any)*/
@@ -440,7 +440,7 @@ static int http_response_parse_range(request_st * const r, buffer * const path,
 		buffer_append_string_len(tb, CONST_STR_LEN("/"));
 		buffer_append_int(tb, sce->st.st_size);
 
-		http_header_response_set(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Content-Range"), CONST_BUF_LEN(tb));
+		http_header_response_set(r, HTTP_HEADER_CONTENT_RANGE, CONST_STR_LEN("Content-Range"), CONST_BUF_LEN(tb));
 	}
 
 	/* ok, the file is set-up */
@@ -484,12 +484,15 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 		return;
 	}
 
-	/*(Note: O_NOFOLLOW affects only the final path segment,
-	 * the target file, not any intermediate symlinks along path)*/
-	const int fd = (0 != sce->st.st_size)
-	  ? fdevent_open_cloexec(path->ptr, r->conf.follow_symlink, O_RDONLY, 0)
+	/*(contents of small file might be cached in sce, else
+	 * fd might be cached in sce (fd == sce->fd); do not close() it then)*/
+	const buffer * const content = (0 != sce->st.st_size)
+	  ? stat_cache_entry_content(sce, r->conf.follow_symlink)
+	  : NULL;
+	const int fd = (0 != sce->st.st_size && NULL == content)
+	  ? stat_cache_entry_open(sce, r->conf.follow_symlink)
 	  : -1;
-	if (fd < 0 && 0 != sce->st.st_size) {
+	if (fd < 0 && 0 != sce->st.st_size && NULL == content) {
 		r->http_status = (errno == ENOENT) ? 404 : 403;
 		if (r->conf.log_request_handling) {
 			log_perror(r->conf.errh, __FILE__, __LINE__,
@@ -518,7 +521,7 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 	}
 
 	if (r->conf.range_requests) {
-		http_header_response_append(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Accept-Ranges"), CONST_STR_LEN("bytes"));
+		http_header_response_append(r, HTTP_HEADER_ACCEPT_RANGES, CONST_STR_LEN("Accept-Ranges"), CONST_STR_LEN("bytes"));
 	}
 
 	if (allow_caching) {
@@ -541,12 +544,12 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 		}
 
 		if (HANDLER_FINISHED == http_response_handle_cachable(r, mtime)) {
-			if (fd >= 0) close(fd);
+			if (fd >= 0 && fd != sce->fd) close(fd);
 			return;
 		}
 	}
 
-	if (fd < 0) { /* 0-length file */
+	if (fd < 0 && NULL == content) { /* 0-length file */
 		r->http_status = 200;
 		r->resp_body_finished = 1;
 		return;
@@ -560,7 +563,7 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 		int do_range_request = 1;
 		/* check if we have a conditional GET */
 
-		if (NULL != (vb = http_header_request_get(r, HTTP_HEADER_OTHER, CONST_STR_LEN("If-Range")))) {
+		if (NULL != (vb = http_header_request_get(r, HTTP_HEADER_IF_RANGE, CONST_STR_LEN("If-Range")))) {
 			/* if the value is the same as our ETag, we do a Range-request,
 			 * otherwise a full 200 */
 
@@ -593,7 +596,7 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 			if (0 == http_response_parse_range(r, path, sce, range->ptr+6)) {
 				r->http_status = 206;
 			}
-			close(fd);
+			if (fd >= 0 && fd != sce->fd) close(fd);
 			return;
 		}
 	}
@@ -604,7 +607,11 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 	 * the HEAD request will drop it afterwards again
 	 */
 
-	if (0 == http_chunk_append_file_fd(r, path, fd, sce->st.st_size)) {
+	if (0 == (NULL != content
+	          ? http_chunk_append_file_content_ref(r, sce)
+	          : fd == sce->fd
+	          ? http_chunk_append_file_ref(r, sce)
+	          : http_chunk_append_file_fd(r, path, fd, sce->st.st_size))) {
 		r->http_status = 200;
 		r->resp_body_finished = 1;
 	}
@@ -622,7 +629,7 @@ static void http_response_xsendfile (request_st * const r, buffer * const path,
 	 * Content-Length might later be set to size of X-Sendfile static file,
 	 * determined by open(), fstat() to reduces race conditions if the file
 	 * is modified between stat() (stat_cache_get_entry()) and open(). */
-	if (r->resp_htags & HTTP_HEADER_CONTENT_LENGTH) {
+	if (light_btst(r->resp_htags, HTTP_HEADER_CONTENT_LENGTH)) {
 		http_header_response_unset(r, HTTP_HEADER_CONTENT_LENGTH, CONST_STR_LEN("Content-Length"));
 		r->content_length = -1;
 	}
@@ -682,7 +689,7 @@ static void http_response_xsendfile2(request_st * const r, const buffer * const
     const int status = r->http_status;
 
     /* reset Content-Length, if set by backend */
-    if (r->resp_htags & HTTP_HEADER_CONTENT_LENGTH) {
+    if (light_btst(r->resp_htags, HTTP_HEADER_CONTENT_LENGTH)) {
         http_header_response_unset(r, HTTP_HEADER_CONTENT_LENGTH, CONST_STR_LEN("Content-Length"));
         r->content_length = -1;
     }
@@ -897,7 +904,7 @@ static handler_t http_response_process_local_redir(request_st * const r, size_t
                 && vb->ptr[ulen] != '/'
                 && vb->ptr[ulen] != '?'))
         && 0 == blen
-        && !(r->resp_htags & HTTP_HEADER_STATUS) /*no "Status" or NPH response*/
+        && !light_btst(r->resp_htags, HTTP_HEADER_STATUS) /*no "Status" or NPH response*/
         && 1 == r->resp_headers.used) {
         if (++r->loops_per_request > 5) {
             log_error(r->conf.errh, __FILE__, __LINE__,
@@ -958,7 +965,7 @@ static int http_response_process_headers(request_st * const r, http_response_opt
                 int status = http_header_str_to_code(s+9);
                 if (status >= 100 && status < 1000) {
                     status_is_set = 1;
-                    r->resp_htags |= HTTP_HEADER_STATUS;
+                    light_bset(r->resp_htags, HTTP_HEADER_STATUS);
                     r->http_status = status;
                 } /* else we expected 3 digits and didn't get them */
             }
@@ -1057,7 +1064,7 @@ static int http_response_process_headers(request_st * const r, http_response_opt
 
     /* CGI/1.1 rev 03 - 7.2.1.2 */
     /* (proxy requires Status-Line, so never true for proxy)*/
-    if (!status_is_set && (r->resp_htags & HTTP_HEADER_LOCATION)) {
+    if (!status_is_set && light_btst(r->resp_htags, HTTP_HEADER_LOCATION)) {
         r->http_status = 302;
     }
 
@@ -1179,7 +1186,7 @@ handler_t http_response_parse_headers(request_st * const r, http_response_opts *
     }
 
     if (opts->local_redir && r->http_status >= 300 && r->http_status < 400){
-        /*(r->resp_htags & HTTP_HEADER_LOCATION)*/
+        /*light_btst(r->resp_htags, HTTP_HEADER_LOCATION)*/
         handler_t rc = http_response_process_local_redir(r, blen);
         if (NULL == r->handler_module)
             r->resp_body_started = 0;
@@ -1219,8 +1226,35 @@ handler_t http_response_parse_headers(request_st * const r, http_response_opts *
 }
 
 
+#ifdef HAVE_SPLICE
+
+__attribute_pure__
+static int http_response_splice_ok(const request_st * const r, const http_response_opts * const opts, const buffer * const b) {
+    /* splice() response body from backend socket to client socket through
+     * pipe (avoiding copy into and out of userspace) only if response body
+     * is passed through unmodified: response headers already sent (so no
+     * response filters, e.g. mod_deflate) or no HTTP processing at all
+     * (r->http_status < 0, e.g. mod_sockproxy), no chunked decoding or
+     * encoding, and client connection is HTTP/1.x without TLS */
+    return r->resp_body_started
+        && (0 != r->resp_header_len || r->http_status < 0)
+        && NULL == opts->parse
+        && S_IFSOCK == opts->fdfmt
+        && buffer_string_is_empty(b)
+        && r->http_version <= HTTP_VERSION_1_1
+        && !r->con->is_ssl_sock
+        && (r->resp_decode_chunked
+            ? r->resp_send_chunked && !r->gw_dechunk->decode
+            : !r->resp_send_chunked);
+}
+
+#endif
+
 handler_t http_response_read(request_st * const r, http_response_opts * const opts, buffer * const b, fdnode * const fdn) {
     const int fd = fdn->fd;
+  #ifdef HAVE_SPLICE
+    const int use_splice = http_response_splice_ok(r, opts, b);
+  #endif
     while (1) {
         ssize_t n;
         size_t avail = buffer_string_space(b);
@@ -1275,6 +1309,44 @@ handler_t http_response_read(request_st * const r, http_response_opts * const op
             }
         }
 
+      #ifdef HAVE_SPLICE
+        if (use_splice && toread) {
+            n = chunkqueue_append_splice_sock(r->write_queue, fd, toread,
+                                              r->conf.errh);
+            if (n > 0) {
+                if (r->conf.stream_response_body
+                    & FDEVENT_STREAM_RESPONSE_BUFMIN) {
+                    if (chunkqueue_length(r->write_queue) > 65536 - 4096) {
+                        if (!r->con->is_writable)
+                            fdevent_fdnode_event_clr(r->con->srv->ev, fdn,
+                                                     FDEVENT_IN);
+                        break;
+                    }
+                }
+                if ((size_t)n < toread)
+                    break; /* emptied kernel read buffer or partial read */
+                continue;
+            }
+            else if (n < 0 && n != -2) {
+                switch (errno) {
+                  case EAGAIN:
+                 #ifdef EWOULDBLOCK
+                 #if EWOULDBLOCK != EAGAIN
+                  case EWOULDBLOCK:
+                 #endif
+                 #endif
+                  case EINTR:
+                    return HANDLER_GO_ON;
+                  default:
+                    log_perror(r->conf.errh, __FILE__, __LINE__,
+                      "splice() %d %d", r->con->fd, fd);
+                    return HANDLER_ERROR;
+                }
+            }
+            /* else (0 == n) (EOF) or (-2 == n) read() below */
+        }
+      #endif
+
         if (avail < toread) {
             /*(add avail+toread to reduce allocations when ioctl EOPNOTSUPP)*/
             avail = avail ? avail - 1 + toread : toread;
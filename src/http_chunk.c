@@ -76,7 +76,8 @@ static int http_chunk_append_read_fd_range(request_st * const r, const buffer *
     if (r->resp_send_chunked)
         http_chunk_len_append(cq, (uintmax_t)len);
 
-    if (0 != offset && -1 == lseek(fd, offset, SEEK_SET)) return -1;
+    /*(fd offset might not be 0, e.g. file just written)*/
+    if (-1 == lseek(fd, offset, SEEK_SET)) return -1;
     buffer * const b = chunkqueue_append_buffer_open_sz(cq, len+2);
     ssize_t rd;
     offset = 0;
@@ -145,6 +146,39 @@ int http_chunk_append_file_fd(request_st * const r, const buffer * const fn, con
     return rc;
 }
 
+int http_chunk_append_file_ref(request_st * const r, stat_cache_entry * const sce) {
+    /* send file using fd cached in sce (not closed here) */
+    const off_t sz = sce->st.st_size;
+    if (0 == sz) return 0;
+    chunkqueue * const cq = r->write_queue;
+
+    if (r->resp_send_chunked)
+        http_chunk_len_append(cq, (uintmax_t)sz);
+
+    chunkqueue_append_file_fd_ref(cq, &sce->name, sce->fd, 0, sz,
+                                  sce, stat_cache_entry_refchg);
+
+    if (r->resp_send_chunked)
+        chunkqueue_append_mem(cq, CONST_STR_LEN("\r\n"));
+
+    return 0;
+}
+
+int http_chunk_append_file_content_ref(request_st * const r, stat_cache_entry * const sce) {
+    /* send file contents cached in sce (shared; not copied) */
+    chunkqueue * const cq = r->write_queue;
+
+    if (r->resp_send_chunked)
+        http_chunk_len_append(cq, (uintmax_t)buffer_string_length(sce->content));
+
+    chunkqueue_append_mem_ref(cq, sce->content, sce, stat_cache_entry_refchg);
+
+    if (r->resp_send_chunked)
+        chunkqueue_append_mem(cq, CONST_STR_LEN("\r\n"));
+
+    return 0;
+}
+
 static int http_chunk_append_to_tempfile(request_st * const r, const char * const mem, const size_t len) {
     chunkqueue * const cq = r->write_queue;
     log_error_st * const errh = r->conf.errh;
@@ -437,8 +471,10 @@ int http_chunk_decode_append_buffer(request_st * const r, buffer * const mem)
      * chunk of chunked encoding from backend.  If we were, we could consider
      * closing HTTP/1.0 and HTTP/1.1 connections (no keep-alive), and in HTTP/2
      * we could consider sending RST_STREAM error.  http_chunk_close() would
-     * only handle case of streaming chunked to client */
-    if (r->resp_send_chunked) {
+     * only handle case of streaming chunked to client
+     * (r->gw_dechunk->decode is set if caller needs to find end of response,
+     *  e.g. to reuse backend connection) */
+    if (r->resp_send_chunked && !r->gw_dechunk->decode) {
         r->resp_send_chunked = 0;
         int rc = http_chunk_append_buffer(r, mem); /* might append to tmpfile */
         r->resp_send_chunked = 1;
@@ -465,7 +501,7 @@ int http_chunk_decode_append_mem(request_st * const r, const char * const mem, c
      * closing HTTP/1.0 and HTTP/1.1 connections (no keep-alive), and in HTTP/2
      * we could consider sending RST_STREAM error.  http_chunk_close() would
      * only handle case of streaming chunked to client */
-    if (r->resp_send_chunked) {
+    if (r->resp_send_chunked && !r->gw_dechunk->decode) {
         r->resp_send_chunked = 0;
         int rc = http_chunk_append_mem(r, mem, len); /*might append to tmpfile*/
         r->resp_send_chunked = 1;
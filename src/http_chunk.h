@@ -13,6 +13,9 @@ int http_chunk_decode_append_buffer(request_st * const r, buffer * const mem); /
 int http_chunk_transfer_cqlen(request_st *r, chunkqueue *src, size_t len);
 int http_chunk_append_file(request_st *r, const buffer *fn); /* copies "fn" */
 int http_chunk_append_file_fd(request_st *r, const buffer *fn, int fd, off_t sz);
+struct stat_cache_entry;  /* declaration */
+int http_chunk_append_file_ref(request_st *r, struct stat_cache_entry *sce); /* sce->fd from stat_cache_entry_open() */
+int http_chunk_append_file_content_ref(request_st *r, struct stat_cache_entry *sce); /* sce->content from stat_cache_entry_content() */
 int http_chunk_append_file_range(request_st *r, const buffer *fn, off_t offset, off_t len); /* copies "fn" */
 void http_chunk_close(request_st *r);
 
@@ -18,57 +18,155 @@
 typedef struct keyvlenvalue {
     const int key;
     const uint32_t vlen;
-    const char value[24];
+    const char value[28];
 } keyvlenvalue;
 
-/* Note: must be sorted by length */
+/* Note: must be sorted by enum http_header_e value (http_headers[id]) */
 /* Note: must be kept in sync with http_header.h enum http_header_e */
-/* Note: must be kept in sync http_headers[] and http_headers_off[] */
-/* http_headers_off lists first offset at which string of specific len occur */
-int8_t http_headers_off[] = {
-  -1, -1, -1, -1, 0, 4, 5, 9, 10, 11, 12, -1, 15, 16, 20, 21, 23, 25
-};
+/* Note: must be kept in sync with http_headers_phash[] (regenerate with
+ *       t/test_http_header gen; t/test_http_header fails if out of sync) */
+/* Note: names are lowercase (compared with http_header_eq_lc()) */
 static const keyvlenvalue http_headers[] = {
-  { HTTP_HEADER_HOST,                 CONST_LEN_STR("Host") }
- ,{ HTTP_HEADER_DATE,                 CONST_LEN_STR("Date") }
- ,{ HTTP_HEADER_ETAG,                 CONST_LEN_STR("ETag") }
- ,{ HTTP_HEADER_VARY,                 CONST_LEN_STR("Vary") }
- ,{ HTTP_HEADER_RANGE,                CONST_LEN_STR("Range") }
- ,{ HTTP_HEADER_COOKIE,               CONST_LEN_STR("Cookie") }
- ,{ HTTP_HEADER_EXPECT,               CONST_LEN_STR("Expect") }
- ,{ HTTP_HEADER_STATUS,               CONST_LEN_STR("Status") }
- ,{ HTTP_HEADER_SERVER,               CONST_LEN_STR("Server") }
- ,{ HTTP_HEADER_UPGRADE,              CONST_LEN_STR("Upgrade") }
- ,{ HTTP_HEADER_LOCATION,             CONST_LEN_STR("Location") }
- ,{ HTTP_HEADER_FORWARDED,            CONST_LEN_STR("Forwarded") }
- ,{ HTTP_HEADER_CONNECTION,           CONST_LEN_STR("Connection") }
- ,{ HTTP_HEADER_SET_COOKIE,           CONST_LEN_STR("Set-Cookie") }
- ,{ HTTP_HEADER_USER_AGENT,           CONST_LEN_STR("User-Agent") }
- ,{ HTTP_HEADER_CONTENT_TYPE,         CONST_LEN_STR("Content-Type") }
- ,{ HTTP_HEADER_LAST_MODIFIED,        CONST_LEN_STR("Last-Modified") }
- ,{ HTTP_HEADER_AUTHORIZATION,        CONST_LEN_STR("Authorization") }
- ,{ HTTP_HEADER_IF_NONE_MATCH,        CONST_LEN_STR("If-None-Match") }
- ,{ HTTP_HEADER_CACHE_CONTROL,        CONST_LEN_STR("Cache-Control") }
- ,{ HTTP_HEADER_CONTENT_LENGTH,       CONST_LEN_STR("Content-Length") }
- ,{ HTTP_HEADER_ACCEPT_ENCODING,      CONST_LEN_STR("Accept-Encoding") }
- ,{ HTTP_HEADER_X_FORWARDED_FOR,      CONST_LEN_STR("X-Forwarded-For") }
- ,{ HTTP_HEADER_CONTENT_ENCODING,     CONST_LEN_STR("Content-Encoding") }
- ,{ HTTP_HEADER_CONTENT_LOCATION,     CONST_LEN_STR("Content-Location") }
- ,{ HTTP_HEADER_IF_MODIFIED_SINCE,    CONST_LEN_STR("If-Modified-Since") }
- ,{ HTTP_HEADER_TRANSFER_ENCODING,    CONST_LEN_STR("Transfer-Encoding") }
- ,{ HTTP_HEADER_X_FORWARDED_PROTO,    CONST_LEN_STR("X-Forwarded-Proto") }
- ,{ HTTP_HEADER_OTHER, 0, "" }
+  { HTTP_HEADER_OTHER,                     0, "" }
+ ,{ HTTP_HEADER_ACCEPT,                    CONST_LEN_STR("accept") }
+ ,{ HTTP_HEADER_ACCEPT_ENCODING,           CONST_LEN_STR("accept-encoding") }
+ ,{ HTTP_HEADER_ACCEPT_LANGUAGE,           CONST_LEN_STR("accept-language") }
+ ,{ HTTP_HEADER_ACCEPT_RANGES,             CONST_LEN_STR("accept-ranges") }
+ ,{ HTTP_HEADER_AUTHORIZATION,             CONST_LEN_STR("authorization") }
+ ,{ HTTP_HEADER_CACHE_CONTROL,             CONST_LEN_STR("cache-control") }
+ ,{ HTTP_HEADER_CONNECTION,                CONST_LEN_STR("connection") }
+ ,{ HTTP_HEADER_CONTENT_ENCODING,          CONST_LEN_STR("content-encoding") }
+ ,{ HTTP_HEADER_CONTENT_LENGTH,            CONST_LEN_STR("content-length") }
+ ,{ HTTP_HEADER_CONTENT_LOCATION,          CONST_LEN_STR("content-location") }
+ ,{ HTTP_HEADER_CONTENT_RANGE,             CONST_LEN_STR("content-range") }
+ ,{ HTTP_HEADER_CONTENT_TYPE,              CONST_LEN_STR("content-type") }
+ ,{ HTTP_HEADER_COOKIE,                    CONST_LEN_STR("cookie") }
+ ,{ HTTP_HEADER_DATE,                      CONST_LEN_STR("date") }
+ ,{ HTTP_HEADER_DNT,                       CONST_LEN_STR("dnt") }
+ ,{ HTTP_HEADER_ETAG,                      CONST_LEN_STR("etag") }
+ ,{ HTTP_HEADER_EXPECT,                    CONST_LEN_STR("expect") }
+ ,{ HTTP_HEADER_EXPIRES,                   CONST_LEN_STR("expires") }
+ ,{ HTTP_HEADER_FORWARDED,                 CONST_LEN_STR("forwarded") }
+ ,{ HTTP_HEADER_HOST,                      CONST_LEN_STR("host") }
+ ,{ HTTP_HEADER_IF_MATCH,                  CONST_LEN_STR("if-match") }
+ ,{ HTTP_HEADER_IF_MODIFIED_SINCE,         CONST_LEN_STR("if-modified-since") }
+ ,{ HTTP_HEADER_IF_NONE_MATCH,             CONST_LEN_STR("if-none-match") }
+ ,{ HTTP_HEADER_IF_RANGE,                  CONST_LEN_STR("if-range") }
+ ,{ HTTP_HEADER_IF_UNMODIFIED_SINCE,       CONST_LEN_STR("if-unmodified-since") }
+ ,{ HTTP_HEADER_LAST_MODIFIED,             CONST_LEN_STR("last-modified") }
+ ,{ HTTP_HEADER_LOCATION,                  CONST_LEN_STR("location") }
+ ,{ HTTP_HEADER_ORIGIN,                    CONST_LEN_STR("origin") }
+ ,{ HTTP_HEADER_PRAGMA,                    CONST_LEN_STR("pragma") }
+ ,{ HTTP_HEADER_RANGE,                     CONST_LEN_STR("range") }
+ ,{ HTTP_HEADER_REFERER,                   CONST_LEN_STR("referer") }
+ ,{ HTTP_HEADER_SEC_CH_UA,                 CONST_LEN_STR("sec-ch-ua") }
+ ,{ HTTP_HEADER_SEC_CH_UA_MOBILE,          CONST_LEN_STR("sec-ch-ua-mobile") }
+ ,{ HTTP_HEADER_SEC_CH_UA_PLATFORM,        CONST_LEN_STR("sec-ch-ua-platform") }
+ ,{ HTTP_HEADER_SEC_FETCH_DEST,            CONST_LEN_STR("sec-fetch-dest") }
+ ,{ HTTP_HEADER_SEC_FETCH_MODE,            CONST_LEN_STR("sec-fetch-mode") }
+ ,{ HTTP_HEADER_SEC_FETCH_SITE,            CONST_LEN_STR("sec-fetch-site") }
+ ,{ HTTP_HEADER_SEC_FETCH_USER,            CONST_LEN_STR("sec-fetch-user") }
+ ,{ HTTP_HEADER_SERVER,                    CONST_LEN_STR("server") }
+ ,{ HTTP_HEADER_SET_COOKIE,                CONST_LEN_STR("set-cookie") }
+ ,{ HTTP_HEADER_STATUS,                    CONST_LEN_STR("status") }
+ ,{ HTTP_HEADER_TRANSFER_ENCODING,         CONST_LEN_STR("transfer-encoding") }
+ ,{ HTTP_HEADER_UPGRADE,                   CONST_LEN_STR("upgrade") }
+ ,{ HTTP_HEADER_UPGRADE_INSECURE_REQUESTS, CONST_LEN_STR("upgrade-insecure-requests") }
+ ,{ HTTP_HEADER_USER_AGENT,                CONST_LEN_STR("user-agent") }
+ ,{ HTTP_HEADER_VARY,                      CONST_LEN_STR("vary") }
+ ,{ HTTP_HEADER_X_FORWARDED_FOR,           CONST_LEN_STR("x-forwarded-for") }
+ ,{ HTTP_HEADER_X_FORWARDED_PROTO,         CONST_LEN_STR("x-forwarded-proto") }
+};
+
+/* perfect hash of known header names: index into http_headers[]; 0 if none */
+#define HTTP_HEADERS_PHASH_MULT 0xdbd46d4bu
+#define HTTP_HEADERS_PHASH_BITS 7
+static const int8_t http_headers_phash[1u << HTTP_HEADERS_PHASH_BITS] = {
+   0, 41, 47,  0,  0,  0, 22,  0,  0,  0,  0, 25,  0,  0, 44, 48,
+   0, 45,  0,  0,  0,  7,  0, 29,  1, 11, 13,  0,  0,  0, 42,  0,
+   0,  0,  0, 43,  0,  0, 10, 36,  0,  0,  0, 26,  0,  0,  0, 23,
+   0, 34, 46,  0,  0,  0,  0,  0, 30,  0,  8,  0, 39,  0,  0,  0,
+   0,  0,  0,  3, 17,  5,  0,  0,  0,  0, 37,  0,  0, 14,  0,  0,
+   0, 38, 19,  0,  0,  0, 24,  0,  0, 31, 15,  2,  0, 28,  9,  0,
+   0, 27,  0,  0,  0,  0, 12, 20, 33,  0,  0,  0,  4,  0, 18,  6,
+  40, 32,  0,  0,  0,  0,  0, 21,  0,  0,  0, 16, 35,  0,  0,  0
 };
 
+__attribute_pure__
+static inline uint32_t http_header_phash (const char * const s, const uint32_t slen) {
+    /* (slen >= 2) first two and last two chars (lowercased) and length */
+    const unsigned char * const u = (const unsigned char *)s;
+    const uint32_t x = ((uint32_t)(u[0]      | 0x20) << 24)
+                     | ((uint32_t)(u[1]      | 0x20) << 16)
+                     | ((uint32_t)(u[slen-2] | 0x20) <<  8)
+                     | ((uint32_t)(u[slen-1] | 0x20));
+    return ((x ^ (slen << 5)) * HTTP_HEADERS_PHASH_MULT)
+           >> (32 - HTTP_HEADERS_PHASH_BITS);
+}
+
+__attribute_pure__
+static inline uint64_t http_header_ld8 (const char * const s) {
+    uint64_t w;
+    memcpy(&w, s, 8); /*(compiles to a single unaligned load)*/
+    return w;
+}
+
+__attribute_pure__
+static inline uint64_t http_header_ld4 (const char * const s) {
+    uint32_t w;
+    memcpy(&w, s, 4); /*(compiles to a single unaligned load)*/
+    return w;
+}
+
+__attribute_pure__
+static inline uint64_t http_header_ld2 (const char * const s) {
+    uint16_t w;
+    memcpy(&w, s, 2); /*(compiles to a single unaligned load)*/
+    return w;
+}
+
+__attribute_const__
+static inline uint64_t http_header_tolower8 (const uint64_t w) {
+    /* ASCII tolower() of 8 bytes at once (SWAR); bytes >= 0x80 unchanged */
+    const uint64_t hi = 0x8080808080808080uLL;
+    const uint64_t h7 = w & ~hi;
+    const uint64_t ge_A = h7 + 0x3f3f3f3f3f3f3f3fuLL; /* 0x80 - 'A' */
+    const uint64_t gt_Z = h7 + 0x2525252525252525uLL; /* 0x80 - 'Z' - 1 */
+    return w | (((ge_A & ~gt_Z) & ~w & hi) >> 2);
+}
+
+__attribute_pure__
+static inline int http_header_eq_lc (const char * const s, const char * const lc, const uint32_t len) {
+    /* (len >= 2) compare s, case-insensitively, to lowercase lc
+     * using (possibly overlapping) word loads; no reads past s[len-1] */
+    if (len >= 8) {
+        for (uint32_t i = 0; i + 8 < len; i += 8) {
+            if (http_header_tolower8(http_header_ld8(s+i))
+                != http_header_ld8(lc+i))
+                return 0;
+        }
+        return http_header_tolower8(http_header_ld8(s+len-8))
+            == http_header_ld8(lc+len-8);
+    }
+    else if (len >= 4)
+        return (http_header_tolower8(http_header_ld4(s))
+                == http_header_ld4(lc))
+             & (http_header_tolower8(http_header_ld4(s+len-4))
+                == http_header_ld4(lc+len-4));
+    else
+        return (http_header_tolower8(http_header_ld2(s))
+                == http_header_ld2(lc))
+             & (http_header_tolower8(http_header_ld2(s+len-2))
+                == http_header_ld2(lc+len-2));
+}
+
 enum http_header_e http_header_hkey_get(const char * const s, const uint32_t slen) {
-    const struct keyvlenvalue * const kv = http_headers;
-    int i = slen < sizeof(http_headers_off) ? http_headers_off[slen] : -1;
-    if (i < 0) return HTTP_HEADER_OTHER;
-    do {
-        if (buffer_eq_icase_ssn(s, kv[i].value, slen))
-            return (enum http_header_e)kv[i].key;
-    } while (slen == kv[++i].vlen);
-    return HTTP_HEADER_OTHER;
+    if (slen < 2) return HTTP_HEADER_OTHER;
+    const keyvlenvalue * const kv =
+      http_headers + http_headers_phash[http_header_phash(s, slen)];
+    return (kv->vlen == slen && http_header_eq_lc(s, kv->value, slen))
+      ? (enum http_header_e)kv->key
+      : HTTP_HEADER_OTHER;
 }
 
 
@@ -145,14 +243,14 @@ static inline buffer * http_header_generic_get_ifnotempty(const array * const a,
 
 
 buffer * http_header_response_get(const request_st * const r, enum http_header_e id, const char *k, uint32_t klen) {
-    return (id <= HTTP_HEADER_OTHER || (r->resp_htags & id))
+    return (id <= HTTP_HEADER_OTHER || light_btst(r->resp_htags, id))
       ? http_header_generic_get_ifnotempty(&r->resp_headers, k, klen)
       : NULL;
 }
 
 void http_header_response_unset(request_st * const r, enum http_header_e id, const char *k, uint32_t klen) {
-    if (id <= HTTP_HEADER_OTHER || (r->resp_htags & id)) {
-        if (id > HTTP_HEADER_OTHER) r->resp_htags &= ~id;
+    if (id <= HTTP_HEADER_OTHER || light_btst(r->resp_htags, id)) {
+        if (id > HTTP_HEADER_OTHER) light_bclr(r->resp_htags, id);
         array_set_key_value(&r->resp_headers, k, klen, CONST_STR_LEN(""));
     }
 }
@@ -163,20 +261,20 @@ void http_header_response_set(request_st * const r, enum http_header_e id, const
      *  which is used to indicate a "removed" header)
      */
     if (id > HTTP_HEADER_OTHER)
-        (vlen) ? (r->resp_htags |= id) : (r->resp_htags &= ~id);
+        (vlen) ? light_bset(r->resp_htags, id) : light_bclr(r->resp_htags, id);
     array_set_key_value(&r->resp_headers, k, klen, v, vlen);
 }
 
 void http_header_response_append(request_st * const r, enum http_header_e id, const char *k, uint32_t klen, const char *v, uint32_t vlen) {
     if (0 == vlen) return;
-    if (id > HTTP_HEADER_OTHER) r->resp_htags |= id;
+    if (id > HTTP_HEADER_OTHER) light_bset(r->resp_htags, id);
     buffer * const vb = array_get_buf_ptr(&r->resp_headers, k, klen);
     http_header_token_append(vb, v, vlen);
 }
 
 void http_header_response_insert(request_st * const r, enum http_header_e id, const char *k, uint32_t klen, const char *v, uint32_t vlen) {
     if (0 == vlen) return;
-    if (id > HTTP_HEADER_OTHER) r->resp_htags |= id;
+    if (id > HTTP_HEADER_OTHER) light_bset(r->resp_htags, id);
     buffer * const vb = array_get_buf_ptr(&r->resp_headers, k, klen);
     if (!buffer_string_is_empty(vb)) { /* append value */
         buffer_append_string_len(vb, CONST_STR_LEN("\r\n"));
@@ -188,14 +286,14 @@ void http_header_response_insert(request_st * const r, enum http_header_e id, co
 
 
 buffer * http_header_request_get(const request_st * const r, enum http_header_e id, const char *k, uint32_t klen) {
-    return (id <= HTTP_HEADER_OTHER || (r->rqst_htags & id))
+    return (id <= HTTP_HEADER_OTHER || light_btst(r->rqst_htags, id))
       ? http_header_generic_get_ifnotempty(&r->rqst_headers, k, klen)
       : NULL;
 }
 
 void http_header_request_unset(request_st * const r, enum http_header_e id, const char *k, uint32_t klen) {
-    if (id <= HTTP_HEADER_OTHER || (r->rqst_htags & id)) {
-        if (id > HTTP_HEADER_OTHER) r->rqst_htags &= ~id;
+    if (id <= HTTP_HEADER_OTHER || light_btst(r->rqst_htags, id)) {
+        if (id > HTTP_HEADER_OTHER) light_bclr(r->rqst_htags, id);
         array_set_key_value(&r->rqst_headers, k, klen, CONST_STR_LEN(""));
     }
 }
@@ -206,13 +304,13 @@ void http_header_request_set(request_st * const r, enum http_header_e id, const
      *  which is used to indicate a "removed" header)
      */
     if (id > HTTP_HEADER_OTHER)
-        (vlen) ? (r->rqst_htags |= id) : (r->rqst_htags &= ~id);
+        (vlen) ? light_bset(r->rqst_htags, id) : light_bclr(r->rqst_htags, id);
     array_set_key_value(&r->rqst_headers, k, klen, v, vlen);
 }
 
 void http_header_request_append(request_st * const r, enum http_header_e id, const char *k, uint32_t klen, const char *v, uint32_t vlen) {
     if (0 == vlen) return;
-    if (id > HTTP_HEADER_OTHER) r->rqst_htags |= id;
+    if (id > HTTP_HEADER_OTHER) light_bset(r->rqst_htags, id);
     buffer * const vb = array_get_buf_ptr(&r->rqst_headers, k, klen);
     http_header_token_append(vb, v, vlen);
 }
@@ -7,37 +7,59 @@
 
 /* Note: must be kept in sync with http_header.c http_headers[] */
 /* Note: when adding new items, must replace OTHER in existing code for item */
+/* Note: values are bit positions in request_st rqst_htags and resp_htags
+ *       (uint64_t; see light_btst()), so must not exceed 63 */
 enum http_header_e {
-  HTTP_HEADER_UNSPECIFIED       = -1
- ,HTTP_HEADER_OTHER             = 0x00000000
- ,HTTP_HEADER_ACCEPT_ENCODING   = 0x00000001
- ,HTTP_HEADER_AUTHORIZATION     = 0x00000002
- ,HTTP_HEADER_CACHE_CONTROL     = 0x00000004
- ,HTTP_HEADER_CONNECTION        = 0x00000008
- ,HTTP_HEADER_CONTENT_ENCODING  = 0x00000010
- ,HTTP_HEADER_CONTENT_LENGTH    = 0x00000020
- ,HTTP_HEADER_CONTENT_LOCATION  = 0x00000040
- ,HTTP_HEADER_CONTENT_TYPE      = 0x00000080
- ,HTTP_HEADER_COOKIE            = 0x00000100
- ,HTTP_HEADER_DATE              = 0x00000200
- ,HTTP_HEADER_ETAG              = 0x00000400
- ,HTTP_HEADER_EXPECT            = 0x00000800
- ,HTTP_HEADER_FORWARDED         = 0x00001000
- ,HTTP_HEADER_HOST              = 0x00002000
- ,HTTP_HEADER_IF_MODIFIED_SINCE = 0x00004000
- ,HTTP_HEADER_IF_NONE_MATCH     = 0x00008000
- ,HTTP_HEADER_LAST_MODIFIED     = 0x00010000
- ,HTTP_HEADER_LOCATION          = 0x00020000
- ,HTTP_HEADER_RANGE             = 0x00040000
- ,HTTP_HEADER_SERVER            = 0x00080000
- ,HTTP_HEADER_SET_COOKIE        = 0x00100000
- ,HTTP_HEADER_STATUS            = 0x00200000
- ,HTTP_HEADER_TRANSFER_ENCODING = 0x00400000
- ,HTTP_HEADER_UPGRADE           = 0x00800000
- ,HTTP_HEADER_USER_AGENT        = 0x01000000
- ,HTTP_HEADER_VARY              = 0x02000000
- ,HTTP_HEADER_X_FORWARDED_FOR   = 0x04000000
- ,HTTP_HEADER_X_FORWARDED_PROTO = 0x08000000
+  HTTP_HEADER_UNSPECIFIED = -1
+ ,HTTP_HEADER_OTHER = 0
+ ,HTTP_HEADER_ACCEPT
+ ,HTTP_HEADER_ACCEPT_ENCODING
+ ,HTTP_HEADER_ACCEPT_LANGUAGE
+ ,HTTP_HEADER_ACCEPT_RANGES
+ ,HTTP_HEADER_AUTHORIZATION
+ ,HTTP_HEADER_CACHE_CONTROL
+ ,HTTP_HEADER_CONNECTION
+ ,HTTP_HEADER_CONTENT_ENCODING
+ ,HTTP_HEADER_CONTENT_LENGTH
+ ,HTTP_HEADER_CONTENT_LOCATION
+ ,HTTP_HEADER_CONTENT_RANGE
+ ,HTTP_HEADER_CONTENT_TYPE
+ ,HTTP_HEADER_COOKIE
+ ,HTTP_HEADER_DATE
+ ,HTTP_HEADER_DNT
+ ,HTTP_HEADER_ETAG
+ ,HTTP_HEADER_EXPECT
+ ,HTTP_HEADER_EXPIRES
+ ,HTTP_HEADER_FORWARDED
+ ,HTTP_HEADER_HOST
+ ,HTTP_HEADER_IF_MATCH
+ ,HTTP_HEADER_IF_MODIFIED_SINCE
+ ,HTTP_HEADER_IF_NONE_MATCH
+ ,HTTP_HEADER_IF_RANGE
+ ,HTTP_HEADER_IF_UNMODIFIED_SINCE
+ ,HTTP_HEADER_LAST_MODIFIED
+ ,HTTP_HEADER_LOCATION
+ ,HTTP_HEADER_ORIGIN
+ ,HTTP_HEADER_PRAGMA
+ ,HTTP_HEADER_RANGE
+ ,HTTP_HEADER_REFERER
+ ,HTTP_HEADER_SEC_CH_UA
+ ,HTTP_HEADER_SEC_CH_UA_MOBILE
+ ,HTTP_HEADER_SEC_CH_UA_PLATFORM
+ ,HTTP_HEADER_SEC_FETCH_DEST
+ ,HTTP_HEADER_SEC_FETCH_MODE
+ ,HTTP_HEADER_SEC_FETCH_SITE
+ ,HTTP_HEADER_SEC_FETCH_USER
+ ,HTTP_HEADER_SERVER
+ ,HTTP_HEADER_SET_COOKIE
+ ,HTTP_HEADER_STATUS
+ ,HTTP_HEADER_TRANSFER_ENCODING
+ ,HTTP_HEADER_UPGRADE
+ ,HTTP_HEADER_UPGRADE_INSECURE_REQUESTS
+ ,HTTP_HEADER_USER_AGENT
+ ,HTTP_HEADER_VARY
+ ,HTTP_HEADER_X_FORWARDED_FOR
+ ,HTTP_HEADER_X_FORWARDED_PROTO
 };
 
 __attribute_pure__
@@ -19,6 +19,7 @@ typedef struct {
 } keyvalue;
 
 static const keyvalue http_versions[] = {
+	{ HTTP_VERSION_2,   CONST_LEN_STR("HTTP/2.0") },
 	{ HTTP_VERSION_1_1, CONST_LEN_STR("HTTP/1.1") },
 	{ HTTP_VERSION_1_0, CONST_LEN_STR("HTTP/1.0") },
 	{ HTTP_VERSION_UNSET, 0, NULL }
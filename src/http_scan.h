@@ -0,0 +1,28 @@
+#ifndef INCLUDED_HTTP_SCAN_H
+#define INCLUDED_HTTP_SCAN_H
+#include "first.h"
+
+/* vectorized scanning of HTTP/1.x request headers
+ *
+ * SSE2 (x86_64 baseline) kernels are used on x86_64, with a portable scalar
+ * fallback on other architectures.  AVX2 kernels are available, but only if
+ * explicitly selected with http_scan_select(2) and supported by the cpu.
+ * Kernels never read past the end of the buffer (len). */
+
+/* scan request header lines in n (up to clen), recording offset of each line
+ * (after '\n') in hoff[] (hoff[0] is number of lines); return length of
+ * request headers (through blank line) or 0 if end of headers not found
+ * (or if too many lines) */
+uint32_t http_scan_header_lines (const char *n, uint32_t clen, unsigned short hoff[8192]);
+
+/* return offset of first char in s not in [A-Za-z-] (or len if none) */
+uint32_t http_scan_token_alpha (const char *s, uint32_t len);
+
+/* return offset of first CTL (excluding HTAB) or DEL in s (or len if none) */
+uint32_t http_scan_field_value_ctl (const char *s, uint32_t len);
+
+/* (for tests and benchmarks) force scalar kernels (0), SSE2 (1), AVX2 (2);
+ * -1 restores default (SSE2 if available); return level selected */
+int http_scan_select (int level);
+
+#endif
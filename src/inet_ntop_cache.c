@@ -23,8 +23,8 @@ const char * inet_ntop_cache_get_ip(server *srv, sock_addr *addr) {
 		char b2[INET6_ADDRSTRLEN + 1];
 	} inet_ntop_cache_type;
 	#define INET_NTOP_CACHE_MAX 4
-	static inet_ntop_cache_type inet_ntop_cache[INET_NTOP_CACHE_MAX];
-	static int ndx;
+	static __thread_local inet_ntop_cache_type inet_ntop_cache[INET_NTOP_CACHE_MAX];
+	static __thread_local int ndx;
 
 	int i;
 	UNUSED(srv);
@@ -15,18 +15,206 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
 typedef struct pcre_keyvalue {
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+	pcre2_code *code;
+#elif defined(HAVE_PCRE_H)
 	pcre *key;
 	pcre_extra *key_extra;
 #endif
 	buffer value;
+	int next; /* next rule (in order) with same prefix in prefilter, or -1 */
 } pcre_keyvalue;
 
+#ifdef HAVE_PCRE
+
+/* prefilter: trie of literal prefixes required at start of input by rules,
+ * e.g. "/foo/" for "^/foo/(.*)$".  Walking input down the trie yields the
+ * (ordered) chains of rules which might match; all other rules are skipped
+ * without running the regex.  Rules without a required prefix are chained
+ * at the root, which is on every path.  Prefixes are truncated to
+ * PCRE_KEYVALUE_PREFIX_MAX chars, which also bounds the number of chains. */
+#define PCRE_KEYVALUE_PREFIX_MAX 64
+
+typedef struct pcre_keyvalue_node {
+	uint32_t child;   /* first child (0 if none; root is never a child) */
+	uint32_t sibling; /* next sibling (0 if none) */
+	int rule;         /* first rule with prefix ending at node, or -1 */
+	int last;         /* last rule with prefix ending at node, or -1 */
+	unsigned char c;
+} pcre_keyvalue_node;
+
+/* return 1 if pattern might contain top-level alternation
+ * (or is otherwise not understood well enough to rely on prefix) */
+static int pcre_keyvalue_alternation (const char * const s, const uint32_t len) {
+	int depth = 0;
+	for (uint32_t i = 0; i < len; ++i) {
+		switch (s[i]) {
+		  case '\\':
+			if (s[i+1] == 'Q') { /* \Q...\E quoted literal */
+				const char * const e = strstr(s+i+2, "\\E");
+				if (NULL == e) return 0;
+				i = (uint32_t)(e - s) + 1;
+			}
+			else
+				++i;
+			break;
+		  case '[': /* character class; (may end early, e.g. [[:alpha:]],
+			     * leaving remainder to be (conservatively) scanned) */
+			if (s[++i] == '^') ++i;
+			if (s[i] == ']') ++i;
+			for (; i < len && s[i] != ']'; ++i) {
+				if (s[i] == '\\') ++i;
+			}
+			break;
+		  case '(':
+			if (s[i+1] == '?') {
+				if (s[i+2] == '#') { /* (?#...) comment */
+					const char * const e = strchr(s+i+2, ')');
+					if (NULL == e) return 1;
+					i = (uint32_t)(e - s);
+					break;
+				}
+				/* (?x) extended syntax; '#' comments might contain ( ) | */
+				for (uint32_t j = i+2; s[j] != ')' && s[j] != ':'; ++j) {
+					if (s[j] == 'x') return 1;
+					if (!light_isalpha(s[j]) && s[j] != '-' && s[j] != '^')
+						break;
+				}
+			}
+			++depth;
+			break;
+		  case ')':
+			--depth;
+			break;
+		  case '|':
+			if (depth <= 0) return 1;
+			break;
+		  default:
+			break;
+		}
+	}
+	return 0;
+}
+
+/* copy (unescaped) literal prefix required at start of input by pattern
+ * into pfx and return prefix length; return 0 if pattern is not anchored
+ * at start of input or if prefix is empty */
+static uint32_t pcre_keyvalue_prefix (const buffer * const key, char * const pfx) {
+	const char * const s = key->ptr;
+	const uint32_t len = buffer_string_length(key);
+	uint32_t n = 0;
+	if (0 == len || s[0] != '^' || pcre_keyvalue_alternation(s, len))
+		return 0;
+	for (uint32_t i = 1; i < len && n < PCRE_KEYVALUE_PREFIX_MAX; ++i) {
+		int c = ((unsigned char *)s)[i];
+		if (c == '\\') {
+			/* escaped non-alphanumeric char is literal */
+			if (i+1 == len || light_isalnum(s[i+1])) break;
+			c = ((unsigned char *)s)[++i];
+		}
+		else if (NULL != strchr("^$.[|()?*+{", c)) /*(c == '\0' matches)*/
+			break;
+		/* char is optional if followed by quantifier ? * {n,m} (or {n}),
+		 * and followed by + is required, but repeated */
+		if (s[i+1] == '?' || s[i+1] == '*' || s[i+1] == '{') break;
+		pfx[n++] = (char)c;
+		if (s[i+1] == '+') break;
+	}
+	return n;
+}
+
+__attribute_cold__
+static void pcre_keyvalue_prefilter_insert (pcre_keyvalue_buffer * const kvb, const buffer * const key, const int ndx) {
+	char pfx[PCRE_KEYVALUE_PREFIX_MAX];
+	const uint32_t n = pcre_keyvalue_prefix(key, pfx);
+	uint32_t x = 0; /* root */
+
+	if (0 == kvb->nused) {
+		kvb->nodes = malloc(16 * sizeof(*kvb->nodes));
+		force_assert(NULL != kvb->nodes);
+		memset(kvb->nodes, 0, sizeof(*kvb->nodes));
+		kvb->nodes[0].rule = kvb->nodes[0].last = -1;
+		kvb->nused = 1;
+	}
+
+	for (uint32_t i = 0; i < n; ++i) {
+		const unsigned char c = (unsigned char)pfx[i];
+		uint32_t y = kvb->nodes[x].child;
+		while (y && kvb->nodes[y].c != c) y = kvb->nodes[y].sibling;
+		if (0 == y) {
+			if (0 == (kvb->nused & 15)) { /*(allocate in groups of 16)*/
+				kvb->nodes = realloc(kvb->nodes,
+				                     (kvb->nused + 16) * sizeof(*kvb->nodes));
+				force_assert(NULL != kvb->nodes);
+			}
+			y = kvb->nused++;
+			pcre_keyvalue_node * const node = kvb->nodes+y;
+			node->child = 0;
+			node->sibling = kvb->nodes[x].child;
+			node->rule = node->last = -1;
+			node->c = c;
+			kvb->nodes[x].child = y;
+		}
+		x = y;
+	}
+
+	/* rules are appended in order, so chain remains ordered */
+	pcre_keyvalue_node * const node = kvb->nodes+x;
+	kvb->kv[ndx].next = -1;
+	if (node->last >= 0)
+		kvb->kv[node->last].next = ndx;
+	else
+		node->rule = ndx;
+	node->last = ndx;
+}
+
+/* collect into h[] the heads of rule chains for all prefixes of input
+ * in trie; return number of chains */
+static int pcre_keyvalue_prefilter (const pcre_keyvalue_buffer * const kvb, const buffer * const input, int h[PCRE_KEYVALUE_PREFIX_MAX+1]) {
+	const pcre_keyvalue_node * const nodes = kvb->nodes;
+	const unsigned char * const s = (const unsigned char *)input->ptr;
+	const uint32_t len = buffer_string_length(input);
+	int nh = 0;
+	uint32_t x = 0; /* root */
+	for (uint32_t i = 0; ; ++i) {
+		if (nodes[x].rule >= 0) h[nh++] = nodes[x].rule;
+		if (i == len) break;
+		x = nodes[x].child;
+		while (x && nodes[x].c != s[i]) x = nodes[x].sibling;
+		if (0 == x) break;
+	}
+	return nh;
+}
+
+/* merge chains; return next candidate rule in rule order, or -1 if none */
+static int pcre_keyvalue_prefilter_next (const pcre_keyvalue_buffer * const kvb, int * const h, int * const nh) {
+	if (0 == *nh) return -1;
+	int j = 0;
+	for (int k = 1; k < *nh; ++k) {
+		if (h[k] < h[j]) j = k;
+	}
+	const int i = h[j];
+	if ((h[j] = kvb->kv[i].next) < 0)
+		h[j] = h[--*nh];
+	return i;
+}
+
+#endif /* HAVE_PCRE */
+
+#if defined(HAVE_PCRE2_H)
+typedef PCRE2_SIZE pcre_keyvalue_ovec_t;
+#elif defined(HAVE_PCRE_H)
+typedef int pcre_keyvalue_ovec_t;
+#endif
+
 pcre_keyvalue_buffer *pcre_keyvalue_buffer_init(void) {
 	pcre_keyvalue_buffer *kvb;
 
@@ -37,7 +225,35 @@ pcre_keyvalue_buffer *pcre_keyvalue_buffer_init(void) {
 }
 
 int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, const buffer *key, const buffer *value) {
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+	int errcode;
+	PCRE2_SIZE erroff;
+	pcre_keyvalue *kv;
+
+	if (0 == (kvb->used & 3)) { /*(allocate in groups of 4)*/
+		kvb->kv = realloc(kvb->kv, (kvb->used + 4) * sizeof(*kvb->kv));
+		force_assert(NULL != kvb->kv);
+	}
+
+	kv = kvb->kv + kvb->used++;
+
+        /* copy persistent config data, and elide free() in free_data below */
+	memcpy(&kv->value, value, sizeof(buffer));
+	/*buffer_copy_buffer(&kv->value, value);*/
+
+	if (NULL == (kv->code = pcre2_compile((PCRE2_SPTR)key->ptr,
+					      buffer_string_length(key),
+					      0, &errcode, &erroff, NULL))) {
+		PCRE2_UCHAR errbuf[256];
+		pcre2_get_error_message(errcode, errbuf, sizeof(errbuf));
+		log_error(errh, __FILE__, __LINE__,
+		  "rexexp compilation error at %s", (char *)errbuf);
+		return 0;
+	}
+
+	/* JIT compile; (on failure, pcre2_match() uses the interpreter) */
+	(void)pcre2_jit_compile(kv->code, PCRE2_JIT_COMPLETE);
+#elif defined(HAVE_PCRE_H)
 	const char *errptr;
 	int erroff;
 	pcre_keyvalue *kv;
@@ -62,10 +278,17 @@ int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, c
 		return 0;
 	}
 
-	if (NULL == (kv->key_extra = pcre_study(kv->key, 0, &errptr)) &&
+  #ifndef PCRE_STUDY_JIT_COMPILE
+  #define PCRE_STUDY_JIT_COMPILE 0
+  #endif
+	if (NULL == (kv->key_extra = pcre_study(kv->key, PCRE_STUDY_JIT_COMPILE,
+						&errptr)) &&
 			errptr != NULL) {
 		return 0;
 	}
+#endif
+#ifdef HAVE_PCRE
+	pcre_keyvalue_prefilter_insert(kvb, key, (int)(kvb->used - 1));
 #else
 	static int logged_message = 0;
 	if (logged_message) return 1;
@@ -81,23 +304,30 @@ int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, c
 }
 
 void pcre_keyvalue_buffer_free(pcre_keyvalue_buffer *kvb) {
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE
 	for (uint32_t i = 0; i < kvb->used; ++i) {
 		pcre_keyvalue * const kv = kvb->kv+i;
+	  #if defined(HAVE_PCRE2_H)
+		if (kv->code) pcre2_code_free(kv->code);
+	  #else
 		if (kv->key) pcre_free(kv->key);
-		if (kv->key_extra) pcre_free(kv->key_extra);
+		if (kv->key_extra) pcre_free_study(kv->key_extra);
+	  #endif
 		/*free (kv->value.ptr);*//*(see pcre_keyvalue_buffer_append)*/
 	}
 
 	if (kvb->kv) free(kvb->kv);
+	if (kvb->nodes) free(kvb->nodes);
 #endif
 	free(kvb);
 }
 
-#ifdef HAVE_PCRE_H
-static void pcre_keyvalue_buffer_append_match(buffer *b, const char **list, int n, unsigned int num, int flags) {
+#ifdef HAVE_PCRE
+static void pcre_keyvalue_buffer_append_match(buffer *b, const char *subject, const pcre_keyvalue_ovec_t *ovec, int n, unsigned int num, int flags) {
     if (num < (unsigned int)n) { /* n is always > 0 */
-        burl_append(b, list[num], strlen(list[num]), flags);
+        const pcre_keyvalue_ovec_t off = ovec[(num <<= 1)]; /*(num *= 2)*/
+        const size_t len = (size_t)(ovec[num+1] - off);
+        if (len) burl_append(b, subject + off, len, flags); /*(len 0 if unset)*/
     }
 }
 
@@ -111,7 +341,7 @@ static void pcre_keyvalue_buffer_append_ctxmatch(buffer *b, pcre_keyvalue_ctx *c
     }
 }
 
-static int pcre_keyvalue_buffer_subst_ext(buffer *b, const char *pattern, const char **list, int n, pcre_keyvalue_ctx *ctx) {
+static int pcre_keyvalue_buffer_subst_ext(buffer *b, const char *pattern, const char *subject, const pcre_keyvalue_ovec_t *ovec, int n, pcre_keyvalue_ctx *ctx) {
     const unsigned char *p = (unsigned char *)pattern+2;/* +2 past ${} or %{} */
     int flags = 0;
     while (!light_isdigit(*p) && *p != '}' && *p != '\0') {
@@ -243,13 +473,13 @@ static int pcre_keyvalue_buffer_subst_ext(buffer *b, const char *pattern, const
         }
         if (0 == flags) flags = BURL_ENCODE_PSNDE; /* default */
         pattern[0] == '$' /*(else '%')*/
-          ? pcre_keyvalue_buffer_append_match(b, list, n, num, flags)
+          ? pcre_keyvalue_buffer_append_match(b, subject, ovec, n, num, flags)
           : pcre_keyvalue_buffer_append_ctxmatch(b, ctx, num, flags);
     }
     return (int)(p + 1 - (unsigned char *)pattern - 2);
 }
 
-static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const char **list, int n, pcre_keyvalue_ctx *ctx) {
+static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const char *subject, const pcre_keyvalue_ovec_t *ovec, int n, pcre_keyvalue_ctx *ctx) {
 	const char *pattern = patternb->ptr;
 	const size_t pattern_len = buffer_string_length(patternb);
 	size_t start = 0;
@@ -264,13 +494,13 @@ static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const
 			buffer_append_string_len(b, pattern + start, k - start);
 
 			if (pattern[k + 1] == '{') {
-				int num = pcre_keyvalue_buffer_subst_ext(b, pattern+k, list, n, ctx);
+				int num = pcre_keyvalue_buffer_subst_ext(b, pattern+k, subject, ovec, n, ctx);
 				if (num < 0) return; /* error; truncate result */
 				k += (size_t)num;
 			} else if (light_isdigit(((unsigned char *)pattern)[k + 1])) {
 				unsigned int num = (unsigned int)pattern[k + 1] - '0';
 				pattern[k] == '$' /*(else '%')*/
-				  ? pcre_keyvalue_buffer_append_match(b, list, n, num, 0)
+				  ? pcre_keyvalue_buffer_append_match(b, subject, ovec, n, num, 0)
 				  : pcre_keyvalue_buffer_append_ctxmatch(b, ctx, num, 0);
 			} else {
 				/* enable escape: "%%" => "%", "%a" => "%a", "$$" => "$" */
@@ -286,8 +516,24 @@ static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const
 }
 
 handler_t pcre_keyvalue_buffer_process(const pcre_keyvalue_buffer *kvb, pcre_keyvalue_ctx *ctx, const buffer *input, buffer *result) {
-    for (int i = 0, used = (int)kvb->used; i < used; ++i) {
+  #if defined(HAVE_PCRE2_H)
+    pcre2_match_data * const md = config_pcre2_match_data();
+    const pcre_keyvalue_ovec_t * const ovec = pcre2_get_ovector_pointer(md);
+  #endif
+    if (0 == kvb->used) return HANDLER_GO_ON;
+    int h[PCRE_KEYVALUE_PREFIX_MAX+1];
+    int nh = pcre_keyvalue_prefilter(kvb, input, h);
+    for (int i; (i = pcre_keyvalue_prefilter_next(kvb, h, &nh)) >= 0; ) {
         const pcre_keyvalue * const kv = kvb->kv+i;
+      #if defined(HAVE_PCRE2_H)
+        int n = pcre2_match(kv->code, (PCRE2_SPTR)input->ptr,
+                            buffer_string_length(input), 0, 0, md, NULL);
+        if (n < 0) {
+            if (n != PCRE2_ERROR_NOMATCH) {
+                return HANDLER_ERROR;
+            }
+        }
+      #else
         #define N 20
         int ovec[N * 3];
         #undef N
@@ -298,6 +544,7 @@ handler_t pcre_keyvalue_buffer_process(const pcre_keyvalue_buffer *kvb, pcre_key
                 return HANDLER_ERROR;
             }
         }
+      #endif
         else if (buffer_string_is_empty(&kv->value)) {
             /* short-circuit if blank replacement pattern
              * (do not attempt to match against remaining kvb rules) */
@@ -305,11 +552,8 @@ handler_t pcre_keyvalue_buffer_process(const pcre_keyvalue_buffer *kvb, pcre_key
             return HANDLER_GO_ON;
         }
         else { /* it matched */
-            const char **list;
             ctx->m = i;
-            pcre_get_substring_list(input->ptr, ovec, n, &list);
-            pcre_keyvalue_buffer_subst(result, &kv->value, list, n, ctx);
-            pcre_free(list);
+            pcre_keyvalue_buffer_subst(result, &kv->value, input->ptr, ovec, n, ctx);
             return HANDLER_FINISHED;
         }
     }
@@ -8,6 +8,7 @@
 struct burl_parts_t;    /* declaration */
 struct cond_match_t;    /* declaration */
 struct pcre_keyvalue;   /* declaration */
+struct pcre_keyvalue_node; /* declaration */
 
 typedef struct pcre_keyvalue_ctx {
   struct cond_match_t *cache;
@@ -21,6 +22,8 @@ typedef struct {
 	uint32_t used;
 	uint16_t x0;
 	uint16_t x1;
+	struct pcre_keyvalue_node *nodes; /* prefilter trie (see keyvalue.c) */
+	uint32_t nused;
 } pcre_keyvalue_buffer;
 
 __attribute_cold__
@@ -28,6 +28,16 @@
 
 time_t log_epoch_secs = 0;
 
+/* per-thread buffer in which to format log messages (server.threads);
+ * NULL in main thread, which formats into errh->b */
+static __thread_local buffer *log_tb;
+
+void log_thread_buffer (buffer * const b) {
+    log_tb = b;
+}
+
+#define log_buffer(errh) (log_tb ? log_tb : &(errh)->b)
+
 int log_clock_gettime_realtime (struct timespec *ts) {
       #ifdef HAVE_CLOCK_GETTIME
 	return clock_gettime(CLOCK_REALTIME, ts);
@@ -42,6 +52,12 @@ int log_clock_gettime_realtime (struct timespec *ts) {
       #endif
 }
 
+uint64_t log_epoch_ms (void) {
+    struct timespec ts;
+    log_clock_gettime_realtime(&ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
 /* retry write on EINTR or when not all data was written */
 ssize_t write_all(int fd, const void * const buf, size_t count) {
     ssize_t written = 0;
@@ -59,9 +75,9 @@ ssize_t write_all(int fd, const void * const buf, size_t count) {
 }
 
 static int log_buffer_prepare(const log_error_st *errh, const char *filename, unsigned int line, buffer *b) {
-	static time_t tlast;
-	static char tstr[20]; /* 20-chars needed for "%Y-%m-%d %H:%M:%S" */
-	static size_t tlen;
+	static __thread_local time_t tlast;
+	static __thread_local char tstr[20]; /* 20-chars needed for "%Y-%m-%d %H:%M:%S" */
+	static __thread_local size_t tlen;
 	switch(errh->errorlog_mode) {
 	case ERRORLOG_PIPE:
 	case ERRORLOG_FILE:
@@ -70,8 +86,14 @@ static int log_buffer_prepare(const log_error_st *errh, const char *filename, un
 		/* cache the generated timestamp */
 		if (tlast != log_epoch_secs) {
 			tlast = log_epoch_secs;
+		      #ifdef HAVE_LOCALTIME_R
+			struct tm tm;
+			tlen = strftime(tstr, sizeof(tstr),
+			                "%Y-%m-%d %H:%M:%S", localtime_r(&tlast, &tm));
+		      #else
 			tlen = strftime(tstr, sizeof(tstr),
 			                "%Y-%m-%d %H:%M:%S", localtime(&tlast));
+		      #endif
 		}
 
 		buffer_copy_string_len(b, tstr, tlen);
@@ -165,7 +187,7 @@ log_error_va_list_impl (log_error_st * const errh,
                         const int perr)
 {
     const int errnum = errno;
-    buffer * const b = &errh->b;
+    buffer * const b = log_buffer(errh);
     if (-1 == log_buffer_prepare(errh, filename, line, b)) return;
     log_buffer_vprintf(b, fmt, ap);
     if (perr) {
@@ -211,7 +233,7 @@ log_error_multiline_buffer (log_error_st * const restrict errh,
     if (multiline->used < 2) return;
 
     const int errnum = errno;
-    buffer * const b = &errh->b;
+    buffer * const b = log_buffer(errh);
     if (-1 == log_buffer_prepare(errh, filename, line, b)) return;
 
     va_list ap;
@@ -9,6 +9,7 @@ extern time_t log_epoch_secs;
 
 struct timespec; /* declaration */
 int log_clock_gettime_realtime (struct timespec *ts);
+uint64_t log_epoch_ms (void);
 
 ssize_t write_all(int fd, const void* buf, size_t count);
 
@@ -22,6 +23,10 @@ struct log_error_st {
 __attribute_cold__
 log_error_st * log_error_st_init (void);
 
+/* set buffer used by calling thread to format log messages (server.threads) */
+__attribute_cold__
+void log_thread_buffer (buffer *b);
+
 __attribute_cold__
 void log_error_st_free (log_error_st *errh);
 
@@ -22,6 +22,18 @@
 # include <syslog.h>
 #endif
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* log buffers, cached timestamp strings, and log fds (cycled by main thread)
+ * are shared by event loop threads (server.threads) */
+static pthread_mutex_t accesslog_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define accesslog_lock()   pthread_mutex_lock(&accesslog_mutex)
+#define accesslog_unlock() pthread_mutex_unlock(&accesslog_mutex)
+#else
+#define accesslog_lock()   do { } while (0)
+#define accesslog_unlock() do { } while (0)
+#endif
+
 typedef struct {
 	char key;
 	enum {
@@ -145,17 +157,6 @@ typedef struct {
   #endif
 } format_fields;
 
-typedef struct {
-	int    log_access_fd;
-	char use_syslog; /* syslog has global buffer */
-	char piped_logger;
-	unsigned short syslog_level;
-	buffer *access_logbuffer; /* each logfile has a separate buffer */
-	const buffer *access_logfile;
-
-	format_fields *parsed_format;
-} plugin_config;
-
 typedef struct {
     int log_access_fd;
     char piped_logger;
@@ -163,10 +164,17 @@ typedef struct {
     buffer access_logbuffer; /* each logfile has a separate buffer */
 } accesslog_st;
 
+typedef struct {
+	accesslog_st *log; /* NULL if no accesslog.filename */
+	char use_syslog; /* syslog has global buffer */
+	unsigned short syslog_level;
+
+	format_fields *parsed_format;
+} plugin_config;
+
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 
     buffer syslog_logbuffer; /* syslog has global buffer. no caching, always written directly */
     log_error_st *errh; /* copy of srv->errh */
@@ -482,10 +490,7 @@ static void mod_accesslog_merge_config_cpv(plugin_config * const pconf, const co
       case 0:{/* accesslog.filename */
         if (cpv->vtype != T_CONFIG_LOCAL) break;
         accesslog_st * const x = cpv->v.v;
-        pconf->log_access_fd    = x->log_access_fd;
-        pconf->piped_logger     = x->piped_logger;
-        pconf->access_logfile   = x->access_logfile;
-        pconf->access_logbuffer = &x->access_logbuffer;
+        pconf->log = !buffer_string_is_empty(x->access_logfile) ? x : NULL;
         break;
       }
       case 1:{/* accesslog.format */
@@ -510,11 +515,11 @@ static void mod_accesslog_merge_config(plugin_config * const pconf, const config
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_accesslog_patch_config(request_st * const r, plugin_data * const p) {
-    memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
+static void mod_accesslog_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    memcpy(pconf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_accesslog_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_accesslog_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -613,7 +618,6 @@ SETDEFAULTS_FUNC(mod_accesslog_set_defaults) {
         }
     }
 
-    p->defaults.log_access_fd = -1;
     p->defaults.syslog_level = LOG_INFO;
 
     /* initialize p->defaults from global config context */
@@ -757,7 +761,11 @@ static void log_access_flush(plugin_data * const p) {
 
 TRIGGER_FUNC(log_access_periodic_flush) {
     /* flush buffered access logs every 4 seconds */
-    if (0 == (log_epoch_secs & 3)) log_access_flush((plugin_data *)p_d);
+    if (0 == (log_epoch_secs & 3)) {
+        accesslog_lock();
+        log_access_flush((plugin_data *)p_d);
+        accesslog_unlock();
+    }
     UNUSED(srv);
     return HANDLER_GO_ON;
 }
@@ -765,6 +773,7 @@ TRIGGER_FUNC(log_access_periodic_flush) {
 SIGHUP_FUNC(log_access_cycle) {
     plugin_data * const p = p_d;
 
+    accesslog_lock();
     log_access_flush(p);
 
     /* future: might be slightly faster to have allocated array of open files
@@ -791,6 +800,7 @@ SIGHUP_FUNC(log_access_cycle) {
             }
         }
     }
+    accesslog_unlock();
 
     return HANDLER_GO_ON;
 }
@@ -800,6 +810,13 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 	const buffer *vb;
 	struct timespec ts = { 0, 0 };
 	int flush = 0;
+	/* HTTP/2 streams share the connection; count bytes per stream */
+	const off_t bytes_written = !r->h2id
+	  ? con->bytes_written
+	  : r->write_queue->bytes_out + (off_t)r->resp_header_len;
+	const off_t bytes_read = !r->h2id
+	  ? con->bytes_read
+	  : r->read_queue->bytes_in + (off_t)r->rqst_header_len;
 
 	for (const format_field *f = parsed_format->ptr; f->type != FIELD_UNSET; ++f) {
 		switch(f->type) {
@@ -981,8 +998,8 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 				break;
 
 			case FORMAT_BYTES_OUT_NO_HEADER:
-				if (con->bytes_written > 0) {
-					off_t bytes = con->bytes_written - (off_t)r->resp_header_len;
+				if (bytes_written > 0) {
+					off_t bytes = bytes_written - (off_t)r->resp_header_len;
 					buffer_append_int(b, bytes > 0 ? bytes : 0);
 				} else {
 					buffer_append_string_len(b, CONST_STR_LEN("-"));
@@ -1018,15 +1035,15 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 				}
 				break;
 			case FORMAT_BYTES_OUT:
-				if (con->bytes_written > 0) {
-					buffer_append_int(b, con->bytes_written);
+				if (bytes_written > 0) {
+					buffer_append_int(b, bytes_written);
 				} else {
 					buffer_append_string_len(b, CONST_STR_LEN("-"));
 				}
 				break;
 			case FORMAT_BYTES_IN:
-				if (con->bytes_read > 0) {
-					buffer_append_int(b, con->bytes_read);
+				if (bytes_read > 0) {
+					buffer_append_int(b, bytes_read);
 				} else {
 					buffer_append_string_len(b, CONST_STR_LEN("-"));
 				}
@@ -1046,8 +1063,7 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 				}
 				break;
 			case FORMAT_REQUEST_PROTOCOL:
-				buffer_append_string_len(b,
-					r->http_version == HTTP_VERSION_1_1 ? "HTTP/1.1" : "HTTP/1.0", 8);
+				buffer_append_string(b, get_http_version_name(r->http_version));
 				break;
 			case FORMAT_REQUEST_METHOD:
 				http_method_append(b, r->http_method);
@@ -1153,23 +1169,27 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 
 REQUESTDONE_FUNC(log_access_write) {
 	plugin_data * const p = p_d;
-	mod_accesslog_patch_config(r, p);
+	plugin_config pconf;
+	mod_accesslog_patch_config(r, p, &pconf);
+	accesslog_st * const x = pconf.log;
 
 	/* No output device, nothing to do */
-	if (!p->conf.use_syslog && p->conf.log_access_fd == -1) return HANDLER_GO_ON;
+	if (!pconf.use_syslog && NULL == x) return HANDLER_GO_ON;
 
-	buffer * const b = (p->conf.use_syslog)
+	accesslog_lock();
+
+	buffer * const b = (pconf.use_syslog)
 	  ? &p->syslog_logbuffer
-	  : p->conf.access_logbuffer;
+	  : &x->access_logbuffer;
 
-	const int flush = p->conf.piped_logger
-	                | log_access_record(r, b, p->conf.parsed_format);
+	const int flush = (!pconf.use_syslog && x->piped_logger)
+	                | log_access_record(r, b, pconf.parsed_format);
 
-	if (p->conf.use_syslog) { /* syslog doesn't cache */
+	if (pconf.use_syslog) { /* syslog doesn't cache */
 #ifdef HAVE_SYSLOG_H
 		if (!buffer_string_is_empty(b)) {
 			/*(syslog appends a \n on its own)*/
-			syslog(p->conf.syslog_level, "%s", b->ptr);
+			syslog(pconf.syslog_level, "%s", b->ptr);
 		}
 #endif
 		buffer_clear(b);
@@ -1178,14 +1198,16 @@ REQUESTDONE_FUNC(log_access_write) {
 		buffer_append_string_len(b, CONST_STR_LEN("\n"));
 
 		if (flush || buffer_string_length(b) >= 8192) {
-			if (!accesslog_write_all(p->conf.log_access_fd, b)) {
+			if (!accesslog_write_all(x->log_access_fd, b)) {
 				log_perror(r->conf.errh, __FILE__, __LINE__,
 				  "writing access log entry failed: %s",
-				  p->conf.access_logfile->ptr);
+				  x->access_logfile->ptr);
 			}
 		}
 	}
 
+	accesslog_unlock();
+
 	return HANDLER_GO_ON;
 }
 
@@ -1194,6 +1216,7 @@ int mod_accesslog_plugin_init(plugin *p);
 int mod_accesslog_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "accesslog";
+	p->thread_safe = 1;
 
 	p->init        = mod_accesslog_init;
 	p->set_defaults= mod_accesslog_set_defaults;
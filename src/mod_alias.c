@@ -17,7 +17,6 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
 INIT_FUNC(mod_alias_init) {
@@ -40,12 +39,12 @@ static void mod_alias_merge_config(plugin_config * const pconf, const config_plu
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_alias_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_alias_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_alias_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_alias_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -126,8 +125,9 @@ PHYSICALPATH_FUNC(mod_alias_physical_handler) {
 
 	if (0 == uri_len) return HANDLER_GO_ON;
 
-	mod_alias_patch_config(r, p);
-	if (NULL == p->conf.alias) return HANDLER_GO_ON;
+	plugin_config pconf;
+	mod_alias_patch_config(r, p, &pconf);
+	if (NULL == pconf.alias) return HANDLER_GO_ON;
 
 	/* do not include trailing slash on basedir */
 	basedir_len = buffer_string_length(&r->physical.basedir);
@@ -136,8 +136,8 @@ PHYSICALPATH_FUNC(mod_alias_physical_handler) {
 	uri_ptr = r->physical.path.ptr + basedir_len;
 
 	ds = (!r->conf.force_lowercase_filenames)
-	   ? (data_string *)array_match_key_prefix_klen(p->conf.alias, uri_ptr, uri_len)
-	   : (data_string *)array_match_key_prefix_nc_klen(p->conf.alias, uri_ptr, uri_len);
+	   ? (data_string *)array_match_key_prefix_klen(pconf.alias, uri_ptr, uri_len)
+	   : (data_string *)array_match_key_prefix_nc_klen(pconf.alias, uri_ptr, uri_len);
 	if (NULL == ds) { return HANDLER_GO_ON; }
 
 			/* matched */
@@ -172,6 +172,7 @@ int mod_alias_plugin_init(plugin *p);
 int mod_alias_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "alias";
+	p->thread_safe = 1;
 
 	p->init           = mod_alias_init;
 	p->handle_physical= mod_alias_physical_handler;
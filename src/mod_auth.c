@@ -32,9 +32,20 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* http_auth_cache splay trees are shared by all server threads and
+ * are modified even on lookup (splaytree_splay()) */
+static pthread_mutex_t http_auth_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define http_auth_cache_lock()   pthread_mutex_lock(&http_auth_cache_mutex)
+#define http_auth_cache_unlock() pthread_mutex_unlock(&http_auth_cache_mutex)
+#else
+#define http_auth_cache_lock()   do { } while (0)
+#define http_auth_cache_unlock() do { } while (0)
+#endif
+
 typedef struct {
     const struct http_auth_require_t *require;
     time_t ctime;
@@ -127,9 +138,9 @@ http_auth_cache_query (splay_tree ** const sptree, const int ndx)
 static void
 http_auth_cache_insert (splay_tree ** const sptree, const int ndx, void * const data, void(data_free_fn)(void *))
 {
-    /*(not necessary to re-splay (with current usage) since single-threaded
-     * and splaytree has not been modified since http_auth_cache_query())*/
-    /* *sptree = splaytree_splay(*sptree, ndx); */
+    /*(re-splay since splaytree might have been modified by another thread
+     * since http_auth_cache_query(); http_auth_cache_lock() must be held)*/
+    *sptree = splaytree_splay(*sptree, ndx);
     if (NULL == *sptree || (*sptree)->key != ndx)
         *sptree = splaytree_insert(*sptree, ndx, data);
     else { /* collision; replace old entry */
@@ -192,7 +203,9 @@ TRIGGER_FUNC(mod_auth_periodic)
             if (cpv->k_id != 3) continue; /* k_id == 3 for auth.cache */
             if (cpv->vtype != T_CONFIG_LOCAL) continue;
             http_auth_cache *ac = cpv->v.v;
+            http_auth_cache_lock();
             mod_auth_periodic_cleanup(&ac->sptree, ac->max_age, cur_ts);
+            http_auth_cache_unlock();
         }
     }
 
@@ -568,15 +581,23 @@ static void mod_auth_merge_config(plugin_config * const pconf, const config_plug
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_auth_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_auth_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_auth_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_auth_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
+static http_auth_cache * mod_auth_get_cache(request_st * const r, const plugin_data * const p) {
+    /*(scheme checkfn does not receive plugin_config, so re-patch config;
+     * plugin_data is shared between threads and must not hold request state)*/
+    plugin_config pconf;
+    mod_auth_patch_config(r, p, &pconf);
+    return pconf.auth_cache;
+}
+
 SETDEFAULTS_FUNC(mod_auth_set_defaults) {
     static const config_plugin_keys_t cpk[] = {
       { CONST_STR_LEN("auth.backend"),
@@ -655,28 +676,29 @@ SETDEFAULTS_FUNC(mod_auth_set_defaults) {
 
 static handler_t mod_auth_uri_handler(request_st * const r, void *p_d) {
 	plugin_data *p = p_d;
+	plugin_config pconf;
 	data_auth *dauth;
 
-	mod_auth_patch_config(r, p);
+	mod_auth_patch_config(r, p, &pconf);
 
-	if (p->conf.auth_require == NULL) return HANDLER_GO_ON;
+	if (pconf.auth_require == NULL) return HANDLER_GO_ON;
 
 	/* search auth directives for first prefix match against URL path */
 	/* if we have a case-insensitive FS we have to lower-case the URI here too */
 	dauth = (!r->conf.force_lowercase_filenames)
-	   ? (data_auth *)array_match_key_prefix(p->conf.auth_require, &r->uri.path)
-	   : (data_auth *)array_match_key_prefix_nc(p->conf.auth_require, &r->uri.path);
+	   ? (data_auth *)array_match_key_prefix(pconf.auth_require, &r->uri.path)
+	   : (data_auth *)array_match_key_prefix_nc(pconf.auth_require, &r->uri.path);
 	if (NULL == dauth) return HANDLER_GO_ON;
 
 	{
 			const http_auth_scheme_t * const scheme = dauth->require->scheme;
-			if (p->conf.auth_extern_authn) {
+			if (pconf.auth_extern_authn) {
 				const buffer *vb = http_header_env_get(r, CONST_STR_LEN("REMOTE_USER"));
 				if (NULL != vb && http_auth_match_rules(dauth->require, vb->ptr, NULL, NULL)) {
 					return HANDLER_GO_ON;
 				}
 			}
-			return scheme->checkfn(r, scheme->p_d, dauth->require, p->conf.auth_backend);
+			return scheme->checkfn(r, scheme->p_d, dauth->require, pconf.auth_backend);
 	}
 }
 
@@ -685,6 +707,7 @@ int mod_auth_plugin_init(plugin *p);
 int mod_auth_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "auth";
+	p->thread_safe = 1;
 	p->init        = mod_auth_init;
 	p->set_defaults = mod_auth_set_defaults;
 	p->handle_trigger = mod_auth_periodic;
@@ -781,14 +804,13 @@ static handler_t mod_auth_check_basic(request_st * const r, void *p_d, const str
 	pw++;
 	pwlen -= (pw - username->ptr);
 
-	plugin_data * const p = p_d;
-	splay_tree ** sptree = p->conf.auth_cache
-	  ? &p->conf.auth_cache->sptree
-	  : NULL;
+	http_auth_cache * const ac = mod_auth_get_cache(r, p_d);
+	splay_tree ** sptree = ac ? &ac->sptree : NULL;
 	http_auth_cache_entry *ae = NULL;
 	int ndx = -1;
 	if (sptree) {
 		ndx = http_auth_cache_hash(require, CONST_BUF_LEN(username));
+		http_auth_cache_lock();
 		ae = http_auth_cache_query(sptree, ndx);
 		if (ae && ae->require == require
 		    && buffer_is_equal_string(username, ae->username, ae->ulen))
@@ -798,6 +820,8 @@ static handler_t mod_auth_check_basic(request_st * const r, void *p_d, const str
 			  : HANDLER_ERROR;
 		else /*(not found or hash collision)*/
 			ae = NULL;
+		http_auth_cache_unlock();
+		/*(ae must not be dereferenced after http_auth_cache_unlock())*/
 	}
 
 	if (NULL == ae) /* (HANDLER_UNSET == rc) */
@@ -809,7 +833,9 @@ static handler_t mod_auth_check_basic(request_st * const r, void *p_d, const str
 		if (sptree && NULL == ae) { /*(cache (new) successful result)*/
 			ae = http_auth_cache_entry_init(require, 0, CONST_BUF_LEN(username),
 			                                pw, pwlen);
+			http_auth_cache_lock();
 			http_auth_cache_insert(sptree, ndx, ae, http_auth_cache_entry_free);
+			http_auth_cache_unlock();
 		}
 		break;
 	case HANDLER_WAIT_FOR_EVENT:
@@ -1412,14 +1438,13 @@ static handler_t mod_auth_check_digest(request_st * const r, void *p_d, const st
 
 	handler_t rc = HANDLER_UNSET;
 
-	plugin_data * const p = p_d;
-	splay_tree ** sptree = p->conf.auth_cache
-	  ? &p->conf.auth_cache->sptree
-	  : NULL;
+	http_auth_cache * const ac = mod_auth_get_cache(r, p_d);
+	splay_tree ** sptree = ac ? &ac->sptree : NULL;
 	http_auth_cache_entry *ae = NULL;
 	int ndx = -1;
 	if (sptree) {
 		ndx = http_auth_cache_hash(require, ai.username, ai.ulen);
+		http_auth_cache_lock();
 		ae = http_auth_cache_query(sptree, ndx);
 		if (ae && ae->require == require
 		    && ae->dalgo == ai.dalgo
@@ -1431,6 +1456,8 @@ static handler_t mod_auth_check_digest(request_st * const r, void *p_d, const st
 		}
 		else /*(not found or hash collision)*/
 			ae = NULL;
+		http_auth_cache_unlock();
+		/*(ae must not be dereferenced after http_auth_cache_unlock())*/
 	}
 
 	if (HANDLER_UNSET == rc)
@@ -1455,7 +1482,9 @@ static handler_t mod_auth_check_digest(request_st * const r, void *p_d, const st
 	if (sptree && NULL == ae) { /*(cache digest from backend)*/
 		ae = http_auth_cache_entry_init(require, ai.dalgo, ai.username, ai.ulen,
 		                                (char *)ai.digest, ai.dlen);
+		http_auth_cache_lock();
 		http_auth_cache_insert(sptree, ndx, ae, http_auth_cache_entry_free);
+		http_auth_cache_unlock();
 	}
 
 	const char *m = get_http_method_name(r->http_method);
@@ -47,9 +47,19 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* crypt() returns pointer to static buffer shared by all server threads */
+static pthread_mutex_t authn_file_crypt_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define authn_file_crypt_lock()   pthread_mutex_lock(&authn_file_crypt_mutex)
+#define authn_file_crypt_unlock() pthread_mutex_unlock(&authn_file_crypt_mutex)
+#else
+#define authn_file_crypt_lock()   do { } while (0)
+#define authn_file_crypt_unlock() do { } while (0)
+#endif
+
 static handler_t mod_authn_file_htdigest_digest(request_st *r, void *p_d, http_auth_info_t *ai);
 static handler_t mod_authn_file_htdigest_basic(request_st *r, void *p_d, const http_auth_require_t *require, const buffer *username, const char *pw);
 static handler_t mod_authn_file_plain_digest(request_st *r, void *p_d, http_auth_info_t *ai);
@@ -105,12 +115,12 @@ static void mod_authn_file_merge_config(plugin_config * const pconf, const confi
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_authn_file_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_authn_file_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_authn_file_merge_config(&p->conf,
+            mod_authn_file_merge_config(pconf,
                                         p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
@@ -256,11 +266,12 @@ static int mod_authn_file_htdigest_get_loop(FILE *fp, const buffer *auth_fn, htt
 
 static int mod_authn_file_htdigest_get(request_st * const r, void *p_d, http_auth_info_t * const ai) {
     plugin_data *p = (plugin_data *)p_d;
+    plugin_config pconf;
     const buffer *auth_fn;
     FILE *fp;
 
-    mod_authn_file_patch_config(r, p);
-    auth_fn = p->conf.auth_htdigest_userfile;
+    mod_authn_file_patch_config(r, p, &pconf);
+    auth_fn = pconf.auth_htdigest_userfile;
     if (buffer_string_is_empty(auth_fn)) return -1;
 
     fp = fopen(auth_fn->ptr, "r");
@@ -369,9 +380,10 @@ static int mod_authn_file_htpasswd_get(const buffer *auth_fn, const char *userna
 static handler_t mod_authn_file_plain_digest(request_st * const r, void *p_d, http_auth_info_t * const ai) {
     plugin_data *p = (plugin_data *)p_d;
     buffer *password_buf = buffer_init();/* password-string from auth-backend */
+    plugin_config pconf;
     int rc;
-    mod_authn_file_patch_config(r, p);
-    rc = mod_authn_file_htpasswd_get(p->conf.auth_plain_userfile, ai->username, ai->ulen, password_buf, r->conf.errh);
+    mod_authn_file_patch_config(r, p, &pconf);
+    rc = mod_authn_file_htpasswd_get(pconf.auth_plain_userfile, ai->username, ai->ulen, password_buf, r->conf.errh);
     if (0 == rc) {
         /* generate password from plain-text */
         mod_authn_file_digest(ai, CONST_BUF_LEN(password_buf));
@@ -383,9 +395,10 @@ static handler_t mod_authn_file_plain_digest(request_st * const r, void *p_d, ht
 static handler_t mod_authn_file_plain_basic(request_st * const r, void *p_d, const http_auth_require_t * const require, const buffer * const username, const char * const pw) {
     plugin_data *p = (plugin_data *)p_d;
     buffer *password_buf = buffer_init();/* password-string from auth-backend */
+    plugin_config pconf;
     int rc;
-    mod_authn_file_patch_config(r, p);
-    rc = mod_authn_file_htpasswd_get(p->conf.auth_plain_userfile, CONST_BUF_LEN(username), password_buf, r->conf.errh);
+    mod_authn_file_patch_config(r, p, &pconf);
+    rc = mod_authn_file_htpasswd_get(pconf.auth_plain_userfile, CONST_BUF_LEN(username), password_buf, r->conf.errh);
     if (0 == rc) {
         rc = http_auth_const_time_memeq_pad(CONST_BUF_LEN(password_buf), pw, strlen(pw)) ? 0 : -1;
     }
@@ -607,9 +620,10 @@ static void apr_sha_encode(const char *pw, char *result, size_t nbytes) {
 static handler_t mod_authn_file_htpasswd_basic(request_st * const r, void *p_d, const http_auth_require_t * const require, const buffer * const username, const char * const pw) {
     plugin_data *p = (plugin_data *)p_d;
     buffer *password = buffer_init();/* password-string from auth-backend */
+    plugin_config pconf;
     int rc;
-    mod_authn_file_patch_config(r, p);
-    rc = mod_authn_file_htpasswd_get(p->conf.auth_htpasswd_userfile, CONST_BUF_LEN(username), password, r->conf.errh);
+    mod_authn_file_patch_config(r, p, &pconf);
+    rc = mod_authn_file_htpasswd_get(pconf.auth_htpasswd_userfile, CONST_BUF_LEN(username), password, r->conf.errh);
     if (0 == rc) {
         char sample[256];
         rc = -1;
@@ -676,6 +690,7 @@ static handler_t mod_authn_file_htpasswd_basic(request_st * const r, void *p_d,
                     memcpy(sample, "$1$", sizeof("$1$")-1);
                     memcpy(sample+sizeof("$1$")-1, b, slen);
                     sample[sizeof("$1$")-1+slen] = '\0';
+                    authn_file_crypt_lock();
                    #if 0 && defined(HAVE_CRYPT_R)
                     crypted = crypt_r(ntlmhex, sample, &crypt_tmp_data);
                    #else
@@ -685,11 +700,13 @@ static handler_t mod_authn_file_htpasswd_basic(request_st * const r, void *p_d,
                         && 0 == strncmp(crypted, "$1$", sizeof("$1$")-1)) {
                         rc = strcmp(b, crypted+3); /*skip crypted "$1$" prefix*/
                     }
+                    authn_file_crypt_unlock();
                 }
             }
             else
            #endif
             {
+                authn_file_crypt_lock();
                #if 0 && defined(HAVE_CRYPT_R)
                 crypted = crypt_r(pw, password->ptr, &crypt_tmp_data);
                #else
@@ -698,6 +715,7 @@ static handler_t mod_authn_file_htpasswd_basic(request_st * const r, void *p_d,
                 if (NULL != crypted) {
                     rc = strcmp(password->ptr, crypted);
                 }
+                authn_file_crypt_unlock();
             }
         }
       #endif
@@ -713,6 +731,7 @@ int mod_authn_file_plugin_init(plugin *p);
 int mod_authn_file_plugin_init(plugin *p) {
     p->version     = LIGHTTPD_VERSION_ID;
     p->name        = "authn_file";
+    p->thread_safe = 1;
     p->init        = mod_authn_file_init;
     p->set_defaults= mod_authn_file_set_defaults;
 
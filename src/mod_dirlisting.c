@@ -17,7 +17,10 @@
 #include <unistd.h>
 #include <time.h>
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
@@ -34,7 +37,9 @@ typedef struct {
 	char encode_header;
 	char auto_layout;
 
-      #ifdef HAVE_PCRE_H
+      #if defined(HAVE_PCRE2_H)
+	pcre2_code **excludes;
+      #elif defined(HAVE_PCRE_H)
 	pcre **excludes;
       #else
 	void *excludes;
@@ -51,12 +56,52 @@ typedef struct {
 typedef struct {
 	PLUGIN_DATA;
 	plugin_config defaults;
-	plugin_config conf;
-
-	buffer tmp_buf;
 } plugin_data;
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+
+static pcre2_code ** mod_dirlisting_parse_excludes(server *srv, const array *a) {
+    pcre2_code **regexes = calloc(a->used + 1, sizeof(pcre2_code *));
+    force_assert(regexes);
+    for (uint32_t j = 0; j < a->used; ++j) {
+        const data_string *ds = (const data_string *)a->data[j];
+        int errcode;
+        PCRE2_SIZE erroff;
+        regexes[j] = pcre2_compile((PCRE2_SPTR)ds->value.ptr,
+                                   buffer_string_length(&ds->value),
+                                   0, &errcode, &erroff, NULL);
+        if (NULL == regexes[j]) {
+            log_error(srv->errh, __FILE__, __LINE__,
+              "pcre2_compile failed for: %s", ds->value.ptr);
+            for (pcre2_code **regex = regexes; *regex; ++regex)
+                pcre2_code_free(*regex);
+            free(regexes);
+            return NULL;
+        }
+        (void)pcre2_jit_compile(regexes[j], PCRE2_JIT_COMPLETE);
+    }
+    return regexes;
+}
+
+static int mod_dirlisting_exclude(log_error_st *errh, pcre2_code **regex, const char *name, size_t len) {
+    pcre2_match_data * const md = config_pcre2_match_data();
+    for(; *regex; ++regex) {
+        int n;
+        if ((n = pcre2_match(*regex, (PCRE2_SPTR)name, len, 0, 0, md, NULL)) < 0) {
+            if (n == PCRE2_ERROR_NOMATCH) continue;
+
+            log_error(errh, __FILE__, __LINE__,
+              "execution error while matching: %d", n);
+            /* aborting would require a lot of manual cleanup here.
+             * skip instead (to not leak names that break pcre matching)
+             */
+        }
+        return 1;
+    }
+    return 0; /* no match */
+}
+
+#elif defined(HAVE_PCRE_H)
 
 static pcre ** mod_dirlisting_parse_excludes(server *srv, const array *a) {
     pcre **regexes = calloc(a->used + 1, sizeof(pcre *));
@@ -110,14 +155,20 @@ INIT_FUNC(mod_dirlisting_init) {
 
 FREE_FUNC(mod_dirlisting_free) {
     plugin_data * const p = p_d;
-    free(p->tmp_buf.ptr);
     if (NULL == p->cvlist) return;
     /* (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
         config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
         for (; -1 != cpv->k_id; ++cpv) {
             switch (cpv->k_id) {
-             #ifdef HAVE_PCRE_H
+             #if defined(HAVE_PCRE2_H)
+              case 2: /* dir-listing.exclude */
+                if (cpv->vtype != T_CONFIG_LOCAL) continue;
+                for (pcre2_code **regex = cpv->v.v; *regex; ++regex)
+                    pcre2_code_free(*regex);
+                free(cpv->v.v);
+                break;
+             #elif defined(HAVE_PCRE_H)
               case 2: /* dir-listing.exclude */
                 if (cpv->vtype != T_CONFIG_LOCAL) continue;
                 for (pcre **regex = cpv->v.v; *regex; ++regex)
@@ -189,11 +240,11 @@ static void mod_dirlisting_merge_config(plugin_config * const pconf, const confi
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_dirlisting_patch_config(request_st * const r, plugin_data * const p) {
-    memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
+static void mod_dirlisting_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    memcpy(pconf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_dirlisting_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_dirlisting_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -263,7 +314,7 @@ SETDEFAULTS_FUNC(mod_dirlisting_set_defaults) {
               case 1: /* server.dir-listing *//*(historical)*/
                 break;
               case 2: /* dir-listing.exclude */
-               #ifndef HAVE_PCRE_H
+               #ifndef HAVE_PCRE
                 if (cpv->v.a->used > 0) {
                     log_error(srv->errh, __FILE__, __LINE__,
                       "pcre support is missing for: %s, "
@@ -655,27 +706,27 @@ static void http_dirlist_append_js_table_resort (buffer * const b, const request
 	buffer_append_string_len(b, CONST_STR_LEN(");\n\n// -->\n</script>\n\n"));
 }
 
-static void http_list_directory_header(const request_st * const r, plugin_data * const p, buffer * const out) {
+static void http_list_directory_header(const request_st * const r, const plugin_config * const pconf, buffer * const out) {
 
-	if (p->conf.auto_layout) {
+	if (pconf->auto_layout) {
 		buffer_append_string_len(out, CONST_STR_LEN(
 			"<!DOCTYPE html>\n"
 			"<html>\n"
 			"<head>\n"
 		));
-		if (!buffer_string_is_empty(p->conf.encoding)) {
+		if (!buffer_string_is_empty(pconf->encoding)) {
 			buffer_append_string_len(out, CONST_STR_LEN("<meta charset=\""));
-			buffer_append_string_buffer(out, p->conf.encoding);
+			buffer_append_string_buffer(out, pconf->encoding);
 			buffer_append_string_len(out, CONST_STR_LEN("\">\n"));
 		}
 		buffer_append_string_len(out, CONST_STR_LEN("<title>Index of "));
 		buffer_append_string_encoded(out, CONST_BUF_LEN(&r->uri.path), ENCODING_MINIMAL_XML);
 		buffer_append_string_len(out, CONST_STR_LEN("</title>\n"));
 
-		if (!buffer_string_is_empty(p->conf.external_css)) {
+		if (!buffer_string_is_empty(pconf->external_css)) {
 			buffer_append_string_len(out, CONST_STR_LEN("<meta name=\"viewport\" content=\"initial-scale=1\">"));
 			buffer_append_string_len(out, CONST_STR_LEN("<link rel=\"stylesheet\" type=\"text/css\" href=\""));
-			buffer_append_string_buffer(out, p->conf.external_css);
+			buffer_append_string_buffer(out, pconf->external_css);
 			buffer_append_string_len(out, CONST_STR_LEN("\">\n"));
 		} else {
 			buffer_append_string_len(out, CONST_STR_LEN(
@@ -716,17 +767,18 @@ static void http_list_directory_header(const request_st * const r, plugin_data *
 		buffer_append_string_len(out, CONST_STR_LEN("</head>\n<body>\n"));
 	}
 
-	if (!buffer_string_is_empty(p->conf.show_header)) {
+	if (!buffer_string_is_empty(pconf->show_header)) {
 		/* if we have a HEADER file, display it in <pre class="header"></pre> */
 
-		const buffer *hb = p->conf.show_header;
+		const buffer *hb = pconf->show_header;
 		if (hb->ptr[0] != '/') {
-			hb = &p->tmp_buf;
-			buffer_copy_buffer(&p->tmp_buf, &r->physical.path);
-			buffer_append_path_len(&p->tmp_buf, CONST_BUF_LEN(p->conf.show_header));
+			buffer * const tb = r->tmp_buf;
+			buffer_copy_buffer(tb, &r->physical.path);
+			buffer_append_path_len(tb, CONST_BUF_LEN(pconf->show_header));
+			hb = tb;
 		}
 
-		http_list_directory_include_file(out, r->conf.follow_symlink, hb, "header", p->conf.encode_header);
+		http_list_directory_include_file(out, r->conf.follow_symlink, hb, "header", pconf->encode_header);
 	}
 
 	buffer_append_string_len(out, CONST_STR_LEN("<h2>Index of "));
@@ -757,7 +809,7 @@ static void http_list_directory_header(const request_st * const r, plugin_data *
 	}
 }
 
-static void http_list_directory_footer(const request_st * const r, plugin_data * const p, buffer * const out) {
+static void http_list_directory_footer(const request_st * const r, const plugin_config * const pconf, buffer * const out) {
 
 	buffer_append_string_len(out, CONST_STR_LEN(
 		"</tbody>\n"
@@ -765,27 +817,28 @@ static void http_list_directory_footer(const request_st * const r, plugin_data *
 		"</div>\n"
 	));
 
-	if (!buffer_string_is_empty(p->conf.show_readme)) {
+	if (!buffer_string_is_empty(pconf->show_readme)) {
 		/* if we have a README file, display it in <pre class="readme"></pre> */
 
-		const buffer *rb = p->conf.show_readme;
+		const buffer *rb = pconf->show_readme;
 		if (rb->ptr[0] != '/') {
-			rb = &p->tmp_buf;
-			buffer_copy_buffer(&p->tmp_buf, &r->physical.path);
-			buffer_append_path_len(&p->tmp_buf, CONST_BUF_LEN(p->conf.show_readme));
+			buffer * const tb = r->tmp_buf;
+			buffer_copy_buffer(tb, &r->physical.path);
+			buffer_append_path_len(tb, CONST_BUF_LEN(pconf->show_readme));
+			rb = tb;
 		}
 
-		http_list_directory_include_file(out, r->conf.follow_symlink, rb, "readme", p->conf.encode_readme);
+		http_list_directory_include_file(out, r->conf.follow_symlink, rb, "readme", pconf->encode_readme);
 	}
 
-	if(p->conf.auto_layout) {
+	if(pconf->auto_layout) {
 
 		buffer_append_string_len(out, CONST_STR_LEN(
 			"<div class=\"foot\">"
 		));
 
-		if (!buffer_string_is_empty(p->conf.set_footer)) {
-			buffer_append_string_buffer(out, p->conf.set_footer);
+		if (!buffer_string_is_empty(pconf->set_footer)) {
+			buffer_append_string_buffer(out, pconf->set_footer);
 		} else {
 			buffer_append_string_buffer(out, r->conf.server_tag);
 		}
@@ -794,11 +847,11 @@ static void http_list_directory_footer(const request_st * const r, plugin_data *
 			"</div>\n"
 		));
 
-		if (!buffer_string_is_empty(p->conf.external_js)) {
+		if (!buffer_string_is_empty(pconf->external_js)) {
 			buffer_append_string_len(out, CONST_STR_LEN("<script type=\"text/javascript\" src=\""));
-			buffer_append_string_buffer(out, p->conf.external_js);
+			buffer_append_string_buffer(out, pconf->external_js);
 			buffer_append_string_len(out, CONST_STR_LEN("\"></script>\n"));
-		} else if (buffer_is_empty(p->conf.external_js)) {
+		} else if (buffer_is_empty(pconf->external_js)) {
 			http_dirlist_append_js_table_resort(out, r);
 		}
 
@@ -809,14 +862,14 @@ static void http_list_directory_footer(const request_st * const r, plugin_data *
 	}
 }
 
-static int http_list_directory(request_st * const r, plugin_data * const p, buffer * const dir) {
+static int http_list_directory(request_st * const r, const plugin_config * const pconf, buffer * const dir) {
 	DIR *dp;
 	buffer *out;
 	struct dirent *dent;
 	struct stat st;
 	char *path, *path_file;
 	size_t i;
-	int hide_dotfiles = p->conf.hide_dot_files;
+	int hide_dotfiles = pconf->hide_dot_files;
 	dirls_list_t dirs, files, *list;
 	dirls_entry_t *tmp;
 	char sizebuf[sizeof("999.9K")];
@@ -879,12 +932,12 @@ static int http_list_directory(request_st * const r, plugin_data * const p, buff
 				continue;
 		}
 
-		if (p->conf.hide_readme_file && !buffer_string_is_empty(p->conf.show_readme)) {
-			if (strcmp(dent->d_name, p->conf.show_readme->ptr) == 0)
+		if (pconf->hide_readme_file && !buffer_string_is_empty(pconf->show_readme)) {
+			if (strcmp(dent->d_name, pconf->show_readme->ptr) == 0)
 				continue;
 		}
-		if (p->conf.hide_header_file && !buffer_string_is_empty(p->conf.show_header)) {
-			if (strcmp(dent->d_name, p->conf.show_header->ptr) == 0)
+		if (pconf->hide_header_file && !buffer_string_is_empty(pconf->show_header)) {
+			if (strcmp(dent->d_name, pconf->show_header->ptr) == 0)
 				continue;
 		}
 
@@ -893,8 +946,8 @@ static int http_list_directory(request_st * const r, plugin_data * const p, buff
 		/* compare d_name against excludes array
 		 * elements, skipping any that match.
 		 */
-		if (p->conf.excludes
-		    && mod_dirlisting_exclude(errh, p->conf.excludes, dent->d_name, i))
+		if (pconf->excludes
+		    && mod_dirlisting_exclude(errh, pconf->excludes, dent->d_name, i))
 			continue;
 
 		/* NOTE: the manual says, d_name is never more than NAME_MAX
@@ -931,7 +984,7 @@ static int http_list_directory(request_st * const r, plugin_data * const p, buff
 	if (files.used) http_dirls_sort(files.ent, files.used);
 
 	out = chunkqueue_append_buffer_open(r->write_queue);
-	http_list_directory_header(r, p, out);
+	http_list_directory_header(r, pconf, out);
 
 	/* directories */
 	for (i = 0; i < dirs.used; i++) {
@@ -1003,15 +1056,16 @@ static int http_list_directory(request_st * const r, plugin_data * const p, buff
 	free(dirs.ent);
 	free(path);
 
-	http_list_directory_footer(r, p, out);
+	http_list_directory_footer(r, pconf, out);
 
 	/* Insert possible charset to Content-Type */
-	if (buffer_string_is_empty(p->conf.encoding)) {
+	if (buffer_string_is_empty(pconf->encoding)) {
 		http_header_response_set(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"), CONST_STR_LEN("text/html"));
 	} else {
-		buffer_copy_string_len(&p->tmp_buf, CONST_STR_LEN("text/html; charset="));
-		buffer_append_string_buffer(&p->tmp_buf, p->conf.encoding);
-		http_header_response_set(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"), CONST_BUF_LEN(&p->tmp_buf));
+		buffer * const tb = r->tmp_buf;
+		buffer_copy_string_len(tb, CONST_STR_LEN("text/html; charset="));
+		buffer_append_string_buffer(tb, pconf->encoding);
+		http_header_response_set(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"), CONST_BUF_LEN(tb));
 	}
 
 	chunkqueue_append_buffer_commit(r->write_queue);
@@ -1032,9 +1086,10 @@ URIHANDLER_FUNC(mod_dirlisting_subrequest) {
 	if (!http_method_get_or_head(r->http_method)) return HANDLER_GO_ON;
 	if (buffer_is_empty(&r->physical.path)) return HANDLER_GO_ON;
 
-	mod_dirlisting_patch_config(r, p);
+	plugin_config pconf;
+	mod_dirlisting_patch_config(r, p, &pconf);
 
-	if (!p->conf.dir_listing) return HANDLER_GO_ON;
+	if (!pconf.dir_listing) return HANDLER_GO_ON;
 
 	if (r->conf.log_request_handling) {
 		log_error(r->conf.errh, __FILE__, __LINE__,
@@ -1053,7 +1108,7 @@ URIHANDLER_FUNC(mod_dirlisting_subrequest) {
 
 	if (!S_ISDIR(sce->st.st_mode)) return HANDLER_GO_ON;
 
-	if (http_list_directory(r, p, &r->physical.path)) {
+	if (http_list_directory(r, &pconf, &r->physical.path)) {
 		/* dirlisting failed */
 		r->http_status = 403;
 	}
@@ -1069,6 +1124,7 @@ int mod_dirlisting_plugin_init(plugin *p);
 int mod_dirlisting_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "dirlisting";
+	p->thread_safe = 1;
 
 	p->init        = mod_dirlisting_init;
 	p->handle_subrequest_start  = mod_dirlisting_subrequest;
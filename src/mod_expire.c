@@ -25,7 +25,6 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
     time_t *toffsets;
     uint32_t tused;
 } plugin_data;
@@ -184,12 +183,12 @@ static void mod_expire_merge_config(plugin_config * const pconf, const config_pl
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_expire_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_expire_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_expire_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_expire_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -281,19 +280,20 @@ REQUEST_FUNC(mod_expire_handler) {
 	vb = http_header_response_get(r, HTTP_HEADER_CACHE_CONTROL, CONST_STR_LEN("Cache-Control"));
 	if (NULL != vb) return HANDLER_GO_ON;
 
-	mod_expire_patch_config(r, p);
+	plugin_config pconf;
+	mod_expire_patch_config(r, p, &pconf);
 
 	/* check expire.url */
-	ds = p->conf.expire_url
-	  ? (const data_string *)array_match_key_prefix(p->conf.expire_url, &r->uri.path)
+	ds = pconf.expire_url
+	  ? (const data_string *)array_match_key_prefix(pconf.expire_url, &r->uri.path)
 	  : NULL;
 	/* check expire.mimetypes (if no match with expire.url) */
 	if (NULL == ds) {
-		if (NULL == p->conf.expire_mimetypes) return HANDLER_GO_ON;
+		if (NULL == pconf.expire_mimetypes) return HANDLER_GO_ON;
 		vb = http_header_response_get(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"));
 		ds = (NULL != vb)
-		   ? (const data_string *)array_match_key_prefix(p->conf.expire_mimetypes, vb)
-		   : (const data_string *)array_get_element_klen(p->conf.expire_mimetypes, CONST_STR_LEN(""));
+		   ? (const data_string *)array_match_key_prefix(pconf.expire_mimetypes, vb)
+		   : (const data_string *)array_get_element_klen(pconf.expire_mimetypes, CONST_STR_LEN(""));
 		if (NULL == ds) return HANDLER_GO_ON;
 	}
 
@@ -317,8 +317,13 @@ REQUEST_FUNC(mod_expire_handler) {
 
 			/* HTTP/1.0 */
 			buffer_clear(tb);
+		      #ifdef HAVE_GMTIME_R
+			struct tm tm;
+			buffer_append_strftime(tb, "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&expires, &tm));
+		      #else
 			buffer_append_strftime(tb, "%a, %d %b %Y %H:%M:%S GMT", gmtime(&(expires)));
-			http_header_response_set(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Expires"), CONST_BUF_LEN(tb));
+		      #endif
+			http_header_response_set(r, HTTP_HEADER_EXPIRES, CONST_STR_LEN("Expires"), CONST_BUF_LEN(tb));
 
 			/* HTTP/1.1 */
 			buffer_copy_string_len(tb, CONST_STR_LEN("max-age="));
@@ -333,6 +338,7 @@ int mod_expire_plugin_init(plugin *p);
 int mod_expire_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "expire";
+	p->thread_safe = 1;
 
 	p->init        = mod_expire_init;
 	p->cleanup     = mod_expire_free;
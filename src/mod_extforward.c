@@ -135,6 +135,7 @@ static handler_ctx * handler_ctx_init(void) {
 	handler_ctx * hctx;
 	hctx = calloc(1, sizeof(*hctx));
 	force_assert(hctx);
+	heap_nallocs_inc();
 	return hctx;
 }
 
@@ -67,11 +67,11 @@ static void mod_fastcgi_merge_config(plugin_config * const pconf, const config_p
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_fastcgi_patch_config(request_st * const r, plugin_data * const p) {
-    memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
+static void mod_fastcgi_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    memcpy(pconf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_fastcgi_merge_config(&p->conf,p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_fastcgi_merge_config(pconf,p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -285,10 +285,13 @@ static handler_t fcgi_create_env(handler_ctx *hctx) {
 	}
 	request_id = hctx->request_id;
 
+	/* request that backend keep connection open for reuse, if enabled */
+	hctx->keepalive = (0 != host->keepalive_max_idle);
+
 	fcgi_header(&(beginRecord.header), FCGI_BEGIN_REQUEST, request_id, sizeof(beginRecord.body), 0);
 	beginRecord.body.roleB0 = hctx->gw_mode;
 	beginRecord.body.roleB1 = 0;
-	beginRecord.body.flags = 0;
+	beginRecord.body.flags = hctx->keepalive ? FCGI_KEEP_CONN : 0;
 	memset(beginRecord.body.reserved, 0, sizeof(beginRecord.body.reserved));
 
 	buffer_copy_string_len(b, (const char *)&beginRecord, sizeof(beginRecord));
@@ -431,6 +434,11 @@ static handler_t fcgi_recv_parse(request_st * const r, struct http_response_opts
 		if (!(fdevent_fdnode_interest(hctx->fdn) & FDEVENT_IN)
 		    && !(r->conf.stream_response_body & FDEVENT_STREAM_RESPONSE_POLLRDHUP))
 			return HANDLER_GO_ON;
+		/*(backend closed reused connection before sending response;
+		 * gw_backend.c might retry request on new connection)*/
+		if (hctx->conn_reused && !r->resp_body_started
+		    && chunkqueue_is_empty(hctx->rb))
+			return HANDLER_ERROR;
 		log_error(r->conf.errh, __FILE__, __LINE__,
 		  "unexpected end-of-file (perhaps the fastcgi process died):"
 		  "pid: %d socket: %s",
@@ -504,6 +512,12 @@ static handler_t fcgi_recv_parse(request_st * const r, struct http_response_opts
 			}
 			break;
 		case FCGI_END_REQUEST:
+			chunkqueue_mark_written(hctx->rb, packet.len);
+			/* backend connection can be reused (FCGI_KEEP_CONN)
+			 * if no other data was received after FCGI_END_REQUEST */
+			if (hctx->keepalive && packet.request_id == hctx->request_id
+			    && chunkqueue_is_empty(hctx->rb))
+				hctx->keepalive = 2;
 			hctx->request_id = -1; /*(flag request ended)*/
 			fin = 1;
 			break;
@@ -520,14 +534,15 @@ static handler_t fcgi_recv_parse(request_st * const r, struct http_response_opts
 
 static handler_t fcgi_check_extension(request_st * const r, void *p_d, int uri_path_handler) {
 	plugin_data *p = p_d;
+	plugin_config pconf;
 	handler_t rc;
 
 	if (NULL != r->handler_module) return HANDLER_GO_ON;
 
-	mod_fastcgi_patch_config(r, p);
-	if (NULL == p->conf.exts) return HANDLER_GO_ON;
+	mod_fastcgi_patch_config(r, p, &pconf);
+	if (NULL == pconf.exts) return HANDLER_GO_ON;
 
-	rc = gw_check_extension(r, p, uri_path_handler, 0);
+	rc = gw_check_extension(r, p, &pconf, uri_path_handler, 0);
 	if (HANDLER_GO_ON != rc) return rc;
 
 	if (r->handler_module == p->self) {
@@ -563,6 +578,7 @@ int mod_fastcgi_plugin_init(plugin *p);
 int mod_fastcgi_plugin_init(plugin *p) {
 	p->version      = LIGHTTPD_VERSION_ID;
 	p->name         = "fastcgi";
+	p->thread_safe  = 1;
 
 	p->init         = gw_init;
 	p->cleanup      = gw_free;
@@ -22,7 +22,6 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
 /* init the plugin data */
@@ -47,12 +46,12 @@ static void mod_indexfile_merge_config(plugin_config * const pconf, const config
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_indexfile_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_indexfile_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_indexfile_merge_config(&p->conf,p->cvlist+p->cvlist[i].v.u2[0]);
+            mod_indexfile_merge_config(pconf, p->cvlist+p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -91,8 +90,9 @@ URIHANDLER_FUNC(mod_indexfile_subrequest) {
 	if (buffer_string_is_empty(&r->uri.path)) return HANDLER_GO_ON;
 	if (r->uri.path.ptr[buffer_string_length(&r->uri.path) - 1] != '/') return HANDLER_GO_ON;
 
-	mod_indexfile_patch_config(r, p);
-	if (NULL == p->conf.indexfiles) return HANDLER_GO_ON;
+	plugin_config pconf;
+	mod_indexfile_patch_config(r, p, &pconf);
+	if (NULL == pconf.indexfiles) return HANDLER_GO_ON;
 
 	if (r->conf.log_request_handling) {
 		log_error(r->conf.errh, __FILE__, __LINE__, "-- handling the request as Indexfile");
@@ -101,8 +101,8 @@ URIHANDLER_FUNC(mod_indexfile_subrequest) {
 
 	/* indexfile */
 	buffer * const b = r->tmp_buf;
-	for (uint32_t k = 0; k < p->conf.indexfiles->used; ++k) {
-		const data_string * const ds = (data_string *)p->conf.indexfiles->data[k];
+	for (uint32_t k = 0; k < pconf.indexfiles->used; ++k) {
+		const data_string * const ds = (data_string *)pconf.indexfiles->data[k];
 
 		if (ds->value.ptr[0] == '/') {
 			/* if the index-file starts with a prefix as use this file as
@@ -156,6 +156,7 @@ int mod_indexfile_plugin_init(plugin *p);
 int mod_indexfile_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "indexfile";
+	p->thread_safe = 1;
 
 	p->init        = mod_indexfile_init;
 	p->handle_subrequest_start = mod_indexfile_subrequest;
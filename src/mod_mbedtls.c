@@ -198,6 +198,7 @@ handler_ctx_init (void)
 {
     handler_ctx *hctx = calloc(1, sizeof(*hctx));
     force_assert(hctx);
+    heap_nallocs_inc();
     return hctx;
 }
 
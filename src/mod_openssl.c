@@ -110,7 +110,7 @@
 #ifdef HAVE_SESSION_TICKET
 #define TLSEXT_TYPE_session_ticket
 #endif
-static char global_err_buf[WOLFSSL_MAX_ERROR_SZ];
+static __thread_local char global_err_buf[WOLFSSL_MAX_ERROR_SZ];
 #undef ERR_error_string
 #define ERR_error_string(e,b) \
         (wolfSSL_ERR_error_string_n((e),global_err_buf,WOLFSSL_MAX_ERROR_SZ), \
@@ -195,6 +195,7 @@ typedef struct {
     unsigned char ssl_empty_fragments; /* whether to not set SSL_OP_DONT_INSERT_EMPTY_FRAGMENTS */
     unsigned char ssl_use_sslv2;
     unsigned char ssl_use_sslv3;
+    unsigned char ssl_ktls;
     const buffer *ssl_cipher_list;
     const buffer *ssl_dh_file;
     const buffer *ssl_ec_curve;
@@ -244,7 +245,19 @@ static int ssl_is_init;
  *   i.e. handler_ctx *hctx = con->plugin_ctx[plugin_data_singleton->id]; */
 static plugin_data *plugin_data_singleton;
 #define LOCAL_SEND_BUFSIZE (16 * 1024)
-static char *local_send_buffer;
+static __thread_local char local_send_buffer[LOCAL_SEND_BUFSIZE];
+
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* session ticket keys and OCSP stapling responses are shared by all server
+ * threads and are replaced periodically by main thread in handle_trigger */
+static pthread_mutex_t mod_openssl_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define mod_openssl_lock()   pthread_mutex_lock(&mod_openssl_mutex)
+#define mod_openssl_unlock() pthread_mutex_unlock(&mod_openssl_mutex)
+#else
+#define mod_openssl_lock()   do { } while (0)
+#define mod_openssl_unlock() do { } while (0)
+#endif
 
 typedef struct {
     SSL *ssl;
@@ -264,6 +277,7 @@ handler_ctx_init (void)
 {
     handler_ctx *hctx = calloc(1, sizeof(*hctx));
     force_assert(hctx);
+    heap_nallocs_inc();
     return hctx;
 }
 
@@ -395,25 +409,33 @@ ssl_tlsext_ticket_key_cb (SSL *s, unsigned char key_name[16],
 {
     UNUSED(s);
     if (enc) { /* create new session */
+        if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0)
+            return -1; /* insufficient random */
+        mod_openssl_lock();
         tlsext_ticket_key_t *k = tlsext_ticket_key_get();
-        if (NULL == k)
+        if (NULL == k) {
+            mod_openssl_unlock();
             return 0; /* current key does not exist or is not valid */
+        }
         memcpy(key_name, k->tick_key_name, 16);
-        if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0)
-            return -1; /* insufficient random */
         EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, k->tick_aes_key, iv);
         HMAC_Init_ex(hctx, k->tick_hmac_key, sizeof(k->tick_hmac_key),
                      EVP_sha256(), NULL);
+        mod_openssl_unlock();
         return 1;
     }
     else { /* retrieve session */
         int refresh;
+        mod_openssl_lock();
         tlsext_ticket_key_t *k = tlsext_ticket_key_find(key_name, &refresh);
-        if (NULL == k)
+        if (NULL == k) {
+            mod_openssl_unlock();
             return 0;
+        }
         HMAC_Init_ex(hctx, k->tick_hmac_key, sizeof(k->tick_hmac_key),
                      EVP_sha256(), NULL);
         EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, k->tick_aes_key, iv);
+        mod_openssl_unlock();
         return refresh ? 2 : 1;
         /* 'refresh' will trigger issuing new ticket for session
          * even though the current ticket is still valid */
@@ -483,6 +505,7 @@ static void
 mod_openssl_session_ticket_key_check (const plugin_data *p, const time_t cur_ts)
 {
     int rotate = 0;
+    mod_openssl_lock();
     if (p->ssl_stek_file) {
         struct stat st;
         if (0 == stat(p->ssl_stek_file, &st) && st.st_mtime > stek_rotate_ts)
@@ -496,6 +519,7 @@ mod_openssl_session_ticket_key_check (const plugin_data *p, const time_t cur_ts)
         mod_openssl_session_ticket_key_rotate();
         stek_rotate_ts = cur_ts;
     }
+    mod_openssl_unlock();
 }
 
 #endif /* TLSEXT_TYPE_session_ticket */
@@ -512,9 +536,13 @@ ssl_tlsext_status_cb(SSL *ssl, void *arg)
   #endif
 
     handler_ctx *hctx = (handler_ctx *) SSL_get_app_data(ssl);
-    buffer *ssl_stapling = hctx->conf.pc->ssl_stapling;
-    if (NULL == ssl_stapling) return SSL_TLSEXT_ERR_NOACK;
     UNUSED(arg);
+    mod_openssl_lock();
+    buffer *ssl_stapling = hctx->conf.pc->ssl_stapling;
+    if (NULL == ssl_stapling) {
+        mod_openssl_unlock();
+        return SSL_TLSEXT_ERR_NOACK;
+    }
 
     int len = (int)buffer_string_length(ssl_stapling);
 
@@ -523,12 +551,18 @@ ssl_tlsext_status_cb(SSL *ssl, void *arg)
   #else
     /* OpenSSL and LibreSSL require copy (BoringSSL, too, if using compat API)*/
     uint8_t *ocsp_resp = OPENSSL_malloc(len);
+    if (NULL != ocsp_resp)
+        memcpy(ocsp_resp, ssl_stapling->ptr, len);
+    mod_openssl_unlock();
     if (NULL == ocsp_resp)
         return SSL_TLSEXT_ERR_NOACK; /* ignore OCSP request if error occurs */
-    memcpy(ocsp_resp, ssl_stapling->ptr, len);
   #endif
 
-    if (!SSL_set_tlsext_status_ocsp_resp(ssl, ocsp_resp, len)) {
+    const int rc = SSL_set_tlsext_status_ocsp_resp(ssl, ocsp_resp, len);
+  #ifdef WOLFSSL_VERSION /* (ssl_stapling used directly while lock is held) */
+    mod_openssl_unlock();
+  #endif
+    if (!rc) {
         log_error(hctx->r->conf.errh, __FILE__, __LINE__,
           "SSL: failed to set OCSP response for TLS server name %s: %s",
           hctx->r->uri.authority.ptr, ERR_error_string(ERR_get_error(), NULL));
@@ -585,9 +619,6 @@ static int mod_openssl_init_once_openssl (server *srv)
         return 0;
     }
 
-    local_send_buffer = malloc(LOCAL_SEND_BUFSIZE);
-    force_assert(NULL != local_send_buffer);
-
     return 1;
 }
 
@@ -622,7 +653,6 @@ static void mod_openssl_free_openssl (void)
     EVP_cleanup();
   #endif
 
-    free(local_send_buffer);
     ssl_is_init = 0;
 }
 
@@ -1544,8 +1574,12 @@ mod_openssl_cert_cb (SSL *ssl, void *arg)
 
   #if OPENSSL_VERSION_NUMBER >= 0x10002000 \
    && !defined(LIBRESSL_VERSION_NUMBER)
-    if (pc->ssl_pemfile_chain)
-        SSL_set1_chain(ssl, pc->ssl_pemfile_chain);
+    /*(pc->ssl_pemfile_chain might be filled in below by another thread)*/
+    mod_openssl_lock();
+    STACK_OF(X509) * const ssl_pemfile_chain = pc->ssl_pemfile_chain;
+    mod_openssl_unlock();
+    if (ssl_pemfile_chain)
+        SSL_set1_chain(ssl, ssl_pemfile_chain);
    #ifndef BORINGSSL_API_VERSION /* BoringSSL limitation */
     else if (hctx->conf.ssl_ca_file) {
         /* preserve legacy behavior whereby openssl will reuse CAs trusted for
@@ -1567,7 +1601,15 @@ mod_openssl_cert_cb (SSL *ssl, void *arg)
         else { /* copy chain for future reuse */
             STACK_OF(X509) *chain = NULL;
             SSL_get0_chain_certs(ssl, &chain);
-            pc->ssl_pemfile_chain = X509_chain_up_ref(chain);
+            chain = X509_chain_up_ref(chain);
+            mod_openssl_lock();
+            if (NULL == pc->ssl_pemfile_chain) {
+                pc->ssl_pemfile_chain = chain;
+                chain = NULL;
+            }
+            mod_openssl_unlock();
+            if (chain) /*(chain built concurrently by another thread)*/
+                sk_X509_pop_free(chain, X509_free);
             SSL_set1_chain_cert_store(ssl, NULL);
         }
     }
@@ -1592,9 +1634,13 @@ mod_openssl_cert_cb (SSL *ssl, void *arg)
   #ifndef OPENSSL_NO_OCSP
   #ifdef BORINGSSL_API_VERSION
     /* BoringSSL suggests API different than SSL_CTX_set_tlsext_status_cb() */
+    mod_openssl_lock();
     buffer *ocsp_resp = pc->ssl_stapling;
-    if (NULL != ocsp_resp
-        && !SSL_set_ocsp_response(ssl, (uint8_t *)CONST_BUF_LEN(ocsp_resp))) {
+    const int rc = (NULL == ocsp_resp
+                    || SSL_set_ocsp_response(ssl,
+                                             (uint8_t *)CONST_BUF_LEN(ocsp_resp)));
+    mod_openssl_unlock();
+    if (!rc) {
         log_error(hctx->r->conf.errh, __FILE__, __LINE__,
           "SSL: failed to set OCSP response for TLS server name %s: %s",
           hctx->r->uri.authority.ptr, ERR_error_string(ERR_get_error(), NULL));
@@ -2108,8 +2154,11 @@ mod_openssl_refresh_stapling_files (server *srv, const plugin_data *p, const tim
             if (cpv->k_id != 0) continue; /* k_id == 0 for ssl.pemfile */
             if (cpv->vtype != T_CONFIG_LOCAL) continue;
             plugin_cert *pc = cpv->v.v;
-            if (!buffer_string_is_empty(pc->ssl_stapling_file))
+            if (!buffer_string_is_empty(pc->ssl_stapling_file)) {
+                mod_openssl_lock();
                 mod_openssl_refresh_stapling_file(srv, pc, cur_ts);
+                mod_openssl_unlock();
+            }
         }
     }
 }
@@ -2400,14 +2449,13 @@ mod_openssl_alpn_select_cb (SSL *ssl, const unsigned char **out, unsigned char *
         n = in[i++];
         if (i+n > inlen || 0 == n) break;
         switch (n) {
-         #if 0
           case 2:  /* "h2" */
-            if (in[i] == 'h' && in[i+1] == '2') {
+            if (in[i] == 'h' && in[i+1] == '2'
+                && hctx->r->con->srv->srvconf.h2proto) {
                 proto = MOD_OPENSSL_ALPN_H2;
                 break;
             }
             continue;
-         #endif
           case 8:  /* "http/1.1" "http/1.0" */
             if (0 == memcmp(in+i, "http/1.", 7)) {
                 if (in[i+7] == '1') {
@@ -2702,6 +2750,18 @@ network_init_ssl (server *srv, plugin_config_socket *s, plugin_data *p)
           #endif
         }
 
+        if (s->ssl_ktls) {
+          #ifdef SSL_OP_ENABLE_KTLS /* openssl 3.0 */
+            /* kernel TLS offload (if supported by kernel and negotiated
+             * cipher); OpenSSL falls back to user space TLS if not */
+            ssloptions |= SSL_OP_ENABLE_KTLS;
+          #else
+            log_error(srv->errh, __FILE__, __LINE__,
+              "WARNING: SSL: ssl.ktls not supported by the "
+              "openssl version used to compile lighttpd with");
+          #endif
+        }
+
         SSL_CTX_set_options(s->ssl_ctx, ssloptions);
         SSL_CTX_set_info_callback(s->ssl_ctx, ssl_info_callback);
 
@@ -3023,6 +3083,9 @@ mod_openssl_set_defaults_sockets(server *srv, plugin_data *p)
      ,{ CONST_STR_LEN("ssl.stek-file"),
         T_CONFIG_STRING,
         T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("ssl.ktls"),
+        T_CONFIG_BOOL,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -3129,6 +3192,9 @@ mod_openssl_set_defaults_sockets(server *srv, plugin_data *p)
                 if (!buffer_is_empty(cpv->v.b))
                     p->ssl_stek_file = cpv->v.b->ptr;
                 break;
+              case 11:/* ssl.ktls */
+                conf.ssl_ktls = (0 != cpv->v.u);
+                break;
               default:/* should not happen */
                 break;
             }
@@ -3492,7 +3558,7 @@ load_next_chunk (chunkqueue * const cq, off_t max_bytes,
      * it has to stay at the same location all the time to satisfy the needs
      * of SSL_write to pass the SAME parameter in case of a _WANT_WRITE
      *
-     * buffer is allocated once, is NOT realloced (note: not thread-safe)
+     * buffer is allocated once per thread, is NOT realloced
      *
      * (Note: above restriction no longer true since SSL_CTX_set_mode() is
      *        called with SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER)
@@ -3552,11 +3618,9 @@ load_next_chunk (chunkqueue * const cq, off_t max_bytes,
             if (toSend > LOCAL_SEND_BUFSIZE) toSend = LOCAL_SEND_BUFSIZE;
             if (toSend > max_bytes) toSend = max_bytes;
 
-            if (-1 == lseek(c->file.fd, offset, SEEK_SET)) {
-                log_perror(errh, __FILE__, __LINE__, "lseek");
-                return -1;
-            }
-            if (-1 == (toSend = read(c->file.fd, local_send_buffer, toSend))) {
+            toSend = chunk_file_pread(c->file.fd, local_send_buffer,
+                                      (size_t)toSend, offset);
+            if (-1 == toSend) {
                 log_perror(errh, __FILE__, __LINE__, "read");
                 return -1;
             }
@@ -3575,6 +3639,90 @@ static int
 mod_openssl_close_notify(handler_ctx *hctx);
 
 
+static int
+mod_openssl_write_err (SSL *ssl, int wr, connection *con, log_error_st *errh)
+{
+    int ssl_r;
+    unsigned long err;
+
+    switch ((ssl_r = SSL_get_error(ssl, wr))) {
+    case SSL_ERROR_WANT_READ:
+        con->is_readable = -1;
+        return 0; /* try again later */
+    case SSL_ERROR_WANT_WRITE:
+        con->is_writable = -1;
+        return 0; /* try again later */
+    case SSL_ERROR_SYSCALL:
+        /* perhaps we have error waiting in our error-queue */
+        if (0 != (err = ERR_get_error())) {
+            do {
+                log_error(errh, __FILE__, __LINE__,
+                  "SSL: %d %d %s",ssl_r,wr,ERR_error_string(err,NULL));
+            } while((err = ERR_get_error()));
+        } else if (wr == -1) {
+            /* no, but we have errno */
+            switch(errno) {
+            case EPIPE:
+            case ECONNRESET:
+                return -2;
+            default:
+                log_perror(errh, __FILE__, __LINE__,
+                  "SSL: %d %d", ssl_r, wr);
+                break;
+            }
+        } else {
+            /* neither error-queue nor errno ? */
+            log_perror(errh, __FILE__, __LINE__,
+              "SSL (error): %d %d", ssl_r, wr);
+        }
+        break;
+
+    case SSL_ERROR_ZERO_RETURN:
+        /* clean shutdown on the remote side */
+
+        if (wr == 0) return -2;
+
+        /* fall through */
+    default:
+        while((err = ERR_get_error())) {
+            log_error(errh, __FILE__, __LINE__,
+              "SSL: %d %d %s", ssl_r, wr, ERR_error_string(err, NULL));
+        }
+        break;
+    }
+    return -1;
+}
+
+
+#if defined(BIO_get_ktls_send) && defined(SSL_OP_ENABLE_KTLS)
+static int
+mod_openssl_write_file_chunk_ktls (connection *con, SSL *ssl, chunkqueue *cq, off_t *max_bytes, log_error_st *errh)
+{
+    /* kTLS: kernel encrypts; send file data without copying to user space */
+    chunk * const c = cq->first;
+    if (0 != chunkqueue_open_file_chunk(cq, errh)) return -1;
+
+    const off_t offset = c->file.start + c->offset;
+    off_t toSend = c->file.length - c->offset;
+    if (toSend > *max_bytes) toSend = *max_bytes;
+
+    ERR_clear_error();
+    ossl_ssize_t wr = SSL_sendfile(ssl, c->file.fd, offset, (size_t)toSend, 0);
+    if (wr <= 0) {
+        if (wr < 0 && (errno == EPIPE || errno == ECONNRESET)) {
+            ERR_clear_error();
+            return -2;
+        }
+        return mod_openssl_write_err(ssl, wr < 0 ? -1 : 0, con, errh);
+    }
+
+    chunkqueue_mark_written(cq, wr);
+    *max_bytes -= wr;
+    return (wr < toSend) ? 1 : 0; /* 1: try again later */
+}
+#endif
+
+
 static int
 connection_write_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
 {
@@ -3586,11 +3734,24 @@ connection_write_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
 
     chunkqueue_remove_finished_chunks(cq);
 
+  #if defined(BIO_get_ktls_send) && defined(SSL_OP_ENABLE_KTLS)
+    /*(kTLS is enabled (or not) when TLS handshake completes)*/
+    const int ktls_send = BIO_get_ktls_send(SSL_get_wbio(ssl));
+  #endif
+
     while (max_bytes > 0 && NULL != cq->first) {
         const char *data;
         size_t data_len;
         int wr;
 
+      #if defined(BIO_get_ktls_send) && defined(SSL_OP_ENABLE_KTLS)
+        if (ktls_send && cq->first->type == FILE_CHUNK) {
+            wr = mod_openssl_write_file_chunk_ktls(con,ssl,cq,&max_bytes,errh);
+            if (0 == wr) continue;
+            return (wr > 0) ? 0 : wr; /*(wr > 0: partial write)*/
+        }
+      #endif
+
         if (0 != load_next_chunk(cq,max_bytes,&data,&data_len,errh)) return -1;
 
         /**
@@ -3612,57 +3773,7 @@ connection_write_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
             return -1;
         }
 
-        if (wr <= 0) {
-            int ssl_r;
-            unsigned long err;
-
-            switch ((ssl_r = SSL_get_error(ssl, wr))) {
-            case SSL_ERROR_WANT_READ:
-                con->is_readable = -1;
-                return 0; /* try again later */
-            case SSL_ERROR_WANT_WRITE:
-                con->is_writable = -1;
-                return 0; /* try again later */
-            case SSL_ERROR_SYSCALL:
-                /* perhaps we have error waiting in our error-queue */
-                if (0 != (err = ERR_get_error())) {
-                    do {
-                        log_error(errh, __FILE__, __LINE__,
-                          "SSL: %d %d %s",ssl_r,wr,ERR_error_string(err,NULL));
-                    } while((err = ERR_get_error()));
-                } else if (wr == -1) {
-                    /* no, but we have errno */
-                    switch(errno) {
-                    case EPIPE:
-                    case ECONNRESET:
-                        return -2;
-                    default:
-                        log_perror(errh, __FILE__, __LINE__,
-                          "SSL: %d %d", ssl_r, wr);
-                        break;
-                    }
-                } else {
-                    /* neither error-queue nor errno ? */
-                    log_perror(errh, __FILE__, __LINE__,
-                      "SSL (error): %d %d", ssl_r, wr);
-                }
-                break;
-
-            case SSL_ERROR_ZERO_RETURN:
-                /* clean shutdown on the remote side */
-
-                if (wr == 0) return -2;
-
-                /* fall through */
-            default:
-                while((err = ERR_get_error())) {
-                    log_error(errh, __FILE__, __LINE__,
-                      "SSL: %d %d %s", ssl_r, wr, ERR_error_string(err, NULL));
-                }
-                break;
-            }
-            return -1;
-        }
+        if (wr <= 0) return mod_openssl_write_err(ssl, wr, con, errh);
 
         chunkqueue_mark_written(cq, wr);
         max_bytes -= wr;
@@ -3719,6 +3830,8 @@ connection_read_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
                 len = -1;
                 break;
             }
+            if (hctx->alpn == MOD_OPENSSL_ALPN_H2)
+                hctx->r->http_version = HTTP_VERSION_2;
             hctx->alpn = 0;
         }
       #endif
@@ -4248,6 +4361,7 @@ int mod_openssl_plugin_init (plugin *p)
 {
     p->version      = LIGHTTPD_VERSION_ID;
     p->name         = "openssl";
+    p->thread_safe  = 1;
     p->init         = mod_openssl_init;
     p->cleanup      = mod_openssl_free;
     p->priv_defaults= mod_openssl_set_defaults;
@@ -9,6 +9,7 @@
 #include "buffer.h"
 #include "fdevent.h"
 #include "http_kv.h"
+#include "http_chunk.h"
 #include "http_header.h"
 #include "log.h"
 #include "sock_addr.h"
@@ -18,8 +19,8 @@
  *
  * HTTP reverse proxy
  *
- * TODO:      - HTTP/1.1
- *            - HTTP/1.1 persistent connection with upstream servers
+ * HTTP/1.1 persistent connections with upstream servers are reused
+ * if "keep-alive-max-idle" is set for the backend host (see gw_backend.c)
  */
 
 /* (future: might split struct and move part to http-header-glue.c) */
@@ -54,8 +55,7 @@ typedef struct {
 
 typedef struct {
     PLUGIN_DATA;
-    pid_t srv_pid; /* must match layout of gw_plugin_data through conf member */
-    plugin_config conf;
+    pid_t srv_pid; /* must match layout of gw_plugin_data through srv_pid */
     plugin_config defaults;
 } plugin_data;
 
@@ -66,6 +66,7 @@ typedef struct {
 	gw_handler_ctx gw;
 	http_response_opts opts;
 	plugin_config conf;
+	off_t resp_body_len; /* response body received (keep-alive to backend) */
 } handler_ctx;
 
 
@@ -145,12 +146,12 @@ static void mod_proxy_merge_config(plugin_config * const pconf, const config_plu
 }
 
 
-static void mod_proxy_patch_config(request_st * const r, plugin_data * const p)
+static void mod_proxy_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf)
 {
-    memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
+    memcpy(pconf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_proxy_merge_config(&p->conf, p->cvlist+p->cvlist[i].v.u2[0]);
+            mod_proxy_merge_config(pconf, p->cvlist+p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -857,6 +858,107 @@ static handler_t proxy_stdin_append(gw_handler_ctx *hctx) {
 }
 
 
+static uint32_t proxy_response_header_len(const buffer * const b) {
+    /* (end of headers is first blank line, same as in
+     *  http_response_parse_headers()) */
+    for (const char *n = b->ptr; (n = strchr(n, '\n')); ++n) {
+        if (n[1] == '\n')
+            return (uint32_t)(n + 2 - b->ptr);
+        if (n[1] == '\r' && n[2] == '\n')
+            return (uint32_t)(n + 3 - b->ptr);
+    }
+    return 0;
+}
+
+
+static int proxy_response_keepalive(const char *s, uint32_t hlen) {
+    /* check Status-Line and Connection header in (complete) response headers
+     * to determine if backend will keep connection open after response */
+    if (hlen < sizeof("HTTP/1.1 200\n")-1 || 0 != memcmp(s, "HTTP/1.1 ", 9))
+        return 0;
+    for (const char * const e = s + hlen; (s = memchr(s, '\n', e - s)); ) {
+        ++s;
+        if (e - s > 11 && (s[10] == ':')
+            && buffer_eq_icase_ssn(s, CONST_STR_LEN("Connection"))) {
+            const char *v = s + 11;
+            const char *n = memchr(v, '\n', e - v);
+            if (NULL == n) break;
+            if (n[-1] == '\r') --n;
+            if (http_header_str_contains_token(v, (uint32_t)(n - v),
+                                               CONST_STR_LEN("close")))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+
+static int proxy_response_complete(request_st * const r, handler_ctx * const hctx) {
+    /* response end is determined by Content-Length or chunked encoding
+     * when backend connection is kept open (instead of backend closing) */
+    if (r->http_method == HTTP_METHOD_HEAD
+        || r->http_status == 204 || r->http_status == 304)
+        return 1;
+    if (r->resp_decode_chunked)
+        return (r->gw_dechunk && r->gw_dechunk->done);
+    if (r->content_length >= 0) {
+        if (hctx->resp_body_len < r->content_length) return 0;
+        if (hctx->resp_body_len == r->content_length) return 1;
+    }
+    /* read until backend closes connection */
+    hctx->gw.keepalive = 0;
+    return 0;
+}
+
+
+static handler_t proxy_response_parse(request_st * const r, struct http_response_opts_t *opts, buffer * const b, size_t n) {
+    /* (used when backend connection might be kept open for reuse) */
+    handler_ctx * const hctx = (handler_ctx *)opts->pdata;
+
+    if (0 == n) {
+        /*(backend closed reused connection before sending response;
+         * gw_backend.c might retry request on new connection)*/
+        if (hctx->gw.conn_reused && !r->resp_body_started
+            && buffer_string_is_empty(b))
+            return HANDLER_ERROR;
+        hctx->gw.keepalive = 0;
+        return HANDLER_FINISHED; /* read finished */
+    }
+
+    if (0 == r->resp_body_started) {
+        /* split header from body */
+        const uint32_t blen = buffer_string_length(b);
+        const uint32_t hlen = proxy_response_header_len(b);
+        if (hlen && !proxy_response_keepalive(b->ptr, hlen))
+            hctx->gw.keepalive = 0;
+        handler_t rc = http_response_parse_headers(r, opts, b);
+        if (rc != HANDLER_GO_ON) return rc;
+        /* accumulate response in b until headers completed (or error) */
+        if (0 == r->resp_body_started) return HANDLER_GO_ON;
+        buffer_clear(b);
+        if (r->gw_dechunk) /* find end of chunked response */
+            r->gw_dechunk->decode = 1;
+        hctx->resp_body_len = (off_t)(blen - hlen);
+    }
+    else {
+        hctx->resp_body_len += (off_t)buffer_string_length(b);
+        if (0 != http_chunk_decode_append_buffer(r, b)) {
+            /* error writing to tempfile;
+             * truncate response or send 500 if nothing sent yet */
+            return HANDLER_ERROR;
+        }
+        buffer_clear(b);
+    }
+
+    if (hctx->gw.keepalive && proxy_response_complete(r, hctx)) {
+        hctx->gw.keepalive = 2; /* backend connection can be reused */
+        return HANDLER_FINISHED;
+    }
+
+    return HANDLER_GO_ON;
+}
+
+
 static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 	handler_ctx *hctx = (handler_ctx *)gwhctx;
 	request_st * const r = hctx->gw.r;
@@ -1013,7 +1115,20 @@ static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 		http_header_remap_uri(b, buffer_string_length(b) - vlen - 2, &hctx->conf.header, 1);
 	}
 
-	if (connhdr && !proxy_force_http10 && r->http_version >= HTTP_VERSION_1_1
+	/* keep backend connection open for reuse if enabled for backend host
+	 * (HTTP/1.1 connections are persistent unless Connection: close) */
+	hctx->gw.keepalive = (0 != hctx->gw.host->keepalive_max_idle
+			      && !proxy_force_http10
+			      && buffer_string_is_empty(upgrade));
+	hctx->gw.opts.parse = hctx->gw.keepalive ? proxy_response_parse : NULL;
+	hctx->resp_body_len = 0;
+
+	if (hctx->gw.keepalive) {
+		if (!buffer_string_is_empty(te))
+			buffer_append_string_len(b, CONST_STR_LEN("Connection: te\r\n"));
+		buffer_append_string_len(b, CONST_STR_LEN("\r\n"));
+	}
+	else if (connhdr && !proxy_force_http10 && r->http_version >= HTTP_VERSION_1_1
 	    && !buffer_eq_icase_slen(connhdr, CONST_STR_LEN("close"))) {
 		/* mod_proxy always sends Connection: close to backend */
 		buffer_append_string_len(b, CONST_STR_LEN("Connection: close"));
@@ -1061,14 +1176,15 @@ static handler_t proxy_response_headers(request_st * const r, struct http_respon
     /* response headers just completed */
     handler_ctx *hctx = (handler_ctx *)opts->pdata;
 
-    if (r->resp_htags & HTTP_HEADER_UPGRADE) {
+    if (light_btst(r->resp_htags, HTTP_HEADER_UPGRADE)) {
         if (hctx->conf.header.upgrade && r->http_status == 101) {
             /* 101 Switching Protocols; transition to transparent proxy */
+            hctx->gw.keepalive = 0;
             gw_set_transparent(&hctx->gw);
             http_response_upgrade_read_body_unknown(r);
         }
         else {
-            r->resp_htags &= ~HTTP_HEADER_UPGRADE;
+            light_bclr(r->resp_htags, HTTP_HEADER_UPGRADE);
           #if 0
             /* preserve prior questionable behavior; likely broken behavior
              * anyway if backend thinks connection is being upgraded but client
@@ -1085,15 +1201,15 @@ static handler_t proxy_response_headers(request_st * const r, struct http_respon
         && NULL == hctx->conf.header.hosts_response)
         return HANDLER_GO_ON;
 
-    if (r->resp_htags & HTTP_HEADER_LOCATION) {
+    if (light_btst(r->resp_htags, HTTP_HEADER_LOCATION)) {
         buffer *vb = http_header_response_get(r, HTTP_HEADER_LOCATION, CONST_STR_LEN("Location"));
         if (vb) http_header_remap_uri(vb, 0, &hctx->conf.header, 0);
     }
-    if (r->resp_htags & HTTP_HEADER_CONTENT_LOCATION) {
+    if (light_btst(r->resp_htags, HTTP_HEADER_CONTENT_LOCATION)) {
         buffer *vb = http_header_response_get(r, HTTP_HEADER_CONTENT_LOCATION, CONST_STR_LEN("Content-Location"));
         if (vb) http_header_remap_uri(vb, 0, &hctx->conf.header, 0);
     }
-    if (r->resp_htags & HTTP_HEADER_SET_COOKIE) {
+    if (light_btst(r->resp_htags, HTTP_HEADER_SET_COOKIE)) {
         buffer *vb = http_header_response_get(r, HTTP_HEADER_SET_COOKIE, CONST_STR_LEN("Set-Cookie"));
         if (vb) http_header_remap_setcookie(vb, 0, &hctx->conf.header);
     }
@@ -1103,14 +1219,16 @@ static handler_t proxy_response_headers(request_st * const r, struct http_respon
 
 static handler_t mod_proxy_check_extension(request_st * const r, void *p_d) {
 	plugin_data *p = p_d;
+	plugin_config pconf;
 	handler_t rc;
 
 	if (NULL != r->handler_module) return HANDLER_GO_ON;
 
-	mod_proxy_patch_config(r, p);
-	if (NULL == p->conf.gw.exts) return HANDLER_GO_ON;
+	mod_proxy_patch_config(r, p, &pconf);
+	if (NULL == pconf.gw.exts) return HANDLER_GO_ON;
 
-	rc = gw_check_extension(r, (gw_plugin_data *)p, 1, sizeof(handler_ctx));
+	rc = gw_check_extension(r, (gw_plugin_data *)p, &pconf.gw, 1,
+	                        sizeof(handler_ctx));
 	if (HANDLER_GO_ON != rc) return rc;
 
 	if (r->handler_module == p->self) {
@@ -1121,7 +1239,7 @@ static handler_t mod_proxy_check_extension(request_st * const r, void *p_d) {
 		hctx->gw.opts.pdata = hctx;
 		hctx->gw.opts.headers = proxy_response_headers;
 
-		hctx->conf = p->conf; /*(copies struct)*/
+		hctx->conf = pconf; /*(copies struct)*/
 		hctx->conf.header.http_host = r->http_host;
 		hctx->conf.header.upgrade  &= (r->http_version == HTTP_VERSION_1_1);
 		/* mod_proxy currently sends all backend requests as http.
@@ -1155,6 +1273,7 @@ int mod_proxy_plugin_init(plugin *p);
 int mod_proxy_plugin_init(plugin *p) {
 	p->version      = LIGHTTPD_VERSION_ID;
 	p->name         = "proxy";
+	p->thread_safe  = 1;
 
 	p->init         = mod_proxy_init;
 	p->cleanup      = mod_proxy_free;
@@ -20,7 +20,6 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
 INIT_FUNC(mod_redirect_init) {
@@ -66,12 +65,12 @@ static void mod_redirect_merge_config(plugin_config * const pconf, const config_
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_redirect_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_redirect_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_redirect_merge_config(&p->conf, p->cvlist+p->cvlist[i].v.u2[0]);
+            mod_redirect_merge_config(pconf, p->cvlist+p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -152,14 +151,15 @@ URIHANDLER_FUNC(mod_redirect_uri_handler) {
     pcre_keyvalue_ctx ctx;
     handler_t rc;
 
-    mod_redirect_patch_config(r, p);
-    if (!p->conf.redirect || !p->conf.redirect->used) return HANDLER_GO_ON;
+    plugin_config pconf;
+    mod_redirect_patch_config(r, p, &pconf);
+    if (!pconf.redirect || !pconf.redirect->used) return HANDLER_GO_ON;
 
     ctx.cache = NULL;
-    if (p->conf.redirect->x0) { /*(p->conf.redirect->x0 is context_idx)*/
+    if (pconf.redirect->x0) { /*(pconf.redirect->x0 is context_idx)*/
         ctx.cond_match_count =
-          r->cond_cache[p->conf.redirect->x0].patterncount;
-        ctx.cache = r->cond_match + p->conf.redirect->x0;
+          r->cond_cache[pconf.redirect->x0].patterncount;
+        ctx.cache = r->cond_match + pconf.redirect->x0;
     }
     ctx.burl = &burl;
     burl.scheme    = &r->uri.scheme;
@@ -174,13 +174,13 @@ URIHANDLER_FUNC(mod_redirect_uri_handler) {
      * e.g. redirect /base/ to /index.php?section=base
      */
     buffer * const tb = r->tmp_buf;
-    rc = pcre_keyvalue_buffer_process(p->conf.redirect, &ctx,
+    rc = pcre_keyvalue_buffer_process(pconf.redirect, &ctx,
                                       &r->target, tb);
     if (HANDLER_FINISHED == rc) {
         http_header_response_set(r, HTTP_HEADER_LOCATION,
                                  CONST_STR_LEN("Location"),
                                  CONST_BUF_LEN(tb));
-        r->http_status = p->conf.redirect_code;
+        r->http_status = pconf.redirect_code;
         r->handler_module = NULL;
         r->resp_body_finished = 1;
     }
@@ -196,6 +196,7 @@ int mod_redirect_plugin_init(plugin *p);
 int mod_redirect_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "redirect";
+	p->thread_safe = 1;
 
 	p->init        = mod_redirect_init;
 	p->handle_uri_clean  = mod_redirect_uri_handler;
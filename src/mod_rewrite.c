@@ -22,7 +22,6 @@ enum { REWRITE_STATE_REWRITTEN = 1024, REWRITE_STATE_FINISHED = 2048}; /*flags*/
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
 INIT_FUNC(mod_rewrite_init) {
@@ -84,12 +83,12 @@ static void mod_rewrite_merge_config(plugin_config * const pconf, const config_p
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_rewrite_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_rewrite_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_rewrite_merge_config(&p->conf, p->cvlist+p->cvlist[i].v.u2[0]);
+            mod_rewrite_merge_config(pconf, p->cvlist+p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -319,29 +318,32 @@ URIHANDLER_FUNC(mod_rewrite_physical) {
 
     if (NULL != r->handler_module) return HANDLER_GO_ON;
 
-    mod_rewrite_patch_config(r, p);
-    if (!p->conf.rewrite_NF || !p->conf.rewrite_NF->used) return HANDLER_GO_ON;
+    plugin_config pconf;
+    mod_rewrite_patch_config(r, p, &pconf);
+    if (!pconf.rewrite_NF || !pconf.rewrite_NF->used) return HANDLER_GO_ON;
 
     /* skip if physical.path is a regular file */
     stat_cache_entry *sce = stat_cache_get_entry(&r->physical.path);
     if (sce && S_ISREG(sce->st.st_mode)) return HANDLER_GO_ON;
 
-    return process_rewrite_rules(r, p, p->conf.rewrite_NF);
+    return process_rewrite_rules(r, p, pconf.rewrite_NF);
 }
 
 URIHANDLER_FUNC(mod_rewrite_uri_handler) {
     plugin_data *p = p_d;
 
-    mod_rewrite_patch_config(r, p);
-    if (!p->conf.rewrite || !p->conf.rewrite->used) return HANDLER_GO_ON;
+    plugin_config pconf;
+    mod_rewrite_patch_config(r, p, &pconf);
+    if (!pconf.rewrite || !pconf.rewrite->used) return HANDLER_GO_ON;
 
-    return process_rewrite_rules(r, p, p->conf.rewrite);
+    return process_rewrite_rules(r, p, pconf.rewrite);
 }
 
 int mod_rewrite_plugin_init(plugin *p);
 int mod_rewrite_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "rewrite";
+	p->thread_safe = 1;
 
 	p->init        = mod_rewrite_init;
 	/* it has to stay _raw as we are matching on uri + querystring
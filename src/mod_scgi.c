@@ -54,11 +54,11 @@ static void mod_scgi_merge_config(plugin_config * const pconf, const config_plug
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_scgi_patch_config(request_st * const r, plugin_data * const p) {
-    memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
+static void mod_scgi_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    memcpy(pconf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_scgi_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_scgi_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -281,14 +281,15 @@ static handler_t scgi_create_env(handler_ctx *hctx) {
 
 static handler_t scgi_check_extension(request_st * const r, void *p_d, int uri_path_handler) {
 	plugin_data *p = p_d;
+	plugin_config pconf;
 	handler_t rc;
 
 	if (NULL != r->handler_module) return HANDLER_GO_ON;
 
-	mod_scgi_patch_config(r, p);
-	if (NULL == p->conf.exts) return HANDLER_GO_ON;
+	mod_scgi_patch_config(r, p, &pconf);
+	if (NULL == pconf.exts) return HANDLER_GO_ON;
 
-	rc = gw_check_extension(r, p, uri_path_handler, 0);
+	rc = gw_check_extension(r, p, &pconf, uri_path_handler, 0);
 	if (HANDLER_GO_ON != rc) return rc;
 
 	if (r->handler_module == p->self) {
@@ -317,6 +318,7 @@ int mod_scgi_plugin_init(plugin *p);
 int mod_scgi_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name         = "scgi";
+	p->thread_safe  = 1;
 
 	p->init         = gw_init;
 	p->cleanup      = gw_free;
@@ -31,14 +31,9 @@ typedef struct {
     plugin_config conf;
 } handler_ctx;
 
-static handler_ctx * handler_ctx_init(void) {
-    handler_ctx * const hctx = calloc(1, sizeof(handler_ctx));
-    force_assert(hctx);
-    return hctx;
-}
-
-static void handler_ctx_free(handler_ctx *hctx) {
-    free(hctx);
+static handler_ctx * handler_ctx_init(request_st * const r) {
+    /* (request-lifetime; released in request_reset()) */
+    return request_arena_alloc(r, sizeof(handler_ctx));
 }
 
 INIT_FUNC(mod_setenv_init) {
@@ -151,7 +146,7 @@ URIHANDLER_FUNC(mod_setenv_uri_handler) {
     plugin_data *p = p_d;
     handler_ctx *hctx = r->plugin_ctx[p->id];
     if (!hctx)
-        r->plugin_ctx[p->id] = hctx = handler_ctx_init();
+        r->plugin_ctx[p->id] = hctx = handler_ctx_init(r);
     else if (hctx->handled)
         return HANDLER_GO_ON;
     hctx->handled = 1;
@@ -250,7 +245,7 @@ REQUEST_FUNC(mod_setenv_handle_response_start) {
 
 REQUEST_FUNC(mod_setenv_handle_request_reset) {
     void ** const hctx = r->plugin_ctx+((plugin_data_base *)p_d)->id;
-    if (*hctx) { handler_ctx_free(*hctx); *hctx = NULL; }
+    *hctx = NULL; /*(handler_ctx allocated from request arena)*/
     return HANDLER_GO_ON;
 }
 
@@ -258,6 +253,7 @@ int mod_setenv_plugin_init(plugin *p);
 int mod_setenv_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "setenv";
+	p->thread_safe = 1;
 
 	p->init        = mod_setenv_init;
 	p->set_defaults= mod_setenv_set_defaults;
@@ -40,6 +40,7 @@
 static handler_ctx * handler_ctx_init(plugin_data *p, log_error_st *errh) {
 	handler_ctx *hctx = calloc(1, sizeof(*hctx));
 	force_assert(hctx);
+	heap_nallocs_inc();
 	hctx->errh = errh;
 	hctx->timefmt = p->timefmt;
 	hctx->stat_fn = p->stat_fn;
@@ -26,7 +26,6 @@ typedef struct {
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
-    plugin_config conf;
 } plugin_data;
 
 INIT_FUNC(mod_staticfile_init) {
@@ -55,13 +54,12 @@ static void mod_staticfile_merge_config(plugin_config * const pconf, const confi
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_staticfile_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_staticfile_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_staticfile_merge_config(&p->conf,
-                                        p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_staticfile_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -104,17 +102,18 @@ URIHANDLER_FUNC(mod_staticfile_subrequest) {
     if (NULL != r->handler_module) return HANDLER_GO_ON;
     if (!http_method_get_head_post(r->http_method)) return HANDLER_GO_ON;
 
-    mod_staticfile_patch_config(r, p);
+    plugin_config pconf;
+    mod_staticfile_patch_config(r, p, &pconf);
 
-    if (p->conf.disable_pathinfo && !buffer_string_is_empty(&r->pathinfo)) {
+    if (pconf.disable_pathinfo && !buffer_string_is_empty(&r->pathinfo)) {
         if (r->conf.log_request_handling)
             log_error(r->conf.errh, __FILE__, __LINE__,
               "-- NOT handling file as static file, pathinfo forbidden");
         return HANDLER_GO_ON;
     }
 
-    if (p->conf.exclude_ext
-        && array_match_value_suffix(p->conf.exclude_ext, &r->physical.path)) {
+    if (pconf.exclude_ext
+        && array_match_value_suffix(pconf.exclude_ext, &r->physical.path)) {
         if (r->conf.log_request_handling)
             log_error(r->conf.errh, __FILE__, __LINE__,
               "-- NOT handling file as static file, extension forbidden");
@@ -126,7 +125,7 @@ URIHANDLER_FUNC(mod_staticfile_subrequest) {
           "-- handling file as static file");
     }
 
-    if (!p->conf.etags_used) r->conf.etag_flags = 0;
+    if (!pconf.etags_used) r->conf.etag_flags = 0;
     http_response_send_file(r, &r->physical.path);
 
     return HANDLER_FINISHED;
@@ -137,6 +136,7 @@ int mod_staticfile_plugin_init(plugin *p);
 int mod_staticfile_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "staticfile";
+	p->thread_safe = 1;
 
 	p->init        = mod_staticfile_init;
 	p->handle_subrequest_start = mod_staticfile_subrequest;
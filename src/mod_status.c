@@ -16,6 +16,18 @@
 #include <time.h>
 #include <stdio.h>
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* counters below are updated once per second by main thread and read by
+ * status pages in any event loop thread (server.threads) */
+static pthread_mutex_t mod_status_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define mod_status_lock()   pthread_mutex_lock(&mod_status_mutex)
+#define mod_status_unlock() pthread_mutex_unlock(&mod_status_mutex)
+#else
+#define mod_status_lock()   do { } while (0)
+#define mod_status_unlock() do { } while (0)
+#endif
+
 typedef struct {
     const buffer *config_url;
     const buffer *status_url;
@@ -27,7 +39,9 @@ typedef struct {
 typedef struct {
 	PLUGIN_DATA;
 	plugin_config defaults;
-	plugin_config conf;
+
+	uint64_t requests_cnt; /* requests completed in current second */
+	uint64_t bytes_out;    /* connection_bytes_out at previous trigger */
 
 	double traffic_out;
 	double requests;
@@ -74,12 +88,12 @@ static void mod_status_merge_config(plugin_config * const pconf, const config_pl
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_status_patch_config(request_st * const r, plugin_data * const p) {
-    p->conf = p->defaults; /* copy small struct instead of memcpy() */
-    /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
+static void mod_status_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    *pconf = p->defaults; /* copy small struct instead of memcpy() */
+    /*memcpy(pconf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_status_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+            mod_status_merge_config(pconf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -143,9 +157,9 @@ static int mod_status_header_append(buffer *b, const char *key) {
 	return 0;
 }
 
-static int mod_status_header_append_sort(buffer *b, plugin_data *p, const char* key) {
+static int mod_status_header_append_sort(buffer *b, const int sort, const char* key) {
 
-	if (p->conf.sort) {
+	if (sort) {
 		buffer_append_string_len(b, CONST_STR_LEN("<th class=\"status\"><a href=\"#\" class=\"sortheader\" onclick=\"resort(this);return false;\">"));
 		buffer_append_string(b, key);
 		buffer_append_string_len(b, CONST_STR_LEN("<span class=\"sortarrow\">:</span></a></th>\n"));
@@ -173,7 +187,7 @@ static int mod_status_get_multiplier(double *avg, char *multiplier, int size) {
 	return 0;
 }
 
-static handler_t mod_status_handle_server_status_html(server *srv, request_st * const r, plugin_data *p) {
+static handler_t mod_status_handle_server_status_html(server *srv, request_st * const r, plugin_data *p, const int sort) {
 	buffer *b = chunkqueue_append_buffer_open(r->write_queue);
 	double avg;
 	uint32_t j;
@@ -221,7 +235,7 @@ static handler_t mod_status_handle_server_status_html(server *srv, request_st *
 		}
 	}
 
-	if (p->conf.sort) {
+	if (sort) {
 		buffer_append_string_len(b, CONST_STR_LEN(
 					   "<script type=\"text/javascript\">\n"
 					   "// <!--\n"
@@ -368,6 +382,10 @@ static handler_t mod_status_handle_server_status_html(server *srv, request_st *
 	if (multiplier)	buffer_append_string_len(b, &multiplier, 1);
 	buffer_append_string_len(b, CONST_STR_LEN("byte</td></tr>\n"));
 
+	buffer_append_string_len(b, CONST_STR_LEN("<tr><td>Request allocations</td><td class=\"string\">"));
+	buffer_append_int(b, (intmax_t)heap_nallocs_get());
+	buffer_append_string_len(b, CONST_STR_LEN("</td></tr>\n"));
+
 
 
 	buffer_append_string_len(b, CONST_STR_LEN("<tr><th colspan=\"2\">average (since start)</th></tr>\n"));
@@ -476,14 +494,14 @@ static handler_t mod_status_handle_server_status_html(server *srv, request_st *
 
 	buffer_append_string_len(b, CONST_STR_LEN("<table summary=\"status\" class=\"status\">\n"));
 	buffer_append_string_len(b, CONST_STR_LEN("<tr>"));
-	mod_status_header_append_sort(b, p, "Client IP");
-	mod_status_header_append_sort(b, p, "Read");
-	mod_status_header_append_sort(b, p, "Written");
-	mod_status_header_append_sort(b, p, "State");
-	mod_status_header_append_sort(b, p, "Time");
-	mod_status_header_append_sort(b, p, "Host");
-	mod_status_header_append_sort(b, p, "URI");
-	mod_status_header_append_sort(b, p, "File");
+	mod_status_header_append_sort(b, sort, "Client IP");
+	mod_status_header_append_sort(b, sort, "Read");
+	mod_status_header_append_sort(b, sort, "Written");
+	mod_status_header_append_sort(b, sort, "State");
+	mod_status_header_append_sort(b, sort, "Time");
+	mod_status_header_append_sort(b, sort, "Host");
+	mod_status_header_append_sort(b, sort, "URI");
+	mod_status_header_append_sort(b, sort, "File");
 	buffer_append_string_len(b, CONST_STR_LEN("</tr>\n"));
 
 	for (j = 0; j < srv->conns.used; ++j) {
@@ -605,6 +623,13 @@ static handler_t mod_status_handle_server_status_text(server *srv, request_st *
 	buffer_append_int(b, srv->conns.size - srv->conns.used);
 	buffer_append_string_len(b, CONST_STR_LEN("\n"));
 
+	/* output heap allocations made while serving (see heap_nallocs)
+	 * (constant in steady state, once pools and arenas have grown to fit;
+	 *  compare change with change in Total Accesses) */
+	buffer_append_string_len(b, CONST_STR_LEN("RequestAllocations: "));
+	buffer_append_int(b, (intmax_t)heap_nallocs_get());
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+
 	/* output scoreboard */
 	buffer_append_string_len(b, CONST_STR_LEN("Scoreboard: "));
 	for (uint32_t i = 0; i < srv->conns.used; ++i) {
@@ -680,6 +705,10 @@ static handler_t mod_status_handle_server_status_json(server *srv, request_st *
 	buffer_append_int(b, srv->conns.size - srv->conns.used);
 	buffer_append_string_len(b, CONST_STR_LEN(",\n"));
 
+	buffer_append_string_len(b, CONST_STR_LEN("\t\"RequestAllocations\": "));
+	buffer_append_int(b, (intmax_t)heap_nallocs_get());
+	buffer_append_string_len(b, CONST_STR_LEN(",\n"));
+
 	for (j = 0, avg = 0; j < 5; j++) {
 		avg += p->mod_5s_requests[j];
 	}
@@ -725,12 +754,14 @@ static handler_t mod_status_handle_server_statistics(request_st * const r) {
 	}
 
 	b = chunkqueue_append_buffer_open(r->write_queue);
+	plugin_stats_lock();
 	for (i = 0; i < st->used; i++) {
 		buffer_append_string_buffer(b, &st->sorted[i]->key);
 		buffer_append_string_len(b, CONST_STR_LEN(": "));
 		buffer_append_int(b, ((data_integer *)st->sorted[i])->value);
 		buffer_append_string_len(b, CONST_STR_LEN("\n"));
 	}
+	plugin_stats_unlock();
 	chunkqueue_append_buffer_commit(r->write_queue);
 
 	http_header_response_set(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"), CONST_STR_LEN("text/plain"));
@@ -742,16 +773,20 @@ static handler_t mod_status_handle_server_statistics(request_st * const r) {
 }
 
 
-static handler_t mod_status_handle_server_status(request_st * const r, plugin_data * const p) {
+static handler_t mod_status_handle_server_status(request_st * const r, plugin_data * const p, const plugin_config * const pconf) {
+	/* (connections listed are those of event loop thread handling request
+	 *  if server.threads is enabled; request and traffic totals are global) */
 	server * const srv = r->con->srv;
+	mod_status_lock();
 	if (buffer_is_equal_string(&r->uri.query, CONST_STR_LEN("auto"))) {
 		mod_status_handle_server_status_text(srv, r, p);
 	} else if (buffer_string_length(&r->uri.query) >= sizeof("json")-1
 		   && 0 == memcmp(r->uri.query.ptr, CONST_STR_LEN("json"))) {
 		mod_status_handle_server_status_json(srv, r, p);
 	} else {
-		mod_status_handle_server_status_html(srv, r, p);
+		mod_status_handle_server_status_html(srv, r, p, pconf->sort);
 	}
+	mod_status_unlock();
 
 	r->http_status = 200;
 	r->resp_body_finished = 1;
@@ -780,7 +815,9 @@ static handler_t mod_status_handle_server_config(request_st * const r) {
 			   "  <table summary=\"status\" border=\"1\">\n"));
 
 	mod_status_header_append(b, "Server-Features");
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H)
+	mod_status_row_append(b, "RegEx Conditionals", "enabled (pcre2)");
+#elif defined(HAVE_PCRE_H)
 	mod_status_row_append(b, "RegEx Conditionals", "enabled");
 #else
 	mod_status_row_append(b, "RegEx Conditionals", "disabled - pcre missing");
@@ -824,16 +861,17 @@ static handler_t mod_status_handler(request_st * const r, void *p_d) {
 
 	if (NULL != r->handler_module) return HANDLER_GO_ON;
 
-	mod_status_patch_config(r, p);
+	plugin_config pconf;
+	mod_status_patch_config(r, p, &pconf);
 
-	if (!buffer_string_is_empty(p->conf.status_url) &&
-	    buffer_is_equal(p->conf.status_url, &r->uri.path)) {
-		return mod_status_handle_server_status(r, p);
-	} else if (!buffer_string_is_empty(p->conf.config_url) &&
-	    buffer_is_equal(p->conf.config_url, &r->uri.path)) {
+	if (!buffer_string_is_empty(pconf.status_url) &&
+	    buffer_is_equal(pconf.status_url, &r->uri.path)) {
+		return mod_status_handle_server_status(r, p, &pconf);
+	} else if (!buffer_string_is_empty(pconf.config_url) &&
+	    buffer_is_equal(pconf.config_url, &r->uri.path)) {
 		return mod_status_handle_server_config(r);
-	} else if (!buffer_string_is_empty(p->conf.statistics_url) &&
-	    buffer_is_equal(p->conf.statistics_url, &r->uri.path)) {
+	} else if (!buffer_string_is_empty(pconf.statistics_url) &&
+	    buffer_is_equal(pconf.statistics_url, &r->uri.path)) {
 		return mod_status_handle_server_statistics(r);
 	}
 
@@ -842,13 +880,22 @@ static handler_t mod_status_handler(request_st * const r, void *p_d) {
 
 TRIGGER_FUNC(mod_status_trigger) {
 	plugin_data *p = p_d;
+	UNUSED(srv);
 
-	/* check all connections */
-	for (uint32_t i = 0; i < srv->conns.used; ++i) {
-		connection *c = srv->conns.ptr[i];
+	/* bytes written by all connections (in all threads) in past second */
+	const uint64_t bytes_out = connection_bytes_out_get();
+	p->bytes_written = (double)(bytes_out - p->bytes_out);
+	p->bytes_out = bytes_out;
 
-		p->bytes_written += c->bytes_written_cur_second;
-	}
+  #ifdef HAVE_THREADS
+	p->requests = (double)
+	  __atomic_exchange_n(&p->requests_cnt, 0, __ATOMIC_RELAXED);
+  #else
+	p->requests = (double)p->requests_cnt;
+	p->requests_cnt = 0;
+  #endif
+
+	mod_status_lock();
 
 	/* a sliding average */
 	p->mod_5s_traffic_out[p->mod_5s_ndx] = p->bytes_written;
@@ -859,6 +906,11 @@ TRIGGER_FUNC(mod_status_trigger) {
 	p->abs_traffic_out += p->bytes_written;
 	p->rel_traffic_out += p->bytes_written;
 
+	p->rel_requests += p->requests;
+	p->abs_requests += p->requests;
+
+	mod_status_unlock();
+
 	p->bytes_written = 0;
 
 	/* reset storage - second */
@@ -870,12 +922,13 @@ TRIGGER_FUNC(mod_status_trigger) {
 
 REQUESTDONE_FUNC(mod_status_account) {
 	plugin_data *p = p_d;
+	UNUSED(r);
 
-	p->requests++;
-	p->rel_requests++;
-	p->abs_requests++;
-
-	p->bytes_written += r->con->bytes_written_cur_second;
+  #ifdef HAVE_THREADS
+	__atomic_add_fetch(&p->requests_cnt, 1, __ATOMIC_RELAXED);
+  #else
+	++p->requests_cnt;
+  #endif
 
 	return HANDLER_GO_ON;
 }
@@ -885,6 +938,7 @@ int mod_status_plugin_init(plugin *p);
 int mod_status_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "status";
+	p->thread_safe = 1;
 
 	p->init        = mod_status_init;
 	p->set_defaults= mod_status_set_defaults;
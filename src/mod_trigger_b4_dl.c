@@ -3,7 +3,7 @@
 #include "plugin.h"
 
 
-#if defined(HAVE_PCRE_H)                /* do nothing if PCRE not available */
+#if defined(HAVE_PCRE)                  /* do nothing if PCRE not available */
 #if defined(HAVE_GDBM_H) || defined(USE_MEMCACHED) /* at least one required */
 
 
@@ -21,7 +21,10 @@
 # include <gdbm.h>
 #endif
 
-#if defined(HAVE_PCRE_H)
+#if defined(HAVE_PCRE2_H)
+# define PCRE2_CODE_UNIT_WIDTH 8
+# include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 # include <pcre.h>
 #endif
 
@@ -36,8 +39,13 @@
 
 typedef struct {
     const buffer *deny_url;
+  #if defined(HAVE_PCRE2_H)
+    pcre2_code *trigger_regex;
+    pcre2_code *download_regex;
+  #else
     pcre *trigger_regex;
     pcre *download_regex;
+  #endif
   #if defined(HAVE_GDBM_H)
     GDBM_FILE db;
   #endif
@@ -74,10 +82,12 @@ FREE_FUNC(mod_trigger_b4_dl_free) {
                 break;
              #endif
               case 1: /* trigger-before-download.trigger-url */
-                pcre_free(cpv->v.v);
-                break;
               case 2: /* trigger-before-download.download-url */
+               #if defined(HAVE_PCRE2_H)
+                pcre2_code_free(cpv->v.v);
+               #else
                 pcre_free(cpv->v.v);
+               #endif
                 break;
              #if defined(USE_MEMCACHED)
               case 5: /* trigger-before-download.memcache-hosts */
@@ -168,6 +178,24 @@ static int mod_trigger_b4_dl_init_regex(server * const srv, config_plugin_value_
         return 1;
     }
 
+  #if defined(HAVE_PCRE2_H)
+    int errcode;
+    PCRE2_SIZE erroff;
+    cpv->v.v = pcre2_compile((PCRE2_SPTR)b->ptr, buffer_string_length(b),
+                             0, &errcode, &erroff, NULL);
+
+    if (cpv->v.v) {
+        (void)pcre2_jit_compile(cpv->v.v, PCRE2_JIT_COMPLETE);
+        cpv->vtype = T_CONFIG_LOCAL;
+        return 1;
+    }
+    else {
+        log_error(srv->errh, __FILE__, __LINE__,
+          "compiling regex for %s failed: %s pos: %zu",
+          str, b->ptr, (size_t)erroff);
+        return 0;
+    }
+  #else
     const char *errptr;
     int erroff;
     cpv->v.v = pcre_compile(b->ptr, 0, &errptr, &erroff, NULL);
@@ -182,6 +210,23 @@ static int mod_trigger_b4_dl_init_regex(server * const srv, config_plugin_value_
           str, b->ptr, erroff);
         return 0;
     }
+  #endif
+}
+
+#if defined(HAVE_PCRE2_H)
+#define PCRE_ERROR_NOMATCH PCRE2_ERROR_NOMATCH
+#endif
+
+static int mod_trigger_b4_dl_match(const void * const regex, const buffer * const b) {
+  #if defined(HAVE_PCRE2_H)
+    return pcre2_match(regex, (PCRE2_SPTR)b->ptr, buffer_string_length(b),
+                       0, 0, config_pcre2_match_data(), NULL);
+  #else
+    #define N 10
+    int ovec[N * 3];
+    return pcre_exec(regex, NULL, CONST_BUF_LEN(b), 0, 0, ovec, 3 * N);
+    #undef N
+  #endif
 }
 
 static void mod_trigger_b4_dl_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
@@ -353,8 +398,6 @@ URIHANDLER_FUNC(mod_trigger_b4_dl_uri_handler) {
 	plugin_data *p = p_d;
 
 	int n;
-# define N 10
-	int ovec[N * 3];
 
 	if (NULL != r->handler_module) return HANDLER_GO_ON;
 
@@ -392,7 +435,7 @@ URIHANDLER_FUNC(mod_trigger_b4_dl_uri_handler) {
 	const time_t cur_ts = log_epoch_secs;
 
 	/* check if URL is a trigger -> insert IP into DB */
-	if ((n = pcre_exec(p->conf.trigger_regex, NULL, CONST_BUF_LEN(&r->uri.path), 0, 0, ovec, 3 * N)) < 0) {
+	if ((n = mod_trigger_b4_dl_match(p->conf.trigger_regex, &r->uri.path)) < 0) {
 		if (n != PCRE_ERROR_NOMATCH) {
 			log_error(r->conf.errh, __FILE__, __LINE__,
 			  "execution error while matching: %d", n);
@@ -436,7 +479,7 @@ URIHANDLER_FUNC(mod_trigger_b4_dl_uri_handler) {
 	}
 
 	/* check if URL is a download -> check IP in DB, update timestamp */
-	if ((n = pcre_exec(p->conf.download_regex, NULL, CONST_BUF_LEN(&r->uri.path), 0, 0, ovec, 3 * N)) < 0) {
+	if ((n = mod_trigger_b4_dl_match(p->conf.download_regex, &r->uri.path)) < 0) {
 		if (n != PCRE_ERROR_NOMATCH) {
 			log_error(r->conf.errh, __FILE__, __LINE__,
 			  "execution error while matching: %d", n);
@@ -585,7 +628,7 @@ TRIGGER_FUNC(mod_trigger_b4_dl_handle_trigger) {
 #endif
 
 
-#endif /* defined(HAVE_PCRE_H) */
+#endif /* defined(HAVE_PCRE) */
 #endif /* defined(HAVE_GDBM_H) || defined(USE_MEMCACHED) */
 
 
@@ -594,7 +637,7 @@ int mod_trigger_b4_dl_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "trigger_b4_dl";
 
-#if defined(HAVE_PCRE_H)                /* do nothing if PCRE not available */
+#if defined(HAVE_PCRE)                  /* do nothing if PCRE not available */
 #if defined(HAVE_GDBM_H) || defined(USE_MEMCACHED) /* at least one required */
 
 	p->init        = mod_trigger_b4_dl_init;
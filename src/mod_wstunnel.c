@@ -119,8 +119,7 @@ typedef struct {
 
 typedef struct plugin_data {
     PLUGIN_DATA;
-    pid_t srv_pid; /* must match layout of gw_plugin_data through conf member */
-    plugin_config conf;
+    pid_t srv_pid; /* must match layout of gw_plugin_data through srv_pid */
     plugin_config defaults;
 } plugin_data;
 
@@ -230,11 +229,11 @@ static void mod_wstunnel_merge_config(plugin_config * const pconf, const config_
     } while ((++cpv)->k_id != -1);
 }
 
-static void mod_wstunnel_patch_config(request_st * const r, plugin_data * const p) {
-    memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
+static void mod_wstunnel_patch_config(request_st * const r, const plugin_data * const p, plugin_config * const pconf) {
+    memcpy(pconf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            mod_wstunnel_merge_config(&p->conf, p->cvlist+p->cvlist[i].v.u2[0]);
+            mod_wstunnel_merge_config(pconf, p->cvlist+p->cvlist[i].v.u2[0]);
     }
 }
 
@@ -414,7 +413,7 @@ static int wstunnel_is_allowed_origin(request_st * const r, handler_ctx * const
 
     /* "Origin" header is preferred
      * ("Sec-WebSocket-Origin" is from older drafts of websocket spec) */
-    origin = http_header_request_get(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Origin"));
+    origin = http_header_request_get(r, HTTP_HEADER_ORIGIN, CONST_STR_LEN("Origin"));
     if (NULL == origin) {
         origin =
           http_header_request_get(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Sec-WebSocket-Origin"));
@@ -478,11 +477,11 @@ static void wstunnel_handler_ctx_free(void *gwhctx) {
     chunk_buffer_release(hctx->frame.payload);
 }
 
-static handler_t wstunnel_handler_setup (request_st * const r, plugin_data * const p) {
+static handler_t wstunnel_handler_setup (request_st * const r, plugin_data * const p, const plugin_config * const pconf) {
     handler_ctx *hctx = r->plugin_ctx[p->id];
     int hybivers;
     hctx->errh = r->conf.errh;/*(for mod_wstunnel-specific DEBUG_* macros)*/
-    hctx->conf = p->conf; /*(copies struct)*/
+    hctx->conf = *pconf; /*(copies struct)*/
     hybivers = wstunnel_check_request(r, hctx);
     if (hybivers < 0) return HANDLER_FINISHED;
     hctx->hybivers = hybivers;
@@ -554,6 +553,7 @@ static handler_t wstunnel_handler_setup (request_st * const r, plugin_data * con
 
 static handler_t mod_wstunnel_check_extension(request_st * const r, void *p_d) {
     plugin_data *p = p_d;
+    plugin_config pconf;
     const buffer *vb;
     handler_t rc;
 
@@ -577,12 +577,13 @@ static handler_t mod_wstunnel_check_extension(request_st * const r, void *p_d) {
         || !http_header_str_contains_token(CONST_BUF_LEN(vb), CONST_STR_LEN("upgrade")))
         return HANDLER_GO_ON;
 
-    mod_wstunnel_patch_config(r, p);
-    if (NULL == p->conf.gw.exts) return HANDLER_GO_ON;
+    mod_wstunnel_patch_config(r, p, &pconf);
+    if (NULL == pconf.gw.exts) return HANDLER_GO_ON;
 
-    rc = gw_check_extension(r, (gw_plugin_data *)p, 1, sizeof(handler_ctx));
+    rc = gw_check_extension(r, (gw_plugin_data *)p, &pconf.gw, 1,
+                            sizeof(handler_ctx));
     return (HANDLER_GO_ON == rc && r->handler_module == p->self)
-      ? wstunnel_handler_setup(r, p)
+      ? wstunnel_handler_setup(r, p, &pconf)
       : rc;
 }
 
@@ -610,6 +611,7 @@ TRIGGER_FUNC(mod_wstunnel_handle_trigger) {
             /* avoid server.c closing connection with error due to max_read_idle
              * (might instead run joblist after plugins_call_handle_trigger())*/
             con->read_idle_ts = cur_ts;
+            con->read_idle_ms = log_epoch_ms();
             continue;
         }
 
@@ -732,7 +734,7 @@ static int create_response_ietf_00(handler_ctx *hctx) {
 
     /* "Origin" header is preferred
      * ("Sec-WebSocket-Origin" is from older drafts of websocket spec) */
-    const buffer *origin = http_header_request_get(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Origin"));
+    const buffer *origin = http_header_request_get(r, HTTP_HEADER_ORIGIN, CONST_STR_LEN("Origin"));
     if (NULL == origin) {
         origin =
           http_header_request_get(r, HTTP_HEADER_OTHER, CONST_STR_LEN("Sec-WebSocket-Origin"));
@@ -21,6 +21,13 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef __linux__
+#include <sched.h>      /* sched_setaffinity() */
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+#include <linux/filter.h>
+#endif
+#endif
+
 void
 network_accept_tcp_nagle_disable (const int fd)
 {
@@ -145,6 +152,8 @@ typedef struct {
     unsigned char use_ipv6;
     unsigned char set_v6only; /* set_v6only is only a temporary option */
     unsigned char defer_accept;
+    unsigned char reuseport;
+    unsigned char reuseport_cpu;
     const buffer *socket_perms;
     const buffer *bsd_accept_filter;
 } network_socket_config;
@@ -178,6 +187,12 @@ static void network_merge_config_cpv(network_socket_config * const pconf, const
       case 6: /* server.set-v6only */
         pconf->set_v6only = (0 != cpv->v.u);
         break;
+      case 7: /* server.reuseport */
+        pconf->reuseport = (0 != cpv->v.u);
+        break;
+      case 8: /* server.reuseport-cpu-affinity */
+        pconf->reuseport_cpu = (0 != cpv->v.u);
+        break;
       default:/* should not happen */
         return;
     }
@@ -189,6 +204,133 @@ static void network_merge_config(network_socket_config * const pconf, const conf
     } while ((++cpv)->k_id != -1);
 }
 
+__attribute_pure__
+static unsigned int network_reuseport_group_size(const server *srv) {
+    /* one SO_REUSEPORT socket per worker process or per event loop thread */
+    return srv->srvconf.max_worker > 1
+      ? srv->srvconf.max_worker
+      : srv->srvconf.threads;
+}
+
+__attribute_cold__
+static int network_reuseport_cpu_steering(server *srv, const server_socket *srv_socket, unsigned int n) {
+  #if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF) \
+   && defined(SKF_AD_CPU)
+    /* select socket (index) in SO_REUSEPORT group by (cpu % n), so that the
+     * connection is accepted by the worker pinned to the CPU on which the
+     * connection was received (see network_reuseport_worker()) */
+    const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < (long)n) {
+        log_error(srv->errh, __FILE__, __LINE__,
+          "server.reuseport-cpu-affinity ignored for %s: "
+          "server.max-worker or server.threads (%u) > number of CPUs (%ld)",
+          srv_socket->srv_token->ptr, n, ncpu);
+        return 0;
+    }
+    struct sock_filter code[] = {
+      { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+      { BPF_ALU | BPF_MOD | BPF_K, 0, 0, n },
+      { BPF_RET | BPF_A,           0, 0, 0 }
+    };
+    struct sock_fprog prog = { sizeof(code)/sizeof(*code), code };
+    if (0 != setsockopt(srv_socket->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                        &prog, sizeof(prog))) {
+        log_perror(srv->errh, __FILE__, __LINE__,
+          "setsockopt(SO_ATTACH_REUSEPORT_CBPF) %s",
+          srv_socket->srv_token->ptr);
+        return 0;
+    }
+    return 1;
+  #else
+    UNUSED(srv_socket);
+    UNUSED(n);
+    log_error(srv->errh, __FILE__, __LINE__,
+      "server.reuseport-cpu-affinity not supported on this platform; ignored");
+    return 0;
+  #endif
+}
+
+__attribute_cold__
+static int network_reuseport_group_init(server *srv, const network_socket_config *s, server_socket *srv_socket0, int set_v6only, socklen_t addr_len) {
+	/* open one additional listening socket per worker, bound to the same
+	 * address in the same SO_REUSEPORT group as the socket used by worker 0.
+	 * The kernel distributes new connections across the per-worker accept
+	 * queues instead of all workers contending to accept() on one socket.
+	 * The parent holds all sockets of the group open, so the group (and
+	 * pending connections) persist across worker restarts and across
+	 * graceful restart (server_sockets_save() and server_sockets_restore()) */
+	const unsigned int n = network_reuseport_group_size(srv);
+	const int family = sock_addr_get_family(&srv_socket0->addr);
+	for (unsigned int i = 1; i < n; ++i) {
+		server_socket *srv_socket = calloc(1, sizeof(*srv_socket));
+		force_assert(NULL != srv_socket);
+		memcpy(srv_socket, srv_socket0, sizeof(*srv_socket));
+		srv_socket->srv_token = buffer_init_buffer(srv_socket0->srv_token);
+		srv_socket->reuseport = (unsigned short)(i + 1);
+		network_srv_sockets_append(srv, srv_socket);
+
+		if (-1 == (srv_socket->fd = fdevent_socket_nb_cloexec(family, SOCK_STREAM, IPPROTO_TCP))) {
+			log_perror(srv->errh, __FILE__, __LINE__, "socket");
+			return -1;
+		}
+		srv->cur_fds = srv_socket->fd;
+
+	      #ifdef HAVE_IPV6
+		if (set_v6only) {
+			int val = 1;
+			if (-1 == setsockopt(srv_socket->fd, IPPROTO_IPV6, IPV6_V6ONLY, &val, sizeof(val))) {
+				log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(IPV6_V6ONLY)");
+				return -1;
+			}
+		}
+	      #else
+		UNUSED(set_v6only);
+	      #endif
+
+		if (fdevent_set_so_reuseaddr(srv_socket->fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(SO_REUSEADDR)");
+			return -1;
+		}
+		if (fdevent_set_so_reuseport(srv_socket->fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(SO_REUSEPORT)");
+			return -1;
+		}
+		if (fdevent_set_tcp_nodelay(srv_socket->fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(TCP_NODELAY)");
+			return -1;
+		}
+		if (0 != bind(srv_socket->fd, (struct sockaddr *) &(srv_socket->addr), addr_len)) {
+			log_perror(srv->errh, __FILE__, __LINE__,
+			  "can't bind to socket: %s", srv_socket->srv_token->ptr);
+			return -1;
+		}
+		if (-1 == listen(srv_socket->fd, s->listen_backlog)) {
+			log_perror(srv->errh, __FILE__, __LINE__, "listen");
+			return -1;
+		}
+#ifdef TCP_DEFER_ACCEPT
+		if (!s->ssl_enabled && s->defer_accept) {
+			int v = s->defer_accept;
+			if (-1 == setsockopt(srv_socket->fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &v, sizeof(v))) {
+				log_perror(srv->errh, __FILE__, __LINE__, "can't set TCP_DEFER_ACCEPT");
+			}
+		}
+#endif
+	}
+
+	/* (program attached to one socket applies to entire SO_REUSEPORT group;
+	 *  sockets are indexed in the group in the order in which they were bound,
+	 *  which is worker order, since none are closed while the parent runs) */
+	if (s->reuseport_cpu && network_reuseport_cpu_steering(srv, srv_socket0, n)) {
+		for (uint32_t i = 0; i < srv->srv_sockets.used; ++i) {
+			if (0 == memcmp(&srv->srv_sockets.ptr[i]->addr, &srv_socket0->addr, addr_len))
+				srv->srv_sockets.ptr[i]->reuseport_cpu = 1;
+		}
+	}
+
+	return 0;
+}
+
 static int network_server_init(server *srv, network_socket_config *s, buffer *host_token, size_t sidx, int stdin_fd) {
 	server_socket *srv_socket;
 	const char *host;
@@ -357,6 +499,15 @@ static int network_server_init(server *srv, network_socket_config *s, buffer *ho
 		}
 	}
 
+	if (-1 == stdin_fd && family != AF_UNIX
+	    && s->reuseport && network_reuseport_group_size(srv) > 1) {
+		if (fdevent_set_so_reuseport(srv_socket->fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(SO_REUSEPORT)");
+			return -1;
+		}
+		srv_socket->reuseport = 1; /* worker 0 */
+	}
+
 	if (-1 != stdin_fd) { } else
 	if (0 != bind(srv_socket->fd, (struct sockaddr *) &(srv_socket->addr), addr_len)) {
 		log_perror(srv->errh, __FILE__, __LINE__,
@@ -412,6 +563,11 @@ static int network_server_init(server *srv, network_socket_config *s, buffer *ho
 #endif
 	}
 
+	if (srv_socket->reuseport) {
+		return network_reuseport_group_init(srv, s, srv_socket,
+		                                    set_v6only, addr_len);
+	}
+
 	return 0;
 }
 
@@ -515,6 +671,12 @@ int network_init(server *srv, int stdin_fd) {
      ,{ CONST_STR_LEN("server.set-v6only"),
         T_CONFIG_BOOL,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("server.reuseport"),
+        T_CONFIG_BOOL,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("server.reuseport-cpu-affinity"),
+        T_CONFIG_BOOL,
+        T_CONFIG_SCOPE_CONNECTION }
     #if 0 /* TODO: more integration needed ... */
      ,{ CONST_STR_LEN("mbedtls.engine"),
         T_CONFIG_BOOL,
@@ -644,6 +806,54 @@ int network_init(server *srv, int stdin_fd) {
     return rc;
 }
 
+__attribute_cold__
+static void network_reuseport_set_affinity(server *srv, unsigned int worker_ndx, unsigned int nworkers) {
+  #if defined(__linux__) && defined(CPU_SET)
+    /* pin worker to the CPUs for which the SO_REUSEPORT CPU steering program
+     * selects the socket of this worker (cpu % nworkers == worker_ndx) */
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long c = (long)worker_ndx; c < ncpu && c < CPU_SETSIZE; c += nworkers)
+        CPU_SET((int)c, &cpuset);
+    if (0 == CPU_COUNT(&cpuset)) return;
+    if (0 != sched_setaffinity(0, sizeof(cpuset), &cpuset))
+        log_perror(srv->errh, __FILE__, __LINE__,
+          "sched_setaffinity() worker %u", worker_ndx);
+  #else
+    UNUSED(srv);
+    UNUSED(worker_ndx);
+    UNUSED(nworkers);
+  #endif
+}
+
+void network_reuseport_worker(server *srv, unsigned int worker_ndx, unsigned int nworkers) {
+	/* keep listening sockets shared by all workers and the SO_REUSEPORT
+	 * sockets assigned to this worker; close the other SO_REUSEPORT sockets
+	 * in this worker process (the parent keeps them open).
+	 * (sockets are assigned modulo nworkers in case server.max-worker was
+	 *  changed in config after SO_REUSEPORT sockets were created, and the
+	 *  sockets were then preserved across a graceful restart) */
+	uint32_t used = 0;
+	int pin_cpu = 0;
+	if (0 == nworkers) return;
+	for (uint32_t i = 0; i < srv->srv_sockets.used; ++i) {
+		server_socket *srv_socket = srv->srv_sockets.ptr[i];
+		if (srv_socket->reuseport
+		    && (srv_socket->reuseport - 1u) % nworkers != worker_ndx) {
+			if (-1 != srv_socket->fd) close(srv_socket->fd);
+			buffer_free(srv_socket->srv_token);
+			free(srv_socket);
+			continue;
+		}
+		if (srv_socket->reuseport_cpu) pin_cpu = 1;
+		srv->srv_sockets.ptr[used++] = srv_socket;
+	}
+	srv->srv_sockets.used = used;
+
+	if (pin_cpu) network_reuseport_set_affinity(srv, worker_ndx, nworkers);
+}
+
 void network_unregister_sock(server *srv, server_socket *srv_socket) {
 	fdnode *fdn = srv_socket->fdn;
 	if (NULL == fdn) return;
@@ -659,12 +869,54 @@ int network_register_fdevents(server *srv) {
 
 	if (srv->sockets_disabled) return 0; /* lighttpd -1 (one-shot mode) */
 
+	/* with threaded event loops, each thread listens on the shared sockets
+	 * and on the SO_REUSEPORT sockets assigned to the thread */
+	const unsigned int nthreads = srv->srvconf.threads;
+	int pin_cpu = 0;
+
 	/* register fdevents after reset */
 	for (uint32_t i = 0; i < srv->srv_sockets.used; ++i) {
 		server_socket *srv_socket = srv->srv_sockets.ptr[i];
+		if (nthreads > 1 && srv_socket->reuseport
+		    && (srv_socket->reuseport - 1u) % nthreads != srv->thread_ndx)
+			continue;
+		if (srv_socket->reuseport_cpu) pin_cpu = 1;
 
 		srv_socket->fdn = fdevent_register(srv->ev, srv_socket->fd, network_server_handle_fdevent, srv_socket);
 		fdevent_fdnode_event_set(srv->ev, srv_socket->fdn, FDEVENT_IN);
 	}
+
+	/*(sched_setaffinity() pins calling thread)*/
+	if (pin_cpu && nthreads > 1)
+		network_reuseport_set_affinity(srv, srv->thread_ndx, nthreads);
 	return 0;
 }
+
+void network_thread_sockets(server *tsrv, const server *srv) {
+	/* per-thread copies of listening sockets (sockets are shared)
+	 * (fdn and srv are per-thread; fd and srv_token are owned by srv) */
+	tsrv->srv_sockets.ptr = NULL;
+	tsrv->srv_sockets.used = 0;
+	tsrv->srv_sockets.size = 0;
+	memset(&tsrv->srv_sockets_inherited, 0, sizeof(server_socket_array));
+	for (uint32_t i = 0; i < srv->srv_sockets.used; ++i) {
+		server_socket * const srv_socket = malloc(sizeof(server_socket));
+		force_assert(NULL != srv_socket);
+		memcpy(srv_socket, srv->srv_sockets.ptr[i], sizeof(server_socket));
+		srv_socket->fdn = NULL;
+		srv_socket->srv = tsrv;
+		network_srv_sockets_append(tsrv, srv_socket);
+	}
+}
+
+void network_thread_sockets_free(server *tsrv) {
+	for (uint32_t i = 0; i < tsrv->srv_sockets.used; ++i) {
+		server_socket * const srv_socket = tsrv->srv_sockets.ptr[i];
+		network_unregister_sock(tsrv, srv_socket);
+		free(srv_socket);
+	}
+	free(tsrv->srv_sockets.ptr);
+	tsrv->srv_sockets.ptr = NULL;
+	tsrv->srv_sockets.used = 0;
+	tsrv->srv_sockets.size = 0;
+}
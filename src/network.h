@@ -17,7 +17,16 @@ int network_close(server *srv);
 __attribute_cold__
 int network_register_fdevents(server *srv);
 
+__attribute_cold__
+void network_reuseport_worker(server *srv, unsigned int worker_ndx, unsigned int nworkers);
+
 __attribute_cold__
 void network_unregister_sock(server *srv, struct server_socket *srv_socket);
 
+__attribute_cold__
+void network_thread_sockets(server *tsrv, const server *srv);
+
+__attribute_cold__
+void network_thread_sockets_free(server *tsrv);
+
 #endif
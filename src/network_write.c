@@ -66,6 +66,10 @@
 # define NETWORK_WRITE_USE_MMAP
 #endif
 
+#if defined HAVE_SPLICE
+# define NETWORK_WRITE_USE_SPLICE
+#endif
+
 
 static int network_write_error(int fd, log_error_st *errh) {
   #if defined(__WIN32)
@@ -161,11 +165,8 @@ static int network_write_file_chunk_no_mmap(int fd, chunkqueue *cq, off_t *p_max
 
     if (toSend > (off_t)sizeof(buf)) toSend = (off_t)sizeof(buf);
 
-    if (-1 == lseek(c->file.fd, offset, SEEK_SET)) {
-        log_perror(errh, __FILE__, __LINE__, "lseek");
-        return -1;
-    }
-    if (-1 == (toSend = read(c->file.fd, buf, toSend))) {
+    toSend = chunk_file_pread(c->file.fd, buf, (size_t)toSend, offset);
+    if (-1 == toSend) {
         log_perror(errh, __FILE__, __LINE__, "read");
         return -1;
     }
@@ -204,8 +205,8 @@ static off_t mmap_align_offset(off_t start) {
     return start - (start % pagesize);
 }
 
-static volatile int sigbus_jmp_valid;
-static sigjmp_buf sigbus_jmp;
+static __thread_local volatile int sigbus_jmp_valid;
+static __thread_local sigjmp_buf sigbus_jmp;
 
 static void sigbus_handler(int sig) {
     UNUSED(sig);
@@ -539,6 +540,45 @@ static int network_write_file_chunk_sendfile(int fd, chunkqueue *cq, off_t *p_ma
 
 
 
+#if defined(NETWORK_WRITE_USE_SPLICE)
+
+#include <fcntl.h>
+
+/* next chunk must be pipe FILE_CHUNK (see chunkqueue_append_splice_sock()).
+ * send data from pipe to socket with splice() */
+static int network_write_file_chunk_splice(int fd, chunkqueue *cq, off_t *p_max_bytes, log_error_st *errh) {
+    chunk * const c = cq->first;
+    off_t toSend = c->file.length - c->offset;
+    if (toSend > *p_max_bytes) toSend = *p_max_bytes;
+
+    if (0 == toSend) {
+        chunkqueue_remove_finished_chunks(cq);
+        return 0;
+    }
+
+    ssize_t wr = splice(c->file.fd, NULL, fd, NULL, (size_t)toSend,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (wr >= 0) {
+        *p_max_bytes -= wr;
+        chunkqueue_mark_written(cq, wr);
+        return (wr > 0 && wr == toSend) ? 0 : -3;
+    } else {
+        return network_write_error(fd, errh);
+    }
+}
+
+#define network_write_chunk_is_pipe(c) chunk_is_pipe(c)
+
+#else
+
+#define network_write_chunk_is_pipe(c) 0
+#define network_write_file_chunk_splice(fd, cq, p_max_bytes, errh) -1
+
+#endif
+
+
+
+
 /* return values:
  * >= 0 : no error
  *   -1 : error (on our side)
@@ -554,6 +594,10 @@ static int network_write_chunkqueue_write(int fd, chunkqueue *cq, off_t max_byte
             rc = network_write_mem_chunk(fd, cq, &max_bytes, errh);
             break;
         case FILE_CHUNK:
+            if (network_write_chunk_is_pipe(cq->first)) {
+                rc = network_write_file_chunk_splice(fd, cq, &max_bytes, errh);
+                break;
+            }
           #ifdef NETWORK_WRITE_USE_MMAP
             rc = network_write_file_chunk_mmap(fd, cq, &max_bytes, errh);
           #else
@@ -583,6 +627,10 @@ static int network_write_chunkqueue_writev(int fd, chunkqueue *cq, off_t max_byt
           #endif
             break;
         case FILE_CHUNK:
+            if (network_write_chunk_is_pipe(cq->first)) {
+                rc = network_write_file_chunk_splice(fd, cq, &max_bytes, errh);
+                break;
+            }
           #ifdef NETWORK_WRITE_USE_MMAP
             rc = network_write_file_chunk_mmap(fd, cq, &max_bytes, errh);
           #else
@@ -613,6 +661,10 @@ static int network_write_chunkqueue_sendfile(int fd, chunkqueue *cq, off_t max_b
           #endif
             break;
         case FILE_CHUNK:
+            if (network_write_chunk_is_pipe(cq->first)) {
+                rc = network_write_file_chunk_splice(fd, cq, &max_bytes, errh);
+                break;
+            }
           #if defined(NETWORK_WRITE_USE_SENDFILE)
             rc = network_write_file_chunk_sendfile(fd, cq, &max_bytes, errh);
           #elif defined(NETWORK_WRITE_USE_MMAP)
@@ -10,6 +10,16 @@
 
 array plugin_stats; /* global */
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+static pthread_mutex_t plugin_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+void plugin_stats_lock(void) { pthread_mutex_lock(&plugin_stats_mutex); }
+void plugin_stats_unlock(void) { pthread_mutex_unlock(&plugin_stats_mutex); }
+#else
+void plugin_stats_lock(void) {}
+void plugin_stats_unlock(void) {}
+#endif
+
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
 #endif
@@ -568,6 +578,15 @@ handler_t plugins_call_init(server *srv) {
 	return HANDLER_GO_ON;
 }
 
+const char * plugins_thread_unsafe(server *srv) {
+	/* name of first loaded plugin not flagged thread_safe; NULL if none */
+	plugin ** const ps = srv->plugins.ptr;
+	for (uint32_t i = 0; i < srv->plugins.used; ++i) {
+		if (!ps[i]->thread_safe) return ps[i]->name;
+	}
+	return NULL;
+}
+
 void plugins_free(server *srv) {
 	if (srv->plugin_slots) {
 		plugins_call_cleanup(srv);
@@ -23,6 +23,11 @@
  */
 extern array plugin_stats;
 
+/* plugin_stats is shared by event loop threads (server.threads);
+ * hold lock to look up (and possibly insert), modify, or walk counters */
+void plugin_stats_lock(void);
+void plugin_stats_unlock(void);
+
 
 #define SERVER_FUNC(x) \
 		static handler_t x(server *srv, void *p_d)
@@ -90,6 +95,8 @@ struct plugin {
 	const char *name;/* name of the plugin */
 	size_t version;
 	void *lib;       /* dlopen handle */
+	unsigned char thread_safe; /* handlers may run concurrently in threaded
+	                            * event loops (server.threads) */
 };
 
 __attribute_cold__
@@ -127,4 +134,7 @@ handler_t plugins_call_set_defaults(server *srv);
 __attribute_cold__
 handler_t plugins_call_worker_init(server *srv);
 
+__attribute_cold__
+const char * plugins_thread_unsafe(server *srv);
+
 #endif
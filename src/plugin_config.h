@@ -173,4 +173,14 @@ typedef struct cond_match_t {
 
 int config_check_cond(request_st *r, int context_ndx);
 
+#ifdef HAVE_PCRE2_H
+struct pcre2_real_match_data_8; /* declaration */
+/* pcre2 match data (ovector of 20 pairs) shared by all pcre2_match() in the
+ * current thread; results must be used before the next pcre2_match() */
+struct pcre2_real_match_data_8 * config_pcre2_match_data(void);
+#endif
+
+__attribute_cold__
+void config_pcre2_match_data_free(void);
+
 #endif
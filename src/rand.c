@@ -158,6 +158,17 @@ static int li_rand_device_bytes (unsigned char *buf, int num)
 
 static int li_rand_inited;
 static unsigned short xsubi[3];
+
+#ifdef HAVE_THREADS
+#include <pthread.h>
+/* PRNG state below (and xsubi[]) is shared by all server threads */
+static pthread_mutex_t li_rand_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define li_rand_lock()   pthread_mutex_lock(&li_rand_mutex)
+#define li_rand_unlock() pthread_mutex_unlock(&li_rand_mutex)
+#else
+#define li_rand_lock()   do { } while (0)
+#define li_rand_unlock() do { } while (0)
+#endif
 #ifdef USE_MBEDTLS_CRYPTO
 #ifdef MBEDTLS_ENTROPY_C
 static mbedtls_entropy_context entropy;
@@ -311,7 +322,7 @@ void li_rand_reseed (void)
     if (li_rand_inited) li_rand_init();
 }
 
-int li_rand_pseudo (void)
+static int li_rand_pseudo_locked (void)
 {
   #ifdef USE_GNUTLS_CRYPTO
     int i;
@@ -364,7 +375,7 @@ int li_rand_pseudo (void)
   #endif
 }
 
-void li_rand_pseudo_bytes (unsigned char *buf, int num)
+static void li_rand_pseudo_bytes_locked (unsigned char *buf, int num)
 {
   #ifdef USE_GNUTLS_CRYPTO
     if (0 == gnutls_rnd(GNUTLS_RND_NONCE, buf, (size_t)num)) return;
@@ -381,10 +392,25 @@ void li_rand_pseudo_bytes (unsigned char *buf, int num)
         return;
   #endif
     for (int i = 0; i < num; ++i)
-        buf[i] = li_rand_pseudo() & 0xFF;
+        buf[i] = li_rand_pseudo_locked() & 0xFF;
 }
 
-int li_rand_bytes (unsigned char *buf, int num)
+int li_rand_pseudo (void)
+{
+    li_rand_lock();
+    const int i = li_rand_pseudo_locked();
+    li_rand_unlock();
+    return i;
+}
+
+void li_rand_pseudo_bytes (unsigned char *buf, int num)
+{
+    li_rand_lock();
+    li_rand_pseudo_bytes_locked(buf, num);
+    li_rand_unlock();
+}
+
+static int li_rand_bytes_locked (unsigned char *buf, int num)
 {
   #ifdef USE_GNUTLS_CRYPTO /* should use GNUTLS_RND_KEY for long-term keys */
     if (0 == gnutls_rnd(GNUTLS_RND_RANDOM, buf, (size_t)num)) return 1;
@@ -429,12 +455,20 @@ int li_rand_bytes (unsigned char *buf, int num)
     }
     else {
         /* NOTE: not cryptographically random !!! */
-        li_rand_pseudo_bytes(buf, num);
+        li_rand_pseudo_bytes_locked(buf, num);
         /*(openssl RAND_pseudo_bytes rc for non-cryptographically random data)*/
         return 0;
     }
 }
 
+int li_rand_bytes (unsigned char *buf, int num)
+{
+    li_rand_lock();
+    const int rc = li_rand_bytes_locked(buf, num);
+    li_rand_unlock();
+    return rc;
+}
+
 void li_rand_cleanup (void)
 {
   #ifdef USE_WOLFSSL_CRYPTO
@@ -10,6 +10,7 @@
 #include "request.h"
 #include "burl.h"
 #include "http_header.h"
+#include "http_scan.h"
 #include "http_kv.h"
 #include "log.h"
 #include "sock_addr.h"
@@ -259,7 +260,7 @@ int http_request_host_normalize(buffer * const b, const int scheme_port) {
         if (light_isdigit(*p)) do {
             /* (IPv4 address literal or domain starting w/ digit (e.g. 3com))*/
             /* (check one-element cache of normalized IPv4 address string) */
-            static struct { char s[INET_ADDRSTRLEN]; size_t n; } laddr;
+            static __thread_local struct { char s[INET_ADDRSTRLEN]; size_t n; } laddr;
             size_t n = colon ? (size_t)(colon - p) : blen;
             sock_addr addr;
             if (n == laddr.n && 0 == memcmp(p, laddr.s, n)) break;
@@ -273,7 +274,7 @@ int http_request_host_normalize(buffer * const b, const int scheme_port) {
       #if defined(HAVE_IPV6) && defined(HAVE_INET_PTON)
 
         /* (check one-element cache of normalized IPv4 address string) */
-        static struct { char s[INET6_ADDRSTRLEN]; size_t n; } laddr;
+        static __thread_local struct { char s[INET6_ADDRSTRLEN]; size_t n; } laddr;
         sock_addr addr;
         char *bracket = b->ptr+blen-1;
         char *percent = strchr(b->ptr+1, '%');
@@ -394,7 +395,7 @@ static int http_request_parse_single_header(request_st * const restrict r, const
       default:
         break;
       case HTTP_HEADER_HOST:
-        if (!(r->rqst_htags & HTTP_HEADER_HOST)) {
+        if (!light_btst(r->rqst_htags, HTTP_HEADER_HOST)) {
             saveb = &r->http_host;
             if (vlen >= 1024) { /*(expecting < 256)*/
                 return http_request_header_line_invalid(r, 400, "uri-authority too long -> 400");
@@ -422,18 +423,18 @@ static int http_request_parse_single_header(request_st * const restrict r, const
         }
         break;
       case HTTP_HEADER_CONTENT_TYPE:
-        if (r->rqst_htags & HTTP_HEADER_CONTENT_TYPE) {
+        if (light_btst(r->rqst_htags, HTTP_HEADER_CONTENT_TYPE)) {
             return http_request_header_line_invalid(r, 400, "duplicate Content-Type header -> 400");
         }
         break;
       case HTTP_HEADER_IF_NONE_MATCH:
         /* if dup, only the first one will survive */
-        if (r->rqst_htags & HTTP_HEADER_IF_NONE_MATCH) {
+        if (light_btst(r->rqst_htags, HTTP_HEADER_IF_NONE_MATCH)) {
             return 0; /* ignore header */
         }
         break;
       case HTTP_HEADER_CONTENT_LENGTH:
-        if (!(r->rqst_htags & HTTP_HEADER_CONTENT_LENGTH)) {
+        if (!light_btst(r->rqst_htags, HTTP_HEADER_CONTENT_LENGTH)) {
             /*(trailing whitespace was removed from vlen)*/
             char *err;
             off_t clen = strtoll(v, &err, 10);
@@ -450,7 +451,7 @@ static int http_request_parse_single_header(request_st * const restrict r, const
         }
         break;
       case HTTP_HEADER_IF_MODIFIED_SINCE:
-        if (r->rqst_htags & HTTP_HEADER_IF_MODIFIED_SINCE) {
+        if (light_btst(r->rqst_htags, HTTP_HEADER_IF_MODIFIED_SINCE)) {
             /* Proxies sometimes send dup headers
              * if they are the same we ignore the second
              * if not, we raise an error */
@@ -823,7 +824,11 @@ static int http_request_parse_headers(request_st * const restrict r, char * cons
         /* one past last line hoff[hoff[0]] is to final "\r\n" */
         char *end = ptr + hoff[i+1];
 
-        const char *colon = memchr(k, ':', end - k);
+        /* common case: field-name is [A-Za-z-]+ immediately followed by ':' */
+        const uint32_t ka = http_scan_token_alpha(k, (uint32_t)(end - k));
+        const char *colon = (k + ka < end && k[ka] == ':')
+          ? k + ka
+          : memchr(k + ka, ':', (size_t)(end - k - ka));
         if (NULL == colon)
             return http_request_header_line_invalid(r, 400, "invalid header missing ':' -> 400");
 
@@ -858,13 +863,9 @@ static int http_request_parse_headers(request_st * const restrict r, char * cons
             return http_request_header_line_invalid(r, 400, "invalid header key -> 400");
         const enum http_header_e id = http_header_hkey_get(k, klen);
 
-        if (id == HTTP_HEADER_OTHER) {
-            for (int j = 0; j < klen; ++j) {
-                if (light_isalpha(k[j]) || k[j] == '-') continue; /*(common cases)*/
-                if (0 != http_request_parse_header_other(r, k+j, klen-j, http_header_strict))
-                    return 400;
-                break;
-            }
+        if (id == HTTP_HEADER_OTHER && (int)ka < klen) {
+            if (0 != http_request_parse_header_other(r, k+ka, klen-(int)ka, http_header_strict))
+                return 400;
         }
 
         /* remove leading whitespace from value */
@@ -903,10 +904,9 @@ static int http_request_parse_headers(request_st * const restrict r, char * cons
         if (vlen <= 0) continue; /* ignore header */
 
         if (http_header_strict) {
-            for (int j = 0; j < vlen; ++j) {
-                if ((((unsigned char *)v)[j] < 32 && v[j] != '\t') || v[j]==127)
-                    return http_request_header_char_invalid(r, v[j], "invalid character in header -> 400");
-            }
+            const uint32_t j = http_scan_field_value_ctl(v, (uint32_t)vlen);
+            if (j < (uint32_t)vlen)
+                return http_request_header_char_invalid(r, v[j], "invalid character in header -> 400");
         } /* else URI already checked in http_request_parse_reqline() for any '\0' */
 
         int status = http_request_parse_single_header(r, id, k, (size_t)klen, v, (size_t)vlen);
@@ -956,14 +956,14 @@ int http_request_parse(request_st * const restrict r, char * const restrict hdrs
         /* POST requires Content-Length (or Transfer-Encoding)
          * (-1 == r->reqbody_length when Transfer-Encoding: chunked)*/
         if (HTTP_METHOD_POST == r->http_method
-            && !(r->rqst_htags & HTTP_HEADER_CONTENT_LENGTH)) {
+            && !light_btst(r->rqst_htags, HTTP_HEADER_CONTENT_LENGTH)) {
             return http_request_header_line_invalid(r, 411, "POST-request, but content-length missing -> 411");
         }
     }
     else {
         /* (-1 == r->reqbody_length when Transfer-Encoding: chunked)*/
         if (-1 == r->reqbody_length
-            && (r->rqst_htags & HTTP_HEADER_CONTENT_LENGTH)) {
+            && light_btst(r->rqst_htags, HTTP_HEADER_CONTENT_LENGTH)) {
             /* RFC7230 Hypertext Transfer Protocol (HTTP/1.1): Message Syntax and Routing
              * 3.3.3.  Message Body Length
              * [...]
@@ -993,3 +993,87 @@ int http_request_parse(request_st * const restrict r, char * const restrict hdrs
 
     return 0;
 }
+
+
+#define REQUEST_ARENA_ALIGN 16
+#define REQUEST_ARENA_MIN   1024
+#define REQUEST_ARENA_MAX   65536 /* largest block kept between requests */
+
+__attribute_cold__
+__attribute_noinline__
+__attribute_returns_nonnull__
+static void * request_arena_alloc_block (request_arena * const a, const size_t sz)
+{
+    heap_nallocs_inc();
+    if (NULL == a->ptr && sz <= REQUEST_ARENA_MIN) {
+        a->ptr = calloc(1, REQUEST_ARENA_MIN);
+        force_assert(a->ptr);
+        a->size = REQUEST_ARENA_MIN;
+        a->used = (uint32_t)sz;
+        return a->ptr;
+    }
+
+    /* overflow block (header is a link to next overflow block) */
+    void ** const blk = calloc(1, REQUEST_ARENA_ALIGN + sz);
+    force_assert(blk);
+    *blk = a->extra;
+    a->extra = blk;
+    a->extra_sz += (uint32_t)sz;
+    return (char *)blk + REQUEST_ARENA_ALIGN;
+}
+
+
+void * request_arena_alloc (request_st * const r, size_t sz)
+{
+    request_arena * const a = &r->arena;
+    sz = (sz + (REQUEST_ARENA_ALIGN-1)) & ~(size_t)(REQUEST_ARENA_ALIGN-1);
+    if (0 == sz) sz = REQUEST_ARENA_ALIGN;
+    if (sz <= a->size - a->used) {
+        void * const p = a->ptr + a->used;
+        a->used += (uint32_t)sz;
+        return p;
+    }
+    return request_arena_alloc_block(a, sz);
+}
+
+
+static void request_arena_free_extra (request_arena * const a)
+{
+    for (void **blk = a->extra, **next; blk; blk = next) {
+        next = *blk;
+        free(blk);
+    }
+    a->extra = NULL;
+    a->extra_sz = 0;
+}
+
+
+void request_arena_reset (request_arena * const a)
+{
+    if (a->used) {
+        memset(a->ptr, 0, a->used);
+        a->used = 0;
+    }
+    if (a->extra) {
+        /* grow block to high-water mark of request which overflowed */
+        size_t sz = a->size + a->extra_sz;
+        request_arena_free_extra(a);
+        if (sz <= REQUEST_ARENA_MAX) {
+            sz = (sz + (REQUEST_ARENA_MIN-1)) & ~(size_t)(REQUEST_ARENA_MIN-1);
+            free(a->ptr);
+            a->ptr = calloc(1, sz);
+            force_assert(a->ptr);
+            heap_nallocs_inc();
+            a->size = (uint32_t)sz;
+        }
+    }
+}
+
+
+void request_arena_free (request_arena * const a)
+{
+    request_arena_free_extra(a);
+    free(a->ptr);
+    a->ptr = NULL;
+    a->used = a->size = 0;
+}
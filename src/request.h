@@ -26,6 +26,8 @@ typedef struct {
     struct log_error_st *errh;
 
     unsigned int max_request_size;
+    unsigned int max_read_idle_ms;  /* (overrides max_read_idle if not 0) */
+    unsigned int max_write_idle_ms; /* (overrides max_write_idle if not 0) */
     unsigned short max_keep_alive_requests;
     unsigned short max_keep_alive_idle;
     unsigned short max_read_idle;
@@ -99,6 +101,7 @@ typedef struct {
     off_t gw_chunked;
     buffer b;
     int done;
+    int decode; /* decode even if passing through chunked to client */
 } response_dechunk;
 
 /* the order of the items should be the same as they are processed
@@ -117,6 +120,28 @@ typedef enum {
     CON_STATE_CLOSE
 } request_state_t;
 
+/* per-request bump allocator for request-lifetime objects (e.g. plugin
+ * per-request ctx); see request_arena_alloc().  The block is kept for the
+ * life of the connection and is grown when reset to the prior request's
+ * high-water mark, so that steady-state requests do not allocate */
+typedef struct {
+    char *ptr;
+    uint32_t used;
+    uint32_t size;
+    void *extra;        /* overflow blocks; freed in request_arena_reset() */
+    uint32_t extra_sz;
+} request_arena;
+
+typedef enum {
+    H2_STATE_IDLE,
+    H2_STATE_RESERVED_LOCAL,
+    H2_STATE_RESERVED_REMOTE,
+    H2_STATE_OPEN,
+    H2_STATE_HALF_CLOSED_LOCAL,
+    H2_STATE_HALF_CLOSED_REMOTE,
+    H2_STATE_CLOSED
+} request_h2state_t;
+
 struct request_st {
     request_state_t state; /*(modules should not modify request state)*/
     int http_status;
@@ -127,6 +152,13 @@ struct request_st {
     const plugin *handler_module;
     void **plugin_ctx;           /* plugin connection specific config */
     connection *con;
+    request_arena arena;
+
+    /* HTTP/2 stream */
+    request_h2state_t h2state;
+    uint32_t h2id;
+    int32_t h2_rwin;
+    int32_t h2_swin;
 
     /* config conditions (internal) */
     uint32_t conditional_is_valid;
@@ -136,7 +168,7 @@ struct request_st {
     request_config conf;
 
     /* request */
-    uint32_t rqst_htags;/* bitfield of flagged headers present in request */
+    uint64_t rqst_htags;/* bitfield of flagged headers present in request */
     uint32_t rqst_header_len;
     array rqst_headers;
 
@@ -159,7 +191,7 @@ struct request_st {
 
     /* response */
     off_t content_length;
-    uint32_t resp_htags; /*bitfield of flagged headers present in response*/
+    uint64_t resp_htags; /*bitfield of flagged headers present in response*/
     uint32_t resp_header_len;
     array resp_headers;
     char resp_body_finished;
@@ -178,6 +210,7 @@ struct request_st {
 
     struct timespec start_hp;
     time_t start_ts;
+    uint64_t start_ms;  /* (HTTP/2 streams; server.max-write-idle-ms) */
 
     int error_handler_saved_status; /* error-handler */
     http_method_t error_handler_saved_method; /* error-handler */
@@ -189,4 +222,13 @@ int http_request_parse_target(request_st *r, int scheme_port);
 int http_request_host_normalize(buffer *b, int scheme_port);
 int http_request_host_policy(buffer *b, unsigned int http_parseopts, int scheme_port);
 
+/* return zeroed memory valid until request_reset() (never NULL) */
+__attribute_returns_nonnull__
+void * request_arena_alloc(request_st *r, size_t sz);
+
+void request_arena_reset(request_arena *a);
+
+__attribute_cold__
+void request_arena_free(request_arena *a);
+
 #endif
@@ -5,6 +5,7 @@
 #include "base.h"
 #include "burl.h"
 #include "fdevent.h"
+#include "h2.h"
 #include "http_header.h"
 #include "http_kv.h"
 #include "log.h"
@@ -46,7 +47,109 @@ static int http_response_omit_header(request_st * const r, const data_string * c
     return 0;
 }
 
+static const char * http_response_date(uint32_t * const len) {
+	static __thread_local time_t tlast;
+	static __thread_local char tstr[32]; /* 30-chars for "%a, %d %b %Y %H:%M:%S GMT" */
+	static __thread_local uint32_t tlen;
+
+	/* cache the generated timestamp */
+	const time_t cur_ts = log_epoch_secs;
+	if (tlast != cur_ts) {
+		tlast = cur_ts;
+		tlen = (uint32_t)strftime(tstr, sizeof(tstr),
+		                          "%a, %d %b %Y %H:%M:%S GMT", gmtime(&tlast));
+	}
+
+	*len = tlen;
+	return tstr;
+}
+
+static int http_response_omit_header_h2(const buffer * const k) {
+	/* connection-specific header fields are not used in HTTP/2 */
+	switch (buffer_string_length(k)) {
+	  case 7:
+		return buffer_eq_slen(k, CONST_STR_LEN("upgrade"));
+	  case 10:
+		return buffer_eq_slen(k, CONST_STR_LEN("connection"))
+		    || buffer_eq_slen(k, CONST_STR_LEN("keep-alive"));
+	  case 16:
+		return buffer_eq_slen(k, CONST_STR_LEN("proxy-connection"));
+	  case 17:
+		return buffer_eq_slen(k, CONST_STR_LEN("transfer-encoding"));
+	  default:
+		return 0;
+	}
+}
+
+__attribute_noinline__
+static int http_response_write_header_h2(request_st * const r) {
+	h2con * const h2c = r->con->h2;
+	hpack_table * const t = &h2c->encoder;
+	buffer * const b = r->tmp_buf;
+	buffer_clear(b);
+	hpack_encode_begin(t, b);
+	hpack_encode_status(t, b, r->http_status);
+
+	if (304 == r->http_status && light_btst(r->resp_htags, HTTP_HEADER_CONTENT_ENCODING)) {
+		http_header_response_unset(r, HTTP_HEADER_CONTENT_ENCODING, CONST_STR_LEN("Content-Encoding"));
+	}
+
+	/* add all headers (field names are lowercase in HTTP/2) */
+	for (size_t i = 0; i < r->resp_headers.used; ++i) {
+		data_string * const ds = (data_string *)r->resp_headers.data[i];
+
+		if (buffer_string_is_empty(&ds->value)) continue;
+		if (buffer_string_is_empty(&ds->key)) continue;
+		if ((ds->key.ptr[0] & 0xdf) == 'X' && http_response_omit_header(r, ds))
+			continue;
+		buffer_to_lower(&ds->key);
+		if (http_response_omit_header_h2(&ds->key)) continue;
+
+		/* repeated headers (e.g. Set-Cookie) are joined with "\r\nKey: "
+		 * (see http_header_response_insert()); send as separate fields */
+		const char *v = ds->value.ptr;
+		for (const char *n; (n = strchr(v, '\n')); ) {
+			uint32_t vlen = (uint32_t)(n - v);
+			if (vlen && v[vlen-1] == '\r') --vlen;
+			hpack_encode_header(t, b, CONST_BUF_LEN(&ds->key), v, vlen);
+			if (NULL == (v = strchr(n, ':'))) break;
+			do { ++v; } while (*v == ' ' || *v == '\t');
+		}
+		if (v)
+			hpack_encode_header(t, b, CONST_BUF_LEN(&ds->key),
+			                    v, (uint32_t)(ds->value.ptr + buffer_string_length(&ds->value) - v));
+	}
+
+	if (!light_btst(r->resp_htags, HTTP_HEADER_DATE)) {
+		uint32_t tlen;
+		const char * const tstr = http_response_date(&tlen);
+		hpack_encode_header(t, b, CONST_STR_LEN("date"), tstr, tlen);
+	}
+
+	if (!light_btst(r->resp_htags, HTTP_HEADER_SERVER)) {
+		if (!buffer_string_is_empty(r->conf.server_tag)) {
+			hpack_encode_header(t, b, CONST_STR_LEN("server"),
+			                    CONST_BUF_LEN(r->conf.server_tag));
+		}
+	}
+
+	r->resp_header_len = buffer_string_length(b);
+
+	if (r->conf.log_response_header) {
+		log_error(r->conf.errh, __FILE__, __LINE__,
+		  "Response-Header: (HTTP/2 stream %u) status %d, %u headers, "
+		  "%u octets (HPACK)", r->h2id, r->http_status,
+		  (unsigned int)r->resp_headers.used, (unsigned int)r->resp_header_len);
+	}
+
+	h2_send_headers(r, r->con, b);
+	return 0;
+}
+
 int http_response_write_header(request_st * const r) {
+	if (r->http_version == HTTP_VERSION_2)
+		return http_response_write_header_h2(r);
+
 	chunkqueue * const cq = r->write_queue;
 	buffer * const b = chunkqueue_prepend_buffer_open(cq);
 
@@ -72,7 +175,7 @@ int http_response_write_header(request_st * const r) {
 		r->con->keep_alive_idle = r->conf.max_keep_alive_idle;
 	}
 
-	if ((r->resp_htags & HTTP_HEADER_UPGRADE) && r->http_version == HTTP_VERSION_1_1) {
+	if (light_btst(r->resp_htags, HTTP_HEADER_UPGRADE) && r->http_version == HTTP_VERSION_1_1) {
 		http_header_response_set(r, HTTP_HEADER_CONNECTION, CONST_STR_LEN("Connection"), CONST_STR_LEN("upgrade"));
 	} else if (0 == r->keep_alive) {
 		http_header_response_set(r, HTTP_HEADER_CONNECTION, CONST_STR_LEN("Connection"), CONST_STR_LEN("close"));
@@ -80,7 +183,7 @@ int http_response_write_header(request_st * const r) {
 		http_header_response_set(r, HTTP_HEADER_CONNECTION, CONST_STR_LEN("Connection"), CONST_STR_LEN("keep-alive"));
 	}
 
-	if (304 == r->http_status && (r->resp_htags & HTTP_HEADER_CONTENT_ENCODING)) {
+	if (304 == r->http_status && light_btst(r->resp_htags, HTTP_HEADER_CONTENT_ENCODING)) {
 		http_header_response_unset(r, HTTP_HEADER_CONTENT_ENCODING, CONST_STR_LEN("Content-Encoding"));
 	}
 
@@ -99,26 +202,15 @@ int http_response_write_header(request_st * const r) {
 		buffer_append_string_buffer(b, &ds->value);
 	}
 
-	if (!(r->resp_htags & HTTP_HEADER_DATE)) {
-		static time_t tlast;
-		static char tstr[32]; /* 30-chars for "%a, %d %b %Y %H:%M:%S GMT" */
-		static size_t tlen;
-
+	if (!light_btst(r->resp_htags, HTTP_HEADER_DATE)) {
 		/* HTTP/1.1 requires a Date: header */
 		buffer_append_string_len(b, CONST_STR_LEN("\r\nDate: "));
-
-		/* cache the generated timestamp */
-		const time_t cur_ts = log_epoch_secs;
-		if (tlast != cur_ts) {
-			tlast = cur_ts;
-			tlen = strftime(tstr, sizeof(tstr),
-			                "%a, %d %b %Y %H:%M:%S GMT", gmtime(&tlast));
-		}
-
+		uint32_t tlen;
+		const char * const tstr = http_response_date(&tlen);
 		buffer_append_string_len(b, tstr, tlen);
 	}
 
-	if (!(r->resp_htags & HTTP_HEADER_SERVER)) {
+	if (!light_btst(r->resp_htags, HTTP_HEADER_SERVER)) {
 		if (!buffer_string_is_empty(r->conf.server_tag)) {
 			buffer_append_string_len(b, CONST_STR_LEN("\r\nServer: "));
 			buffer_append_string_len(b, CONST_BUF_LEN(r->conf.server_tag));
@@ -306,7 +398,7 @@ static handler_t http_response_config (request_st * const r) {
     config_patch_config(r);
 
     /* do we have to downgrade to 1.0 ? */
-    if (!r->conf.allow_http11)
+    if (!r->conf.allow_http11 && r->http_version == HTTP_VERSION_1_1)
         r->http_version = HTTP_VERSION_1_0;
 
     /* r->conf.max_request_size is in kBytes */
@@ -10,6 +10,8 @@
 #include "http_vhostdb.h"   /* http_vhostdb_dumbdata_reset() */
 #include "fdevent.h"
 #include "connections.h"
+#include "h2.h"             /* h2_stream_pool_free() */
+#include "aio_pool.h"
 #include "sock_addr.h"
 #include "stat_cache.h"
 #include "plugin.h"
@@ -41,6 +43,10 @@ static const buffer default_server_tag = { CONST_STR_LEN(PACKAGE_DESC), 0 };
 
 #include <stdio.h>
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif
+
 #ifdef HAVE_GETOPT_H
 # include <getopt.h>
 #endif
@@ -98,6 +104,14 @@ static volatile sig_atomic_t handle_sig_alarm = 1;
 static volatile sig_atomic_t handle_sig_hup = 0;
 static time_t idle_limit = 0;
 
+#ifdef HAVE_THREADS
+/* threaded event loops (server.threads) */
+static pthread_t *server_tids;
+static uint32_t server_nthreads;        /* threads in addition to main thread */
+static uint32_t server_threads_active;  /* (atomic) threads not yet exited */
+static uint32_t server_threads_unlisten;/* (atomic) threads done listening */
+#endif
+
 #if defined(HAVE_SIGACTION) && defined(SA_SIGINFO)
 static volatile siginfo_t last_sigterm_info;
 static volatile siginfo_t last_sighup_info;
@@ -280,7 +294,9 @@ static void server_free(server *srv) {
 	stat_cache_free();
 
 	li_rand_cleanup();
+	h2_stream_pool_free();
 	chunkqueue_chunk_pool_free();
+	config_pcre2_match_data_free();
 
 	log_error_st_free(srv->errh);
 	free(srv);
@@ -475,7 +491,9 @@ static void show_features (void) {
 #else
       "\t- Nettle support\n"
 #endif
-#ifdef HAVE_LIBPCRE
+#ifdef HAVE_LIBPCRE2
+      "\t+ PCRE2 support\n"
+#elif defined(HAVE_LIBPCRE)
       "\t+ PCRE support\n"
 #else
       "\t- PCRE support\n"
@@ -520,6 +538,11 @@ static void show_features (void) {
 #else
       "\t- FAM support\n"
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+      "\t+ inotify support\n"
+#else
+      "\t- inotify support\n"
+#endif
 #ifdef HAVE_LUA_H
       "\t+ LUA support\n"
 #else
@@ -581,6 +604,9 @@ __attribute_cold__
 static void server_sockets_restore (server *srv) { /* graceful_restart */
     memcpy(&srv->srv_sockets, &graceful_sockets, sizeof(server_socket_array));
     memset(&graceful_sockets, 0, sizeof(server_socket_array));
+    /* (srv is newly allocated upon graceful restart) */
+    for (uint32_t i = 0; i < srv->srv_sockets.used; ++i)
+        srv->srv_sockets.ptr[i]->srv = srv;
     memcpy(&srv->srv_sockets_inherited, &inherited_sockets, sizeof(server_socket_array));
     memset(&inherited_sockets, 0, sizeof(server_socket_array));
 }
@@ -638,9 +664,27 @@ static void server_graceful_state (server *srv) {
 
     if (!srv_shutdown) connection_graceful_shutdown_maint(srv);
 
+  #ifdef HAVE_THREADS
+    if (srv->thread_ndx) {
+        /* stop listening; main thread closes sockets after all threads have */
+        if (2 != srv->sockets_disabled) {
+            server_sockets_unregister(srv);
+            __atomic_add_fetch(&server_threads_unlisten, 1, __ATOMIC_RELEASE);
+        }
+        return;
+    }
+  #endif
+
     if (!oneshot_fd
         && (2 == srv->sockets_disabled || 3 == srv->sockets_disabled)) return;
 
+  #ifdef HAVE_THREADS
+    if (server_nthreads
+        && server_nthreads
+           != __atomic_load_n(&server_threads_unlisten, __ATOMIC_ACQUIRE))
+        return; /* threads might still be listening on sockets */
+  #endif
+
     log_error(srv->errh,__FILE__,__LINE__,"[note] graceful shutdown started");
 
     /* no graceful restart if chroot()ed, if oneshot mode, or if idle timeout */
@@ -706,6 +750,163 @@ static void server_process_fdwaitqueue (server *srv) {
     }
 }
 
+__attribute_cold__
+static void server_threads_check (server * const srv) {
+    if (srv->srvconf.threads <= 1) return;
+    const char *reason = NULL;
+  #ifdef HAVE_THREADS
+    const char *pname;
+    if (srv->srvconf.max_worker)
+        reason = "server.max-worker is non-zero";
+    else if (idle_limit)
+        reason = "server idle time limit command line option";
+    else if (oneshot_fd)
+        reason = "one-shot mode (-1)";
+    else if (srv->srvconf.event_handler
+             && 0 == strcmp(srv->srvconf.event_handler, "libev"))
+        reason = "server.event-handler = \"libev\"";
+    else if (NULL != (pname = plugins_thread_unsafe(srv))) {
+        log_error(srv->errh, __FILE__, __LINE__,
+          "server.threads ignored; mod_%s is not thread-safe", pname);
+        srv->srvconf.threads = 0;
+        return;
+    }
+  #else
+    reason = "threads not supported in this build";
+  #endif
+    if (reason) {
+        log_error(srv->errh, __FILE__, __LINE__,
+          "server.threads ignored; %s", reason);
+        srv->srvconf.threads = 0;
+    }
+}
+
+#ifdef HAVE_THREADS
+
+static void server_main_loop (server *srv);
+
+static void * server_thread_main (void *arg) {
+    server * const srv = arg;
+    buffer * const b = buffer_init();
+    log_thread_buffer(b);
+
+    aio_pool_loop_init(srv);
+    if (0 == network_register_fdevents(srv))
+        server_main_loop(srv);
+    else
+        log_error(srv->errh, __FILE__, __LINE__,
+          "thread %u: registering listening sockets failed", srv->thread_ndx);
+
+    if (2 != srv->sockets_disabled)
+        __atomic_add_fetch(&server_threads_unlisten, 1, __ATOMIC_RELEASE);
+    aio_pool_loop_free(srv);
+    connections_free(srv);
+    network_thread_sockets_free(srv);
+    fdevent_free(srv->ev);
+    free(srv->joblist.ptr);
+    free(srv->fdwaitqueue.ptr);
+    buffer_free(srv->tmp_buf);
+    free(srv);
+    h2_stream_pool_free();
+    chunkqueue_chunk_pool_free();
+    config_pcre2_match_data_free();
+
+    log_thread_buffer(NULL);
+    buffer_free(b);
+    __atomic_sub_fetch(&server_threads_active, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+__attribute_cold__
+static int server_threads_start (server * const srv) {
+    /* Each thread runs an event loop on its own copy of the server struct,
+     * with its own connections, timers, fdevents, and buffers, sharing
+     * config, plugins, listening sockets, and stat_cache with main thread.
+     * Main thread alone handles signals and once-per-second maintenance */
+    const uint32_t n = srv->srvconf.threads;
+    server_tids = calloc(n, sizeof(*server_tids));
+    force_assert(NULL != server_tids);
+    server_threads_unlisten = 0;
+    stat_cache_threads(n);
+
+    /* divide connection and fd limits among threads
+     * (fdevents in each thread must be sized to index any fd in process) */
+    const int max_fds = srv->max_fds;
+    const int max_fds_share = max_fds / (int)n;
+    srv->max_conns /= n;
+    if (0 == srv->max_conns) srv->max_conns = 1;
+
+    /* threads do not handle (asynchronous) signals */
+    sigset_t sigs, osigs;
+    sigfillset(&sigs);
+    sigdelset(&sigs, SIGBUS);
+    sigdelset(&sigs, SIGSEGV);
+    sigdelset(&sigs, SIGFPE);
+    sigdelset(&sigs, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &sigs, &osigs);
+
+    int rc = 0;
+    for (uint32_t i = 1; i < n; ++i) {
+        server * const tsrv = malloc(sizeof(*tsrv));
+        force_assert(NULL != tsrv);
+        memcpy(tsrv, srv, sizeof(*srv));
+        tsrv->thread_ndx = i;
+        tsrv->tmp_buf = buffer_init();
+        memset(&tsrv->conns, 0, sizeof(tsrv->conns));
+        memset(&tsrv->joblist, 0, sizeof(tsrv->joblist));
+        memset(&tsrv->fdwaitqueue, 0, sizeof(tsrv->fdwaitqueue));
+        tsrv->con_opened = tsrv->con_read = 0;
+        tsrv->con_written = tsrv->con_closed = 0;
+        tsrv->cur_fds = 0;
+        tsrv->max_fds = max_fds;
+        tsrv->ev = fdevent_init(srv->srvconf.event_handler, &tsrv->max_fds,
+                                &tsrv->cur_fds, srv->errh);
+        if (NULL == tsrv->ev) {
+            log_error(srv->errh, __FILE__, __LINE__, "fdevent_init failed");
+            buffer_free(tsrv->tmp_buf);
+            free(tsrv);
+            rc = -1;
+            break;
+        }
+        tsrv->max_fds = max_fds_share;
+        tsrv->max_fds_lowat = max_fds_share * 8 / 10;
+        tsrv->max_fds_hiwat = max_fds_share * 9 / 10;
+        network_thread_sockets(tsrv, srv);
+
+        __atomic_add_fetch(&server_threads_active, 1, __ATOMIC_RELEASE);
+        if (0 != pthread_create(server_tids+server_nthreads, NULL,
+                                server_thread_main, tsrv)) {
+            log_perror(srv->errh, __FILE__, __LINE__, "pthread_create()");
+            __atomic_sub_fetch(&server_threads_active, 1, __ATOMIC_RELEASE);
+            network_thread_sockets_free(tsrv);
+            fdevent_free(tsrv->ev);
+            buffer_free(tsrv->tmp_buf);
+            free(tsrv);
+            rc = -1;
+            break;
+        }
+        ++server_nthreads;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &osigs, NULL);
+
+    srv->max_fds = max_fds_share;
+    srv->max_fds_lowat = max_fds_share * 8 / 10;
+    srv->max_fds_hiwat = max_fds_share * 9 / 10;
+    return rc;
+}
+
+__attribute_cold__
+static void server_threads_join (void) {
+    for (uint32_t i = 0; i < server_nthreads; ++i)
+        pthread_join(server_tids[i], NULL);
+    free(server_tids);
+    server_tids = NULL;
+    server_nthreads = 0;
+}
+
+#endif
+
 __attribute_cold__
 static int server_main_setup (server * const srv, int argc, char **argv) {
 	int print_config = 0;
@@ -915,6 +1116,8 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		}
 	}
 
+	server_threads_check(srv);
+
 	/* open pid file BEFORE chroot */
 	if (-2 == pid_fd) pid_fd = -1; /*(initial startup state)*/
 	if (-1 == pid_fd && !buffer_string_is_empty(srv->srvconf.pid_file)) {
@@ -1205,10 +1408,14 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		pid_t pid;
 		const int npids = num_childs;
 		int child = 0;
+		int worker_ndx = 0;
 		unsigned int timer = 0;
 		for (int n = 0; n < npids; ++n) pids[n] = -1;
 		while (!child && !srv_shutdown && !graceful_shutdown) {
 			if (num_childs > 0) {
+				/* worker index (slot) is stable across worker restarts */
+				worker_ndx = 0;
+				while (-1 != pids[worker_ndx]) ++worker_ndx;
 				switch ((pid = fork())) {
 				case -1:
 					return -1;
@@ -1218,12 +1425,7 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 					break;
 				default:
 					num_childs--;
-					for (int n = 0; n < npids; ++n) {
-						if (-1 == pids[n]) {
-							pids[n] = pid;
-							break;
-						}
-					}
+					pids[worker_ndx] = pid;
 					break;
 				}
 			} else {
@@ -1326,6 +1528,10 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		fdevent_clr_logger_pipe_pids();
 		srv->pid = getpid();
 		li_rand_reseed();
+
+		/* select per-worker SO_REUSEPORT listening sockets, if configured */
+		network_reuseport_worker(srv, (unsigned int)worker_ndx,
+		                         (unsigned int)npids);
 	}
 #endif
 
@@ -1413,6 +1619,17 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		oneshot_fd = -1;
 	}
 
+	if (srv->srvconf.aio_threads && 0 != aio_pool_init(srv))
+		return -1;
+
+	/* count heap allocations made while serving (mod_status) */
+	heap_nallocs = 0;
+
+      #ifdef HAVE_THREADS
+	if (srv->srvconf.threads > 1 && 0 != server_threads_start(srv))
+		return -1;
+      #endif
+
 	return 1;
 }
 
@@ -1478,7 +1695,6 @@ static void server_handle_sigalrm (server * const srv, time_t min_ts, time_t las
 				config_reset_config_bytes_sec(srv->config_data_base);
 				/* if graceful_shutdown, accelerate cleanup of recently completed request/responses */
 				if (graceful_shutdown && !srv_shutdown) connection_graceful_shutdown_maint(srv);
-				connection_periodic_maint(srv, min_ts);
 }
 
 __attribute_noinline__
@@ -1501,15 +1717,27 @@ static void server_handle_sigchld (server * const srv) {
 			} while (pid > 0 || (-1 == pid && errno == EINTR));
 }
 
+static int server_threads_running (void) {
+  #ifdef HAVE_THREADS
+	return 0 != __atomic_load_n(&server_threads_active, __ATOMIC_ACQUIRE);
+  #else
+	return 0;
+  #endif
+}
+
 __attribute_hot__
 __attribute_noinline__
 static void server_main_loop (server * const srv) {
 	connections * const joblist = &srv->joblist;
 	time_t last_active_ts = time(NULL);
+	uint64_t cur_ms = log_epoch_ms();
+	tw_init(&srv->tw, cur_ms);
+	/* (signals and periodic tasks are handled only in main thread) */
+	const uint32_t thread_ndx = srv->thread_ndx;
 
 	while (!srv_shutdown) {
 
-		if (handle_sig_hup) {
+		if (0 == thread_ndx && handle_sig_hup) {
 			handle_sig_hup = 0;
 			server_handle_sighup(srv);
 		}
@@ -1519,15 +1747,22 @@ static void server_main_loop (server * const srv) {
 		if (handle_sig_alarm) {
 			handle_sig_alarm = 0;
 	      #endif
-			time_t min_ts = time(NULL);
-			if (min_ts != log_epoch_secs) {
+			cur_ms = log_epoch_ms();
+			time_t min_ts = (time_t)(cur_ms / 1000);
+			if (0 == thread_ndx && min_ts != log_epoch_secs) {
 				server_handle_sigalrm(srv, min_ts, last_active_ts);
 			}
 	      #ifdef USE_ALARM
 		}
 	      #endif
 
-		if (handle_sig_child) {
+		/* thread holds no stat_cache entries at top of loop */
+		stat_cache_thread_quiescent(thread_ndx);
+
+		/* check connections with expired timeouts */
+		connection_periodic_maint(srv, cur_ms);
+
+		if (handle_sig_child && 0 == thread_ndx) {
 			handle_sig_child = 0;
 			server_handle_sigchld(srv);
 		}
@@ -1535,10 +1770,14 @@ static void server_main_loop (server * const srv) {
 		if (graceful_shutdown) {
 			server_graceful_state(srv);
 			if (0 == srv->conns.used) {
-				/* we are in graceful shutdown phase and all connections are closed
-				 * we are ready to terminate without harming anyone */
-				srv_shutdown = 1;
-				break;
+				if (thread_ndx) break; /* thread exits */
+				/* (main thread waits for other threads to exit) */
+				if (!server_threads_running()) {
+					/* we are in graceful shutdown phase and all connections are closed
+					 * we are ready to terminate without harming anyone */
+					srv_shutdown = 1;
+					break;
+				}
 			}
 		} else if (srv->sockets_disabled) {
 			server_overload_check(srv);
@@ -1550,7 +1789,15 @@ static void server_main_loop (server * const srv) {
 			server_process_fdwaitqueue(srv);
 		}
 
-		if (fdevent_poll(srv->ev, 1000) > 0) {
+		/* poll until next timer (if sooner), and at least once per second */
+		/* (next_ms might be earlier than cur_ms if a timer is overdue) */
+		const uint64_t next_ms = tw_next(&srv->tw);
+		const int timeout_ms = (next_ms <= cur_ms)
+		  ? 0
+		  : (next_ms - cur_ms < 1000)
+		  ? (int)(next_ms - cur_ms)
+		  : 1000;
+		if (fdevent_poll(srv->ev, timeout_ms) > 0) {
 			last_active_ts = log_epoch_secs;
 		}
 
@@ -1589,9 +1836,18 @@ int main (int argc, char **argv) {
         }
 
         rc = server_main_setup(srv, argc, argv);
+      #ifdef HAVE_THREADS
+        if (rc < 0 && server_nthreads) { /*(server_threads_start() failed)*/
+            srv_shutdown = 1;
+            server_threads_join();
+        }
+      #endif
         if (rc > 0) {
 
             server_main_loop(srv);
+          #ifdef HAVE_THREADS
+            server_threads_join();
+          #endif
 
             if (graceful_shutdown || graceful_restart) {
                 server_graceful_state(srv);
@@ -1620,6 +1876,7 @@ int main (int argc, char **argv) {
             server_sockets_save(srv);
         else
             network_close(srv);
+        aio_pool_free(srv);
         connections_free(srv);
         plugins_free(srv);
         server_free(srv);
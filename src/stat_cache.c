@@ -1,6 +1,7 @@
 #include "first.h"
 
 #include "stat_cache.h"
+#include "chunk.h"
 #include "log.h"
 #include "fdevent.h"
 #include "etag.h"
@@ -15,6 +16,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif
+
 #if defined(HAVE_SYS_XATTR_H)
 # include <sys/xattr.h>
 #elif defined(HAVE_ATTR_ATTRIBUTES_H)
@@ -35,26 +40,188 @@
 /*
  * stat-cache
  *
- * - a splay-tree is used as we can use the caching effect of it
+ * - an open addressing hash table (Robin Hood probing) indexes entries by path.
+ *   Each slot stores the full hash alongside the entry pointer, so that probes
+ *   do not dereference entries except on a hash match, and lookups do not
+ *   modify the table (unlike the splay-tree previously used here).
+ * - the number of entries is bounded (server.stat-cache-max-entries).
+ *   When full, an entry is evicted using CLOCK (second chance), where a
+ *   reference bit in the slot is set upon use.
+ * - expired entries are removed by an incremental sweep of a small slice of
+ *   the table each second, rather than by walking the entire cache at once.
+ * - an entry may cache an open fd to the file (server.stat-cache-max-fds),
+ *   which chunks reference (sce->refcnt) instead of open() and close() of the
+ *   file for each response.  The fd is closed when the entry is invalidated,
+ *   evicted, or the file is replaced, but not before the last chunk using it
+ *   is released; an entry removed from the cache while in use is freed then.
+ * - similarly, an entry may cache the contents of a small file in an immutable
+ *   buffer (server.stat-cache-max-content-size), which chunks reference
+ *   instead of copying, so that response headers and body are sent together.
+ * - with threaded event loops (server.threads), the cache is shared by all
+ *   threads and protected by a mutex.  Entries are not modified in place once
+ *   other threads might be using them; an entry is replaced by a new entry
+ *   instead.  Entries removed from the cache are freed only after every thread
+ *   has passed through the top of its event loop (quiescent state), since
+ *   callers use entries returned by stat_cache_get_entry() without a lock.
  */
 
 enum {
   STAT_CACHE_ENGINE_SIMPLE, /*(default)*/
   STAT_CACHE_ENGINE_NONE,
-  STAT_CACHE_ENGINE_FAM
+  STAT_CACHE_ENGINE_FAM,
+  STAT_CACHE_ENGINE_INOTIFY
 };
 
+#if defined(HAVE_FAM_H) || defined(HAVE_SYS_INOTIFY_H)
+#define STAT_CACHE_MONITOR_DIRS /* (fam_dir_entry monitoring by FAM or inotify) */
+#endif
+
+#define STAT_CACHE_MAX_ENTRIES_DEFAULT 32768
+#define STAT_CACHE_MAX_FDS_DEFAULT 256
+#define STAT_CACHE_MAX_CONTENT_SIZE_DEFAULT 16384
+#define STAT_CACHE_MAX_CONTENT_TOTAL_DEFAULT (64 << 20)
+
 struct stat_cache_fam;  /* declaration */
 
+typedef struct stat_cache_slot {
+	uint32_t hash;          /* stat_cache_hash() of sce->name */
+	uint32_t ref;           /* CLOCK reference bit */
+	stat_cache_entry *sce;  /* NULL if slot is empty */
+} stat_cache_slot;
+
 typedef struct stat_cache {
 	int stat_cache_engine;
-	splay_tree *files; /* nodes of tree are (stat_cache_entry *) */
+	uint32_t used;          /* number of entries in files[] */
+	uint32_t mask;          /* size of files[] - 1 (size is power of 2) */
+	uint32_t max;           /* max number of entries */
+	uint32_t hand;          /* CLOCK hand (index into files[]) */
+	uint32_t sweep;         /* next index of incremental expiration sweep */
+	uint32_t fds;           /* number of open fds cached in entries */
+	uint32_t max_fds;       /* max number of open fds cached in entries */
+	uint32_t max_content_size; /* max size of file with contents cached */
+	size_t content_total;   /* size of file contents cached in entries */
+	size_t max_content_total; /* max size of file contents cached */
+	stat_cache_slot *files;
 	struct stat_cache_fam *scf;
+	uint32_t threads;       /* number of threads sharing cache; 0 if none */
+	uint32_t retired_used;
+	uint32_t retired_size;
+	uint64_t epoch;         /* incremented each time retired[] is reclaimed */
+	uint64_t *qs;           /* epoch observed by each thread when quiescent */
+	struct stat_cache_retired {
+		stat_cache_entry *sce;
+		uint64_t epoch;
+	} *retired;             /* entries removed, pending free */
 } stat_cache;
 
-static stat_cache sc;
+static stat_cache sc = {
+  STAT_CACHE_ENGINE_SIMPLE, 0, 0, STAT_CACHE_MAX_ENTRIES_DEFAULT, 0, 0,
+  0, STAT_CACHE_MAX_FDS_DEFAULT, STAT_CACHE_MAX_CONTENT_SIZE_DEFAULT,
+  0, STAT_CACHE_MAX_CONTENT_TOTAL_DEFAULT, NULL, NULL, 0, 0, 0, 0, NULL, NULL
+};
+
+#ifdef HAVE_THREADS
+static pthread_mutex_t stat_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define stat_cache_lock() \
+        do { if (sc.threads) pthread_mutex_lock(&stat_cache_mutex); } while (0)
+#define stat_cache_unlock() \
+        do { if (sc.threads) pthread_mutex_unlock(&stat_cache_mutex); } while (0)
+#else
+#define stat_cache_lock()   do { } while (0)
+#define stat_cache_unlock() do { } while (0)
+#endif
 
 
+__attribute_pure__
+static uint32_t stat_cache_hash(const char * const name, const uint32_t len)
+{
+    uint32_t h = djbhash(name, len, DJBHASH_INIT);
+    /* mix bits; table index is taken from low bits of hash */
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+static stat_cache_slot * stat_cache_slot_find(const char * const name,
+                                              const uint32_t len,
+                                              const uint32_t hash)
+{
+    stat_cache_slot * const files = sc.files;
+    if (NULL == files) return NULL;
+    const uint32_t mask = sc.mask;
+    for (uint32_t i = hash & mask, dist = 0; ; i = (i+1) & mask, ++dist) {
+        stat_cache_slot * const slot = files+i;
+        /* (Robin Hood: stop when probe dist exceeds dist of resident entry)*/
+        if (NULL == slot->sce || ((i - slot->hash) & mask) < dist)
+            return NULL;
+        if (slot->hash == hash
+            && buffer_is_equal_string(&slot->sce->name, name, len))
+            return slot;
+    }
+}
+
+static void stat_cache_slot_insert(stat_cache_slot * const files,
+                                   const uint32_t mask, stat_cache_slot cur)
+{
+    for (uint32_t i = cur.hash & mask, dist = 0; ; i = (i+1) & mask, ++dist) {
+        stat_cache_slot * const slot = files+i;
+        if (NULL == slot->sce) {
+            *slot = cur;
+            return;
+        }
+        const uint32_t sdist = (i - slot->hash) & mask;
+        if (sdist < dist) { /* displace entry closer to its home slot */
+            const stat_cache_slot tmp = *slot;
+            *slot = cur;
+            cur = tmp;
+            dist = sdist;
+        }
+    }
+}
+
+static void stat_cache_slot_remove(stat_cache_slot *slot)
+{
+    /* backward shift deletion (no tombstones) */
+    stat_cache_slot * const files = sc.files;
+    const uint32_t mask = sc.mask;
+    for (uint32_t i = (uint32_t)(slot - files), j; ; i = j) {
+        j = (i+1) & mask;
+        if (NULL == files[j].sce || ((j - files[j].hash) & mask) == 0) {
+            files[i].sce = NULL;
+            files[i].hash = 0;
+            files[i].ref = 0;
+            break;
+        }
+        files[i] = files[j];
+    }
+    --sc.used;
+}
+
+__attribute_cold__
+__attribute_noinline__
+static void stat_cache_resize(const uint32_t sz)
+{
+    stat_cache_slot * const files = calloc(sz, sizeof(*files));
+    force_assert(NULL != files);
+    if (sc.files) {
+        for (uint32_t i = 0; i <= sc.mask; ++i) {
+            if (sc.files[i].sce)
+                stat_cache_slot_insert(files, sz-1, sc.files[i]);
+        }
+        free(sc.files);
+    }
+    sc.files = files;
+    sc.mask = sz-1;
+    sc.hand &= sc.mask;
+    sc.sweep &= sc.mask;
+}
+
+
+#ifdef STAT_CACHE_MONITOR_DIRS
+
 static void * stat_cache_sptree_find(splay_tree ** const sptree,
                                      const char * const name,
                                      uint32_t len)
@@ -64,10 +231,7 @@ static void * stat_cache_sptree_find(splay_tree ** const sptree,
     return (*sptree && (*sptree)->key == ndx) ? (*sptree)->data : NULL;
 }
 
-
-#ifdef HAVE_FAM_H
-
-/* monitor changes in directories using FAM
+/* monitor changes in directories using FAM (or inotify)
  *
  * This implementation employing FAM monitors directories as they are used,
  * and maintains a reference count for cache use within stat_cache.c.
@@ -118,17 +282,52 @@ static void * stat_cache_sptree_find(splay_tree ** const sptree,
  *
  * Internal note: lighttpd walks the caches to prune trees in stat_cache when an
  * event is received for a directory (or symlink to a directory) which has been
- * deleted or renamed.  The splaytree data structure is suboptimal for frequent
+ * deleted or renamed.  Walking the entire hash table is suboptimal for frequent
  * changes of large directories trees where there have been a large number of
  * different files recently accessed and part of the stat_cache.
+ *
+ * server.stat-cache-engine = "inotify" (Linux) uses the same directory
+ * monitoring as "fam" above, with events received directly from the kernel.
+ * Since inotify does not drop events silently (IN_Q_OVERFLOW is reported,
+ * and then the entire cache is invalidated), entries in monitored directories
+ * are not periodically re-stat()ed; they remain valid until an event for the
+ * entry or its directory is received, or until unused for 32-64 seconds.
+ * The limitations noted above for "fam" still apply, but without the 16 second
+ * upper limit on use of stale data, so "inotify" should not be used where
+ * parent directories of monitored directories are renamed (e.g. to deploy
+ * a new document root) unless the renamed directory is itself monitored.
+ * Files which are symlinks are not treated as monitored and are re-stat()ed
+ * upon use, as with "fam".  (symlinks to directories are monitored)
  */
 
+#ifdef HAVE_FAM_H
 #include <fam.h>
+#else
+typedef enum FAMCodes { /*(subset of fam.h; used for inotify event codes)*/
+    FAMChanged=1,
+    FAMDeleted=2,
+    FAMCreated=5,
+    FAMMoved=6
+} FAMCodes;
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#define STAT_CACHE_INOTIFY_MASK \
+  (IN_ATTRIB | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MODIFY \
+  | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_EXCL_UNLINK | IN_ONLYDIR)
+  /*(note: follows symlinks; IN_DONT_FOLLOW not used, like FAM)*/
+#endif
 
 typedef struct fam_dir_entry {
 	buffer *name;
 	int refcnt;
+  #ifdef HAVE_FAM_H
 	FAMRequest req;
+  #endif
+  #ifdef HAVE_SYS_INOTIFY_H
+	int wd; /* inotify watch descriptor (-1 if not monitored) */
+  #endif
 	time_t stat_ts;
 	dev_t st_dev;
 	ino_t st_ino;
@@ -137,7 +336,12 @@ typedef struct fam_dir_entry {
 
 typedef struct stat_cache_fam {
 	splay_tree *dirs; /* the nodes of the tree are fam_dir_entry */
+  #ifdef HAVE_FAM_H
 	FAMConnection fam;
+  #endif
+  #ifdef HAVE_SYS_INOTIFY_H
+	splay_tree *wds; /* inotify wd -> fam_dir_entry (keyed by wd) */
+  #endif
 	log_error_st *errh;
 	fdevents *ev;
 	fdnode *fdn;
@@ -152,6 +356,9 @@ static fam_dir_entry * fam_dir_entry_init(const char *name, size_t len)
     fam_dir->name = buffer_init();
     buffer_copy_string_len(fam_dir->name, name, len);
     fam_dir->refcnt = 0;
+  #ifdef HAVE_SYS_INOTIFY_H
+    fam_dir->wd = -1;
+  #endif
 
     return fam_dir;
 }
@@ -164,6 +371,67 @@ static void fam_dir_entry_free(fam_dir_entry *fam_dir)
     free(fam_dir);
 }
 
+static int fam_dir_monitor_start(stat_cache_fam *scf, fam_dir_entry *fam_dir, int dir_ndx)
+{
+  #ifdef HAVE_SYS_INOTIFY_H
+    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY) {
+        const int wd =
+          inotify_add_watch(scf->fd, fam_dir->name->ptr, STAT_CACHE_INOTIFY_MASK);
+        if (wd < 0) return -1;
+        scf->wds = splaytree_splay(scf->wds, wd);
+        if (scf->wds && scf->wds->key == wd) {
+            /* inotify returns existing wd if dir is already monitored,
+             * e.g. through a symlink; do not share (or remove) that watch */
+            if (scf->wds->data != fam_dir) { errno = EEXIST; return -1; }
+        }
+        else
+            scf->wds = splaytree_insert(scf->wds, wd, fam_dir);
+        fam_dir->wd = wd;
+        return 0;
+    }
+  #endif
+  #ifdef HAVE_FAM_H
+    return FAMMonitorDirectory(&scf->fam, fam_dir->name->ptr, &fam_dir->req,
+                               (void *)(intptr_t)dir_ndx);
+  #else
+    UNUSED(dir_ndx);
+    return -1;
+  #endif
+}
+
+static int fam_dir_monitor_cancel(stat_cache_fam *scf, fam_dir_entry *fam_dir)
+{
+  #ifdef HAVE_SYS_INOTIFY_H
+    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY) {
+        const int wd = fam_dir->wd;
+        if (wd < 0) return 0; /*(e.g. watch already removed by kernel)*/
+        fam_dir->wd = -1;
+        scf->wds = splaytree_splay(scf->wds, wd);
+        if (scf->wds && scf->wds->key == wd && scf->wds->data == fam_dir) {
+            scf->wds = splaytree_delete(scf->wds, wd);
+            if (-1 != scf->fd) inotify_rm_watch(scf->fd, wd);
+        }
+        return 0;
+    }
+  #endif
+  #ifdef HAVE_FAM_H
+    return FAMCancelMonitor(&scf->fam, &fam_dir->req);
+  #else
+    UNUSED(scf);
+    return 0;
+  #endif
+}
+
+static int fam_dir_is_monitored(const fam_dir_entry *fam_dir)
+{
+  #ifdef HAVE_SYS_INOTIFY_H
+    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY)
+        return (fam_dir->wd >= 0);
+  #endif
+    UNUSED(fam_dir);
+    return 1;
+}
+
 static void fam_dir_invalidate_node(fam_dir_entry *fam_dir)
 {
     fam_dir->stat_ts = 0;
@@ -207,7 +475,7 @@ static void fam_dir_periodic_cleanup() {
             if (node && node->key == ndx) {
                 fam_dir_entry *fam_dir = node->data;
                 scf->dirs = splaytree_delete(scf->dirs, ndx);
-                FAMCancelMonitor(&scf->fam, &fam_dir->req);
+                fam_dir_monitor_cancel(scf, fam_dir);
                 fam_dir_entry_free(fam_dir);
             }
         }
@@ -236,6 +504,79 @@ static void fam_dir_invalidate_tree(splay_tree *t, const char *name, size_t len)
 /* declarations */
 static void stat_cache_delete_tree(const char *name, uint32_t len);
 static void stat_cache_invalidate_dir_tree(const char *name, size_t len);
+static void stat_cache_invalidate_entry_locked(const char *name, uint32_t len);
+static void stat_cache_update_entry_locked(const char *name, uint32_t len, struct stat *st, buffer *etagb);
+
+static void stat_cache_handle_fam_event(stat_cache_fam *scf, fam_dir_entry *fam_dir, int code, const char *fn, size_t fnlen)
+{
+    if (NULL != fn) { /* event for file in monitored dir (not dir itself) */
+        buffer * const n = fam_dir->name;
+        fam_dir_entry *fam_link;
+        size_t len;
+        switch(code) {
+        case FAMCreated:
+            /* file created in monitored dir modifies dir and
+             * we should get a separate FAMChanged event for dir.
+             * Therefore, ignore file FAMCreated event here.
+             * Also, if FAMNoExists() is used, might get spurious
+             * FAMCreated events as changes are made e.g. in monitored
+             * sub-sub-sub dirs and the library discovers new (already
+             * existing) dir entries */
+            return;
+        case FAMChanged:
+            /* file changed in monitored dir does not modify dir */
+        case FAMDeleted:
+        case FAMMoved:
+            /* file deleted or moved in monitored dir modifies dir,
+             * but FAM provides separate notification for that */
+
+            /* temporarily append filename to dir in fam_dir->name to
+             * construct path, then delete stat_cache entry (if any)*/
+            len = buffer_string_length(n);
+            buffer_append_string_len(n, CONST_STR_LEN("/"));
+            buffer_append_string_len(n, fn, fnlen);
+            /* (alternatively, could chose to stat() and update)*/
+            stat_cache_invalidate_entry_locked(CONST_BUF_LEN(n));
+
+            fam_link = /*(check if might be symlink to monitored dir)*/
+              stat_cache_sptree_find(&scf->dirs, CONST_BUF_LEN(n));
+            if (fam_link && !buffer_is_equal(fam_link->name, n))
+                fam_link = NULL;
+
+            buffer_string_set_length(n, len);
+
+            if (fam_link) {
+                /* replaced symlink changes containing dir */
+                stat_cache_invalidate_entry_locked(CONST_BUF_LEN(n));
+                /* handle symlink to dir as deleted dir below */
+                code = FAMDeleted;
+                fam_dir = fam_link;
+                break;
+            }
+            return;
+        default:
+            return;
+        }
+    }
+
+    switch(code) {
+    case FAMChanged:
+        stat_cache_invalidate_entry_locked(CONST_BUF_LEN(fam_dir->name));
+        break;
+    case FAMDeleted:
+    case FAMMoved:
+        stat_cache_delete_tree(CONST_BUF_LEN(fam_dir->name));
+        fam_dir_invalidate_node(fam_dir);
+        if (scf->dirs)
+            fam_dir_invalidate_tree(scf->dirs, CONST_BUF_LEN(fam_dir->name));
+        fam_dir_periodic_cleanup();
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef HAVE_FAM_H
 
 static void stat_cache_handle_fdevent_in(stat_cache_fam *scf)
 {
@@ -256,80 +597,116 @@ static void stat_cache_handle_fdevent_in(stat_cache_fam *scf)
             continue;
         }
 
-        if (fe.filename[0] != '/') {
-            buffer * const n = fam_dir->name;
-            fam_dir_entry *fam_link;
-            size_t len;
-            switch(fe.code) {
-            case FAMCreated:
-                /* file created in monitored dir modifies dir and
-                 * we should get a separate FAMChanged event for dir.
-                 * Therefore, ignore file FAMCreated event here.
-                 * Also, if FAMNoExists() is used, might get spurious
-                 * FAMCreated events as changes are made e.g. in monitored
-                 * sub-sub-sub dirs and the library discovers new (already
-                 * existing) dir entries */
-                continue;
-            case FAMChanged:
-                /* file changed in monitored dir does not modify dir */
-            case FAMDeleted:
-            case FAMMoved:
-                /* file deleted or moved in monitored dir modifies dir,
-                 * but FAM provides separate notification for that */
-
-                /* temporarily append filename to dir in fam_dir->name to
-                 * construct path, then delete stat_cache entry (if any)*/
-                len = buffer_string_length(n);
-                buffer_append_string_len(n, CONST_STR_LEN("/"));
-                buffer_append_string_len(n,fe.filename,strlen(fe.filename));
-                /* (alternatively, could chose to stat() and update)*/
-                stat_cache_invalidate_entry(CONST_BUF_LEN(n));
-
-                fam_link = /*(check if might be symlink to monitored dir)*/
-                  stat_cache_sptree_find(&scf->dirs, CONST_BUF_LEN(n));
-                if (fam_link && !buffer_is_equal(fam_link->name, n))
-                    fam_link = NULL;
-
-                buffer_string_set_length(n, len);
-
-                if (fam_link) {
-                    /* replaced symlink changes containing dir */
-                    stat_cache_invalidate_entry(CONST_BUF_LEN(n));
-                    /* handle symlink to dir as deleted dir below */
-                    fe.code = FAMDeleted;
-                    fam_dir = fam_link;
-                    break;
-                }
-                continue;
-            default:
-                continue;
-            }
-        }
+        if (fe.filename[0] != '/')
+            stat_cache_handle_fam_event(scf, fam_dir, fe.code,
+                                        fe.filename, strlen(fe.filename));
+        else
+            stat_cache_handle_fam_event(scf, fam_dir, fe.code, NULL, 0);
+    }
+}
 
-        switch(fe.code) {
-        case FAMChanged:
-            stat_cache_invalidate_entry(CONST_BUF_LEN(fam_dir->name));
-            break;
-        case FAMDeleted:
-        case FAMMoved:
-            stat_cache_delete_tree(CONST_BUF_LEN(fam_dir->name));
-            fam_dir_invalidate_node(fam_dir);
-            if (scf->dirs)
-                fam_dir_invalidate_tree(scf->dirs,CONST_BUF_LEN(fam_dir->name));
-            fam_dir_periodic_cleanup();
-            break;
-        default:
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+static void stat_cache_handle_inotify_event(stat_cache_fam *scf, const struct inotify_event *ie)
+{
+    if (ie->mask & IN_Q_OVERFLOW) {
+        /* events were dropped; invalidate everything (re-stat() upon use) */
+        log_error(scf->errh, __FILE__, __LINE__,
+          "inotify event queue overflow; invalidating stat_cache");
+        stat_cache_invalidate_dir_tree("", 0);
+        if (scf->dirs) fam_dir_invalidate_tree(scf->dirs, "", 0);
+        return;
+    }
+
+    /* ignore events which may have been pending for
+     * dirs recently cancelled via inotify_rm_watch() */
+    scf->wds = splaytree_splay(scf->wds, ie->wd);
+    if (!scf->wds || scf->wds->key != ie->wd) return;
+    fam_dir_entry * const fam_dir = scf->wds->data;
+
+    if (ie->mask & IN_IGNORED) {
+        /* watch removed by kernel (dir deleted or filesystem unmounted) */
+        scf->wds = splaytree_delete(scf->wds, ie->wd);
+        fam_dir->wd = -1;
+        stat_cache_handle_fam_event(scf, fam_dir, FAMDeleted, NULL, 0);
+        return;
+    }
+
+    if (ie->len && ie->name[0]) {
+        /* (no separate event for dir itself when dir entries change) */
+        if (ie->mask & (IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO))
+            stat_cache_invalidate_entry_locked(CONST_BUF_LEN(fam_dir->name));
+        /* (IN_CREATE and IN_MOVED_TO handled as FAMDeleted since name might
+         *  have replaced a symlink to a monitored dir, e.g. atomic deploy) */
+        const int code = (ie->mask & (IN_MODIFY|IN_ATTRIB))
+          ? FAMChanged
+          : FAMDeleted;
+        stat_cache_handle_fam_event(scf, fam_dir, code,
+                                    ie->name, strlen(ie->name));
+    }
+    else if (ie->mask & (IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT))
+        stat_cache_handle_fam_event(scf, fam_dir, FAMDeleted, NULL, 0);
+    else if (ie->mask & (IN_ATTRIB|IN_MODIFY))
+        stat_cache_handle_fam_event(scf, fam_dir, FAMChanged, NULL, 0);
+}
+
+static void stat_cache_handle_fdevent_in_inotify(stat_cache_fam *scf)
+{
+    char buf[4096]
+      __attribute__((__aligned__(__alignof__(struct inotify_event))));
+    /*(limit loop; remaining events are handled upon next poll)*/
+    for (int n = 0; n < 16 && -1 != scf->fd; ++n) {
+        const ssize_t rd = read(scf->fd, buf, sizeof(buf));
+        if (rd <= 0) {
+            if (-1 == rd && errno == EINTR) continue;
             break;
         }
+        for (ssize_t i = 0; i < rd; ) {
+            const struct inotify_event * const ie =
+              (const struct inotify_event *)(buf+i);
+            stat_cache_handle_inotify_event(scf, ie);
+            i += (ssize_t)(sizeof(struct inotify_event) + ie->len);
+        }
+    }
+}
+
+#endif
+
+static void stat_cache_fam_close(stat_cache_fam *scf)
+{
+  #ifdef HAVE_SYS_INOTIFY_H
+    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY) {
+        /* (closing inotify fd removes all watches) */
+        while (scf->wds)
+            scf->wds = splaytree_delete(scf->wds, scf->wds->key);
+        close(scf->fd);
+        scf->fd = -1;
+        return;
     }
+  #endif
+  #ifdef HAVE_FAM_H
+    FAMClose(&scf->fam);
+  #endif
+    scf->fd = -1;
 }
 
 static handler_t stat_cache_handle_fdevent(void *ctx, int revent)
 {
 	stat_cache_fam * const scf = ctx; /* sc.scf */
 
+	stat_cache_lock();
+
 	if (revent & FDEVENT_IN) {
-		stat_cache_handle_fdevent_in(scf);
+	  #ifdef HAVE_SYS_INOTIFY_H
+		if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY)
+			stat_cache_handle_fdevent_in_inotify(scf);
+	  #endif
+	  #ifdef HAVE_FAM_H
+		if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM)
+			stat_cache_handle_fdevent_in(scf);
+	  #endif
 	}
 
 	if (revent & (FDEVENT_HUP|FDEVENT_RDHUP)) {
@@ -343,10 +720,11 @@ static handler_t stat_cache_handle_fdevent(void *ctx, int revent)
 		fdevent_unregister(scf->ev, scf->fd);
 		scf->fdn = NULL;
 
-		FAMClose(&scf->fam);
-		scf->fd = -1;
+		stat_cache_fam_close(scf);
 	}
 
+	stat_cache_unlock();
+
 	return HANDLER_GO_ON;
 }
 
@@ -357,18 +735,35 @@ static stat_cache_fam * stat_cache_init_fam(fdevents *ev, log_error_st *errh) {
 	scf->ev = ev;
 	scf->errh = errh;
 
-	/* setup FAM */
-	if (0 != FAMOpen2(&scf->fam, "lighttpd")) {
-		log_error(errh, __FILE__, __LINE__,
-		  "could not open a fam connection, dying.");
-		return NULL;
+      #ifdef HAVE_SYS_INOTIFY_H
+	if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY) {
+		scf->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (-1 == scf->fd) {
+			log_perror(errh, __FILE__, __LINE__,
+			  "inotify_init1() failed, dying.");
+			free(scf);
+			return NULL;
+		}
+	}
+      #endif
+      #ifdef HAVE_FAM_H
+	if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM) {
+		/* setup FAM */
+		if (0 != FAMOpen2(&scf->fam, "lighttpd")) {
+			log_error(errh, __FILE__, __LINE__,
+			  "could not open a fam connection, dying.");
+			free(scf);
+			return NULL;
+		}
+	      #ifdef HAVE_FAMNOEXISTS
+		FAMNoExists(&scf->fam);
+	      #endif
+
+		scf->fd = FAMCONNECTION_GETFD(&scf->fam);
+		fdevent_setfd_cloexec(scf->fd);
 	}
-      #ifdef HAVE_FAMNOEXISTS
-	FAMNoExists(&scf->fam);
       #endif
 
-	scf->fd = FAMCONNECTION_GETFD(&scf->fam);
-	fdevent_setfd_cloexec(scf->fd);
 	scf->fdn = fdevent_register(scf->ev, scf->fd, stat_cache_handle_fdevent, scf);
 	fdevent_fdnode_event_set(scf->ev, scf->fdn, FDEVENT_IN | FDEVENT_RDHUP);
 
@@ -387,7 +782,7 @@ static void stat_cache_free_fam(stat_cache_fam *scf) {
 
 	if (-1 != scf->fd) {
 		/*scf->fdn already cleaned up in fdevent_free()*/
-		FAMClose(&scf->fam);
+		stat_cache_fam_close(scf);
 		/*scf->fd = -1;*/
 	}
 
@@ -449,19 +844,18 @@ static fam_dir_entry * fam_dir_monitor(stat_cache_fam *scf, char *fn, uint32_t d
     if (ck_dir && NULL != fam_dir) {
         /* check stat() matches device and inode, just in case an external event
          * not being monitored occurs (e.g. rename of unmonitored parent dir)*/
-        if (st->st_dev != fam_dir->st_dev || st->st_ino != fam_dir->st_ino) {
+        if (st->st_dev != fam_dir->st_dev || st->st_ino != fam_dir->st_ino
+            || !fam_dir_is_monitored(fam_dir)) {
             ck_lnk = 1;
             /*(modifies scf->dirs but no need to re-splay for dir_ndx since
              * fam_dir is not NULL and so splaytree_insert not called below)*/
             if (scf->dirs) fam_dir_invalidate_tree(scf->dirs, fn, dirlen);
             if (!fn_is_dir) /*(if dir, caller is updating stat_cache_entry)*/
-                stat_cache_update_entry(fn, dirlen, st, NULL);
+                stat_cache_update_entry_locked(fn, dirlen, st, NULL);
             /*(must not delete tree since caller is holding a valid node)*/
             stat_cache_invalidate_dir_tree(fn, dirlen);
-            if (0 != FAMCancelMonitor(&scf->fam, &fam_dir->req)
-                || 0 != FAMMonitorDirectory(&scf->fam, fam_dir->name->ptr,
-                                            &fam_dir->req,
-                                            (void *)(intptr_t)dir_ndx)) {
+            if (0 != fam_dir_monitor_cancel(scf, fam_dir)
+                || 0 != fam_dir_monitor_start(scf, fam_dir, dir_ndx)) {
                 fam_dir->stat_ts = 0; /* invalidate */
                 return NULL;
             }
@@ -474,11 +868,18 @@ static fam_dir_entry * fam_dir_monitor(stat_cache_fam *scf, char *fn, uint32_t d
     if (NULL == fam_dir) {
         fam_dir = fam_dir_entry_init(fn, dirlen);
 
-        if (0 != FAMMonitorDirectory(&scf->fam,fam_dir->name->ptr,&fam_dir->req,
-                                     (void *)(intptr_t)dir_ndx)) {
-            log_error(scf->errh, __FILE__, __LINE__,
-              "monitoring dir failed: %s file: %s %s",
-              fam_dir->name->ptr, fn, FamErrlist[FAMErrno]);
+        if (0 != fam_dir_monitor_start(scf, fam_dir, dir_ndx)) {
+          #ifdef HAVE_FAM_H
+            if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM)
+                log_error(scf->errh, __FILE__, __LINE__,
+                  "monitoring dir failed: %s file: %s %s",
+                  fam_dir->name->ptr, fn, FamErrlist[FAMErrno]);
+            else
+          #endif
+            if (errno != ENOENT && errno != ENOTDIR && errno != EEXIST)
+                log_perror(scf->errh, __FILE__, __LINE__,
+                  "monitoring dir failed: %s file: %s",
+                  fam_dir->name->ptr, fn);
             fam_dir_entry_free(fam_dir);
             return NULL;
         }
@@ -519,31 +920,224 @@ static fam_dir_entry * fam_dir_monitor(stat_cache_fam *scf, char *fn, uint32_t d
 static stat_cache_entry * stat_cache_entry_init(void) {
     stat_cache_entry *sce = calloc(1, sizeof(*sce));
     force_assert(NULL != sce);
+    sce->fd = -1;
+    sce->refcnt = 1;
     return sce;
 }
 
+static void stat_cache_entry_content_free(stat_cache_entry * const sce) {
+    sc.content_total -= buffer_string_length(sce->content);
+    buffer_free(sce->content);
+    sce->content = NULL;
+}
+
+static void stat_cache_entry_release(stat_cache_entry * const sce) {
+    if (sce->fd >= 0) {
+        close(sce->fd);
+        --sc.fds;
+    }
+    if (sce->content)
+        stat_cache_entry_content_free(sce);
+
+    free(sce->name.ptr);
+    free(sce->etag.ptr);
+    if (sce->content_type.size) free(sce->content_type.ptr);
+
+    free(sce);
+}
+
+#ifdef HAVE_THREADS
+
+static void stat_cache_entry_retire(stat_cache_entry * const sce) {
+    /* defer free until each thread has been quiescent, since other threads
+     * might still be using the entry obtained before it was removed */
+    if (sc.retired_used == sc.retired_size) {
+        sc.retired_size += 64;
+        sc.retired = realloc(sc.retired, sc.retired_size * sizeof(*sc.retired));
+        force_assert(NULL != sc.retired);
+    }
+    sc.retired[sc.retired_used].sce = sce;
+    sc.retired[sc.retired_used].epoch = sc.epoch;
+    ++sc.retired_used;
+}
+
+static void stat_cache_reclaim(void) {
+    uint64_t min = UINT64_MAX;
+    for (uint32_t i = 0; i < sc.threads; ++i) {
+        const uint64_t q = __atomic_load_n(sc.qs+i, __ATOMIC_ACQUIRE);
+        if (min > q) min = q;
+    }
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < sc.retired_used; ++i) {
+        if (sc.retired[i].epoch < min)
+            stat_cache_entry_release(sc.retired[i].sce);
+        else
+            sc.retired[j++] = sc.retired[i];
+    }
+    sc.retired_used = j;
+    __atomic_store_n(&sc.epoch, sc.epoch+1, __ATOMIC_RELEASE);
+}
+
+#endif
+
+void stat_cache_threads (uint32_t n) {
+    free(sc.qs);
+    sc.qs = NULL;
+    sc.threads = 0;
+    if (n <= 1) return;
+    sc.qs = calloc(n, sizeof(*sc.qs));
+    force_assert(NULL != sc.qs);
+    sc.threads = n;
+}
+
+void stat_cache_thread_quiescent (uint32_t ndx) {
+    /* (called by each thread at top of event loop; holds no entries) */
+  #ifdef HAVE_THREADS
+    if (sc.threads)
+        __atomic_store_n(sc.qs+ndx, __atomic_load_n(&sc.epoch,__ATOMIC_ACQUIRE),
+                         __ATOMIC_RELEASE);
+  #else
+    UNUSED(ndx);
+  #endif
+}
+
+static void stat_cache_entry_refchg_locked(stat_cache_entry * const sce, const int mod) {
+    if (0 != (sce->refcnt += mod)) return;
+  #ifdef HAVE_THREADS
+    if (sc.threads) {
+        stat_cache_entry_retire(sce);
+        return;
+    }
+  #endif
+    stat_cache_entry_release(sce);
+}
+
+void stat_cache_entry_refchg(void *data, int mod) {
+    /*(callback used by chunks which reference sce->fd or sce->content)*/
+    stat_cache_lock();
+    stat_cache_entry_refchg_locked(data, mod);
+    stat_cache_unlock();
+}
+
 static void stat_cache_entry_free(void *data) {
+    /* remove entry from cache; entry is freed when no longer referenced
+     * (sce->fd or sce->content might still be in use by chunks in response
+     *  write queues) */
     stat_cache_entry *sce = data;
     if (!sce) return;
 
-  #ifdef HAVE_FAM_H
+  #ifdef STAT_CACHE_MONITOR_DIRS
     /*(decrement refcnt only;
      * defer cancelling FAM monitor on dir even if refcnt reaches zero)*/
-    if (sce->fam_dir) --((fam_dir_entry *)sce->fam_dir)->refcnt;
+    if (sce->fam_dir) {
+        --((fam_dir_entry *)sce->fam_dir)->refcnt;
+        sce->fam_dir = NULL;
+    }
   #endif
 
-    free(sce->name.ptr);
-    free(sce->etag.ptr);
-    if (sce->content_type.size) free(sce->content_type.ptr);
+    stat_cache_entry_refchg_locked(sce, -1);
+}
 
-    free(sce);
+#define stat_cache_entry_has_file(sce) ((sce)->fd >= 0 || NULL != (sce)->content)
+
+__attribute_pure__
+static int stat_cache_st_times_eq(const struct stat * const a, const struct stat * const b)
+{
+    /* (compare high-precision timestamps if available; a file rewritten
+     *  in place with the same size in the same second differs only here) */
+    return a->st_mtime == b->st_mtime
+        && a->st_ctime == b->st_ctime
+      #ifdef st_mtime
+      #if defined(__APPLE__) && defined(__MACH__)
+        && a->st_mtimespec.tv_nsec == b->st_mtimespec.tv_nsec
+        && a->st_ctimespec.tv_nsec == b->st_ctimespec.tv_nsec
+      #else
+        && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec
+        && a->st_ctim.tv_nsec == b->st_ctim.tv_nsec
+      #endif
+      #endif
+        ;
+}
+
+__attribute_pure__
+static int stat_cache_entry_file_changed(const stat_cache_entry * const sce, const struct stat * const st)
+{
+    /* cached fd must refer to same file; cached content must match file */
+    return sce->st.st_ino != st->st_ino
+        || sce->st.st_dev != st->st_dev
+        || (NULL != sce->content
+            && (sce->st.st_size != st->st_size
+                || !stat_cache_st_times_eq(&sce->st, st)));
+}
+
+__attribute_noinline__
+static stat_cache_entry * stat_cache_entry_file_close(stat_cache_slot * const slot)
+{
+    /* close fd and release contents cached in entry
+     * (e.g. file modified or replaced, or entry invalidated)
+     * If still in use by chunks, replace entry in cache with a copy
+     * and leave the original to be freed when the last chunk releases it
+     * (always replace entry if threaded; entry might be in use by others) */
+    stat_cache_entry *sce = slot->sce;
+    if (1 == sce->refcnt && !sc.threads) {
+        if (sce->fd >= 0) {
+            close(sce->fd);
+            sce->fd = -1;
+            --sc.fds;
+        }
+        if (sce->content)
+            stat_cache_entry_content_free(sce);
+        return sce;
+    }
+
+    stat_cache_entry * const nsce = stat_cache_entry_init();
+    buffer_copy_buffer(&nsce->name, &sce->name);
+    nsce->stat_ts = sce->stat_ts;
+    nsce->st = sce->st;
+    /*(etag and content_type are regenerated on demand)*/
+  #ifdef STAT_CACHE_MONITOR_DIRS
+    nsce->fam_dir = sce->fam_dir;
+    sce->fam_dir = NULL;
+  #endif
+    stat_cache_entry_refchg_locked(sce, -1);
+    return (slot->sce = nsce);
+}
+
+static void stat_cache_evict_clock(void)
+{
+    /* CLOCK (second chance): clear reference bit of each used entry passed,
+     * and evict first entry found which has not been used since last pass */
+    stat_cache_slot * const files = sc.files;
+    const uint32_t mask = sc.mask;
+    for (uint32_t i = sc.hand; ; i = (i+1) & mask) {
+        stat_cache_slot * const slot = files+i;
+        if (NULL == slot->sce) continue;
+        if (slot->ref) { slot->ref = 0; continue; }
+        stat_cache_entry_free(slot->sce);
+        stat_cache_slot_remove(slot);
+        sc.hand = i; /*(next entry, if any, was shifted into slot i)*/
+        return;
+    }
+}
+
+static void stat_cache_slot_add(stat_cache_entry * const sce, const uint32_t hash)
+{
+    if (sc.used >= sc.max)
+        stat_cache_evict_clock();
+    /* max load factor 3/4 */
+    const uint32_t sz = sc.files ? sc.mask+1 : 0;
+    if (sc.used >= sz - (sz >> 2))
+        stat_cache_resize(sz ? sz << 1 : 64);
+    stat_cache_slot cur = { hash, 1, sce };
+    stat_cache_slot_insert(sc.files, sc.mask, cur);
+    ++sc.used;
 }
 
 #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
 
 static const char *attrname = "Content-Type";
-static char attrval[128];
-static buffer attrb = { attrval, 0, 0 };
+static __thread_local char attrval[128];
+static __thread_local buffer attrb; /*(attrb.ptr = attrval)*/
 
 static int stat_cache_attr_get(const char *name) {
   #if defined(HAVE_XATTR)
@@ -562,6 +1156,7 @@ static int stat_cache_attr_get(const char *name) {
   #endif
     {
         attrval[attrlen] = '\0';
+        attrb.ptr = attrval;
         attrb.used = (uint32_t)(attrlen + 1);
         return 1;
     }
@@ -571,8 +1166,9 @@ static int stat_cache_attr_get(const char *name) {
 #endif
 
 int stat_cache_init(fdevents *ev, log_error_st *errh) {
-  #ifdef HAVE_FAM_H
-    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM) {
+  #ifdef STAT_CACHE_MONITOR_DIRS
+    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM
+        || sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY) {
         sc.scf = stat_cache_init_fam(ev, errh);
         if (NULL == sc.scf) return 0;
     }
@@ -585,14 +1181,29 @@ int stat_cache_init(fdevents *ev, log_error_st *errh) {
 }
 
 void stat_cache_free(void) {
-    splay_tree *sptree = sc.files;
-    while (sptree) {
-        stat_cache_entry_free(sptree->data);
-        sptree = splaytree_delete(sptree, sptree->key);
+    stat_cache_slot * const files = sc.files;
+    if (files) {
+        for (uint32_t i = 0; i <= sc.mask; ++i)
+            stat_cache_entry_free(files[i].sce);
+        free(files);
     }
     sc.files = NULL;
+    sc.used = 0;
+    sc.mask = 0;
+  #ifdef HAVE_THREADS
+    /*(threads have exited)*/
+    for (uint32_t i = 0; i < sc.retired_used; ++i)
+        stat_cache_entry_release(sc.retired[i].sce);
+    free(sc.retired);
+    sc.retired = NULL;
+    sc.retired_used = 0;
+    sc.retired_size = 0;
+    stat_cache_threads(0);
+  #endif
+    sc.hand = 0;
+    sc.sweep = 0;
 
-  #ifdef HAVE_FAM_H
+  #ifdef STAT_CACHE_MONITOR_DIRS
     stat_cache_free_fam(sc.scf);
     sc.scf = NULL;
   #endif
@@ -602,6 +1213,11 @@ void stat_cache_free(void) {
   #endif
 
     sc.stat_cache_engine = STAT_CACHE_ENGINE_SIMPLE; /*(default)*/
+    sc.max = STAT_CACHE_MAX_ENTRIES_DEFAULT;
+    sc.max_fds = STAT_CACHE_MAX_FDS_DEFAULT;
+    sc.max_content_size = STAT_CACHE_MAX_CONTENT_SIZE_DEFAULT;
+    sc.max_content_total = STAT_CACHE_MAX_CONTENT_TOTAL_DEFAULT;
+    /*(sc.fds is not reset; entries referenced by chunks are freed later)*/
 }
 
 void stat_cache_xattrname (const char *name) {
@@ -612,6 +1228,24 @@ void stat_cache_xattrname (const char *name) {
   #endif
 }
 
+void stat_cache_max_entries (uint32_t max) {
+    sc.max = (0 == max) ? STAT_CACHE_MAX_ENTRIES_DEFAULT : max < 64 ? 64 : max;
+}
+
+void stat_cache_max_fds (uint32_t max) {
+    sc.max_fds = max; /*(0 disables caching open fds)*/
+}
+
+void stat_cache_max_content_size (uint32_t max) {
+    sc.max_content_size = max; /*(0 disables caching file contents)*/
+}
+
+void stat_cache_max_content_total (uint32_t max_kb) {
+    sc.max_content_total = (0 == max_kb)
+      ? STAT_CACHE_MAX_CONTENT_TOTAL_DEFAULT
+      : (size_t)max_kb << 10;
+}
+
 int stat_cache_choose_engine (const buffer *stat_cache_string, log_error_st *errh) {
     if (buffer_string_is_empty(stat_cache_string))
         sc.stat_cache_engine = STAT_CACHE_ENGINE_SIMPLE;
@@ -620,6 +1254,10 @@ int stat_cache_choose_engine (const buffer *stat_cache_string, log_error_st *err
 #ifdef HAVE_FAM_H
     else if (buffer_eq_slen(stat_cache_string, CONST_STR_LEN("fam")))
         sc.stat_cache_engine = STAT_CACHE_ENGINE_FAM;
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+    else if (buffer_eq_slen(stat_cache_string, CONST_STR_LEN("inotify")))
+        sc.stat_cache_engine = STAT_CACHE_ENGINE_INOTIFY;
 #endif
     else if (buffer_eq_slen(stat_cache_string, CONST_STR_LEN("disable")))
         sc.stat_cache_engine = STAT_CACHE_ENGINE_NONE;
@@ -628,6 +1266,9 @@ int stat_cache_choose_engine (const buffer *stat_cache_string, log_error_st *err
           "server.stat-cache-engine can be one of \"disable\", \"simple\","
 #ifdef HAVE_FAM_H
           " \"fam\","
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+          " \"inotify\","
 #endif
           " but not: %s", stat_cache_string->ptr);
         return -1;
@@ -690,7 +1331,7 @@ const buffer * stat_cache_mimetype_by_xattr(const char * const name)
     return stat_cache_attr_get(name) ? &attrb : NULL;
 }
 
-const buffer * stat_cache_content_type_get_by_xattr(stat_cache_entry *sce, const array *mimetypes, int use_xattr)
+static const buffer * stat_cache_content_type_get_by_xattr_locked(stat_cache_entry *sce, const array *mimetypes, int use_xattr)
 {
     /*(invalid caching if user config has multiple, different
      * r->conf.mimetypes for same extension (not expected))*/
@@ -724,9 +1365,18 @@ const buffer * stat_cache_content_type_get_by_xattr(stat_cache_entry *sce, const
     return &sce->content_type;
 }
 
+const buffer * stat_cache_content_type_get_by_xattr(stat_cache_entry *sce, const array *mimetypes, int use_xattr)
+{
+    stat_cache_lock();
+    const buffer * const b =
+      stat_cache_content_type_get_by_xattr_locked(sce, mimetypes, use_xattr);
+    stat_cache_unlock();
+    return b;
+}
+
 #else
 
-const buffer * stat_cache_content_type_get_by_ext(stat_cache_entry *sce, const array *mimetypes)
+static const buffer * stat_cache_content_type_get_by_ext_locked(stat_cache_entry *sce, const array *mimetypes)
 {
     /*(invalid caching if user config has multiple, different
      * r->conf.mimetypes for same extension (not expected))*/
@@ -743,15 +1393,24 @@ const buffer * stat_cache_content_type_get_by_ext(stat_cache_entry *sce, const a
         sce->content_type.used = mtype->used;
         /*(leave sce->content_type.size = 0 to flag not-allocated)*/
     }
-    else
+    else if (sce->content_type.used) /*(avoid write to sce if unchanged)*/
         buffer_clear(&sce->content_type);
 
     return &sce->content_type;
 }
 
+const buffer * stat_cache_content_type_get_by_ext(stat_cache_entry *sce, const array *mimetypes)
+{
+    stat_cache_lock();
+    const buffer * const b =
+      stat_cache_content_type_get_by_ext_locked(sce, mimetypes);
+    stat_cache_unlock();
+    return b;
+}
+
 #endif
 
-const buffer * stat_cache_etag_get(stat_cache_entry *sce, int flags) {
+static const buffer * stat_cache_etag_get_locked(stat_cache_entry *sce, int flags) {
     /*(invalid caching if user cfg has multiple, different r->conf.etag_flags
      * for same path (not expected, since etag flags should be by filesystem))*/
     if (!buffer_string_is_empty(&sce->etag)) return &sce->etag;
@@ -765,16 +1424,27 @@ const buffer * stat_cache_etag_get(stat_cache_entry *sce, int flags) {
     return NULL;
 }
 
-void stat_cache_update_entry(const char *name, uint32_t len,
-                             struct stat *st, buffer *etagb)
+const buffer * stat_cache_etag_get(stat_cache_entry *sce, int flags) {
+    stat_cache_lock();
+    const buffer * const b = stat_cache_etag_get_locked(sce, flags);
+    stat_cache_unlock();
+    return b;
+}
+
+static void stat_cache_update_entry_locked(const char *name, uint32_t len,
+                                           struct stat *st, buffer *etagb)
 {
     if (sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE) return;
     force_assert(0 != len);
     if (name[len-1] == '/') { if (0 == --len) len = 1; }
-    splay_tree **sptree = &sc.files;
-    stat_cache_entry *sce =
-      stat_cache_sptree_find(sptree, name, len);
-    if (sce && buffer_is_equal_string(&sce->name, name, len)) {
+    stat_cache_slot * const slot =
+      stat_cache_slot_find(name, len, stat_cache_hash(name, len));
+    if (slot) {
+        stat_cache_entry *sce = slot->sce;
+        if (sc.threads /*(do not modify entry in place; might be in use)*/
+            || (stat_cache_entry_has_file(sce)
+                && stat_cache_entry_file_changed(sce, st)))
+            sce = stat_cache_entry_file_close(slot);
         sce->stat_ts = log_epoch_secs;
         sce->st = *st; /* etagb might be NULL to clear etag (invalidate) */
         buffer_copy_string_len(&sce->etag, CONST_BUF_LEN(etagb));
@@ -784,116 +1454,118 @@ void stat_cache_update_entry(const char *name, uint32_t len,
     }
 }
 
-void stat_cache_delete_entry(const char *name, uint32_t len)
+void stat_cache_update_entry(const char *name, uint32_t len,
+                             struct stat *st, buffer *etagb)
+{
+    stat_cache_lock();
+    stat_cache_update_entry_locked(name, len, st, etagb);
+    stat_cache_unlock();
+}
+
+static void stat_cache_delete_entry_locked(const char *name, uint32_t len)
 {
     if (sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE) return;
     force_assert(0 != len);
     if (name[len-1] == '/') { if (0 == --len) len = 1; }
-    splay_tree **sptree = &sc.files;
-    stat_cache_entry *sce = stat_cache_sptree_find(sptree, name, len);
-    if (sce && buffer_is_equal_string(&sce->name, name, len)) {
-        stat_cache_entry_free(sce);
-        *sptree = splaytree_delete(*sptree, (*sptree)->key);
+    stat_cache_slot * const slot =
+      stat_cache_slot_find(name, len, stat_cache_hash(name, len));
+    if (slot) {
+        stat_cache_entry_free(slot->sce);
+        stat_cache_slot_remove(slot);
     }
 }
 
-void stat_cache_invalidate_entry(const char *name, uint32_t len)
+void stat_cache_delete_entry(const char *name, uint32_t len)
 {
-    splay_tree **sptree = &sc.files;
-    stat_cache_entry *sce = stat_cache_sptree_find(sptree, name, len);
-    if (sce && buffer_is_equal_string(&sce->name, name, len)) {
-        sce->stat_ts = 0;
-      #ifdef HAVE_FAM_H
-        if (sce->fam_dir != NULL) {
-            --((fam_dir_entry *)sce->fam_dir)->refcnt;
-            sce->fam_dir = NULL;
-        }
-      #endif
-    }
+    stat_cache_lock();
+    stat_cache_delete_entry_locked(name, len);
+    stat_cache_unlock();
 }
 
-#ifdef HAVE_FAM_H
-
-static void stat_cache_invalidate_dir_tree_walk(splay_tree *t,
-                                                const char *name, size_t len)
+static void stat_cache_invalidate_entry_locked(const char *name, uint32_t len)
 {
-    if (t->left)  stat_cache_invalidate_dir_tree_walk(t->left,  name, len);
-    if (t->right) stat_cache_invalidate_dir_tree_walk(t->right, name, len);
-
-    buffer *b = &((stat_cache_entry *)t->data)->name;
-    size_t blen = buffer_string_length(b);
-    if (blen > len && b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len)) {
-        stat_cache_entry *sce = t->data;
+    stat_cache_slot * const slot =
+      stat_cache_slot_find(name, len, stat_cache_hash(name, len));
+    if (slot) {
+        stat_cache_entry * const sce = stat_cache_entry_has_file(slot->sce)
+          ? stat_cache_entry_file_close(slot)
+          : slot->sce;
         sce->stat_ts = 0;
+      #ifdef STAT_CACHE_MONITOR_DIRS
         if (sce->fam_dir != NULL) {
             --((fam_dir_entry *)sce->fam_dir)->refcnt;
             sce->fam_dir = NULL;
         }
+      #endif
     }
 }
 
-static void stat_cache_invalidate_dir_tree(const char *name, size_t len)
+void stat_cache_invalidate_entry(const char *name, uint32_t len)
 {
-    splay_tree * const sptree = sc.files;
-    if (sptree) stat_cache_invalidate_dir_tree_walk(sptree, name, len);
+    stat_cache_lock();
+    stat_cache_invalidate_entry_locked(name, len);
+    stat_cache_unlock();
 }
 
-#endif
-
-/*
- * walk though splay_tree and collect contents of dir tree.
- * remove tagged entries in a second loop
- */
+#ifdef STAT_CACHE_MONITOR_DIRS
 
-static void stat_cache_tag_dir_tree(splay_tree *t, const char *name, size_t len,
-                                    int *keys, int *ndx)
+static void stat_cache_invalidate_dir_tree(const char *name, size_t len)
 {
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-    if (t->left)  stat_cache_tag_dir_tree(t->left,  name, len, keys, ndx);
-    if (t->right) stat_cache_tag_dir_tree(t->right, name, len, keys, ndx);
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-
-    buffer *b = &((stat_cache_entry *)t->data)->name;
-    size_t blen = buffer_string_length(b);
-    if (blen > len && b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len))
-        keys[(*ndx)++] = t->key;
+    stat_cache_slot * const files = sc.files;
+    if (NULL == files) return;
+    for (uint32_t i = 0; i <= sc.mask; ++i) {
+        stat_cache_entry *sce = files[i].sce;
+        if (NULL == sce) continue;
+        const buffer * const b = &sce->name;
+        const size_t blen = buffer_string_length(b);
+        if (blen > len && b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len)) {
+            if (stat_cache_entry_has_file(sce))
+                sce = stat_cache_entry_file_close(files+i);
+            sce->stat_ts = 0;
+            if (sce->fam_dir != NULL) {
+                --((fam_dir_entry *)sce->fam_dir)->refcnt;
+                sce->fam_dir = NULL;
+            }
+        }
+    }
 }
 
+#endif
+
 __attribute_noinline__
 static void stat_cache_prune_dir_tree(const char *name, size_t len)
 {
-    splay_tree *sptree = sc.files;
-    int max_ndx, i;
-    int keys[8192]; /* 32k size on stack */
-    do {
-        if (!sptree) break;
-        max_ndx = 0;
-        stat_cache_tag_dir_tree(sptree, name, len, keys, &max_ndx);
-        for (i = 0; i < max_ndx; ++i) {
-            const int ndx = keys[i];
-            splay_tree *node = sptree = splaytree_splay(sptree, ndx);
-            if (node && node->key == ndx) {
-                stat_cache_entry_free(node->data);
-                sptree = splaytree_delete(sptree, ndx);
+    stat_cache_slot * const files = sc.files;
+    if (NULL == files) return;
+    for (uint32_t i = 0; i <= sc.mask; ) {
+        stat_cache_entry * const sce = files[i].sce;
+        if (NULL != sce) {
+            const buffer * const b = &sce->name;
+            const size_t blen = buffer_string_length(b);
+            if (blen > len && b->ptr[len] == '/'
+                && 0 == memcmp(b->ptr, name, len)) {
+                stat_cache_entry_free(sce);
+                stat_cache_slot_remove(files+i);
+                continue; /*(next entry, if any, was shifted into slot i)*/
             }
         }
-    } while (max_ndx == sizeof(keys)/sizeof(int));
-    sc.files = sptree;
+        ++i;
+    }
 }
 
 static void stat_cache_delete_tree(const char *name, uint32_t len)
 {
-    stat_cache_delete_entry(name, len);
+    stat_cache_delete_entry_locked(name, len);
     stat_cache_prune_dir_tree(name, len);
 }
 
-void stat_cache_delete_dir(const char *name, uint32_t len)
+static void stat_cache_delete_dir_locked(const char *name, uint32_t len)
 {
     force_assert(0 != len);
     if (name[len-1] == '/') { if (0 == --len) len = 1; }
     stat_cache_delete_tree(name, len);
-  #ifdef HAVE_FAM_H
-    if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM) {
+  #ifdef STAT_CACHE_MONITOR_DIRS
+    if (NULL != sc.scf) { /* STAT_CACHE_ENGINE_FAM or _INOTIFY */
         splay_tree **sptree = &sc.scf->dirs;
         fam_dir_entry *fam_dir = stat_cache_sptree_find(sptree, name, len);
         if (fam_dir && buffer_is_equal_string(fam_dir->name, name, len))
@@ -904,6 +1576,13 @@ void stat_cache_delete_dir(const char *name, uint32_t len)
   #endif
 }
 
+void stat_cache_delete_dir(const char *name, uint32_t len)
+{
+    stat_cache_lock();
+    stat_cache_delete_dir_locked(name, len);
+    stat_cache_unlock();
+}
+
 /***
  *
  *
@@ -913,10 +1592,9 @@ void stat_cache_delete_dir(const char *name, uint32_t len)
  *  - HANDLER_ERROR on stat() failed -> see errno for problem
  */
 
-stat_cache_entry * stat_cache_get_entry(const buffer *name) {
+static stat_cache_entry * stat_cache_get_entry_locked(const buffer *name) {
 	stat_cache_entry *sce = NULL;
 	struct stat st;
-	int file_ndx;
 
 	/* consistency: ensure lookup name does not end in '/' unless root "/"
 	 * (but use full path given with stat(), even with trailing '/') */
@@ -938,49 +1616,76 @@ stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 
 	const time_t cur_ts = log_epoch_secs;
 
-	file_ndx = splaytree_djbhash(name->ptr, len);
-	splay_tree * const sptree = sc.files = splaytree_splay(sc.files, file_ndx);
+	const uint32_t hash = stat_cache_hash(name->ptr, len);
+	stat_cache_slot *slot = stat_cache_slot_find(name->ptr, len, hash);
 
-	if (sptree && (sptree->key == file_ndx)) {
+	if (slot) {
 		/* we have seen this file already and
 		 * don't stat() it again in the same second */
 
-		sce = sptree->data;
-
-		/* check if the name is the same, we might have a collision */
+		sce = slot->sce;
+		if (!slot->ref) slot->ref = 1; /*(CLOCK reference bit)*/
 
-		if (buffer_is_equal_string(&sce->name, name->ptr, len)) {
-			if (sc.stat_cache_engine == STAT_CACHE_ENGINE_SIMPLE) {
-				if (sce->stat_ts == cur_ts) {
-					if (final_slash && !S_ISDIR(sce->st.st_mode)) {
-						errno = ENOTDIR;
-						return NULL;
-					}
-					return sce;
+		if (sc.stat_cache_engine == STAT_CACHE_ENGINE_SIMPLE) {
+			if (sce->stat_ts == cur_ts) {
+				if (final_slash && !S_ISDIR(sce->st.st_mode)) {
+					errno = ENOTDIR;
+					return NULL;
 				}
+				return sce;
 			}
-		      #ifdef HAVE_FAM_H
-			else if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM
-				 && sce->fam_dir) { /* entry is in monitored dir */
-				/* re-stat() periodically, even if monitoring for changes
-				 * (due to limitations in stat_cache.c use of FAM)
-				 * (gaps due to not continually monitoring an entire tree) */
-				if (cur_ts - sce->stat_ts < 16) {
-					if (final_slash && !S_ISDIR(sce->st.st_mode)) {
-						errno = ENOTDIR;
-						return NULL;
-					}
-					return sce;
+		}
+	      #ifdef HAVE_FAM_H
+		else if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM
+			 && sce->fam_dir) { /* entry is in monitored dir */
+			/* re-stat() periodically, even if monitoring for changes
+			 * (due to limitations in stat_cache.c use of FAM)
+			 * (gaps due to not continually monitoring an entire tree) */
+			if (cur_ts - sce->stat_ts < 16) {
+				if (final_slash && !S_ISDIR(sce->st.st_mode)) {
+					errno = ENOTDIR;
+					return NULL;
 				}
+				return sce;
 			}
-		      #endif
-		} else {
-			/* collision, forget about the entry */
-			sce = NULL;
 		}
+	      #endif
+	      #ifdef HAVE_SYS_INOTIFY_H
+		else if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY
+			 && sce->fam_dir) { /* entry is in monitored dir */
+			/* valid until invalidated by inotify event;
+			 * (stat_ts marks last use for periodic cleanup) */
+			sce->stat_ts = cur_ts;
+			if (final_slash && !S_ISDIR(sce->st.st_mode)) {
+				errno = ENOTDIR;
+				return NULL;
+			}
+			return sce;
+		}
+	      #endif
 	}
 
-	if (-1 == stat(name->ptr, &st)) {
+	int rc;
+	if (sc.threads) {
+		/* do not hold lock during stat(); entry might change meanwhile */
+		stat_cache_unlock();
+		rc = stat(name->ptr, &st);
+		const int errnum = errno;
+		stat_cache_lock();
+		slot = stat_cache_slot_find(name->ptr, len, hash);
+		sce = slot ? slot->sce : NULL;
+		errno = errnum;
+	}
+	else
+		rc = stat(name->ptr, &st);
+
+	if (-1 == rc) {
+		if (sce && stat_cache_entry_has_file(sce)) {
+			/*(do not hold open or in memory a removed file)*/
+			const int errnum = errno;
+			stat_cache_entry_file_close(slot);
+			errno = errnum;
+		}
 		return NULL;
 	}
 
@@ -997,17 +1702,23 @@ stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 		sce = stat_cache_entry_init();
 		buffer_copy_string_len(&sce->name, name->ptr, len);
 
-		/* already splayed file_ndx */
-		if (NULL != sptree && sptree->key == file_ndx) {
-			/* hash collision: replace old entry */
-			stat_cache_entry_free(sptree->data);
-			sptree->data = sce;
-		} else {
-			sc.files = splaytree_insert(sptree, file_ndx, sce);
-		}
+		stat_cache_slot_add(sce, hash);
+
+	} else if (sc.threads) {
+
+		/* entry might be in use by other threads; do not modify in place
+		 * (if stat() info unchanged, cached etag and content_type valid) */
+		if (0 != memcmp(&sce->st, &st, sizeof(st)))
+			sce = stat_cache_entry_file_close(slot);
 
 	} else {
 
+		if (stat_cache_entry_has_file(sce)
+		    && stat_cache_entry_file_changed(sce, &st)) {
+			/* file modified or replaced; cached fd or content stale */
+			sce = stat_cache_entry_file_close(slot);
+		}
+
 		buffer_clear(&sce->etag);
 	      #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
 		buffer_clear(&sce->content_type);
@@ -1017,11 +1728,23 @@ stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 
 	sce->st = st; /*(copy prior to calling fam_dir_monitor())*/
 
-#ifdef HAVE_FAM_H
-	if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM) {
+#ifdef STAT_CACHE_MONITOR_DIRS
+	if (NULL != sc.scf) { /* STAT_CACHE_ENGINE_FAM or _INOTIFY */
 		if (sce->fam_dir) --((fam_dir_entry *)sce->fam_dir)->refcnt;
 		sce->fam_dir =
 		  fam_dir_monitor(sc.scf, CONST_BUF_LEN(name), &st);
+	      #ifdef HAVE_SYS_INOTIFY_H
+		/* symlink to file might be outside monitored dir; re-stat() on use
+		 * (FAM engine re-stat()s periodically, which bounds staleness) */
+		if (sc.stat_cache_engine == STAT_CACHE_ENGINE_INOTIFY
+		    && NULL != sce->fam_dir && !S_ISDIR(st.st_mode)) {
+			struct stat lst;
+			if (0 != lstat(name->ptr, &lst) || S_ISLNK(lst.st_mode)) {
+				--((fam_dir_entry *)sce->fam_dir)->refcnt;
+				sce->fam_dir = NULL;
+			}
+		}
+	      #endif
 	      #if 0 /*(performed below)*/
 		if (NULL != sce->fam_dir) {
 			/*(may have been invalidated by dir change)*/
@@ -1035,6 +1758,13 @@ stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 	return sce;
 }
 
+stat_cache_entry * stat_cache_get_entry(const buffer *name) {
+	stat_cache_lock();
+	stat_cache_entry * const sce = stat_cache_get_entry_locked(name);
+	stat_cache_unlock();
+	return sce;
+}
+
 int stat_cache_path_contains_symlink(const buffer *name, log_error_st *errh) {
     /* caller should check for symlinks only if we should block symlinks. */
 
@@ -1094,63 +1824,159 @@ int stat_cache_open_rdonly_fstat (const buffer *name, struct stat *st, int symli
 	return -1;
 }
 
+static int stat_cache_entry_open_locked(stat_cache_entry * const sce, const int symlinks) {
+	/* returns sce->fd if fd is cached in sce (caller must not close() it),
+	 * else an fd which caller must close(), or -1 on error (see errno) */
+	if (sce->fd >= 0) return sce->fd;
+
+	/* cache fd only if open() without following a final symlink, so that
+	 * the fd is valid for any request (regardless of server.follow-symlink) */
+	if (sc.fds < sc.max_fds
+	    && sc.stat_cache_engine != STAT_CACHE_ENGINE_NONE
+	    && S_ISREG(sce->st.st_mode)) {
+		/*(Note: O_NOFOLLOW affects only the final path segment, the target
+		 * file, not any intermediate symlinks along the path)*/
+		const int fd = fdevent_open_cloexec(sce->name.ptr, 0, O_RDONLY, 0);
+		if (fd >= 0) {
+			struct stat st;
+			if (0 == fstat(fd, &st) && st.st_ino == sce->st.st_ino
+			    && st.st_dev == sce->st.st_dev) {
+				++sc.fds;
+				return (sce->fd = fd);
+			}
+			return fd; /*(file replaced since stat(); do not cache fd)*/
+		}
+		if (!symlinks) return -1;
+	}
+
+	return fdevent_open_cloexec(sce->name.ptr, symlinks, O_RDONLY, 0);
+}
+
+int stat_cache_entry_open(stat_cache_entry * const sce, const int symlinks) {
+	stat_cache_lock();
+	const int fd = stat_cache_entry_open_locked(sce, symlinks);
+	stat_cache_unlock();
+	return fd;
+}
+
+static const buffer * stat_cache_entry_content_locked(stat_cache_entry * const sce, const int symlinks) {
+	/* returns contents of (small) file cached in sce, or NULL if not cached
+	 * (buffer is immutable and shared; see chunkqueue_append_mem_ref()) */
+	if (sce->content) return sce->content;
+
+	const off_t sz = sce->st.st_size;
+	if (0 == sz || sz > (off_t)sc.max_content_size
+	    || sc.content_total + (size_t)sz > sc.max_content_total
+	    || sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE
+	    || !S_ISREG(sce->st.st_mode))
+		return NULL;
+
+	/* do not cache contents of file modified within the past couple of
+	 * seconds; filesystem timestamp granularity might be too coarse to
+	 * detect a further in-place rewrite of same size (e.g. still being
+	 * written), and stat info might be up to a second old (simple engine) */
+	const time_t cur_ts = log_epoch_secs;
+	if (cur_ts - sce->st.st_mtime <= 1 || cur_ts - sce->st.st_ctime <= 1)
+		return NULL;
+
+	const int fd = stat_cache_entry_open_locked(sce, symlinks);
+	if (fd < 0) return NULL;
+
+	/*(allocate exact size; mem->size == mem->used, so no space to append)*/
+	buffer * const b = buffer_init();
+	b->ptr = malloc((size_t)sz+1);
+	force_assert(NULL != b->ptr);
+	b->size = b->used = (uint32_t)sz+1;
+	b->ptr[sz] = '\0';
+
+	ssize_t rd;
+	off_t off = 0;
+	do {
+		rd = chunk_file_pread(fd, b->ptr+off, (size_t)(sz-off), off);
+	} while (rd > 0 && (off += rd) < sz);
+
+	/* cache only if contents read match file stat() info in sce */
+	struct stat st;
+	if (off == sz && 0 == fstat(fd, &st)
+	    && st.st_size == sz && stat_cache_st_times_eq(&st, &sce->st)
+	    && st.st_ino == sce->st.st_ino && st.st_dev == sce->st.st_dev) {
+		sce->content = b;
+		sc.content_total += (size_t)sz;
+	}
+	else
+		buffer_free(b);
+
+	if (fd != sce->fd)
+		close(fd);
+	else if (sce->content && 1 == sce->refcnt && !sc.threads) {
+		/*(fd not needed if contents cached; free fd for other files)*/
+		/*(fd might be in use by other threads if threaded)*/
+		close(sce->fd);
+		sce->fd = -1;
+		--sc.fds;
+	}
+
+	return sce->content;
+}
+
+const buffer * stat_cache_entry_content(stat_cache_entry * const sce, const int symlinks) {
+	stat_cache_lock();
+	const buffer * const b = stat_cache_entry_content_locked(sce, symlinks);
+	stat_cache_unlock();
+	return b;
+}
+
 /**
  * remove stat() from cache which haven't been stat()ed for
- * more than 2 seconds
- *
+ * more than max_age seconds
  *
- * walk though the stat-cache, collect the ids which are too old
- * and remove them in a second loop
+ * sweep a slice of the hash table each time called (once per second),
+ * so that the entire cache is swept every 32 seconds without spikes
  */
 
-static void stat_cache_tag_old_entries(splay_tree * const t, int * const keys, int * const ndx, const time_t max_age, const time_t cur_ts) {
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-    if (t->left)
-        stat_cache_tag_old_entries(t->left, keys, ndx, max_age, cur_ts);
-    if (t->right)
-        stat_cache_tag_old_entries(t->right, keys, ndx, max_age, cur_ts);
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-
-    const stat_cache_entry * const sce = t->data;
-    if (cur_ts - sce->stat_ts > max_age)
-        keys[(*ndx)++] = t->key;
-}
-
 static void stat_cache_periodic_cleanup(const time_t max_age, const time_t cur_ts) {
-    splay_tree *sptree = sc.files;
-    int max_ndx, i;
-    int keys[8192]; /* 32k size on stack */
-    do {
-        if (!sptree) break;
-        max_ndx = 0;
-        stat_cache_tag_old_entries(sptree, keys, &max_ndx, max_age, cur_ts);
-        for (i = 0; i < max_ndx; ++i) {
-            int ndx = keys[i];
-            sptree = splaytree_splay(sptree, ndx);
-            if (sptree && sptree->key == ndx) {
-                stat_cache_entry_free(sptree->data);
-                sptree = splaytree_delete(sptree, ndx);
-            }
+    stat_cache_slot * const files = sc.files;
+    if (NULL == files) return;
+    const uint32_t mask = sc.mask;
+    uint32_t i = sc.sweep;
+    for (uint32_t n = ((mask+1) >> 5) + 1; n; --n) {
+        stat_cache_entry * const sce = files[i].sce;
+        if (NULL != sce && cur_ts - sce->stat_ts > max_age) {
+            stat_cache_entry_free(sce);
+            stat_cache_slot_remove(files+i);
+            continue; /*(next entry, if any, was shifted into slot i)*/
         }
-    } while (max_ndx == sizeof(keys)/sizeof(int));
-    sc.files = sptree;
+        i = (i+1) & mask;
+    }
+    sc.sweep = i;
 }
 
 void stat_cache_trigger_cleanup(void) {
 	time_t max_age = 2;
 
-      #ifdef HAVE_FAM_H
-	if (STAT_CACHE_ENGINE_FAM == sc.stat_cache_engine) {
-		if (log_epoch_secs & 0x1F) return;
-		/* once every 32 seconds (0x1F == 31) */
+	stat_cache_lock();
+
+      #ifdef STAT_CACHE_MONITOR_DIRS
+	if (NULL != sc.scf) { /* STAT_CACHE_ENGINE_FAM or _INOTIFY */
 		max_age = 32;
-		fam_dir_periodic_cleanup();
-		/* By doing this before stat_cache_periodic_cleanup(),
-		 * entries used within the next max_age secs will remain
-		 * monitored, instead of effectively flushing and
-		 * rebuilding the FAM monitoring every max_age seconds */
+		if (0 == (log_epoch_secs & 0x1F)) {
+			/* once every 32 seconds (0x1F == 31) */
+			fam_dir_periodic_cleanup();
+			/* Dirs are released only after entries in them have been
+			 * expired by stat_cache_periodic_cleanup() sweep, so
+			 * entries used within the next max_age secs will remain
+			 * monitored, instead of effectively flushing and
+			 * rebuilding the FAM monitoring every max_age seconds */
+		}
 	}
       #endif
 
 	stat_cache_periodic_cleanup(max_age, log_epoch_secs);
+
+      #ifdef HAVE_THREADS
+	if (sc.threads)
+		stat_cache_reclaim();
+      #endif
+
+	stat_cache_unlock();
 }
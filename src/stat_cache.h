@@ -10,10 +10,13 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 
-typedef struct {
+typedef struct stat_cache_entry {
     buffer name;
     time_t stat_ts;
-#ifdef HAVE_FAM_H
+    int fd;     /* cached open fd, or -1 (see stat_cache_entry_open()) */
+    int refcnt; /* 1 while in cache, +1 for each chunk referencing entry */
+    buffer *content; /* cached contents of small file, or NULL */
+#if defined(HAVE_FAM_H) || defined(HAVE_SYS_INOTIFY_H)
     void *fam_dir;
 #endif
     buffer etag;
@@ -35,6 +38,25 @@ void stat_cache_free(void);
 __attribute_cold__
 void stat_cache_xattrname (const char *name);
 
+__attribute_cold__
+void stat_cache_max_entries (uint32_t max);
+
+__attribute_cold__
+void stat_cache_max_fds (uint32_t max);
+
+__attribute_cold__
+void stat_cache_max_content_size (uint32_t max);
+
+__attribute_cold__
+void stat_cache_max_content_total (uint32_t max_kb);
+
+/* number of threads sharing stat_cache (server.threads); 0 or 1 if none */
+__attribute_cold__
+void stat_cache_threads (uint32_t n);
+
+/* thread ndx holds no stat_cache_entry pointers (top of event loop) */
+void stat_cache_thread_quiescent (uint32_t ndx);
+
 const buffer * stat_cache_mimetype_by_ext(const array *mimetypes, const char *name, uint32_t nlen);
 #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
 const buffer * stat_cache_mimetype_by_xattr(const char *name);
@@ -52,6 +74,9 @@ void stat_cache_invalidate_entry(const char *name, uint32_t len);
 stat_cache_entry * stat_cache_get_entry(const buffer *name);
 int stat_cache_path_contains_symlink(const buffer *name, log_error_st *errh);
 int stat_cache_open_rdonly_fstat (const buffer *name, struct stat *st, int symlinks);
+int stat_cache_entry_open(stat_cache_entry *sce, int symlinks);
+const buffer * stat_cache_entry_content(stat_cache_entry *sce, int symlinks);
+void stat_cache_entry_refchg(void *data, int mod);
 
 void stat_cache_trigger_cleanup(void);
 #endif
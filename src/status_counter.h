@@ -17,25 +17,36 @@ void status_counter_set(const char *s, size_t len, int val);
 
 #include "plugin.h"
 
+/* (pointer returned by status_counter_get_counter() remains valid, but must
+ *  be accessed with plugin_stats_lock() held if server.threads is enabled) */
 __attribute_returns_nonnull__
 static inline
 int *status_counter_get_counter(const char *s, size_t len) {
-    return array_get_int_ptr(&plugin_stats, s, len);
+    plugin_stats_lock();
+    int * const i = array_get_int_ptr(&plugin_stats, s, len);
+    plugin_stats_unlock();
+    return i;
 }
 
 static inline
 void status_counter_inc(const char *s, size_t len) {
+    plugin_stats_lock();
     ++(*array_get_int_ptr(&plugin_stats, s, len));
+    plugin_stats_unlock();
 }
 
 static inline
 void status_counter_dec(const char *s, size_t len) {
+    plugin_stats_lock();
     --(*array_get_int_ptr(&plugin_stats, s, len));
+    plugin_stats_unlock();
 }
 
 static inline
 void status_counter_set(const char *s, size_t len, int val) {
+    plugin_stats_lock();
     *array_get_int_ptr(&plugin_stats, s, len) = val;
+    plugin_stats_unlock();
 }
 
 
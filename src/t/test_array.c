@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "array.h"
 #include "buffer.h"
@@ -63,10 +65,114 @@ static void test_array_set_key_value (void) {
     array_free(a);
 }
 
-int main() {
+static void test_array_freeze (void) {
+    char k[32];
+    data_string *ds;
+    array *a = array_init(0);
+
+    for (int i = 0; i < 8; ++i) {
+        const int klen = snprintf(k, sizeof(k), ".ext%d", i);
+        array_set_key_value(a, k, (size_t)klen, CONST_STR_LEN("x"));
+    }
+    array_freeze(a);
+    assert(NULL == a->hidx); /*(small arrays are not indexed)*/
+
+    for (int i = 8; i < 1000; ++i) {
+        const int klen = snprintf(k, sizeof(k), ".ext%d", i);
+        array_set_key_value(a, k, (size_t)klen, k, (size_t)klen);
+    }
+    array_freeze(a);
+    assert(NULL != a->hidx);
+
+    for (int i = 8; i < 1000; ++i) {
+        const int klen = snprintf(k, sizeof(k), ".EXT%d", i);
+        ds = (data_string *)array_get_element_klen(a, k, (size_t)klen);
+        assert(NULL != ds);
+        assert(buffer_eq_icase_slen(&ds->value, k, (size_t)klen));
+        assert((data_unset *)ds == array_get_data_unset(a, k, (size_t)klen));
+    }
+    ds = (data_string *)array_get_element_klen(a, CONST_STR_LEN(".ext1000"));
+    assert(NULL == ds);
+    ds = (data_string *)array_get_element_klen(a, CONST_STR_LEN(".ext"));
+    assert(NULL == ds);
+    ds = (data_string *)array_get_element_klen(a, CONST_STR_LEN(".ext1["));
+    assert(NULL == ds); /*('[' is not 'Z'|0x20)*/
+
+    /* modifying array discards index */
+    array_set_key_value(a, CONST_STR_LEN(".new"), CONST_STR_LEN("y"));
+    assert(NULL == a->hidx);
+    ds = (data_string *)array_get_element_klen(a, CONST_STR_LEN(".NEW"));
+    assert(NULL != ds);
+    array_freeze(a);
+    assert(NULL != a->hidx);
+    ds = (data_string *)array_get_element_klen(a, CONST_STR_LEN(".New"));
+    assert(NULL != ds);
+    assert(buffer_eq_slen(&ds->value, CONST_STR_LEN("y")));
+    ds = (data_string *)array_extract_element_klen(a, CONST_STR_LEN(".new"));
+    assert(NULL != ds);
+    ds->fn->free((data_unset *)ds);
+    assert(NULL == a->hidx);
+    array_freeze(a);
+    ds = (data_string *)array_get_element_klen(a, CONST_STR_LEN(".new"));
+    assert(NULL == ds);
+
+    array_free(a);
+}
+
+/* microbenchmark: t/test_array bench
+ * (lookups of keys in config-style arrays, e.g. mimetype.assign,
+ *  with and without array_freeze()) */
+
+static double bench_now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench_array (const int n) {
+    char (*keys)[32] = malloc(sizeof(*keys) * (size_t)n);
+    size_t *klen = malloc(sizeof(*klen) * (size_t)n);
+    assert(keys && klen);
+    array *a = array_init(0);
+    for (int i = 0; i < n; ++i) {
+        klen[i] = (size_t)snprintf(keys[i], sizeof(keys[i]), ".ext%d", i*7919);
+        array_set_key_value(a, keys[i], klen[i], CONST_STR_LEN("x"));
+    }
+
+    const int iters = 20000000;
+    uintptr_t sum = 0;
+    for (int frozen = 0; frozen <= 1; ++frozen) {
+        if (frozen) array_freeze(a);
+        double t = bench_now();
+        for (int j = 0, i = 0; j < iters; ++j) {
+            sum += (uintptr_t)array_get_element_klen(a, keys[i], klen[i]);
+            if (++i == n) i = 0;
+        }
+        t = bench_now() - t;
+        printf("%6d elts %-8s %6.1f ns/lookup\n",
+               n, frozen ? "frozen" : "bsearch", t * 1e9 / iters);
+    }
+    if (0 == sum) printf("(checksum %lu)\n", (unsigned long)sum);
+
+    array_free(a);
+    free(klen);
+    free(keys);
+}
+
+static void bench (void) {
+    bench_array(10);
+    bench_array(100);
+    bench_array(10000);
+}
+
+int main (int argc, char **argv) {
     test_array_get_int_ptr();
     test_array_insert_value();
     test_array_set_key_value();
+    test_array_freeze();
+
+    if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+        bench();
 
     return 0;
 }
@@ -147,11 +147,32 @@ static void test_buffer_append_path_len(void) {
 	buffer_free(b);
 }
 
+static void test_buffer_heap_nallocs(void) {
+	const uint64_t n = heap_nallocs_get();
+	buffer *b = buffer_init();
+	assert(n + 1 == heap_nallocs_get());
+	buffer_copy_string_len(b, CONST_STR_LEN("abc"));
+	assert(n + 2 == heap_nallocs_get());
+
+	/* reuse of allocated buffer does not allocate */
+	buffer_copy_string_len(b, CONST_STR_LEN("defghi"));
+	buffer_clear(b);
+	buffer_append_string_len(b, CONST_STR_LEN("xyz"));
+	assert(n + 2 == heap_nallocs_get());
+
+	/* growth does */
+	buffer_append_string_len(b, CONST_STR_LEN("0123456789012345678901234567890123456789012345678901234567890123456789"));
+	assert(n + 3 == heap_nallocs_get());
+
+	buffer_free(b);
+}
+
 int main() {
 	test_buffer_path_simplify();
 	test_buffer_to_lower_upper();
 	test_buffer_string_space();
 	test_buffer_append_path_len();
+	test_buffer_heap_nallocs();
 
 	return 0;
 }
@@ -0,0 +1,208 @@
+#include "first.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hpack.h"
+
+struct test_hdrs {
+    buffer *b;
+};
+
+static int test_hpack_collect (void *ctx, const char *k, uint32_t klen, const char *v, uint32_t vlen) {
+    buffer * const b = ((struct test_hdrs *)ctx)->b;
+    buffer_append_string_len(b, k, klen);
+    buffer_append_string_len(b, CONST_STR_LEN(": "));
+    buffer_append_string_len(b, v, vlen);
+    buffer_append_string_len(b, CONST_STR_LEN("\n"));
+    return 0;
+}
+
+static void run_hpack_decode (hpack_table *t, int line, const char *hex, const char *expect, uint32_t table_size) {
+    unsigned char in[256];
+    uint32_t len = 0;
+    for (; hex[0] && hex[1]; hex += 2)
+        in[len++] = (unsigned char)((hex2int(hex[0]) << 4) | hex2int(hex[1]));
+
+    buffer * const kb = buffer_init();
+    buffer * const vb = buffer_init();
+    struct test_hdrs th = { buffer_init() };
+    int rc = hpack_decode(t, in, len, test_hpack_collect, &th, kb, vb);
+    if (0 != rc || !buffer_is_equal_string(th.b, expect, strlen(expect))
+        || t->size != table_size) {
+        fprintf(stderr,
+                "%s.%d: %s() failed: rc %d, table size %u, got\n%s\nexpected\n%s\n",
+                __FILE__, line, __func__+4, rc, t->size, th.b->ptr
+                ? th.b->ptr : "", expect);
+        fflush(stderr);
+        abort();
+    }
+    buffer_free(th.b);
+    buffer_free(kb);
+    buffer_free(vb);
+}
+
+static void test_hpack_decode (void) {
+    hpack_table t;
+
+    /* RFC 7541 C.3 Request Examples without Huffman Coding */
+    hpack_table_init(&t, HPACK_TABLE_SIZE_DEFAULT);
+    run_hpack_decode(&t, __LINE__,
+      "828684410f7777772e6578616d706c652e636f6d",
+      ":method: GET\n:scheme: http\n:path: /\n"
+      ":authority: www.example.com\n", 57);
+    run_hpack_decode(&t, __LINE__,
+      "828684be58086e6f2d6361636865",
+      ":method: GET\n:scheme: http\n:path: /\n"
+      ":authority: www.example.com\ncache-control: no-cache\n", 110);
+    run_hpack_decode(&t, __LINE__,
+      "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565",
+      ":method: GET\n:scheme: https\n:path: /index.html\n"
+      ":authority: www.example.com\ncustom-key: custom-value\n", 164);
+    hpack_table_free(&t);
+
+    /* RFC 7541 C.4 Request Examples with Huffman Coding */
+    hpack_table_init(&t, HPACK_TABLE_SIZE_DEFAULT);
+    run_hpack_decode(&t, __LINE__,
+      "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+      ":method: GET\n:scheme: http\n:path: /\n"
+      ":authority: www.example.com\n", 57);
+    run_hpack_decode(&t, __LINE__,
+      "828684be5886a8eb10649cbf",
+      ":method: GET\n:scheme: http\n:path: /\n"
+      ":authority: www.example.com\ncache-control: no-cache\n", 110);
+    run_hpack_decode(&t, __LINE__,
+      "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+      ":method: GET\n:scheme: https\n:path: /index.html\n"
+      ":authority: www.example.com\ncustom-key: custom-value\n", 164);
+    hpack_table_free(&t);
+
+    /* RFC 7541 C.6 Response Examples with Huffman Coding
+     * (table size 256; entries are evicted) */
+    hpack_table_init(&t, 256);
+    run_hpack_decode(&t, __LINE__,
+      "488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff"
+      "6e919d29ad171863c78f0b97c8e9ae82ae43d3",
+      ":status: 302\ncache-control: private\n"
+      "date: Mon, 21 Oct 2013 20:13:21 GMT\n"
+      "location: https://www.example.com\n", 222);
+    run_hpack_decode(&t, __LINE__,
+      "4883640effc1c0bf",
+      ":status: 307\ncache-control: private\n"
+      "date: Mon, 21 Oct 2013 20:13:21 GMT\n"
+      "location: https://www.example.com\n", 222);
+    hpack_table_free(&t);
+}
+
+static void test_hpack_decode_errors (void) {
+    static const struct {
+        uint32_t len;
+        const char *s;
+    } bad[] = {
+      { 1, "\x80" }                     /* index 0 */
+     ,{ 1, "\xbe" }                     /* index 62; dynamic table empty */
+     ,{ 2, "\x41\x85" }                 /* string length exceeds input */
+     ,{ 3, "\x41\x81\x00" }             /* Huffman padding not EOS prefix */
+     ,{ 7, "\x41\x85\xff\xff\xff\xff\xff" } /* Huffman EOS; padding > 7 bits */
+     ,{ 3, "\x82\x3f\xe1" }             /* size update after header field */
+     ,{ 3, "\x3f\xe2\x1f" }             /* size update > SETTINGS limit */
+     ,{ 6, "\x7f\xff\xff\xff\xff\x7f" } /* integer overflow */
+    };
+    buffer * const kb = buffer_init();
+    buffer * const vb = buffer_init();
+    struct test_hdrs th = { buffer_init() };
+    for (uint32_t i = 0; i < sizeof(bad)/sizeof(*bad); ++i) {
+        hpack_table t;
+        hpack_table_init(&t, HPACK_TABLE_SIZE_DEFAULT);
+        int rc = hpack_decode(&t, (const unsigned char *)bad[i].s, bad[i].len,
+                              test_hpack_collect, &th, kb, vb);
+        assert(-1 == rc);
+        hpack_table_free(&t);
+    }
+    buffer_free(th.b);
+    buffer_free(kb);
+    buffer_free(vb);
+}
+
+static void test_hpack_roundtrip (void) {
+    /* headers are encoded in two header blocks, the second of which is
+     * expected to be smaller as headers are found in dynamic table */
+    static const char * const hdrs[][2] = {
+      { "content-type", "text/html; charset=utf-8" }
+     ,{ "date", "Mon, 21 Oct 2013 20:13:21 GMT" }
+     ,{ "server", "lighttpd/1.4" }
+     ,{ "x-binary", "\x01\x7f\x80\xff\t~" }
+     ,{ "set-cookie", "a=b; Secure" }
+     ,{ "cache-control", "max-age=3600" }
+    };
+    hpack_table enc, dec;
+    hpack_table_init(&enc, HPACK_TABLE_SIZE_DEFAULT);
+    hpack_table_init(&dec, HPACK_TABLE_SIZE_DEFAULT);
+    buffer * const b = buffer_init();
+    buffer * const kb = buffer_init();
+    buffer * const vb = buffer_init();
+    buffer * const expect = buffer_init();
+    struct test_hdrs th = { buffer_init() };
+    uint32_t blen[2];
+
+    for (int n = 0; n < 2; ++n) {
+        buffer_clear(b);
+        buffer_clear(expect);
+        buffer_clear(th.b);
+        if (n == 1) hpack_table_set_max_size(&enc, 1024);
+        hpack_encode_begin(&enc, b);
+        hpack_encode_status(&enc, b, n ? 200 : 302);
+        buffer_append_string_len(expect, n ? ":status: 200\n" : ":status: 302\n",
+                                 sizeof(":status: 200\n")-1);
+        for (uint32_t i = 0; i < sizeof(hdrs)/sizeof(*hdrs); ++i) {
+            hpack_encode_header(&enc, b, hdrs[i][0], strlen(hdrs[i][0]),
+                                hdrs[i][1], strlen(hdrs[i][1]));
+            test_hpack_collect(&(struct test_hdrs){ expect },
+                               hdrs[i][0], strlen(hdrs[i][0]),
+                               hdrs[i][1], strlen(hdrs[i][1]));
+        }
+        blen[n] = buffer_string_length(b);
+        int rc = hpack_decode(&dec, (unsigned char *)b->ptr, blen[n],
+                              test_hpack_collect, &th, kb, vb);
+        assert(0 == rc);
+        assert(buffer_is_equal(th.b, expect));
+        assert(enc.size == dec.size);
+    }
+    assert(blen[1] < blen[0]);
+    assert(dec.max_size == 1024);
+
+    /* Huffman coding of all octet values */
+    for (int c = 0; c < 256; ++c) {
+        char s[4] = { (char)c, 'a', (char)c, (char)(255-c) };
+        buffer_clear(b);
+        buffer_clear(th.b);
+        buffer_clear(expect);
+        hpack_encode_header(&enc, b, CONST_STR_LEN("x-octets"), s, sizeof(s));
+        test_hpack_collect(&(struct test_hdrs){ expect },
+                           CONST_STR_LEN("x-octets"), s, sizeof(s));
+        int rc = hpack_decode(&dec, (unsigned char *)b->ptr,
+                              buffer_string_length(b),
+                              test_hpack_collect, &th, kb, vb);
+        assert(0 == rc);
+        assert(buffer_is_equal(th.b, expect));
+    }
+
+    hpack_table_free(&enc);
+    hpack_table_free(&dec);
+    buffer_free(th.b);
+    buffer_free(expect);
+    buffer_free(b);
+    buffer_free(kb);
+    buffer_free(vb);
+}
+
+int main (void) {
+    test_hpack_decode();
+    test_hpack_decode_errors();
+    test_hpack_roundtrip();
+
+    return 0;
+}
+
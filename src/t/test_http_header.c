@@ -0,0 +1,268 @@
+#include "first.h"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "http_header.c"
+
+/* request header names captured from common clients, in order sent */
+static const char * const captured[] = {
+  /* Chrome (desktop) */
+  "Host", "Connection", "sec-ch-ua", "sec-ch-ua-mobile", "sec-ch-ua-platform",
+  "Upgrade-Insecure-Requests", "User-Agent", "Accept", "Sec-Fetch-Site",
+  "Sec-Fetch-Mode", "Sec-Fetch-User", "Sec-Fetch-Dest", "Referer",
+  "Accept-Encoding", "Accept-Language", "Cookie", "If-None-Match",
+  "If-Modified-Since",
+  /* Firefox */
+  "Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+  "DNT", "Connection", "Referer", "Cookie", "Upgrade-Insecure-Requests",
+  "Sec-Fetch-Dest", "Sec-Fetch-Mode", "Sec-Fetch-Site", "Pragma",
+  "Cache-Control", "TE",
+  /* Safari */
+  "Host", "Accept", "Accept-Language", "Connection", "Accept-Encoding",
+  "User-Agent", "Referer", "Cookie",
+  /* XHR/fetch() via reverse proxy */
+  "Host", "X-Real-IP", "X-Forwarded-For", "X-Forwarded-Proto", "Content-Length",
+  "Content-Type", "Origin", "Accept", "X-Requested-With", "Authorization",
+  "X-CSRF-Token", "Sec-Fetch-Site", "Sec-Fetch-Mode", "Sec-Fetch-Dest",
+  "Referer", "Accept-Encoding", "Accept-Language", "Cookie",
+  /* curl */
+  "Host", "User-Agent", "Accept",
+  /* HTTP/2 (lowercase) */
+  "user-agent", "accept", "accept-encoding", "accept-language", "cookie",
+  "sec-fetch-site", "sec-fetch-mode", "sec-fetch-dest", "referer",
+  "if-none-match", "priority"
+};
+
+/* http_header_hkey_get() prior to perfect hash (and extended enum) */
+static const struct { int key; uint32_t vlen; const char value[24]; }
+http_headers_linear[] = {
+  { HTTP_HEADER_HOST,                 CONST_LEN_STR("Host") }
+ ,{ HTTP_HEADER_DATE,                 CONST_LEN_STR("Date") }
+ ,{ HTTP_HEADER_ETAG,                 CONST_LEN_STR("ETag") }
+ ,{ HTTP_HEADER_VARY,                 CONST_LEN_STR("Vary") }
+ ,{ HTTP_HEADER_RANGE,                CONST_LEN_STR("Range") }
+ ,{ HTTP_HEADER_COOKIE,               CONST_LEN_STR("Cookie") }
+ ,{ HTTP_HEADER_EXPECT,               CONST_LEN_STR("Expect") }
+ ,{ HTTP_HEADER_STATUS,               CONST_LEN_STR("Status") }
+ ,{ HTTP_HEADER_SERVER,               CONST_LEN_STR("Server") }
+ ,{ HTTP_HEADER_UPGRADE,              CONST_LEN_STR("Upgrade") }
+ ,{ HTTP_HEADER_LOCATION,             CONST_LEN_STR("Location") }
+ ,{ HTTP_HEADER_FORWARDED,            CONST_LEN_STR("Forwarded") }
+ ,{ HTTP_HEADER_CONNECTION,           CONST_LEN_STR("Connection") }
+ ,{ HTTP_HEADER_SET_COOKIE,           CONST_LEN_STR("Set-Cookie") }
+ ,{ HTTP_HEADER_USER_AGENT,           CONST_LEN_STR("User-Agent") }
+ ,{ HTTP_HEADER_CONTENT_TYPE,         CONST_LEN_STR("Content-Type") }
+ ,{ HTTP_HEADER_LAST_MODIFIED,        CONST_LEN_STR("Last-Modified") }
+ ,{ HTTP_HEADER_AUTHORIZATION,        CONST_LEN_STR("Authorization") }
+ ,{ HTTP_HEADER_IF_NONE_MATCH,        CONST_LEN_STR("If-None-Match") }
+ ,{ HTTP_HEADER_CACHE_CONTROL,        CONST_LEN_STR("Cache-Control") }
+ ,{ HTTP_HEADER_CONTENT_LENGTH,       CONST_LEN_STR("Content-Length") }
+ ,{ HTTP_HEADER_ACCEPT_ENCODING,      CONST_LEN_STR("Accept-Encoding") }
+ ,{ HTTP_HEADER_X_FORWARDED_FOR,      CONST_LEN_STR("X-Forwarded-For") }
+ ,{ HTTP_HEADER_CONTENT_ENCODING,     CONST_LEN_STR("Content-Encoding") }
+ ,{ HTTP_HEADER_CONTENT_LOCATION,     CONST_LEN_STR("Content-Location") }
+ ,{ HTTP_HEADER_IF_MODIFIED_SINCE,    CONST_LEN_STR("If-Modified-Since") }
+ ,{ HTTP_HEADER_TRANSFER_ENCODING,    CONST_LEN_STR("Transfer-Encoding") }
+ ,{ HTTP_HEADER_X_FORWARDED_PROTO,    CONST_LEN_STR("X-Forwarded-Proto") }
+ ,{ HTTP_HEADER_OTHER, 0, "" }
+};
+static const int8_t http_headers_linear_off[] = {
+  -1, -1, -1, -1, 0, 4, 5, 9, 10, 11, 12, -1, 15, 16, 20, 21, 23, 25
+};
+
+static enum http_header_e http_header_hkey_get_linear(const char * const s, const uint32_t slen) {
+    int i = slen < sizeof(http_headers_linear_off)
+      ? http_headers_linear_off[slen]
+      : -1;
+    if (i < 0) return HTTP_HEADER_OTHER;
+    do {
+        if (buffer_eq_icase_ssn(s, http_headers_linear[i].value, slen))
+            return (enum http_header_e)http_headers_linear[i].key;
+    } while (slen == http_headers_linear[++i].vlen);
+    return HTTP_HEADER_OTHER;
+}
+
+static enum http_header_e http_header_hkey_get_brute(const char * const s, const uint32_t slen) {
+    for (uint32_t i = 1; i < sizeof(http_headers)/sizeof(*http_headers); ++i) {
+        if (http_headers[i].vlen == slen
+            && buffer_eq_icase_ssn(s, http_headers[i].value, slen))
+            return (enum http_header_e)http_headers[i].key;
+    }
+    return HTTP_HEADER_OTHER;
+}
+
+static void gen (void);
+
+static void test_http_header_tables (void) {
+    const uint32_t n = sizeof(http_headers)/sizeof(*http_headers);
+    int8_t tab[sizeof(http_headers_phash)];
+    int collision = 0;
+    memset(tab, 0, sizeof(tab));
+    assert(n - 1 <= 63); /*(bit positions in uint64_t rqst_htags, resp_htags)*/
+    for (uint32_t i = 0; i < n; ++i) {
+        if (http_headers[i].key != (int)i) {
+            fprintf(stderr, "http_headers[%u] \"%s\" out of order; "
+                    "http_headers[] in http_header.c must be sorted by "
+                    "enum http_header_e in http_header.h\n",
+                    i, http_headers[i].value);
+            exit(1);
+        }
+        assert(http_headers[i].vlen == strlen(http_headers[i].value));
+        assert(http_headers[i].vlen < sizeof(http_headers[i].value));
+        for (uint32_t j = 0; j < http_headers[i].vlen; ++j)
+            assert(http_headers[i].value[j] == '-'
+                   || (http_headers[i].value[j] >= 'a'
+                       && http_headers[i].value[j] <= 'z'));
+        if (0 == i) continue;
+        const uint32_t h =
+          http_header_phash(http_headers[i].value, http_headers[i].vlen);
+        if (tab[h]) collision = 1;
+        tab[h] = (int8_t)i;
+    }
+    /* http_headers_phash[] is generated; detect when it is stale */
+    if (collision || 0 != memcmp(tab, http_headers_phash, sizeof(tab))) {
+        fprintf(stderr,
+                "http_headers_phash[] in http_header.c does not match "
+                "http_headers[]; regenerate: run 't/test_http_header gen' and "
+                "replace HTTP_HEADERS_PHASH_MULT and http_headers_phash[] "
+                "in http_header.c with the output:\n");
+        gen();
+        exit(1);
+    }
+}
+
+static void test_http_header_hkey_get (void) {
+    const uint32_t n = sizeof(http_headers)/sizeof(*http_headers);
+    char k[32];
+
+    for (uint32_t i = 1; i < n; ++i) {
+        const uint32_t klen = http_headers[i].vlen;
+        memcpy(k, http_headers[i].value, klen);
+        assert(http_header_hkey_get(k, klen) == (int)i);
+        for (uint32_t j = 0; j < klen; ++j) { /* mixed case */
+            if (k[j] != '-' && (rand() & 1)) k[j] &= ~0x20;
+        }
+        assert(http_header_hkey_get(k, klen) == (int)i);
+        for (uint32_t j = 0; j < klen; ++j) {
+            const char c = k[j];
+            /* must not match (naive (c | 0x20) would conflate '\r', '-') */
+            k[j] = (c == '-') ? '\r' : (char)(c ^ 0x80);
+            assert(http_header_hkey_get(k, klen) == HTTP_HEADER_OTHER);
+            k[j] = (c == '-') ? (char)0xad : (char)((c & 0x1f) | 0xc0);
+            assert(http_header_hkey_get(k, klen) == HTTP_HEADER_OTHER);
+            k[j] = c;
+        }
+        assert(http_header_hkey_get(k, klen-1) != (int)i);
+    }
+
+    assert(http_header_hkey_get("", 0) == HTTP_HEADER_OTHER);
+    assert(http_header_hkey_get("a", 1) == HTTP_HEADER_OTHER);
+    assert(http_header_hkey_get(CONST_STR_LEN("TE")) == HTTP_HEADER_OTHER);
+    assert(http_header_hkey_get(CONST_STR_LEN("Hosts")) == HTTP_HEADER_OTHER);
+    assert(http_header_hkey_get(CONST_STR_LEN("X-Forwarded-Host"))
+           == HTTP_HEADER_OTHER);
+
+    for (uint32_t i = 0; i < sizeof(captured)/sizeof(*captured); ++i) {
+        const uint32_t klen = (uint32_t)strlen(captured[i]);
+        assert(http_header_hkey_get(captured[i], klen)
+               == http_header_hkey_get_brute(captured[i], klen));
+    }
+
+    for (int i = 0; i < 100000; ++i) { /* random strings over [A-Za-z-] */
+        const uint32_t klen = 2 + (uint32_t)(rand() % 24);
+        for (uint32_t j = 0; j < klen; ++j)
+            k[j] = "eEcCsS-aAtTnNoO"[rand() % 15];
+        assert(http_header_hkey_get(k, klen)
+               == http_header_hkey_get_brute(k, klen));
+    }
+}
+
+/* t/test_http_header gen
+ * search for multiplier and print http_headers_phash[] for http_header.c
+ * (run after adding names to http_headers[]; a different number of bits
+ *  requires changing HTTP_HEADERS_PHASH_BITS in http_header.c) */
+static void gen (void) {
+    const uint32_t n = sizeof(http_headers)/sizeof(*http_headers);
+    int8_t tab[1u << HTTP_HEADERS_PHASH_BITS];
+    for (uint32_t m = 1; m < (1u << 24); m += 2) {
+        const uint32_t mult = (m * 0x9E3779B1u) | 1;
+        uint32_t i;
+        memset(tab, 0, sizeof(tab));
+        for (i = 1; i < n; ++i) {
+            const unsigned char * const u =
+              (const unsigned char *)http_headers[i].value;
+            const uint32_t slen = http_headers[i].vlen;
+            const uint32_t x = ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16)
+                             | ((uint32_t)u[slen-2] << 8) | u[slen-1];
+            const uint32_t h = ((x ^ (slen << 5)) * mult)
+                               >> (32 - HTTP_HEADERS_PHASH_BITS);
+            if (tab[h]) break;
+            tab[h] = (int8_t)i;
+        }
+        if (i != n) continue;
+        printf("#define HTTP_HEADERS_PHASH_MULT 0x%08xu\n", mult);
+        for (i = 0; i < sizeof(tab); ++i)
+            printf("%s%2d%s", (i & 15) ? " " : "  ", tab[i],
+                   i+1 == sizeof(tab) ? "\n" : (i & 15) == 15 ? ",\n" : ",");
+        return;
+    }
+    printf("no perfect hash found; increase HTTP_HEADERS_PHASH_BITS\n");
+}
+
+/* t/test_http_header bench
+ * lookup of captured request header names */
+
+static double bench_now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench (void) {
+    const uint32_t n = sizeof(captured)/sizeof(*captured);
+    uint32_t lens[sizeof(captured)/sizeof(*captured)];
+    const int iters = 200000;
+    uint32_t known = 0, sum = 0;
+    double t;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        lens[i] = (uint32_t)strlen(captured[i]);
+        known += (http_header_hkey_get_linear(captured[i], lens[i])
+                  != HTTP_HEADER_OTHER);
+    }
+    t = bench_now();
+    for (int it = 0; it < iters; ++it)
+        for (uint32_t i = 0; i < n; ++i)
+            sum += http_header_hkey_get_linear(captured[i], lens[i]);
+    t = bench_now() - t;
+    printf("%-8s %6.2f ns/lookup (%u/%u names known)\n", "linear",
+           t * 1e9 / ((double)iters * n), known, n);
+
+    known = 0;
+    for (uint32_t i = 0; i < n; ++i)
+        known += (http_header_hkey_get(captured[i], lens[i])
+                  != HTTP_HEADER_OTHER);
+    t = bench_now();
+    for (int it = 0; it < iters; ++it)
+        for (uint32_t i = 0; i < n; ++i)
+            sum += http_header_hkey_get(captured[i], lens[i]);
+    t = bench_now() - t;
+    printf("%-8s %6.2f ns/lookup (%u/%u names known)\n", "phash",
+           t * 1e9 / ((double)iters * n), known, n);
+    printf("(checksum %u)\n", sum);
+}
+
+int main (int argc, char **argv) {
+    test_http_header_tables();
+    test_http_header_hkey_get();
+    if (argc > 1 && 0 == strcmp(argv[1], "gen"))
+        gen();
+    if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+        bench();
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "first.h"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "http_scan.h"
+
+/* representative request headers sent by a current desktop browser */
+static const char browser_req[] =
+  "GET /static/js/app.3f9c1b2e.js?v=20201017 HTTP/1.1\r\n"
+  "Host: www.example.com\r\n"
+  "Connection: keep-alive\r\n"
+  "sec-ch-ua: \"Chromium\";v=\"86\", \"\\\"Not\\\\A;Brand\";v=\"99\", \"Google Chrome\";v=\"86\"\r\n"
+  "sec-ch-ua-mobile: ?0\r\n"
+  "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/86.0.4240.75 Safari/537.36\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.9\r\n"
+  "Sec-Fetch-Site: same-origin\r\n"
+  "Sec-Fetch-Mode: no-cors\r\n"
+  "Sec-Fetch-Dest: script\r\n"
+  "Referer: https://www.example.com/products/category/item-123456.html\r\n"
+  "Accept-Encoding: gzip, deflate, br\r\n"
+  "Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+  "Cookie: _ga=GA1.2.1234567890.1602939283; _gid=GA1.2.987654321.1602939283; session=8f14e45fceea167a5a36dedd4bea2543; prefs=lang%3Den%26cur%3DUSD\r\n"
+  "If-None-Match: \"5f8a1c2b-1d4e7\"\r\n"
+  "If-Modified-Since: Fri, 16 Oct 2020 21:14:35 GMT\r\n"
+  "\r\n";
+
+/* historical connection_read_header_hoff() */
+static uint32_t ref_header_lines (const char *n, const uint32_t clen, unsigned short hoff[8192]) {
+    uint32_t hlen = 0;
+    for (const char *b; (n = memchr((b = n),'\n',clen-hlen)); ++n) {
+        uint32_t x = (uint32_t)(n - b + 1);
+        hlen += x;
+        if (x <= 2 && (x == 1 || n[-1] == '\r')) {
+            hoff[hoff[0]+1] = hlen;
+            return hlen;
+        }
+        if (++hoff[0] >= /*sizeof(hoff)/sizeof(hoff[0])-1*/ 8192-1) break;
+        hoff[hoff[0]] = hlen;
+    }
+    return 0;
+}
+
+static uint32_t ref_token_alpha (const char *s, uint32_t len) {
+    uint32_t i = 0;
+    while (i < len && ((s[i] >= 'a' && s[i] <= 'z')
+                       || (s[i] >= 'A' && s[i] <= 'Z') || s[i] == '-')) ++i;
+    return i;
+}
+
+static uint32_t ref_field_value_ctl (const char *s, uint32_t len) {
+    uint32_t i = 0;
+    while (i < len && !((((unsigned char *)s)[i] < 32 && s[i] != '\t')
+                        || s[i] == 127)) ++i;
+    return i;
+}
+
+static void check_header_lines (const char *s, uint32_t len) {
+    static unsigned short h1[8192], h2[8192];
+    h1[0] = h2[0] = 1;
+    const uint32_t x1 = ref_header_lines(s, len, h1);
+    const uint32_t x2 = http_scan_header_lines(s, len, h2);
+    assert(x1 == x2);
+    assert(h1[0] == h2[0]);
+    assert(0 == memcmp(h1+2, h2+2, (h1[0]-1) * sizeof(unsigned short)));
+    if (x1) assert(h1[h1[0]+1] == h2[h2[0]+1]);
+}
+
+static void check_buf (char *s, uint32_t len) {
+    for (uint32_t i = 0; i <= len; ++i) {
+        /* exact-size copy so that reads past end are detected by ASAN */
+        char * const b = malloc(len - i ? len - i : 1);
+        assert(b);
+        memcpy(b, s + i, len - i);
+        assert(ref_token_alpha(b, len - i)
+               == http_scan_token_alpha(b, len - i));
+        assert(ref_field_value_ctl(b, len - i)
+               == http_scan_field_value_ctl(b, len - i));
+        check_header_lines(b, len - i);
+        free(b);
+    }
+}
+
+static void test_http_scan_level (int level) {
+    static const char bytes[] =
+      "aZ-:\r\n\t \x01\x1f\x7f\x80\xff" "0_[`{@";
+    char buf[200];
+    const uint32_t len = (uint32_t)sizeof(browser_req)-1;
+
+    if (http_scan_select(level) != level) return; /* unsupported on cpu */
+
+    check_buf((char *)(uintptr_t)browser_req, len);
+
+    for (int n = 0; n < 2000; ++n) {
+        /* mostly [A-Za-z-] and printable, with occasional special chars */
+        const uint32_t blen = (uint32_t)(rand() % sizeof(buf));
+        for (uint32_t i = 0; i < blen; ++i)
+            buf[i] = (rand() & 7)
+              ? "abcXYZ-"[rand() % 7]
+              : bytes[rand() % (sizeof(bytes)-1)];
+        check_buf(buf, blen);
+    }
+}
+
+static void test_http_scan (void) {
+    for (int level = 0; level <= 2; ++level)
+        test_http_scan_level(level);
+    http_scan_select(-1);
+}
+
+/* microbenchmark: t/test_http_scan bench
+ * (compares kernels on browser_req; mirrors per-line work done in
+ *  connection_handle_read_state() and http_request_parse_headers()) */
+
+static double bench_now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t bench_parse (const char * const s, const uint32_t len, unsigned short hoff[8192], const int ref) {
+    uint32_t sum = 0;
+    hoff[0] = 1;
+    const uint32_t hlen = ref
+      ? ref_header_lines(s, len, hoff)
+      : http_scan_header_lines(s, len, hoff);
+    if (0 == hlen) return 0;
+    for (int i = 2; i < hoff[0]; ++i) {
+        const char *k = s + hoff[i];
+        const uint32_t llen = hoff[i+1] - hoff[i] - 2;
+        uint32_t ka;
+        const char *colon;
+        if (ref) {
+            colon = memchr(k, ':', llen);
+            ka = ref_token_alpha(k, (uint32_t)(colon - k));
+        }
+        else {
+            ka = http_scan_token_alpha(k, llen);
+            colon = k + ka;
+        }
+        const char *v = colon + 2;
+        const uint32_t vlen = (uint32_t)(s + hoff[i+1] - 2 - v);
+        sum += ka + (ref
+                     ? ref_field_value_ctl(v, vlen)
+                     : http_scan_field_value_ctl(v, vlen));
+    }
+    return sum;
+}
+
+static void bench (void) {
+    static unsigned short hoff[8192];
+    static const char * const names[] = { "scalar", "sse2", "avx2" };
+    const uint32_t len = (uint32_t)sizeof(browser_req)-1;
+    const int iters = 1000000;
+    uint32_t sum = 0;
+    double t;
+
+    /* hoff offsets are relative to the request line */
+    t = bench_now();
+    for (int n = 0; n < iters; ++n)
+        sum += bench_parse(browser_req, len, hoff, 1);
+    t = bench_now() - t;
+    printf("%-12s %7.1f ns/req %6.2f GB/s\n", "baseline",
+           t * 1e9 / iters, (double)len * iters / t / 1e9);
+
+    for (int level = 0; level <= 2; ++level) {
+        if (http_scan_select(level) != level) continue;
+        t = bench_now();
+        for (int n = 0; n < iters; ++n)
+            sum += bench_parse(browser_req, len, hoff, 0);
+        t = bench_now() - t;
+        printf("%-12s %7.1f ns/req %6.2f GB/s\n", names[level],
+               t * 1e9 / iters, (double)len * iters / t / 1e9);
+    }
+    http_scan_select(-1);
+    printf("(%u bytes; checksum %u)\n", len, sum);
+}
+
+int main (int argc, char **argv) {
+    test_http_scan();
+    if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+        bench();
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h> /* STDERR_FILENO */
 
 #include "keyvalue.c"
@@ -11,7 +13,7 @@
 #include "base.h"   /* struct server */
 #include "plugin_config.h" /* struct cond_match_t */
 
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE
 static pcre_keyvalue_buffer * test_keyvalue_test_kvb_init (void) {
     pcre_keyvalue_buffer *kvb = pcre_keyvalue_buffer_init();
 
@@ -117,11 +119,193 @@ static void test_keyvalue_pcre_keyvalue_buffer_process (void) {
     buffer_free(query);
     pcre_keyvalue_buffer_free(kvb);
 }
+
+static void test_keyvalue_pcre_keyvalue_prefix (void) {
+    static const struct {
+        const char *pattern;
+        const char *prefix;
+    } tests[] = {
+      { "^/foo($|\\?.+)",           "/foo" }
+     ,{ "^/redirect(?:\\?(.*))?$",  "/redirect" }
+     ,{ "^(/[^?]*)(?:\\?(.*))?$",   "" }
+     ,{ "/foo/(.*)",                "" }   /* not anchored */
+     ,{ "^/a\\.b\\/c\\d",           "/a.b/c" }
+     ,{ "^/abc?d",                  "/ab" } /* optional char */
+     ,{ "^/abc*d",                  "/ab" }
+     ,{ "^/abc{0,2}d",              "/ab" }
+     ,{ "^/abc+d",                  "/abc" }
+     ,{ "^/a\\.?b",                 "/a" }
+     ,{ "^/foo|^/bar",              "" }   /* top-level alternation */
+     ,{ "^/foo/(a|b)",              "/foo/" }
+     ,{ "^/foo[|]",                 "/foo" }
+     ,{ "^/foo\\|bar",              "/foo|bar" }
+     ,{ "^/foo\\Q|\\E",              "/foo" }
+     ,{ "^/foo(?#|)x",              "/foo" }
+     ,{ "^/foo[[:alpha:]|]",        "" }   /* (conservative) */
+     ,{ "^/foo(?x)bar # )|",        "" }
+     ,{ "^/foo(?i)bar",             "/foo" }
+    };
+
+    for (size_t i = 0; i < sizeof(tests)/sizeof(tests[0]); ++i) {
+        char pfx[PCRE_KEYVALUE_PREFIX_MAX];
+        const buffer key = { (char *)tests[i].pattern,
+                             (uint32_t)strlen(tests[i].pattern)+1, 0 };
+        const uint32_t n = pcre_keyvalue_prefix(&key, pfx);
+        assert(n == strlen(tests[i].prefix));
+        assert(0 == memcmp(pfx, tests[i].prefix, n));
+    }
+}
+
+/* historical sequential match of each rule; return index of matching rule */
+static int test_keyvalue_ref_match (const pcre_keyvalue_buffer *kvb, const buffer *input) {
+    for (int i = 0; i < (int)kvb->used; ++i) {
+        const pcre_keyvalue * const kv = kvb->kv+i;
+      #if defined(HAVE_PCRE2_H)
+        if (pcre2_match(kv->code, (PCRE2_SPTR)input->ptr,
+                        buffer_string_length(input), 0, 0,
+                        config_pcre2_match_data(), NULL) >= 0)
+            return i;
+      #else
+        int ovec[60];
+        if (pcre_exec(kv->key, kv->key_extra, CONST_BUF_LEN(input),
+                      0, 0, ovec, sizeof(ovec)/sizeof(int)) >= 0)
+            return i;
+      #endif
+    }
+    return -1;
+}
+
+static void test_keyvalue_pcre_keyvalue_prefilter (void) {
+    /* rules (in random order) must select same first match as sequential */
+    static const buffer kvstr[] = {
+      { "^/a/b/",         sizeof("^/a/b/"), 0 },
+      { "^/a/",           sizeof("^/a/"), 0 },
+      { "^/a/b/c$",       sizeof("^/a/b/c$"), 0 },
+      { "^/ab?c",         sizeof("^/ab?c"), 0 },
+      { "^/b|/c",         sizeof("^/b|/c"), 0 },
+      { "c$",             sizeof("c$"), 0 },
+      { "^/a\\?x=",       sizeof("^/a\\?x="), 0 },
+      { "^/b/",           sizeof("^/b/"), 0 },
+      { "^/",             sizeof("^/"), 0 },
+      { "^/ac",           sizeof("^/ac"), 0 }
+    };
+    static const char * const inputs[] = {
+      "", "/", "/a", "/a/", "/a/b", "/a/b/", "/a/b/c", "/a/b/cd", "/ac",
+      "/abc", "/b", "/b/", "/c", "/x/c", "/a?x=1", "/a/?x=1", "/bc"
+    };
+    const buffer value = { "/x", sizeof("/x"), 0 };
+    log_error_st * const errh = log_error_st_init();
+    buffer * const input = buffer_init();
+    buffer * const result = buffer_init();
+    pcre_keyvalue_ctx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    for (int n = 0; n < 500; ++n) {
+        pcre_keyvalue_buffer * const kvb = pcre_keyvalue_buffer_init();
+        const int nrules = 1 + rand() % 16;
+        for (int j = 0; j < nrules; ++j) {
+            const buffer * const key =
+              kvstr + rand() % (sizeof(kvstr)/sizeof(kvstr[0]));
+            assert(pcre_keyvalue_buffer_append(errh, kvb, key, &value));
+        }
+        for (size_t j = 0; j < sizeof(inputs)/sizeof(inputs[0]); ++j) {
+            buffer_copy_string(input, inputs[j]);
+            const int m = test_keyvalue_ref_match(kvb, input);
+            ctx.m = -1;
+            handler_t rc = pcre_keyvalue_buffer_process(kvb,&ctx,input,result);
+            assert(rc == (m >= 0 ? HANDLER_FINISHED : HANDLER_GO_ON));
+            assert(ctx.m == m);
+        }
+        pcre_keyvalue_buffer_free(kvb);
+    }
+
+    buffer_free(input);
+    buffer_free(result);
+    log_error_st_free(errh);
+}
+
+/* microbenchmark: t/test_keyvalue bench
+ * (large url.rewrite rule set, in which request matches last rule) */
+
+static double bench_now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench (void) {
+    static const int nrules[] = { 10, 100, 400 };
+    log_error_st * const errh = log_error_st_init();
+    buffer * const input = buffer_init();
+    buffer * const result = buffer_init();
+    const buffer value = { "/index.php?p=$1", sizeof("/index.php?p=$1"), 0 };
+    pcre_keyvalue_ctx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    for (size_t k = 0; k < sizeof(nrules)/sizeof(nrules[0]); ++k) {
+        pcre_keyvalue_buffer * const kvb = pcre_keyvalue_buffer_init();
+        char key[64];
+        buffer *keys = calloc(nrules[k], sizeof(buffer));
+        assert(keys);
+        for (int i = 0; i < nrules[k]; ++i) {
+            buffer_copy_string_len(keys+i, key,
+              snprintf(key, sizeof(key), "^/section%d/(.*)$", i));
+            assert(pcre_keyvalue_buffer_append(errh, kvb, keys+i, &value));
+        }
+        buffer_copy_string_len(input, key,
+          snprintf(key, sizeof(key), "/section%d/page.html", nrules[k]-1));
+
+        const int iters = 2000000 / nrules[k];
+        int sum = 0;
+        double t = bench_now();
+        for (int n = 0; n < iters; ++n)
+            sum += test_keyvalue_ref_match(kvb, input);
+        t = bench_now() - t;
+        printf("%4d rules: sequential %9.1f ns/req", nrules[k], t*1e9/iters);
+
+        t = bench_now();
+        for (int n = 0; n < iters; ++n) {
+            buffer_clear(result);
+            pcre_keyvalue_buffer_process(kvb, &ctx, input, result);
+            sum += ctx.m;
+        }
+        t = bench_now() - t;
+        printf("  prefilter %7.1f ns/req  (checksum %d)\n", t*1e9/iters, sum);
+
+        pcre_keyvalue_buffer_free(kvb);
+        for (int i = 0; i < nrules[k]; ++i) free(keys[i].ptr);
+        free(keys);
+    }
+
+    buffer_free(input);
+    buffer_free(result);
+    log_error_st_free(errh);
+}
 #endif
 
-int main (void) {
-  #ifdef HAVE_PCRE_H
+int main (int argc, char **argv) {
+  #ifdef HAVE_PCRE
     test_keyvalue_pcre_keyvalue_buffer_process();
+    test_keyvalue_pcre_keyvalue_prefix();
+    test_keyvalue_pcre_keyvalue_prefilter();
+    if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+        bench();
+  #else
+    UNUSED(argc);
+    UNUSED(argv);
   #endif
     return 0;
 }
+
+/*
+ * stub functions
+ */
+
+#ifdef HAVE_PCRE2_H
+static pcre2_match_data *test_keyvalue_md;
+pcre2_match_data * config_pcre2_match_data(void) {
+    if (NULL == test_keyvalue_md)
+        test_keyvalue_md = pcre2_match_data_create(20, NULL);
+    return test_keyvalue_md;
+}
+#endif
@@ -557,6 +557,46 @@ static void test_request_http_request_parse(request_st * const r)
                     "\r\n"));
 }
 
+static void test_request_arena(request_st * const r)
+{
+    request_arena * const a = &r->arena;
+    const uint64_t n = heap_nallocs_get();
+
+    char *p = request_arena_alloc(r, 3);
+    assert(p == a->ptr);
+    assert(n + 1 == heap_nallocs_get());
+    memset(p, 'x', 3);
+    char *q = request_arena_alloc(r, 1);
+    assert(0 == ((uintptr_t)q & 15));
+    assert(q == p + 16);
+    assert(0 == *q);
+
+    /* overflow to extra block; block is grown to fit on reset */
+    char *e = request_arena_alloc(r, 4000);
+    assert(NULL != a->extra);
+    memset(e, 'x', 4000);
+    request_arena_reset(a);
+    assert(NULL == a->extra && 0 == a->used);
+    assert(a->size >= 16 + 16 + 4000);
+
+    /* steady state: same allocations do not allocate; memory is zeroed */
+    const uint64_t m = heap_nallocs_get();
+    for (int i = 0; i < 3; ++i) {
+        p = request_arena_alloc(r, 3);
+        assert(0 == p[0] && 0 == p[2]);
+        memset(p, 'x', 3);
+        (void)request_arena_alloc(r, 1);
+        e = request_arena_alloc(r, 4000);
+        assert(0 == e[0] && 0 == e[3999]);
+        memset(e, 'x', 4000);
+        request_arena_reset(a);
+    }
+    assert(m == heap_nallocs_get());
+
+    request_arena_free(a);
+    assert(NULL == a->ptr && 0 == a->size);
+}
+
 #include "base.h"
 #include "burl.h"
 #include "log.h"
@@ -574,6 +614,7 @@ int main (void)
                              | HTTP_PARSEOPT_HOST_NORMALIZE;
 
     test_request_http_request_parse(&r);
+    test_request_arena(&r);
 
     free(r.target_orig.ptr);
     free(r.target.ptr);
@@ -0,0 +1,133 @@
+#include "first.h"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdlib.h>
+
+#include "timer_wheel.h"
+
+#define NTIMERS 512
+
+static tw_node nodes[NTIMERS];
+static uint64_t exp_brute[NTIMERS]; /* 0 if not scheduled */
+
+static uint64_t rand_u64 (void) {
+    return ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+}
+
+static uint64_t rand_delay (void) {
+    /* mix of short and long timeouts, some beyond wheel range */
+    switch (rand() & 7) {
+      case 0:  return 0;
+      case 1:  return rand() & 63;
+      case 2:  return rand() & 4095;
+      case 3:  return rand() % 300000;           /* 5 mins */
+      case 4:  return rand_u64() % 86400000;     /* 1 day */
+      case 5:  return rand_u64() % (1ull << 31); /* beyond 2^30 range */
+      default: return 1000 + (rand() % 60000);
+    }
+}
+
+static void test_timer_wheel_basic (void) {
+    tw_wheel w;
+    tw_node a = { NULL, NULL, 0, NULL, 0 };
+    tw_node b = { NULL, NULL, 0, NULL, 0 };
+    tw_init(&w, 1000);
+    assert(UINT64_MAX == tw_next(&w));
+    assert(NULL == tw_expire(&w, 5000));
+
+    tw_add(&w, &a, 7000);
+    tw_add(&w, &b, 6000);
+    assert(tw_is_scheduled(&a));
+    assert(tw_next(&w) <= 6000);
+    assert(NULL == tw_expire(&w, 5999));
+    assert(&b == tw_expire(&w, 6000));
+    assert(!tw_is_scheduled(&b));
+
+    /* reschedule earlier, then delete */
+    tw_add(&w, &a, 6500);
+    assert(NULL == tw_expire(&w, 6499));
+    tw_del(&w, &a);
+    assert(!tw_is_scheduled(&a));
+    assert(0 == w.count);
+    assert(NULL == tw_expire(&w, 100000));
+
+    /* timer already in the past expires on next tick processed */
+    tw_add(&w, &a, 1);
+    assert(NULL == tw_expire(&w, 100000));
+    assert(&a == tw_expire(&w, 100001));
+
+    /* large jump in time (e.g. clock change) skips empty slots */
+    tw_add(&w, &a, 100002 + (1ull << 34));
+    tw_add(&w, &b, 200000);
+    assert(tw_next(&w) <= 200000);
+    assert(&b == tw_expire(&w, 100000 + (1ull << 33)));
+    assert(tw_next(&w) <= 100002 + (1ull << 34));
+    assert(&a == tw_expire(&w, 100000 + (1ull << 40)));
+    assert(0 == w.count);
+}
+
+static void test_timer_wheel_random (void) {
+    tw_wheel w;
+    uint64_t now = rand_u64() % (1ull << 40);
+    tw_init(&w, now);
+    for (int i = 0; i < NTIMERS; ++i) {
+        nodes[i].pprev = NULL;
+        nodes[i].ctx = (void *)(uintptr_t)i;
+        exp_brute[i] = 0;
+    }
+
+    for (int round = 0; round < 20000; ++round) {
+        /* random add, reschedule, delete */
+        for (int j = rand() % 8; j; --j) {
+            const int i = rand() % NTIMERS;
+            if (exp_brute[i] && 0 == (rand() & 3)) {
+                tw_del(&w, nodes+i);
+                exp_brute[i] = 0;
+            }
+            else {
+                exp_brute[i] = now + 1 + rand_delay();
+                tw_add(&w, nodes+i, exp_brute[i]);
+            }
+        }
+
+        uint64_t min = UINT64_MAX;
+        uint32_t count = 0;
+        for (int i = 0; i < NTIMERS; ++i) {
+            if (exp_brute[i]) {
+                ++count;
+                if (min > exp_brute[i]) min = exp_brute[i];
+            }
+        }
+        assert(count == w.count);
+        const uint64_t next = tw_next(&w);
+        assert(next <= min);
+        assert(next > now);
+
+        /* advance time, sometimes to the exact next expiration */
+        switch (rand() & 3) {
+          case 0:  now = (min != UINT64_MAX) ? min : now + 1; break;
+          case 1:  now += 1 + (rand() & 15); break;
+          case 2:  now += 1 + (rand() % 2000); break;
+          default: now += 1 + (rand_u64() % 3600000); break;
+        }
+
+        for (tw_node *n = tw_expire(&w, now); n; n = n->next) {
+            const int i = (int)(uintptr_t)n->ctx;
+            assert(exp_brute[i] && exp_brute[i] <= now);
+            assert(!tw_is_scheduled(n));
+            exp_brute[i] = 0;
+        }
+        for (int i = 0; i < NTIMERS; ++i) {
+            assert(0 == exp_brute[i] || exp_brute[i] > now);
+            assert(tw_is_scheduled(nodes+i) == (0 != exp_brute[i]));
+        }
+    }
+}
+
+int main (void) {
+    test_timer_wheel_basic();
+    test_timer_wheel_random();
+
+    return 0;
+}
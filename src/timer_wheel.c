@@ -0,0 +1,171 @@
+/*
+ * timer_wheel - hierarchical timer wheel
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+#include "first.h"
+
+#include "timer_wheel.h"
+
+#include <string.h>
+
+#define TW_MASK (TW_LEVEL_SIZE - 1)
+#define TW_RANGE (1ull << (TW_LEVEL_BITS * TW_LEVELS))
+
+__attribute_const__
+static inline uint32_t tw_ctz64 (const uint64_t x) {
+  #if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctzll(x);
+  #else
+    uint32_t n = 0;
+    for (uint64_t v = x; !(v & 1); v >>= 1) ++n;
+    return n;
+  #endif
+}
+
+
+void tw_init (tw_wheel * const w, const uint64_t now)
+{
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+}
+
+
+static void tw_link (tw_wheel * const w, tw_node * const n)
+{
+    /* choose level by distance from w->now; slot index by expiration time */
+    uint64_t e = n->expires > w->now ? n->expires : w->now;
+    uint64_t d = e - w->now;
+    if (d >= TW_RANGE) {
+        d = TW_RANGE - 1;
+        e = w->now + d;
+    }
+    uint32_t lvl = 0;
+    while (d >= (1ull << (TW_LEVEL_BITS * (lvl+1)))) ++lvl;
+    const uint32_t ndx = (uint32_t)(e >> (TW_LEVEL_BITS * lvl)) & TW_MASK;
+
+    tw_node ** const head = &w->slots[lvl][ndx];
+    n->slot = (uint16_t)((lvl << TW_LEVEL_BITS) | ndx);
+    n->pprev = head;
+    n->next = *head;
+    if (n->next) n->next->pprev = &n->next;
+    *head = n;
+    w->occupied[lvl] |= (1ull << ndx);
+}
+
+
+static void tw_unlink (tw_wheel * const w, tw_node * const n)
+{
+    *n->pprev = n->next;
+    if (n->next) n->next->pprev = n->pprev;
+    const uint32_t lvl = n->slot >> TW_LEVEL_BITS;
+    const uint32_t ndx = n->slot & TW_MASK;
+    if (NULL == w->slots[lvl][ndx])
+        w->occupied[lvl] &= ~(1ull << ndx);
+    n->next = NULL;
+    n->pprev = NULL;
+}
+
+
+void tw_add (tw_wheel * const w, tw_node * const n, const uint64_t expires)
+{
+    if (n->pprev)
+        tw_unlink(w, n);
+    else
+        ++w->count;
+    n->expires = expires;
+    tw_link(w, n);
+}
+
+
+void tw_del (tw_wheel * const w, tw_node * const n)
+{
+    if (NULL == n->pprev) return;
+    tw_unlink(w, n);
+    --w->count;
+}
+
+
+static void tw_cascade (tw_wheel * const w, const uint32_t lvl, const uint32_t ndx)
+{
+    /* re-link timers from higher level slot into lower levels */
+    tw_node *n = w->slots[lvl][ndx];
+    w->slots[lvl][ndx] = NULL;
+    w->occupied[lvl] &= ~(1ull << ndx);
+    while (n) {
+        tw_node * const next = n->next;
+        tw_link(w, n);
+        n = next;
+    }
+}
+
+
+tw_node * tw_expire (tw_wheel * const w, const uint64_t now)
+{
+    tw_node *expired = NULL;
+    while (w->now <= now) {
+        if (0 == w->count) {
+            w->now = now + 1;
+            break;
+        }
+
+        const uint32_t ndx = (uint32_t)w->now & TW_MASK;
+        if (0 == ndx) {
+            /* cascade next slot of each level which wrapped */
+            for (uint32_t lvl = 1; lvl < TW_LEVELS; ++lvl) {
+                const uint32_t i =
+                  (uint32_t)(w->now >> (TW_LEVEL_BITS * lvl)) & TW_MASK;
+                if (w->slots[lvl][i]) tw_cascade(w, lvl, i);
+                if (0 != i) break;
+            }
+        }
+
+        tw_node *n = w->slots[0][ndx];
+        if (n) {
+            w->slots[0][ndx] = NULL;
+            w->occupied[0] &= ~(1ull << ndx);
+            do {
+                tw_node * const next = n->next;
+                if (n->expires > now) {
+                    /*(clamped; not yet expired)*/
+                    tw_link(w, n);
+                }
+                else {
+                    n->pprev = NULL;
+                    n->next = expired;
+                    expired = n;
+                    --w->count;
+                }
+                n = next;
+            } while (n);
+        }
+
+        /* skip ahead to next occupied level 0 slot or to next cascade */
+        ++w->now;
+        const uint64_t next = tw_next(w);
+        w->now = (next <= now) ? next : now + 1;
+    }
+    return expired;
+}
+
+
+uint64_t tw_next (const tw_wheel * const w)
+{
+    uint64_t next = UINT64_MAX;
+    if (0 == w->count) return next;
+    for (uint32_t lvl = 0; lvl < TW_LEVELS; ++lvl) {
+        const uint64_t occ = w->occupied[lvl];
+        if (0 == occ) continue;
+        const uint32_t shift = TW_LEVEL_BITS * lvl;
+        const uint64_t p = w->now >> shift;
+        const uint32_t c = (uint32_t)p & TW_MASK;
+        /* rotate bitmap so that bit 0 is the current slot */
+        uint64_t rot = c ? (occ >> c) | (occ << (TW_LEVEL_SIZE - c)) : occ;
+        if (lvl && (w->now & ((1ull << shift) - 1)))
+            rot &= ~1ull; /*(current slot already cascaded in this rotation)*/
+        const uint32_t dist = rot ? tw_ctz64(rot) : TW_LEVEL_SIZE;
+        const uint64_t t = (p + dist) << shift;
+        if (next > t) next = t;
+    }
+    return next;
+}
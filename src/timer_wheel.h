@@ -0,0 +1,52 @@
+#ifndef INCLUDED_TIMER_WHEEL_H
+#define INCLUDED_TIMER_WHEEL_H
+#include "first.h"
+
+/* hierarchical timer wheel (millisecond ticks)
+ *
+ * TW_LEVELS levels of TW_LEVEL_SIZE slots each; level n slots each span
+ * TW_LEVEL_SIZE^n msecs.  Timers are cascaded to lower levels as time
+ * advances, so that add, delete, and expire are O(1) (amortized), and only
+ * timers which expire are visited.  Expiration times further out than the
+ * wheel range (2^30 msecs, ~12 days) are parked in the last slot of the top
+ * level and are re-linked when cascaded. */
+
+#define TW_LEVEL_BITS 6
+#define TW_LEVEL_SIZE (1u << TW_LEVEL_BITS)
+#define TW_LEVELS     5
+
+typedef struct tw_node {
+    struct tw_node *next;
+    struct tw_node **pprev;     /* NULL if not scheduled */
+    uint64_t expires;           /* msecs */
+    void *ctx;
+    uint16_t slot;              /* (level << TW_LEVEL_BITS) | index */
+} tw_node;
+
+typedef struct tw_wheel {
+    uint64_t now;               /* next tick (msecs) to be processed */
+    uint32_t count;             /* number of scheduled timers */
+    uint64_t occupied[TW_LEVELS]; /* bitmap of non-empty slots per level */
+    tw_node *slots[TW_LEVELS][TW_LEVEL_SIZE];
+} tw_wheel;
+
+void tw_init (tw_wheel *w, uint64_t now);
+
+/* (re)schedule n to expire at expires (msecs) */
+void tw_add (tw_wheel *w, tw_node *n, uint64_t expires);
+
+void tw_del (tw_wheel *w, tw_node *n);
+
+static inline int tw_is_scheduled (const tw_node *n);
+static inline int tw_is_scheduled (const tw_node *n) {
+    return (NULL != n->pprev);
+}
+
+/* advance wheel to now (msecs); return list (linked via next) of timers
+ * which expired (expires <= now).  Returned timers are no longer scheduled */
+tw_node * tw_expire (tw_wheel *w, uint64_t now);
+
+/* lower bound (msecs) on time of next expiration; UINT64_MAX if none */
+uint64_t tw_next (const tw_wheel *w);
+
+#endif
@@ -8,7 +8,7 @@ BEGIN {
 
 use strict;
 use IO::Socket;
-use Test::More tests => 51;
+use Test::More tests => 53;
 use LightyTest;
 
 my $tf = LightyTest->new();
@@ -548,5 +548,35 @@ EOF
 $t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.1', 'HTTP-Status' => 200, 'HTTP-Content' => '12345'."\n", 'Content-Type' => 'text/plain', 'Connection' => 'close' } ];
 ok($tf->handle_http($t) == 0, 'Connection-header, comma and space after value');
 
+## file contents (small files are cached in stat_cache) must be reread
+## after an in-place rewrite of the same size which does not change mtime
+
+my $docroot = $tf->{'TESTDIR'}."/tmp/lighttpd/servers/www.example.org/pages";
+my $rewritten = "$docroot/rewritten.txt";
+my $mtime = time() - 60;
+open(my $fh, '>', $rewritten) or die("open $rewritten: $!");
+print $fh "AAAAAA\n";
+close($fh);
+utime($mtime, $mtime, $rewritten);
+sleep(3); # (contents of recently modified files are not cached)
+
+$t->{REQUEST}  = ( <<EOF
+GET /rewritten.txt HTTP/1.0
+EOF
+ );
+$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => "AAAAAA\n" } ];
+ok($tf->handle_http($t) == 0, 'GET file before in-place rewrite');
+
+open($fh, '+<', $rewritten) or die("open $rewritten: $!");
+print $fh "BBBBBB\n";
+close($fh);
+utime($mtime, $mtime, $rewritten); # same size, same mtime; ctime changed
+sleep(2); # (stat info might be cached for up to a second)
+
+$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => "BBBBBB\n" } ];
+ok($tf->handle_http($t) == 0, 'GET file after in-place rewrite of same size and mtime');
+
+unlink($rewritten);
+
 ok($tf->stop_proc == 0, "Stopping lighttpd");
 